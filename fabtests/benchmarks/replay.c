@@ -0,0 +1,638 @@
+/*
+ * Copyright (c) 2024 Hewlett Packard Enterprise Development LP. All rights reserved.
+ *
+ * This software is available to you under the BSD license
+ * below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Replay the data transfer calls captured by the ofi_hook_record provider.
+ *
+ * Each side replays the capture of one process of the recorded pair, in
+ * the order the calls were made, against the provider selected on the
+ * command line.  All peers map to the remote side, and all endpoints of
+ * the capture to one endpoint.  Calls are issued as fast as the
+ * completion window allows, or with their recorded spacing with -g.
+ * Data transfers use one buffer sized for the largest transfer of either
+ * side, and the data is not checked.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <getopt.h>
+
+#include <rdma/fi_errno.h>
+#include <rdma/fi_rma.h>
+#include <rdma/fi_tagged.h>
+
+#include <shared.h>
+#include <hmem.h>
+
+/*
+ * Capture file format.
+ *
+ * Note: keep in sync with prov/hook/record/include/hook_record.h
+ */
+#define RECORD_MAGIC		0x44524f4345524946ULL	/* "FIRECORD" */
+#define RECORD_VERSION		1
+#define RECORD_FLAG_DATA	(1 << 0)
+#define RECORD_FLAG_MULTI_RECV	(1 << 1)
+#define RECORD_PEER_UNSPEC	UINT32_MAX
+
+enum record_op {
+	record_op_recv,
+	record_op_send,
+	record_op_inject,
+	record_op_trecv,
+	record_op_tsend,
+	record_op_tinject,
+	record_op_read,
+	record_op_write,
+	record_op_inject_write,
+	record_op_max
+};
+
+struct record_entry {
+	uint64_t	ts;
+	uint64_t	len;
+	uint64_t	tag;
+	uint64_t	data;
+	uint32_t	peer;
+	uint16_t	ep;
+	uint8_t		op;
+	uint8_t		flags;
+};
+
+struct record_file_hdr {
+	uint64_t	magic;
+	uint32_t	version;
+	uint32_t	record_size;
+	uint32_t	pid;
+	uint32_t	ep_cnt;
+	uint64_t	record_cnt;
+	uint64_t	start_wall_ns;
+	uint64_t	duration_ns;
+	uint64_t	caps;
+	uint32_t	ep_type;
+	uint32_t	reserved;
+	char		prov_name[64];
+};
+
+static const char *op_names[record_op_max] = {
+	"recv", "send", "inject", "trecv", "tsend", "tinject",
+	"read", "write", "inject_write",
+};
+
+#define REPLAY_MR_KEY	(FT_MR_KEY + 0x100)
+#define REPLAY_CAPS	(FI_MSG | FI_TAGGED | FI_RMA)
+
+struct replay_ctx {
+	struct fi_context2	ctx;
+	struct replay_ctx	*next;
+	bool			tx;
+};
+
+/* Exchanged before the buffer is allocated */
+struct replay_setup {
+	uint64_t	max_len;
+	uint64_t	rma;
+};
+
+static char *capture_path;
+static struct record_file_hdr capture;
+static struct record_entry *records;
+static size_t record_cnt;
+static uint64_t record_caps, record_max_len;
+static int replay_ep = -1;
+static bool pace;
+
+static void *replay_buf;
+static size_t replay_size;
+static struct fid_mr *replay_mr;
+static void *replay_desc;
+
+static struct replay_ctx *ctx_pool, *ctx_free;
+static uint64_t tx_posted, tx_done, rx_posted, rx_done;
+static uint64_t op_calls[record_op_max], op_bytes[record_op_max];
+
+static int load_capture(void)
+{
+	struct record_entry *entry;
+	size_t i, cnt;
+	FILE *file;
+	long size;
+	int ret = -FI_EINVAL;
+
+	file = fopen(capture_path, "rb");
+	if (!file) {
+		fprintf(stderr, "%s: %s\n", capture_path, strerror(errno));
+		return -errno;
+	}
+
+	if (fread(&capture, sizeof(capture), 1, file) != 1 ||
+	    capture.magic != RECORD_MAGIC ||
+	    capture.version != RECORD_VERSION ||
+	    capture.record_size != sizeof(struct record_entry)) {
+		fprintf(stderr, "%s: not a capture file\n", capture_path);
+		goto out;
+	}
+
+	/* The header may lag the records if the process did not exit
+	 * cleanly, the file size does not.
+	 */
+	if (fseek(file, 0, SEEK_END) || (size = ftell(file)) < 0 ||
+	    fseek(file, sizeof(capture), SEEK_SET)) {
+		fprintf(stderr, "%s: %s\n", capture_path, strerror(errno));
+		goto out;
+	}
+	cnt = (size - sizeof(capture)) / sizeof(*records);
+
+	records = calloc(cnt ? cnt : 1, sizeof(*records));
+	if (!records) {
+		ret = -FI_ENOMEM;
+		goto out;
+	}
+	if (fread(records, sizeof(*records), cnt, file) != cnt) {
+		fprintf(stderr, "%s: short read\n", capture_path);
+		goto out;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		entry = &records[i];
+		if (entry->op >= record_op_max ||
+		    (replay_ep >= 0 && entry->ep != replay_ep))
+			continue;
+
+		switch (entry->op) {
+		case record_op_recv:
+		case record_op_send:
+		case record_op_inject:
+			record_caps |= FI_MSG;
+			break;
+		case record_op_trecv:
+		case record_op_tsend:
+		case record_op_tinject:
+			record_caps |= FI_TAGGED;
+			break;
+		default:
+			record_caps |= FI_RMA;
+			break;
+		}
+		record_max_len = MAX(record_max_len, entry->len);
+		records[record_cnt++] = *entry;
+	}
+
+	if (!record_cnt) {
+		fprintf(stderr, "%s: no calls to replay\n", capture_path);
+		goto out;
+	}
+	ret = 0;
+out:
+	fclose(file);
+	return ret;
+}
+
+/*
+ * Swap a control message with the peer, using the receive posted by
+ * ft_init_fabric() or the previous exchange.
+ */
+static int exchange(void *local, void *peer, size_t len)
+{
+	int ret;
+
+	ret = ft_hmem_copy_to(opts.iface, opts.device,
+			      tx_buf + ft_tx_prefix_size(), local, len);
+	if (ret)
+		return ret;
+
+	ret = ft_tx(ep, remote_fi_addr, len, &tx_ctx);
+	if (ret)
+		return ret;
+
+	ret = ft_get_rx_comp(rx_seq);
+	if (ret)
+		return ret;
+
+	ret = ft_hmem_copy_from(opts.iface, opts.device, peer,
+				rx_buf + ft_rx_prefix_size(), len);
+	if (ret)
+		return ret;
+
+	return ft_post_rx(ep, rx_size, &rx_ctx);
+}
+
+static int setup(void)
+{
+	struct replay_setup local, peer;
+	char temp[FT_MAX_CTRL_MSG], peer_temp[FT_MAX_CTRL_MSG];
+	struct fi_rma_iov *rma_iov = (struct fi_rma_iov *) temp;
+	size_t key_size, len = FT_MAX_CTRL_MSG;
+	int i, ret;
+
+	local.max_len = record_max_len;
+	local.rma = !!(fi->caps & FI_RMA);
+	ret = exchange(&local, &peer, sizeof(local));
+	if (ret)
+		return ret;
+
+	replay_size = MAX(MAX(local.max_len, peer.max_len), 1);
+	ret = ft_hmem_alloc(opts.iface, opts.device, &replay_buf, replay_size);
+	if (ret)
+		return ret;
+
+	replay_mr = &no_mr;
+	ret = ft_reg_mr(fi, replay_buf, replay_size, ft_info_to_mr_access(fi),
+			REPLAY_MR_KEY, opts.iface, opts.device, &replay_mr,
+			&replay_desc);
+	if (ret) {
+		FT_PRINTERR("ft_reg_mr", ret);
+		return ret;
+	}
+
+	if (local.rma || peer.rma) {
+		ret = ft_fill_rma_info(replay_mr, replay_buf, rma_iov,
+				       &key_size, &len);
+		if (ret)
+			return ret;
+
+		ret = exchange(temp, peer_temp, len);
+		if (ret)
+			return ret;
+
+		ret = ft_get_rma_info((struct fi_rma_iov *) peer_temp, &remote,
+				      key_size);
+		if (ret)
+			return ret;
+	}
+
+	ctx_pool = calloc(2 * opts.window_size, sizeof(*ctx_pool));
+	if (!ctx_pool)
+		return -FI_ENOMEM;
+	for (i = 0; i < 2 * opts.window_size; i++) {
+		ctx_pool[i].next = ctx_free;
+		ctx_free = &ctx_pool[i];
+	}
+
+	/* Start together, with no receive left posted by the exchanges */
+	return ft_sync_inband(false);
+}
+
+static int replay_progress(struct fid_cq *cq)
+{
+	struct fi_cq_err_entry comp;
+	struct replay_ctx *ctx;
+	int ret;
+
+	ret = fi_cq_read(cq, &comp, 1);
+	if (ret == -FI_EAGAIN)
+		return 0;
+	if (ret == -FI_EAVAIL)
+		return ft_cq_readerr(cq);
+	if (ret < 0) {
+		FT_PRINTERR("fi_cq_read", ret);
+		return ret;
+	}
+
+	ctx = comp.op_context;
+	if (!ctx)
+		return 0;
+
+	if (ctx->tx)
+		tx_done++;
+	else
+		rx_done++;
+	ctx->next = ctx_free;
+	ctx_free = ctx;
+	return 0;
+}
+
+static int replay_poll(void)
+{
+	int ret;
+
+	ret = replay_progress(txcq);
+	if (ret || rxcq == txcq)
+		return ret;
+
+	return replay_progress(rxcq);
+}
+
+static bool replay_inject(struct record_entry *entry)
+{
+	return (entry->op == record_op_inject ||
+		entry->op == record_op_tinject ||
+		entry->op == record_op_inject_write) &&
+	       entry->len <= fi->tx_attr->inject_size;
+}
+
+static ssize_t replay_post(struct record_entry *entry)
+{
+	struct replay_ctx *ctx = NULL;
+	fi_addr_t addr;
+	bool rx, data;
+	size_t len;
+	ssize_t ret;
+
+	addr = entry->peer == RECORD_PEER_UNSPEC ? FI_ADDR_UNSPEC :
+		remote_fi_addr;
+	len = MIN(entry->len, replay_size);
+	if (entry->op < record_op_read)
+		len = MIN(len, fi->ep_attr->max_msg_size);
+	data = (entry->flags & RECORD_FLAG_DATA) &&
+	       fi->domain_attr->cq_data_size;
+	rx = entry->op == record_op_recv || entry->op == record_op_trecv;
+
+	if (!replay_inject(entry)) {
+		if (rx ? rx_posted - rx_done >= (uint64_t) opts.window_size :
+			 tx_posted - tx_done >= (uint64_t) opts.window_size)
+			return -FI_EAGAIN;
+		ctx = ctx_free;
+		ctx->tx = !rx;
+	}
+
+	switch (entry->op) {
+	case record_op_recv:
+		ret = fi_recv(ep, replay_buf, len, replay_desc, addr, ctx);
+		break;
+	case record_op_trecv:
+		ret = fi_trecv(ep, replay_buf, len, replay_desc, addr,
+			       entry->tag, entry->data, ctx);
+		break;
+	case record_op_send:
+	case record_op_inject:
+		if (!ctx)
+			ret = data ? fi_injectdata(ep, replay_buf, len,
+						   entry->data, addr) :
+			      fi_inject(ep, replay_buf, len, addr);
+		else
+			ret = data ? fi_senddata(ep, replay_buf, len,
+						 replay_desc, entry->data,
+						 addr, ctx) :
+			      fi_send(ep, replay_buf, len, replay_desc, addr,
+				      ctx);
+		break;
+	case record_op_tsend:
+	case record_op_tinject:
+		if (!ctx)
+			ret = data ? fi_tinjectdata(ep, replay_buf, len,
+						    entry->data, addr,
+						    entry->tag) :
+			      fi_tinject(ep, replay_buf, len, addr,
+					 entry->tag);
+		else
+			ret = data ? fi_tsenddata(ep, replay_buf, len,
+						  replay_desc, entry->data,
+						  addr, entry->tag, ctx) :
+			      fi_tsend(ep, replay_buf, len, replay_desc, addr,
+				       entry->tag, ctx);
+		break;
+	case record_op_read:
+		ret = fi_read(ep, replay_buf, len, replay_desc, remote_fi_addr,
+			      remote.addr, remote.key, ctx);
+		break;
+	default:
+		if (!ctx)
+			ret = fi_inject_write(ep, replay_buf, len,
+					      remote_fi_addr, remote.addr,
+					      remote.key);
+		else
+			ret = fi_write(ep, replay_buf, len, replay_desc,
+				       remote_fi_addr, remote.addr, remote.key,
+				       ctx);
+		break;
+	}
+	if (ret)
+		return ret;
+
+	if (ctx) {
+		ctx_free = ctx->next;
+		if (rx)
+			rx_posted++;
+		else
+			tx_posted++;
+	}
+	op_calls[entry->op]++;
+	op_bytes[entry->op] += len;
+	return 0;
+}
+
+static int replay(void)
+{
+	struct record_entry *entry;
+	uint64_t start, target;
+	ssize_t ret;
+	size_t i;
+
+	start = ft_gettime_ns();
+	for (i = 0; i < record_cnt; i++) {
+		entry = &records[i];
+		if (pace) {
+			target = start + entry->ts - records[0].ts;
+			while (ft_gettime_ns() < target) {
+				ret = replay_poll();
+				if (ret)
+					return (int) ret;
+			}
+		}
+
+		while ((ret = replay_post(entry)) == -FI_EAGAIN) {
+			ret = replay_poll();
+			if (ret)
+				return (int) ret;
+		}
+		if (ret) {
+			FT_ERR("replaying %s: %s", op_names[entry->op],
+			       fi_strerror((int) -ret));
+			return (int) ret;
+		}
+	}
+
+	while (tx_done != tx_posted || rx_done != rx_posted) {
+		ret = replay_poll();
+		if (ret)
+			return (int) ret;
+	}
+	return 0;
+}
+
+static void report(uint64_t elapsed_ns)
+{
+	char str[FT_STR_LEN];
+	uint64_t calls = 0, bytes = 0;
+	double sec = elapsed_ns / 1e9;
+	int i;
+
+	printf("capture: %s, %s, %u endpoint(s), %zu calls over %.3f s\n",
+	       capture_path, capture.prov_name[0] ? capture.prov_name : "-",
+	       capture.ep_cnt, record_cnt, capture.duration_ns / 1e9);
+	printf("%-14s %12s %12s\n", "op", "calls", "bytes");
+	for (i = 0; i < record_op_max; i++) {
+		if (!op_calls[i])
+			continue;
+		printf("%-14s %12" PRIu64 " %12s\n", op_names[i], op_calls[i],
+		       size_str(str, op_bytes[i]));
+		calls += op_calls[i];
+		bytes += op_bytes[i];
+	}
+	printf("replayed %" PRIu64 " calls, %s in %.3f s: %.2f MB/sec, "
+	       "%.0f calls/sec\n", calls, size_str(str, bytes), sec,
+	       sec > 0 ? bytes / sec / 1e6 : 0, sec > 0 ? calls / sec : 0);
+}
+
+static int run(void)
+{
+	uint64_t start;
+	int i, ret;
+
+	if (hints->ep_attr->type == FI_EP_MSG) {
+		if (!opts.dst_addr) {
+			ret = ft_start_server();
+			if (ret)
+				return ret;
+		}
+
+		ret = opts.dst_addr ? ft_client_connect() : ft_server_connect();
+	} else {
+		ret = ft_init_fabric();
+	}
+	if (ret)
+		return ret;
+
+	ret = setup();
+	if (ret)
+		return ret;
+
+	start = ft_gettime_ns();
+	for (i = 0; i < opts.iterations; i++) {
+		ret = replay();
+		if (ret)
+			return ret;
+	}
+	report(ft_gettime_ns() - start);
+
+	/* ft_finalize() needs RX buffer to be posted for proper sync */
+	ret = ft_post_rx(ep, rx_size, &rx_ctx);
+	if (ret)
+		return ret;
+
+	return ft_finalize();
+}
+
+static void cleanup(void)
+{
+	if (replay_mr != &no_mr)
+		FT_CLOSE_FID(replay_mr);
+	if (replay_buf)
+		ft_hmem_free(opts.iface, replay_buf);
+	free(ctx_pool);
+	free(records);
+}
+
+int main(int argc, char **argv)
+{
+	int op, ret, cleanup_ret;
+
+	opts = INIT_OPTS;
+	opts.iterations = 1;
+	opts.options |= FT_OPT_SIZE;
+	opts.transfer_size = FT_MAX_CTRL_MSG;
+
+	hints = fi_allocinfo();
+	if (!hints)
+		return EXIT_FAILURE;
+
+	while ((op = getopt_long(argc, argv, "x:n:gW:h" CS_OPTS INFO_OPTS,
+				 long_opts, &lopt_idx)) != -1) {
+		switch (op) {
+		default:
+			if (!ft_parse_long_opts(op, optarg))
+				continue;
+			ft_parseinfo(op, optarg, hints, &opts);
+			ft_parsecsopts(op, optarg, &opts);
+			break;
+		case 'x':
+			capture_path = optarg;
+			break;
+		case 'n':
+			replay_ep = atoi(optarg);
+			break;
+		case 'g':
+			pace = true;
+			break;
+		case 'W':
+			opts.window_size = atoi(optarg);
+			break;
+		case '?':
+		case 'h':
+			ft_csusage(argv[0], "Replay a capture of the "
+				   "ofi_hook_record provider.");
+			FT_PRINT_OPTS_USAGE("-x <file>", "capture to replay "
+					    "(required)");
+			FT_PRINT_OPTS_USAGE("-n <index>", "only replay the "
+					    "calls of this endpoint");
+			FT_PRINT_OPTS_USAGE("-g", "keep the recorded time "
+					    "between calls");
+			FT_PRINT_OPTS_USAGE("-W <size>", "transmits and "
+					    "receives in flight (default: 64)");
+			ft_longopts_usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!capture_path || opts.window_size <= 0) {
+		fprintf(stderr, "a capture file must be given with -x\n");
+		return EXIT_FAILURE;
+	}
+
+	if (optind < argc)
+		opts.dst_addr = argv[optind];
+
+	ret = load_capture();
+	if (ret)
+		goto out;
+
+	/* Both sides must agree on FI_TAGGED, which selects the format of
+	 * the control messages.  The recorded caps cover the side of the
+	 * pair that is only the target of RMA.
+	 */
+	hints->caps = FI_MSG | FI_TAGGED | record_caps |
+		      (capture.caps & REPLAY_CAPS);
+	if (!hints->ep_attr->type)
+		hints->ep_attr->type = capture.ep_type ?
+				       capture.ep_type : FI_EP_RDM;
+	hints->domain_attr->resource_mgmt = FI_RM_ENABLED;
+	hints->mode = FI_CONTEXT | FI_CONTEXT2;
+	hints->domain_attr->threading = FI_THREAD_DOMAIN;
+	hints->domain_attr->mr_mode = opts.mr_mode;
+	hints->addr_format = opts.address_format;
+
+	ret = run();
+out:
+	cleanup();
+	cleanup_ret = ft_free_res();
+	return ft_exit_code(ret ? ret : cleanup_ret);
+}
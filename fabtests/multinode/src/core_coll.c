@@ -276,6 +276,452 @@ static int sum_all_reduce_test_run(enum fi_collective_op coll_op, enum fi_op op,
 	return -FI_ENOEQ;
 }
 
+static char *coll_op_name(enum fi_collective_op coll_op)
+{
+	switch (coll_op) {
+	case FI_ALLREDUCE:
+		return "allreduce";
+	case FI_REDUCE:
+		return "reduce";
+	case FI_GATHER:
+		return "gather";
+	case FI_ALLTOALL:
+		return "alltoall";
+	case FI_REDUCE_SCATTER:
+		return "reduce_scatter";
+	case FI_BROADCAST:
+		return "broadcast";
+	default:
+		return "unknown";
+	}
+}
+
+/*
+ * Runs coll_op on count uint64 values per rank, summing where it reduces.
+ * Broadcast sends data from the root into result on the other ranks.
+ */
+static int coll_vector(enum fi_collective_op coll_op, uint64_t *data,
+		       uint64_t *result, size_t count, fi_addr_t root)
+{
+	uint64_t done_flag;
+	int err;
+
+	coll_addr = fi_mc_addr(coll_mc);
+	switch (coll_op) {
+	case FI_ALLREDUCE:
+		err = fi_allreduce(ep, data, count, NULL, result, NULL,
+				   coll_addr, FI_UINT64, FI_SUM, 0, &done_flag);
+		break;
+	case FI_REDUCE:
+		err = fi_reduce(ep, data, count, NULL, result, NULL, coll_addr,
+				root, FI_UINT64, FI_SUM, 0, &done_flag);
+		break;
+	case FI_GATHER:
+		err = fi_gather(ep, data, count, NULL, result, NULL, coll_addr,
+				root, FI_UINT64, 0, &done_flag);
+		break;
+	case FI_ALLTOALL:
+		err = fi_alltoall(ep, data, count, NULL, result, NULL,
+				  coll_addr, FI_UINT64, 0, &done_flag);
+		break;
+	case FI_REDUCE_SCATTER:
+		err = fi_reduce_scatter(ep, data, count, NULL, result, NULL,
+					coll_addr, FI_UINT64, FI_SUM, 0,
+					&done_flag);
+		break;
+	case FI_BROADCAST:
+		err = fi_broadcast(ep, pm_job.my_rank == root ? data : result,
+				   count, NULL, coll_addr, root, FI_UINT64, 0,
+				   &done_flag);
+		break;
+	default:
+		return -FI_ENOSYS;
+	}
+	if (err) {
+		FT_PRINTERR("collective operation failed", err);
+		return err;
+	}
+
+	return wait_for_comp(&done_flag);
+}
+
+/*
+ * Vector lengths are chosen to exercise every allreduce algorithm the
+ * provider may select, including blocks of uneven size.
+ */
+static int sum_all_reduce_vector_test_run(enum fi_collective_op coll_op,
+		enum fi_op op, enum fi_datatype datatype)
+{
+	size_t counts[] = { 2, pm_job.num_ranks + 1, 1000, 70001, 200003 };
+	uint64_t *data, *result, expect, rank_sum = 0;
+	size_t max_count = counts[ARRAY_SIZE(counts) - 1];
+	size_t i, j;
+	int err = FI_SUCCESS;
+
+	assert(coll_op == FI_ALLREDUCE);
+	assert(op == FI_SUM);
+	assert(datatype == FI_UINT64);
+
+	data = malloc(max_count * sizeof(*data));
+	result = malloc(max_count * sizeof(*result));
+	if (!data || !result) {
+		err = -FI_ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < pm_job.num_ranks; i++)
+		rank_sum += i;
+
+	for (i = 0; i < ARRAY_SIZE(counts) && !err; i++) {
+		for (j = 0; j < counts[i]; j++)
+			data[j] = pm_job.my_rank * counts[i] + j;
+		memset(result, 0, counts[i] * sizeof(*result));
+
+		err = coll_vector(FI_ALLREDUCE, data, result, counts[i], 0);
+		if (err)
+			goto out;
+
+		for (j = 0; j < counts[i]; j++) {
+			expect = rank_sum * counts[i] + pm_job.num_ranks * j;
+			if (result[j] != expect) {
+				FT_DEBUG("allreduce of %zu values failed at %zu; "
+					 "expect: %" PRIu64 ", actual: %" PRIu64,
+					 counts[i], j, expect, result[j]);
+				err = -FI_ENOEQ;
+				break;
+			}
+		}
+	}
+
+out:
+	free(result);
+	free(data);
+	return err;
+}
+
+/*
+ * Run with -T.  Sizes are per rank; large sizes are capped at about 1 GiB
+ * moved per rank.
+ */
+static int coll_perf_test_run(enum fi_collective_op coll_op,
+		enum fi_op op, enum fi_datatype datatype)
+{
+	uint64_t *data, *result;
+	size_t size, max_size = 0, count;
+	int i, j, iters, err = FI_SUCCESS;
+
+	if (!ft_check_opts(FT_OPT_PERF))
+		return FI_SUCCESS;
+
+	for (i = 0; i < TEST_CNT; i++) {
+		if (ft_use_size(i, opts.sizes_enabled))
+			max_size = MAX(max_size, test_size[i].size);
+	}
+
+	/* gather, alltoall and reduce_scatter move a block per rank */
+	data = calloc(pm_job.num_ranks, max_size);
+	result = calloc(pm_job.num_ranks, max_size);
+	if (!data || !result) {
+		err = -FI_ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < TEST_CNT && !err; i++) {
+		size = test_size[i].size;
+		if (!ft_use_size(i, opts.sizes_enabled) ||
+		    size < sizeof(*data) || (size & (size - 1)))
+			continue;
+
+		count = size / sizeof(*data);
+		iters = MIN(opts.iterations, MAX(1, (1 << 30) / size));
+
+		for (j = 0; j < opts.warmup_iterations && !err; j++)
+			err = coll_vector(coll_op, data, result, count, 0);
+
+		pm_barrier();
+		ft_start();
+		for (j = 0; j < iters && !err; j++)
+			err = coll_vector(coll_op, data, result, count, 0);
+		ft_stop();
+
+		if (!err && pm_job.my_rank == 0)
+			show_perf(coll_op_name(coll_op), size, iters, &start,
+				  &end, 1);
+	}
+
+out:
+	free(result);
+	free(data);
+	return err;
+}
+
+/*
+ * Vector lengths cover uneven splits across the group and vectors long
+ * enough to be pipelined in segments.
+ */
+static int broadcast_vector_test_run(enum fi_collective_op coll_op,
+		enum fi_op op, enum fi_datatype datatype)
+{
+	size_t counts[] = { pm_job.num_ranks + 1, 1000, 70001 };
+	fi_addr_t roots[] = { 0, pm_job.num_ranks - 1 };
+	size_t max_count = counts[ARRAY_SIZE(counts) - 1];
+	uint64_t *data, *result;
+	size_t i, j, k;
+	int err = FI_SUCCESS;
+
+	assert(coll_op == FI_BROADCAST);
+	assert(datatype == FI_UINT64);
+
+	data = malloc(max_count * sizeof(*data));
+	result = malloc(max_count * sizeof(*result));
+	if (!data || !result) {
+		err = -FI_ENOMEM;
+		goto out;
+	}
+
+	for (k = 0; k < ARRAY_SIZE(roots) && !err; k++) {
+		for (i = 0; i < ARRAY_SIZE(counts) && !err; i++) {
+			for (j = 0; j < counts[i]; j++)
+				data[j] = roots[k] * counts[i] + j;
+			memset(result, 0, counts[i] * sizeof(*result));
+
+			err = coll_vector(FI_BROADCAST, data, result, counts[i],
+					  roots[k]);
+			if (err || pm_job.my_rank == roots[k])
+				continue;
+
+			for (j = 0; j < counts[i]; j++) {
+				if (result[j] != data[j]) {
+					FT_DEBUG("broadcast of %zu values from %"
+						 PRIu64 " failed at %zu; expect: %"
+						 PRIu64 ", actual: %" PRIu64,
+						 counts[i], roots[k], j, data[j],
+						 result[j]);
+					err = -FI_ENOEQ;
+					break;
+				}
+			}
+		}
+	}
+
+out:
+	free(result);
+	free(data);
+	return err;
+}
+
+/* Reduces to the first and the last rank to exercise non-zero roots */
+static int sum_reduce_test_run(enum fi_collective_op coll_op, enum fi_op op,
+		enum fi_datatype datatype)
+{
+	size_t counts[] = { 1, 1000, 70001 };
+	fi_addr_t roots[] = { 0, pm_job.num_ranks - 1 };
+	uint64_t *data, *result, expect, rank_sum = 0;
+	size_t max_count = counts[ARRAY_SIZE(counts) - 1];
+	size_t i, j, k;
+	int err = FI_SUCCESS;
+
+	assert(coll_op == FI_REDUCE);
+	assert(op == FI_SUM);
+	assert(datatype == FI_UINT64);
+
+	data = malloc(max_count * sizeof(*data));
+	result = malloc(max_count * sizeof(*result));
+	if (!data || !result) {
+		err = -FI_ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < pm_job.num_ranks; i++)
+		rank_sum += i;
+
+	for (k = 0; k < ARRAY_SIZE(roots) && !err; k++) {
+		for (i = 0; i < ARRAY_SIZE(counts) && !err; i++) {
+			for (j = 0; j < counts[i]; j++)
+				data[j] = pm_job.my_rank * counts[i] + j;
+			memset(result, 0, counts[i] * sizeof(*result));
+
+			err = coll_vector(FI_REDUCE, data, result, counts[i],
+					  roots[k]);
+			if (err || pm_job.my_rank != roots[k])
+				continue;
+
+			for (j = 0; j < counts[i]; j++) {
+				expect = rank_sum * counts[i] +
+					 pm_job.num_ranks * j;
+				if (result[j] != expect) {
+					FT_DEBUG("reduce of %zu values to %" PRIu64
+						 " failed at %zu; expect: %" PRIu64
+						 ", actual: %" PRIu64, counts[i],
+						 roots[k], j, expect, result[j]);
+					err = -FI_ENOEQ;
+					break;
+				}
+			}
+		}
+	}
+
+out:
+	free(result);
+	free(data);
+	return err;
+}
+
+static int gather_test_run(enum fi_collective_op coll_op, enum fi_op op,
+		enum fi_datatype datatype)
+{
+	size_t counts[] = { 1, 1000 };
+	fi_addr_t roots[] = { 0, pm_job.num_ranks - 1 };
+	size_t max_count = counts[ARRAY_SIZE(counts) - 1];
+	uint64_t *data, *result;
+	size_t i, j, k;
+	int err = FI_SUCCESS;
+
+	assert(coll_op == FI_GATHER);
+	assert(datatype == FI_UINT64);
+
+	data = malloc(max_count * sizeof(*data));
+	result = malloc(max_count * pm_job.num_ranks * sizeof(*result));
+	if (!data || !result) {
+		err = -FI_ENOMEM;
+		goto out;
+	}
+
+	for (k = 0; k < ARRAY_SIZE(roots) && !err; k++) {
+		for (i = 0; i < ARRAY_SIZE(counts) && !err; i++) {
+			for (j = 0; j < counts[i]; j++)
+				data[j] = pm_job.my_rank * counts[i] + j;
+			memset(result, 0, counts[i] * pm_job.num_ranks *
+			       sizeof(*result));
+
+			err = coll_vector(FI_GATHER, data, result, counts[i],
+					  roots[k]);
+			if (err || pm_job.my_rank != roots[k])
+				continue;
+
+			for (j = 0; j < counts[i] * pm_job.num_ranks; j++) {
+				if (result[j] != j) {
+					FT_DEBUG("gather of %zu values to %" PRIu64
+						 " failed at %zu; actual: %" PRIu64,
+						 counts[i], roots[k], j, result[j]);
+					err = -FI_ENOEQ;
+					break;
+				}
+			}
+		}
+	}
+
+out:
+	free(result);
+	free(data);
+	return err;
+}
+
+/* Each value encodes its source rank, destination rank and offset */
+static int alltoall_test_run(enum fi_collective_op coll_op, enum fi_op op,
+		enum fi_datatype datatype)
+{
+	size_t counts[] = { 1, 1000 };
+	size_t max_count = counts[ARRAY_SIZE(counts) - 1];
+	size_t num_ranks = pm_job.num_ranks;
+	uint64_t *data, *result, expect;
+	size_t i, j, r;
+	int err = FI_SUCCESS;
+
+	assert(coll_op == FI_ALLTOALL);
+	assert(datatype == FI_UINT64);
+
+	data = malloc(max_count * num_ranks * sizeof(*data));
+	result = malloc(max_count * num_ranks * sizeof(*result));
+	if (!data || !result) {
+		err = -FI_ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(counts) && !err; i++) {
+		for (j = 0; j < counts[i] * num_ranks; j++)
+			data[j] = pm_job.my_rank * counts[i] * num_ranks + j;
+		memset(result, 0, counts[i] * num_ranks * sizeof(*result));
+
+		err = coll_vector(FI_ALLTOALL, data, result, counts[i], 0);
+		if (err)
+			goto out;
+
+		for (r = 0; r < num_ranks && !err; r++) {
+			for (j = 0; j < counts[i]; j++) {
+				expect = (r * num_ranks + pm_job.my_rank) *
+					 counts[i] + j;
+				if (result[r * counts[i] + j] != expect) {
+					FT_DEBUG("alltoall of %zu values failed "
+						 "from rank %zu at %zu; expect: %"
+						 PRIu64 ", actual: %" PRIu64,
+						 counts[i], r, j, expect,
+						 result[r * counts[i] + j]);
+					err = -FI_ENOEQ;
+					break;
+				}
+			}
+		}
+	}
+
+out:
+	free(result);
+	free(data);
+	return err;
+}
+
+static int sum_reduce_scatter_test_run(enum fi_collective_op coll_op,
+		enum fi_op op, enum fi_datatype datatype)
+{
+	size_t counts[] = { 1, 1000, 30001 };
+	size_t max_count = counts[ARRAY_SIZE(counts) - 1];
+	size_t num_ranks = pm_job.num_ranks;
+	uint64_t *data, *result, expect, rank_sum = 0;
+	size_t i, j;
+	int err = FI_SUCCESS;
+
+	assert(coll_op == FI_REDUCE_SCATTER);
+	assert(op == FI_SUM);
+	assert(datatype == FI_UINT64);
+
+	data = malloc(max_count * num_ranks * sizeof(*data));
+	result = malloc(max_count * sizeof(*result));
+	if (!data || !result) {
+		err = -FI_ENOMEM;
+		goto out;
+	}
+
+	for (i = 0; i < num_ranks; i++)
+		rank_sum += i;
+
+	for (i = 0; i < ARRAY_SIZE(counts) && !err; i++) {
+		for (j = 0; j < counts[i] * num_ranks; j++)
+			data[j] = pm_job.my_rank * counts[i] * num_ranks + j;
+		memset(result, 0, counts[i] * sizeof(*result));
+
+		err = coll_vector(FI_REDUCE_SCATTER, data, result, counts[i], 0);
+		if (err)
+			goto out;
+
+		for (j = 0; j < counts[i]; j++) {
+			expect = rank_sum * counts[i] * num_ranks + num_ranks *
+				 (pm_job.my_rank * counts[i] + j);
+			if (result[j] != expect) {
+				FT_DEBUG("reduce_scatter of %zu values failed at "
+					 "%zu; expect: %" PRIu64 ", actual: %"
+					 PRIu64, counts[i], j, expect, result[j]);
+				err = -FI_ENOEQ;
+				break;
+			}
+		}
+	}
+
+out:
+	free(result);
+	free(data);
+	return err;
+}
+
 static int all_gather_test_run(enum fi_collective_op coll_op, enum fi_op op,
 		enum fi_datatype datatype)
 {
@@ -487,6 +933,24 @@ struct coll_test tests[] = {
 		.op = FI_SUM,
 		.datatype = FI_UINT64,
 	},
+	{
+		.name = "sum_all_reduce_vector_test",
+		.setup = coll_setup,
+		.run = sum_all_reduce_vector_test_run,
+		.teardown = coll_teardown,
+		.coll_op = FI_ALLREDUCE,
+		.op = FI_SUM,
+		.datatype = FI_UINT64,
+	},
+	{
+		.name = "all_reduce_perf_test",
+		.setup = coll_setup,
+		.run = coll_perf_test_run,
+		.teardown = coll_teardown,
+		.coll_op = FI_ALLREDUCE,
+		.op = FI_SUM,
+		.datatype = FI_UINT64,
+	},
 	{
 		.name = "all_gather_test",
 		.setup = coll_setup,
@@ -514,6 +978,96 @@ struct coll_test tests[] = {
 		.op = FI_NOOP,
 		.datatype = FI_UINT64
 	},
+	{
+		.name = "broadcast_vector_test",
+		.setup = coll_setup,
+		.run = broadcast_vector_test_run,
+		.teardown = coll_teardown,
+		.coll_op = FI_BROADCAST,
+		.op = FI_NOOP,
+		.datatype = FI_UINT64,
+	},
+	{
+		.name = "broadcast_perf_test",
+		.setup = coll_setup,
+		.run = coll_perf_test_run,
+		.teardown = coll_teardown,
+		.coll_op = FI_BROADCAST,
+		.op = FI_NOOP,
+		.datatype = FI_UINT64,
+	},
+	{
+		.name = "sum_reduce_test",
+		.setup = coll_setup,
+		.run = sum_reduce_test_run,
+		.teardown = coll_teardown,
+		.coll_op = FI_REDUCE,
+		.op = FI_SUM,
+		.datatype = FI_UINT64,
+	},
+	{
+		.name = "reduce_perf_test",
+		.setup = coll_setup,
+		.run = coll_perf_test_run,
+		.teardown = coll_teardown,
+		.coll_op = FI_REDUCE,
+		.op = FI_SUM,
+		.datatype = FI_UINT64,
+	},
+	{
+		.name = "gather_test",
+		.setup = coll_setup,
+		.run = gather_test_run,
+		.teardown = coll_teardown,
+		.coll_op = FI_GATHER,
+		.op = FI_NOOP,
+		.datatype = FI_UINT64,
+	},
+	{
+		.name = "gather_perf_test",
+		.setup = coll_setup,
+		.run = coll_perf_test_run,
+		.teardown = coll_teardown,
+		.coll_op = FI_GATHER,
+		.op = FI_NOOP,
+		.datatype = FI_UINT64,
+	},
+	{
+		.name = "alltoall_test",
+		.setup = coll_setup,
+		.run = alltoall_test_run,
+		.teardown = coll_teardown,
+		.coll_op = FI_ALLTOALL,
+		.op = FI_NOOP,
+		.datatype = FI_UINT64,
+	},
+	{
+		.name = "alltoall_perf_test",
+		.setup = coll_setup,
+		.run = coll_perf_test_run,
+		.teardown = coll_teardown,
+		.coll_op = FI_ALLTOALL,
+		.op = FI_NOOP,
+		.datatype = FI_UINT64,
+	},
+	{
+		.name = "sum_reduce_scatter_test",
+		.setup = coll_setup,
+		.run = sum_reduce_scatter_test_run,
+		.teardown = coll_teardown,
+		.coll_op = FI_REDUCE_SCATTER,
+		.op = FI_SUM,
+		.datatype = FI_UINT64,
+	},
+	{
+		.name = "reduce_scatter_perf_test",
+		.setup = coll_setup,
+		.run = coll_perf_test_run,
+		.teardown = coll_teardown,
+		.coll_op = FI_REDUCE_SCATTER,
+		.op = FI_SUM,
+		.datatype = FI_UINT64,
+	},
 	{
 		.name = "empty_test_to_stop_the_sequence_of_execution",
 		.run = NULL,
@@ -39,6 +39,7 @@
 #include <limits.h>
 #include <stdio.h>
 #include <malloc.h>
+#include <pthread.h>
 
 #include "unit_common.h"
 #include "shared.h"
@@ -56,6 +57,8 @@ enum alloc_type {
 static void *reuse_addr = NULL;
 static char err_buf[512];
 static size_t mr_buf_size = 16384;
+static int churn_threads;
+static size_t churn_iters = 10000;
 
 /* Given a time value, determine the expected cached time value. The assumption
  * is the cache value should at least have a CACHE_IMPROVEMENT_PERCENT time
@@ -742,12 +745,150 @@ static int mr_cache_rocr_test(void)
 	return ret;
 }
 
+/* Registration churn: every thread cycles through CHURN_BUF_CNT buffers of
+ * its own, registering and closing an MR for one buffer per iteration.  Once
+ * every CHURN_REMAP_INTERVAL iterations, the buffer is unmapped and mapped
+ * again at the same address, which invalidates its cache entries and forces
+ * the next registration of the buffer to miss.
+ */
+#define CHURN_BUF_CNT		64
+#define CHURN_REMAP_INTERVAL	64
+
+struct churn_thread {
+	pthread_t	thread;
+	int		id;
+	char		*base;
+	int		ret;
+};
+
+static int churn_remap(void *buf)
+{
+	void *ptr;
+
+	if (munmap(buf, mr_buf_size))
+		return -errno;
+
+	ptr = mmap(buf, mr_buf_size, PROT_READ | PROT_WRITE,
+		   MAP_ANONYMOUS | MAP_PRIVATE | MAP_FIXED, -1, 0);
+	return ptr == MAP_FAILED ? -errno : 0;
+}
+
+static void *churn_thread_func(void *arg)
+{
+	struct churn_thread *ct = arg;
+	struct fid_mr *mr;
+	struct iovec iov;
+	struct fi_mr_attr mr_attr = {
+		.mr_iov = &iov,
+		.iov_count = 1,
+		.access = ft_info_to_mr_access(fi),
+		.requested_key = FT_MR_KEY + ct->id + 1,
+		.iface = FI_HMEM_SYSTEM,
+	};
+	unsigned int seed = ct->id;
+	size_t i;
+	int idx;
+
+	iov.iov_len = mr_buf_size;
+	for (i = 0; i < churn_iters; i++) {
+		idx = rand_r(&seed) % CHURN_BUF_CNT;
+		iov.iov_base = ct->base + idx * mr_buf_size;
+
+		if (i && !(i % CHURN_REMAP_INTERVAL)) {
+			ct->ret = churn_remap(iov.iov_base);
+			if (ct->ret)
+				return NULL;
+		}
+
+		ct->ret = fi_mr_regattr(domain, &mr_attr, 0, &mr);
+		if (ct->ret)
+			return NULL;
+
+		ct->ret = fi_close(&mr->fid);
+		if (ct->ret)
+			return NULL;
+	}
+
+	return NULL;
+}
+
+static int mr_cache_churn_test(void)
+{
+	struct churn_thread *ct;
+	struct timespec a, b;
+	int64_t elapsed;
+	size_t len;
+	int i, started = 0, ret = 0;
+
+	if (!churn_threads) {
+		sprintf(err_buf, "Registration churn not requested");
+		return SKIPPED;
+	}
+
+	ct = calloc(churn_threads, sizeof(*ct));
+	if (!ct) {
+		sprintf(err_buf, "calloc failed");
+		return TEST_RET_VAL(-ENOMEM, FAIL);
+	}
+
+	len = mr_buf_size * CHURN_BUF_CNT;
+	for (i = 0; i < churn_threads; i++) {
+		ct[i].id = i;
+		ct[i].base = mmap(NULL, len, PROT_READ | PROT_WRITE,
+				  MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+		if (ct[i].base == MAP_FAILED) {
+			ct[i].base = NULL;
+			ret = -errno;
+			FT_UNIT_STRERR(err_buf, "mmap failed", ret);
+			goto out;
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &a);
+	for (; started < churn_threads; started++) {
+		ret = -pthread_create(&ct[started].thread, NULL,
+				      churn_thread_func, &ct[started]);
+		if (ret) {
+			FT_UNIT_STRERR(err_buf, "pthread_create failed", ret);
+			break;
+		}
+	}
+
+	for (i = 0; i < started; i++) {
+		pthread_join(ct[i].thread, NULL);
+		if (ct[i].ret && !ret) {
+			ret = ct[i].ret;
+			FT_UNIT_STRERR(err_buf, "registration churn failed",
+				       ret);
+		}
+	}
+	clock_gettime(CLOCK_MONOTONIC, &b);
+
+	if (!ret) {
+		elapsed = get_elapsed(&a, &b, NANO);
+		printf("MR churn: %d threads, %zu registrations, "
+		       "%.1f ns/reg per thread, %.3f Mreg/s\n", churn_threads,
+		       churn_iters * churn_threads,
+		       (double) elapsed / churn_iters,
+		       (double) churn_iters * churn_threads * 1000 / elapsed);
+	}
+
+out:
+	for (i = 0; i < churn_threads; i++) {
+		if (ct[i].base)
+			munmap(ct[i].base, len);
+	}
+	free(ct);
+	return TEST_RET_VAL(ret, PASS);
+}
+
 struct test_entry test_array[] = {
 	TEST_ENTRY(mr_cache_mmap_test, "MR cache eviction test using MMAP"),
 	TEST_ENTRY(mr_cache_brk_test, "MR cache eviction test using BRK"),
 	TEST_ENTRY(mr_cache_sbrk_test, "MR cache eviction test using SBRK"),
 	TEST_ENTRY(mr_cache_cuda_test, "MR cache eviction test using CUDA"),
 	TEST_ENTRY(mr_cache_rocr_test, "MR cache eviction test using ROCR"),
+	TEST_ENTRY(mr_cache_churn_test, "MR cache registration churn"),
 	{ NULL, "" }
 };
 
@@ -763,8 +904,15 @@ static void usage(char *name)
 		"allocation is returned. This can be used to verify the \n"
 		"underlying physical memory changes between MMAP, BRK, and \n"
 		"SBRK allocations. When running as non-root, the reported \n"
-		"physical address is always zero.");
+		"physical address is always zero.\n\n"
+		"With -t, threads register and close MRs over a set of\n"
+		"buffers, some of which are remapped along the way, and\n"
+		"the registration rate is reported.");
 	FT_PRINT_OPTS_USAGE("-s <bytes>", "Memory region size to be tested.");
+	FT_PRINT_OPTS_USAGE("-t <threads>",
+			    "Number of registration churn threads.");
+	FT_PRINT_OPTS_USAGE("-n <iterations>",
+			    "Registrations per churn thread (default 10000).");
 	FT_PRINT_OPTS_USAGE("-H", "Enable provider FI_HMEM support");
 }
 
@@ -790,7 +938,7 @@ int main(int argc, char **argv)
 	if (!hints)
 		return EXIT_FAILURE;
 
-	while ((op = getopt(argc, argv, FAB_OPTS "h" "s:")) != -1) {
+	while ((op = getopt(argc, argv, FAB_OPTS "h" "s:t:n:")) != -1) {
 		switch (op) {
 		default:
 			ft_parseinfo(op, optarg, hints, &opts);
@@ -810,6 +958,12 @@ int main(int argc, char **argv)
 				goto out;
 			}
 			break;
+		case 't':
+			churn_threads = atoi(optarg);
+			break;
+		case 'n':
+			churn_iters = strtoul(optarg, NULL, 10);
+			break;
 		case '?':
 		case 'h':
 			usage(argv[0]);
@@ -825,6 +979,9 @@ int main(int argc, char **argv)
 	if (opts.options & FT_OPT_ENABLE_HMEM)
 		hints->caps |= FI_HMEM;
 
+	if (churn_threads)
+		hints->domain_attr->threading = FI_THREAD_SAFE;
+
 	ret = fi_getinfo(FT_FIVERSION, NULL, 0, 0, hints, &fi);
 	if (ret) {
 		hints->caps &= ~FI_RMA;
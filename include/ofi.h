@@ -438,6 +438,8 @@ uint8_t ofi_lsb(uint64_t num);
 extern int ofi_fork_unsafe;
 extern size_t ofi_universe_size;
 extern int ofi_av_remove_cleanup;
+extern int ofi_av_flat_index;
+extern int ofi_wait_uring;
 extern char *ofi_offload_coll_prov_name;
 extern int ofi_prefer_sysconfig;
 
@@ -86,6 +86,19 @@ extern void (*ofi_atomic_swap_handlers[OFI_SWAP_OP_CNT][OFI_DATATYPE_CNT])
 	ofi_atomic_swap_handlers[op - OFI_SWAP_OP_START][datatype](dst, src, \
 								cmp, res, cnt)
 
+/* Non-atomic element-wise reductions for buffers owned by the caller,
+ * e.g. the local step of a collective.  Indexed like the write handlers.
+ */
+extern void (*ofi_atomic_reduce_handlers[OFI_WRITE_OP_CNT][OFI_DATATYPE_CNT])
+			(void *dst, const void *src, size_t cnt);
+
+#define ofi_atomic_reduce_handler(op, datatype, dst, src, cnt) \
+	ofi_atomic_reduce_handlers[op][datatype](dst, src, cnt)
+
+void ofi_atomic_init(void);
+int ofi_atomic_reduce_init(const char *isa);
+const char *ofi_atomic_reduce_isa(void);
+
 int ofi_atomic_valid(const struct fi_provider *prov,
 		     enum fi_datatype datatype, enum fi_op op, uint64_t flags);
 
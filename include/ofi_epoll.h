@@ -386,12 +386,77 @@ static inline uint32_t ofi_poll_to_epoll(uint32_t events)
 	return events;
 }
 
-/* Dynamic poll: selects between using poll vs epoll.
+/* Poll file descriptor set over io_uring.  Each fd has a one-shot poll
+ * request outstanding on the ring, which is rearmed as its event is
+ * reported.  That keeps the level-triggered behavior of epoll and poll,
+ * while rearming, fd set changes and the wait itself are submitted
+ * together in a single io_uring_enter call.
+ */
+struct ofi_pollring;
+
+#ifdef HAVE_LIBURING
+int ofi_pollring_create(struct ofi_pollring **ring,
+			enum ofi_lock_type lock_type);
+int ofi_pollring_add(struct ofi_pollring *ring, int fd, uint32_t events,
+		     void *context);
+int ofi_pollring_mod(struct ofi_pollring *ring, int fd, uint32_t events,
+		     void *context);
+int ofi_pollring_del(struct ofi_pollring *ring, int fd);
+int ofi_pollring_wait(struct ofi_pollring *ring,
+		      struct ofi_epollfds_event *events,
+		      int maxevents, int timeout);
+int ofi_pollring_fd(struct ofi_pollring *ring);
+void ofi_pollring_close(struct ofi_pollring *ring);
+#else
+static inline int
+ofi_pollring_create(struct ofi_pollring **ring, enum ofi_lock_type lock_type)
+{
+	return -FI_ENOSYS;
+}
+
+static inline int
+ofi_pollring_add(struct ofi_pollring *ring, int fd, uint32_t events,
+		 void *context)
+{
+	return -FI_ENOSYS;
+}
+
+static inline int
+ofi_pollring_mod(struct ofi_pollring *ring, int fd, uint32_t events,
+		 void *context)
+{
+	return -FI_ENOSYS;
+}
+
+static inline int ofi_pollring_del(struct ofi_pollring *ring, int fd)
+{
+	return -FI_ENOSYS;
+}
+
+static inline int
+ofi_pollring_wait(struct ofi_pollring *ring, struct ofi_epollfds_event *events,
+		  int maxevents, int timeout)
+{
+	return -FI_ENOSYS;
+}
+
+static inline int ofi_pollring_fd(struct ofi_pollring *ring)
+{
+	return -1;
+}
+
+static inline void ofi_pollring_close(struct ofi_pollring *ring)
+{
+}
+#endif
+
+/* Dynamic poll: selects between using poll, epoll or io_uring.
  */
 enum ofi_dynpoll_type {
 	OFI_DYNPOLL_UNINIT,
 	OFI_DYNPOLL_EPOLL,
 	OFI_DYNPOLL_POLL,
+	OFI_DYNPOLL_URING,
 };
 
 struct ofi_dynpoll {
@@ -399,6 +464,7 @@ struct ofi_dynpoll {
 	union {
 		struct ofi_pollfds *pfds;
 		ofi_epoll_t ep;
+		struct ofi_pollring *ring;
 	};
 
 	int	(*add)(struct ofi_dynpoll *dynpoll, int fd, uint32_t events,
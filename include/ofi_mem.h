@@ -342,9 +342,11 @@ enum {
 	OFI_BUFPOOL_HUGEPAGES		= 1 << 3,
 	OFI_BUFPOOL_NONSHARED		= 1 << 4,
 	OFI_BUFPOOL_NO_ZERO		= 1 << 5,
+	OFI_BUFPOOL_THREAD_CACHE	= 1 << 6,
 };
 
 struct ofi_bufpool_region;
+struct ofi_bufpool_cache;
 
 struct ofi_bufpool_attr {
 	size_t 		size;
@@ -372,6 +374,9 @@ struct ofi_bufpool {
 	size_t				alloc_size;
 	size_t				region_size;
 	struct ofi_bufpool_attr		attr;
+
+	/* Per-thread magazines, set with OFI_BUFPOOL_THREAD_CACHE */
+	struct ofi_bufpool_cache	*cache;
 };
 
 struct ofi_bufpool_region {
@@ -424,6 +429,14 @@ void ofi_bufpool_destroy(struct ofi_bufpool *pool);
 
 int ofi_bufpool_grow(struct ofi_bufpool *pool);
 
+/*
+ * Pools created with OFI_BUFPOOL_THREAD_CACHE are thread safe.  Each
+ * thread allocates from and frees to its own pair of magazines, which are
+ * exchanged as a whole with a shared depot when they run empty or full.
+ */
+void *ofi_bufpool_cache_alloc(struct ofi_bufpool *pool);
+void ofi_bufpool_cache_free(struct ofi_bufpool *pool, void *buf);
+
 static inline struct ofi_bufpool_hdr *ofi_buf_hdr(void *buf)
 {
 	return (struct ofi_bufpool_hdr *)
@@ -475,6 +488,11 @@ static inline void ofi_buf_free(void *buf)
 	assert(ofi_buf_hdr(buf)->ftr->magic == OFI_MAGIC_SIZE_T);
 	assert(ofi_buf_is_valid(buf));
 
+	if (ofi_buf_pool(buf)->cache) {
+		ofi_bufpool_cache_free(ofi_buf_pool(buf), buf);
+		return;
+	}
+
 	slist_insert_head(&ofi_buf_hdr(buf)->entry.slist,
 			  &ofi_buf_pool(buf)->free_list.entries);
 }
@@ -537,6 +555,9 @@ static inline void *ofi_buf_alloc(struct ofi_bufpool *pool)
 	struct ofi_bufpool_hdr *buf_hdr;
 
 	assert(!(pool->attr.flags & OFI_BUFPOOL_INDEXED));
+	if (pool->cache)
+		return ofi_bufpool_cache_alloc(pool);
+
 	if (ofi_bufpool_empty(pool)) {
 		if (ofi_bufpool_grow(pool))
 			return NULL;
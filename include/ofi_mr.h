@@ -154,6 +154,7 @@ struct ofi_mr_entry {
 	struct ofi_mr_info		info;
 	struct ofi_rbnode		*node;
 	int				use_cnt;
+	bool				accessed;
 	struct dlist_entry		list_entry;
 	union ofi_mr_hmem_info		hmem_info;
 	uint8_t				data[];
@@ -207,6 +208,36 @@ void ofi_monitor_notify(struct ofi_mem_monitor *monitor,
 			const void *addr, size_t len);
 void ofi_monitor_flush(struct ofi_mem_monitor *monitor);
 
+/*
+ * Monitors which receive several invalidation events at a time queue their
+ * ranges in a batch.  Adjacent and overlapping ranges are merged, and each
+ * cache is walked once for the whole batch.  Batches must be notified with
+ * the same locks held as ofi_monitor_notify().
+ */
+#define OFI_MONITOR_BATCH_SIZE	64
+
+struct ofi_monitor_batch {
+	size_t			cnt;
+	size_t			event_cnt;
+	struct iovec		range[OFI_MONITOR_BATCH_SIZE];
+};
+
+static inline void ofi_monitor_batch_init(struct ofi_monitor_batch *batch)
+{
+	batch->cnt = 0;
+	batch->event_cnt = 0;
+}
+
+static inline bool ofi_monitor_batch_full(struct ofi_monitor_batch *batch)
+{
+	return batch->cnt == OFI_MONITOR_BATCH_SIZE;
+}
+
+void ofi_monitor_batch_add(struct ofi_monitor_batch *batch,
+			   const void *addr, size_t len);
+void ofi_monitor_notify_batch(struct ofi_mem_monitor *monitor,
+			      struct ofi_monitor_batch *batch);
+
 int ofi_monitor_subscribe(struct ofi_mem_monitor *monitor,
 			  const void *addr, size_t len,
 			  union ofi_mr_hmem_info *hmem_info);
@@ -390,12 +421,50 @@ struct ofi_mr_cache_params {
 	int				cuda_monitor_enabled;
 	int				rocr_monitor_enabled;
 	int				ze_monitor_enabled;
+	int				async_dereg;
 };
 
 extern struct ofi_mr_cache_params	cache_params;
 
 #define OFI_HMEM_MAX 6
 
+/*
+ * Caches set up through ofi_mr_cache_init() split their entries over
+ * address range shards, each with its own lock.  A region that fits in a
+ * single OFI_MR_CACHE_SHARD_SHIFT sized granule is kept in the shard of
+ * that granule.  Regions crossing a granule boundary are kept in an extra
+ * spanning shard, which is searched in addition to the granule shard.
+ *
+ * Tree updates are made under the shard lock and bump seq, so lookups of
+ * system memory can walk the tree without the lock and retry if a writer
+ * got in the way.  Tree nodes and entries are never returned to the OS
+ * while the cache exists, which keeps those unlocked reads safe.
+ *
+ * gen is bumped whenever a region is dropped from the shard.  Each thread
+ * keeps a small table of the regions it last looked up, which is trusted
+ * for as long as the gen of the shard they came from does not change.
+ */
+#define OFI_MR_CACHE_SHARD_CNT		16
+#define OFI_MR_CACHE_SHARD_SHIFT	21
+
+struct ofi_mr_cache_shard {
+	uint32_t			seq;
+	uint32_t			gen;
+	struct ofi_rbmap		tree;
+
+	pthread_mutex_t			lock __attribute__((aligned(64)));
+	struct dlist_entry		lru_list;
+	struct dlist_entry		dead_region_list;
+	size_t				lru_cnt;
+
+	size_t				search_cnt __attribute__((aligned(64)));
+	size_t				delete_cnt;
+	size_t				hit_cnt;
+} __attribute__((aligned(64)));
+
+/* Caches that are not set up by ofi_mr_cache_init() have no shards and
+ * use tree, lru_list and dead_region_list under mm_lock instead.
+ */
 struct ofi_mr_cache {
 	struct util_domain		*domain;
 	const struct fi_provider	*prov;
@@ -418,8 +487,24 @@ struct ofi_mr_cache {
 	size_t				delete_cnt;
 	size_t				hit_cnt;
 	size_t				notify_cnt;
+	size_t				notify_batch_cnt;
+	size_t				notify_event_cnt;
+	size_t				notify_batch_max;
 	struct ofi_bufpool		*entry_pool;
 
+	struct ofi_mr_cache_shard	*shards;
+	size_t				dead_cnt;
+	size_t				evict_shard;
+	uint64_t			id;
+
+	/* Optional thread freeing dead regions as notifications create them */
+	pthread_t			dereg_thread;
+	pthread_mutex_t			dereg_lock;
+	pthread_cond_t			dereg_cond;
+	bool				dereg_active;
+	bool				dereg_stop;
+	size_t				dereg_async_cnt;
+
 	int				(*add_region)(struct ofi_mr_cache *cache,
 						      struct ofi_mr_entry *entry);
 	void				(*delete_region)(struct ofi_mr_cache *cache,
@@ -432,6 +517,9 @@ int ofi_mr_cache_init(struct util_domain *domain,
 void ofi_mr_cache_cleanup(struct ofi_mr_cache *cache);
 
 void ofi_mr_cache_notify(struct ofi_mr_cache *cache, const void *addr, size_t len);
+void ofi_mr_cache_notify_batch(struct ofi_mr_cache *cache,
+			       const struct iovec *range, size_t cnt,
+			       size_t event_cnt);
 
 int ofi_ipc_cache_open(struct ofi_mr_cache **cache,
 			struct util_domain *domain);
@@ -447,6 +535,7 @@ static inline bool ofi_mr_cache_full(struct ofi_mr_cache *cache)
 }
 
 bool ofi_mr_cache_flush(struct ofi_mr_cache *cache, bool flush_lru);
+bool ofi_mr_cache_lru_empty(struct ofi_mr_cache *cache);
 
 /**
  * @brief Given an ofi_mr_info (with an iov range, ipc_info)
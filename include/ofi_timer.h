@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2024 Hewlett Packard Enterprise Development LP. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _OFI_TIMER_H_
+#define _OFI_TIMER_H_
+
+#include "config.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ofi_list.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Hierarchical timing wheel.
+ *
+ * Level 0 has one slot per tick, and each level above it has slots covering
+ * a whole rotation of the level below, so four levels of 64 slots span 2^24
+ * ticks.  Arming and cancelling a timer is a list insert or remove.  As
+ * time advances, the slots of the higher levels are cascaded down and the
+ * timers of the level 0 slot whose tick is reached are expired.  Timers
+ * further out than the wheel spans are parked in the last slot of the top
+ * level and cascaded again until they come within range.
+ *
+ * The wheel does no locking: arm, cancel and expire must be serialized by
+ * the owner, normally under its progress lock.  Callbacks run from
+ * ofi_timer_wheel_expire() and may arm or cancel any timer, including
+ * their own.
+ */
+#define OFI_TIMER_WHEEL_BITS	6
+#define OFI_TIMER_WHEEL_SLOTS	(1 << OFI_TIMER_WHEEL_BITS)
+#define OFI_TIMER_WHEEL_MASK	(OFI_TIMER_WHEEL_SLOTS - 1)
+#define OFI_TIMER_WHEEL_LEVELS	4
+
+struct ofi_timer;
+typedef void (*ofi_timer_cb)(struct ofi_timer *timer);
+
+struct ofi_timer {
+	struct dlist_entry	entry;
+	uint64_t		expires;	/* in ticks */
+	ofi_timer_cb		callback;
+	uint8_t			level;
+	uint8_t			slot;
+};
+
+struct ofi_timer_wheel {
+	uint64_t		tick_ns;
+	uint64_t		now;		/* last tick expired */
+	size_t			cnt;
+	uint64_t		occupied[OFI_TIMER_WHEEL_LEVELS];
+	struct dlist_entry	slots[OFI_TIMER_WHEEL_LEVELS]
+				     [OFI_TIMER_WHEEL_SLOTS];
+};
+
+void ofi_timer_wheel_init(struct ofi_timer_wheel *wheel, uint64_t tick_ns,
+			  uint64_t now_ns);
+void ofi_timer_arm(struct ofi_timer_wheel *wheel, struct ofi_timer *timer,
+		   uint64_t expires_ns);
+void ofi_timer_cancel(struct ofi_timer_wheel *wheel, struct ofi_timer *timer);
+size_t ofi_timer_wheel_expire(struct ofi_timer_wheel *wheel, uint64_t now_ns);
+uint64_t ofi_timer_wheel_next(struct ofi_timer_wheel *wheel);
+int ofi_timer_wheel_timeout(struct ofi_timer_wheel *wheel, uint64_t now_ns,
+			    int timeout);
+
+static inline void ofi_timer_init(struct ofi_timer *timer, ofi_timer_cb callback)
+{
+	dlist_init(&timer->entry);
+	timer->callback = callback;
+}
+
+static inline bool ofi_timer_armed(struct ofi_timer *timer)
+{
+	return !dlist_empty(&timer->entry);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _OFI_TIMER_H_ */
@@ -60,6 +60,7 @@
 #include <ofi_list.h>
 #include <ofi_mem.h>
 #include <ofi_rbuf.h>
+#include <ofi_atomic_queue.h>
 #include <ofi_signal.h>
 #include <ofi_enosys.h>
 #include <ofi_osd.h>
@@ -430,10 +431,7 @@ struct util_wait_fd {
 	struct fd_signal	signal;
 	struct dlist_entry	fd_list;
 
-	union {
-		ofi_epoll_t		epoll_fd;
-		struct ofi_pollfds	*pollfds;
-	};
+	struct ofi_dynpoll	dynpoll;
 	uint64_t		change_index;
 };
 
@@ -462,7 +460,10 @@ int ofi_wait_fd_open(struct fid_fabric *fabric, struct fi_wait_attr *attr,
 int ofi_wait_add_fd(struct util_wait *wait, int fd, uint32_t events,
 		    ofi_wait_try_func wait_try, void *arg, void *context);
 int ofi_wait_del_fd(struct util_wait *wait, int fd);
+int ofi_wait_fdset_add(struct util_wait_fd *wait_fd, int fd,
+		       uint32_t events, void *context);
 int ofi_wait_fdset_del(struct util_wait_fd *wait_fd, int fd);
+void ofi_wait_fd_reset(struct util_wait_fd *wait_fd);
 int ofi_wait_add_fid(struct util_wait *wat, fid_t fid, uint32_t events,
 		     ofi_wait_try_func wait_try);
 int ofi_wait_del_fid(struct util_wait *wait, fid_t fid);
@@ -498,6 +499,15 @@ struct util_cq_aux_entry {
 
 OFI_DECLARE_CIRQUE(struct fi_cq_tagged_entry, util_comp_cirq);
 
+/* Slot of the lock-free completion ring, aux is set for error entries */
+struct util_comp_entry {
+	struct fi_cq_tagged_entry	comp;
+	fi_addr_t			src;
+	struct util_cq_aux_entry	*aux;
+};
+
+OFI_DECLARE_ATOMIC_Q(struct util_comp_entry, util_comp_aq);
+
 typedef void (*ofi_cq_progress_func)(struct util_cq *cq);
 
 struct util_cq {
@@ -525,12 +535,29 @@ struct util_cq {
 	struct util_comp_cirq	*cirq;
 	fi_addr_t		*src;
 	struct slist		aux_queue;
-	fi_cq_read_func		read_entry;
+	enum fi_cq_format	format;
+
+	/* Multi-producer mode, replaces cirq and src, see ofi_cq_init_mpsc.
+	 * Writers only take cq_lock to queue entries on aux_queue, which
+	 * is read after the ring is drained.  Readers serialize on cq_lock.
+	 */
+	struct util_comp_aq	*aq;
+	ofi_atomic32_t		aux_cnt;
+	struct util_cq_aux_entry *err_entry;
 };
 
 int ofi_cq_init(const struct fi_provider *prov, struct fid_domain *domain,
 		 struct fi_cq_attr *attr, struct util_cq *cq,
 		 ofi_cq_progress_func progress, void *context);
+/* Same as ofi_cq_init, for providers that only access the CQ through the
+ * ofi_cq_write and ofi_cq_read calls and never touch cirq directly.  On
+ * FI_THREAD_SAFE domains the CQ is then backed by a lock-free multi-producer
+ * ring, so that threads completing operations on different endpoints do not
+ * serialize on cq_lock.
+ */
+int ofi_cq_init_mpsc(const struct fi_provider *prov, struct fid_domain *domain,
+		     struct fi_cq_attr *attr, struct util_cq *cq,
+		     ofi_cq_progress_func progress, void *context);
 int ofi_check_bind_cq_flags(struct util_ep *ep, struct util_cq *cq,
 			    uint64_t flags);
 void ofi_cq_progress(struct util_cq *cq);
@@ -554,14 +581,53 @@ int ofi_cq_write_overflow(struct util_cq *cq, void *context, uint64_t flags,
 			  size_t len, void *buf, uint64_t data, uint64_t tag,
 			  fi_addr_t src);
 
+int ofi_cq_write_mpsc(struct util_cq *cq, void *context, uint64_t flags,
+		      size_t len, void *buf, uint64_t data, uint64_t tag,
+		      fi_addr_t src);
+ssize_t ofi_cq_read_entries_mpsc(struct util_cq *cq, void *buf, size_t count,
+				 fi_addr_t *src_addr);
+
+/* All CQ formats are a prefix of fi_cq_tagged_entry */
+static inline void *
+ofi_cq_copy_entries(struct util_cq *cq, void *buf,
+		    const struct fi_cq_tagged_entry *comp, size_t count)
+{
+	struct fi_cq_data_entry *data = buf;
+	struct fi_cq_msg_entry *msg = buf;
+	struct fi_cq_entry *ctx = buf;
+	size_t i;
+
+	switch (cq->format) {
+	case FI_CQ_FORMAT_TAGGED:
+		memcpy(buf, comp, count * sizeof(*comp));
+		return (struct fi_cq_tagged_entry *) buf + count;
+	case FI_CQ_FORMAT_DATA:
+		for (i = 0; i < count; i++)
+			data[i] = *(const struct fi_cq_data_entry *) &comp[i];
+		return data + count;
+	case FI_CQ_FORMAT_MSG:
+		for (i = 0; i < count; i++)
+			msg[i] = *(const struct fi_cq_msg_entry *) &comp[i];
+		return msg + count;
+	default:
+		for (i = 0; i < count; i++)
+			ctx[i].op_context = comp[i].op_context;
+		return ctx + count;
+	}
+}
+
 static inline
 ssize_t ofi_cq_read_entries(struct util_cq *cq, void *buf, size_t count,
 			fi_addr_t *src_addr)
 {
 	struct fi_cq_tagged_entry *entry;
 	struct util_cq_aux_entry *aux_entry;
+	size_t rindex, run, n;
 	ssize_t i;
 
+	if (cq->aq)
+		return ofi_cq_read_entries_mpsc(cq, buf, count, src_addr);
+
 	ofi_genlock_lock(&cq->cq_lock);
 
 	if (cq->err_data) {
@@ -577,14 +643,28 @@ ssize_t ofi_cq_read_entries(struct util_cq *cq, void *buf, size_t count,
 	if (count > ofi_cirque_usedcnt(cq->cirq))
 		count = ofi_cirque_usedcnt(cq->cirq);
 
-	for (i = 0; i < (ssize_t) count; i++) {
+	for (i = 0; i < (ssize_t) count; ) {
 		entry = ofi_cirque_head(cq->cirq);
 		if (!(entry->flags & UTIL_FLAG_AUX)) {
-			if (src_addr)
-				src_addr[i] = cq->src ? cq->src[ofi_cirque_rindex(cq->cirq)] :
-							FI_ADDR_NOTAVAIL;
-			cq->read_entry(&buf, entry);
-			ofi_cirque_discard(cq->cirq);
+			/* Copy the run of regular entries up to the next aux
+			 * entry or the end of the ring at once.
+			 */
+			rindex = ofi_cirque_rindex(cq->cirq);
+			run = MIN(count - i, cq->cirq->size - rindex);
+			for (n = 1; n < run && !(entry[n].flags & UTIL_FLAG_AUX);
+			     n++)
+				;
+
+			if (src_addr && cq->src) {
+				memcpy(&src_addr[i], &cq->src[rindex],
+				       n * sizeof(*src_addr));
+			} else if (src_addr) {
+				for (run = 0; run < n; run++)
+					src_addr[i + run] = FI_ADDR_NOTAVAIL;
+			}
+			buf = ofi_cq_copy_entries(cq, buf, entry, n);
+			cq->cirq->rcnt += n;
+			i += n;
 		} else {
 			assert(!slist_empty(&cq->aux_queue));
 			aux_entry = container_of(cq->aux_queue.head,
@@ -600,9 +680,12 @@ ssize_t ofi_cq_read_entries(struct util_cq *cq, void *buf, size_t count,
 			if (src_addr)
 				src_addr[i] = cq->src ? aux_entry->src :
 							FI_ADDR_NOTAVAIL;
-			cq->read_entry(&buf, &aux_entry->comp);
+			buf = ofi_cq_copy_entries(cq, buf, (struct
+						  fi_cq_tagged_entry *)
+						  &aux_entry->comp, 1);
 			slist_remove_head(&cq->aux_queue);
 			free(aux_entry);
+			i++;
 
 			if (slist_empty(&cq->aux_queue)) {
 				ofi_cirque_discard(cq->cirq);
@@ -649,6 +732,10 @@ ofi_cq_write(struct util_cq *cq, void *context, uint64_t flags, size_t len,
 {
 	int ret;
 
+	if (cq->aq)
+		return ofi_cq_write_mpsc(cq, context, flags, len, buf, data,
+					 tag, FI_ADDR_NOTAVAIL);
+
 	ofi_genlock_lock(&cq->cq_lock);
 	if (ofi_cirque_freecnt(cq->cirq) > 1) {
 		ofi_cq_write_entry(cq, context, flags, len, buf, data, tag);
@@ -667,6 +754,10 @@ ofi_cq_write_src(struct util_cq *cq, void *context, uint64_t flags, size_t len,
 {
 	int ret;
 
+	if (cq->aq)
+		return ofi_cq_write_mpsc(cq, context, flags, len, buf, data,
+					 tag, src);
+
 	ofi_genlock_lock(&cq->cq_lock);
 	if (ofi_cirque_freecnt(cq->cirq) > 1) {
 		ofi_cq_write_src_entry(cq, context, flags, len, buf, data,
@@ -879,6 +970,12 @@ struct util_av_entry {
 	char		data[];
 };
 
+/* Reverse index slot: hash of the address and fi_addr + 1, 0 if empty */
+struct util_av_slot {
+	uint32_t		hash;
+	uint32_t		index;
+};
+
 struct util_av {
 	struct fid_av		av_fid;
 	struct util_domain	*domain;
@@ -886,7 +983,11 @@ struct util_av {
 	struct ofi_genlock	lock;
 	const struct fi_provider *prov;
 
+	/* Reverse index, either hash or slots if ofi_av_flat_index is set */
 	struct util_av_entry	*hash;
+	struct util_av_slot	*slots;
+	size_t			slot_cnt;
+	size_t			addr_cnt;
 	struct ofi_bufpool	*av_entry_pool;
 
 	struct util_av_set	*av_set;
@@ -990,7 +1091,11 @@ int ofi_av_close_lightweight(struct util_av *av);
 size_t ofi_av_size(struct util_av *av);
 int ofi_av_insert_addr_at(struct util_av *av, const void *addr, fi_addr_t fi_addr);
 int ofi_av_insert_addr(struct util_av *av, const void *addr, fi_addr_t *fi_addr);
+size_t ofi_av_insert_addrs(struct util_av *av, const void *addr, size_t count,
+			   fi_addr_t *fi_addr);
 int ofi_av_remove_addr(struct util_av *av, fi_addr_t fi_addr);
+void ofi_av_del_entry(struct util_av *av, struct util_av_entry *entry);
+size_t ofi_av_addr_cnt(struct util_av *av);
 fi_addr_t ofi_av_lookup_fi_addr_unsafe(struct util_av *av, const void *addr);
 fi_addr_t ofi_av_lookup_fi_addr(struct util_av *av, const void *addr);
 
@@ -1306,6 +1411,8 @@ struct util_rx_entry {
 		struct dlist_entry	d_entry;
 		struct slist_entry	s_entry;
 	};
+	/* tag bucket or wildcard list, used by the hash match engine */
+	struct dlist_entry	hash_entry;
 	struct fi_peer_rx_entry	peer_entry;
 	uint64_t		seq_no;
 	uint64_t		ignore;
@@ -1324,6 +1431,33 @@ struct util_srx_ctx;
 typedef void(*ofi_update_func_t)(struct util_srx_ctx *srx,
 				 struct util_rx_entry *rx_entry);
 
+/*
+ * Tagged matching engine of the SRX.  Posted receives and unexpected
+ * messages are handed to the engine, which owns how they are queued.
+ * match_posted and search_unexp must honor posting and arrival order.
+ * All calls are made with the SRX lock held.
+ */
+struct util_srx_match_ops {
+	const char	*name;
+	int	(*init)(struct util_srx_ctx *srx);
+	void	(*close)(struct util_srx_ctx *srx);
+	void	(*insert_posted)(struct util_srx_ctx *srx,
+				 struct util_rx_entry *rx_entry);
+	struct util_rx_entry *(*match_posted)(struct util_srx_ctx *srx,
+					      fi_addr_t addr, uint64_t tag);
+	int	(*cancel_posted)(struct util_srx_ctx *srx, void *context);
+	void	(*insert_unexp)(struct util_srx_ctx *srx,
+				struct util_rx_entry *rx_entry);
+	struct util_rx_entry *(*search_unexp)(struct util_srx_ctx *srx,
+					      fi_addr_t addr, uint64_t tag,
+					      uint64_t ignore, bool remove);
+	void	(*remove_unexp)(struct util_srx_ctx *srx,
+				struct util_rx_entry *rx_entry);
+	void	(*foreach_unspec)(struct util_srx_ctx *srx,
+				  struct fid_peer_srx *peer_srx,
+				  fi_addr_t (*get_addr)(struct fi_peer_rx_entry *));
+};
+
 struct util_unexp_peer {
 	struct dlist_entry	entry;
 	struct slist		msg_queue;
@@ -1354,6 +1488,9 @@ struct util_srx_ctx {
 	struct dlist_entry	unexp_peers;
 	struct ofi_dyn_arr	src_unexp_peers;
 
+	const struct util_srx_match_ops *match_ops;
+	void			*match_ctx;
+
 	struct ofi_bufpool	*rx_pool;
 	struct ofi_genlock	*lock;
 };
@@ -1374,6 +1511,8 @@ int util_ep_srx_context(struct util_domain *domain, size_t rx_size,
 			ofi_update_func_t update_func,
 			struct ofi_genlock *lock, struct fid_ep **rx_ep);
 int util_srx_close(struct fid *fid);
+int util_srx_match_init(const char *engine);
+void ofi_srx_init(void);
 int util_srx_bind(struct fid *fid, struct fid *bfid, uint64_t flags);
 ssize_t util_srx_generic_recv(struct fid_ep *ep_fid, const struct iovec *iov,
 			      void **desc, size_t iov_count, fi_addr_t addr,
@@ -65,6 +65,7 @@ extern "C" {
 
 #define FI_PROV_SPECIFIC_EFA   (0xefa << 16)
 #define FI_PROV_SPECIFIC_TCP   (0x7cb << 16)
+#define FI_PROV_SPECIFIC_RXD   (0x7cd << 16)
 
 
 /* negative options are provider specific */
@@ -80,6 +81,28 @@ enum {
 	FI_OPT_EFA_USE_UNSOLICITED_WRITE_RECV,     /* bool */
 };
 
+enum {
+	FI_OPT_RXD_CC_STATE = -FI_PROV_SPECIFIC_RXD, /* struct fi_rxd_cc_state */
+};
+
+/*
+ * Congestion control state of the rxd provider for a single peer.  The
+ * caller sets addr to the fi_addr_t of the peer before calling fi_getopt.
+ * Times are reported in microseconds, windows in packets.
+ */
+struct fi_rxd_cc_state {
+	fi_addr_t	addr;
+	uint64_t	srtt;
+	uint64_t	rttvar;
+	uint64_t	rto;
+	uint32_t	cwnd;
+	uint32_t	ssthresh;
+	uint32_t	tx_window;
+	uint32_t	unacked;
+	uint64_t	loss_events;
+	uint64_t	timeouts;
+};
+
 struct fi_fid_export {
 	struct fid **fid;
 	uint64_t flags;
@@ -112,6 +112,12 @@
 /* profile provider is built as DSO */
 #define HAVE_PROFILE_DL 0
 
+/* record provider is built */
+#define HAVE_RECORD 0
+
+/* record provider is built as DSO */
+#define HAVE_RECORD_DL 0
+
 /* psm2 provider is built */
 #define HAVE_PSM2 0
 
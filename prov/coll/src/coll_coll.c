@@ -342,17 +342,95 @@ static int coll_sched_comp(struct util_coll_operation *coll_op)
 	return FI_SUCCESS;
 }
 
+/* Rank in the power of two group that remains after folding, and back */
+static inline uint64_t coll_fold_rank(uint64_t new_rank, uint64_t rem)
+{
+	return (new_rank < rem) ? new_rank * 2 + 1 : new_rank + rem;
+}
+
 /*
- * TODO:
- * when this fails, clean up the already scheduled work in this function
+ * Fold the group down to a power of two.  The first 2 * rem ranks pair
+ * up; even ranks hand their vector to the odd neighbor and sit out until
+ * coll_sched_unfold.  Returns the rank within the folded group, or -1.
  */
-static int coll_do_allreduce(struct util_coll_operation *coll_op,
-			     const void *send_buf, void *result,
-			     void* tmp_buf, uint64_t count,
-			     enum fi_datatype datatype, enum fi_op op)
+static int coll_sched_fold(struct util_coll_operation *coll_op,
+			   void *result, void *tmp_buf, uint64_t count,
+			   enum fi_datatype datatype, enum fi_op op,
+			   uint64_t rem, uint64_t *new_rank)
+{
+	uint64_t local = coll_op->mc->local_rank;
+	int ret;
+
+	if (local >= 2 * rem) {
+		*new_rank = local - rem;
+		return FI_SUCCESS;
+	}
+
+	if (local % 2 == 0) {
+		*new_rank = (uint64_t) -1;
+		return coll_sched_send(coll_op, local + 1, result, count,
+				       datatype, 1);
+	}
+
+	*new_rank = local / 2;
+	ret = coll_sched_recv(coll_op, local - 1, tmp_buf, count, datatype, 1);
+	if (ret)
+		return ret;
+
+	return coll_sched_reduce(coll_op, tmp_buf, result, count, datatype,
+				 op, 1);
+}
+
+static int coll_sched_unfold(struct util_coll_operation *coll_op,
+			     void *result, uint64_t count,
+			     enum fi_datatype datatype, uint64_t rem)
+{
+	uint64_t local = coll_op->mc->local_rank;
+
+	if (local >= 2 * rem)
+		return FI_SUCCESS;
+
+	if (local % 2)
+		return coll_sched_send(coll_op, local - 1, result, count,
+				       datatype, 1);
+
+	return coll_sched_recv(coll_op, local + 1, result, count, datatype, 1);
+}
+
+/*
+ * Offset of block i when count values are split into nblocks blocks whose
+ * sizes differ by at most one.  The size of blocks [a, b) is
+ * coll_block_disp(b) - coll_block_disp(a).
+ */
+static inline uint64_t coll_block_disp(uint64_t i, uint64_t count,
+				       uint64_t nblocks)
+{
+	return i * (count / nblocks) + MIN(i, count % nblocks);
+}
+
+/* Number of values per pipeline segment, count when segmenting is off */
+static inline size_t coll_seg_count(size_t count, enum fi_datatype datatype)
+{
+	if (!coll_env.segment_size)
+		return count;
+
+	return MIN(count, MAX(1, coll_env.segment_size /
+				 ofi_datatype_size(datatype)));
+}
+
+/* Fence every COLL_XFER_WINDOW items of a run of n, and the last one */
+static inline int coll_window_fence(size_t i, size_t n)
+{
+	return !((i + 1) % COLL_XFER_WINDOW) || i == n - 1;
+}
+
+static int coll_do_allreduce_recursive_doubling(
+			struct util_coll_operation *coll_op,
+			void *result, void *tmp_buf, uint64_t count,
+			enum fi_datatype datatype, enum fi_op op)
 {
 	uint64_t rem, pof2, my_new_id;
-	uint64_t local, remote, next_remote;
+	uint64_t local, remote;
 	int ret;
 	uint64_t mask = 1;
 
@@ -360,39 +438,14 @@ static int coll_do_allreduce(struct util_coll_operation *coll_op,
 	rem = coll_op->mc->av_set->fi_addr_count - pof2;
 	local = coll_op->mc->local_rank;
 
-	/* copy initial send data to result */
-	memcpy(result, send_buf, count * ofi_datatype_size(datatype));
-
-	if (local < 2 * rem) {
-		if (local % 2 == 0) {
-			ret = coll_sched_send(coll_op, local + 1, result,
-					      count, datatype, 1);
-			if (ret)
-				return ret;
-
-			my_new_id = (uint64_t)-1;
-		} else {
-			ret = coll_sched_recv(coll_op, local - 1,
-					      tmp_buf, count, datatype, 1);
-			if (ret)
-				return ret;
-
-			my_new_id = local / 2;
-
-			ret = coll_sched_reduce(coll_op, tmp_buf, result,
-						count, datatype, op, 1);
-			if (ret)
-				return ret;
-		}
-	} else {
-		my_new_id = local - rem;
-	}
+	ret = coll_sched_fold(coll_op, result, tmp_buf, count, datatype, op,
+			      rem, &my_new_id);
+	if (ret)
+		return ret;
 
 	if (my_new_id != -1) {
 		while (mask < pof2) {
-			next_remote = my_new_id ^ mask;
-			remote = (next_remote < rem) ? next_remote * 2 + 1 :
-				next_remote + rem;
+			remote = coll_fold_rank(my_new_id ^ mask, rem);
 
 			/* receive remote data into tmp buf */
 			ret = coll_sched_recv(coll_op, remote, tmp_buf,
@@ -432,22 +485,301 @@ static int coll_do_allreduce(struct util_coll_operation *coll_op,
 		}
 	}
 
-	if (local < 2 * rem) {
-		if (local % 2) {
-			ret = coll_sched_send(coll_op, local - 1, result,
-					      count, datatype, 1);
+	return coll_sched_unfold(coll_op, result, count, datatype, rem);
+}
+
+/*
+ * Rabenseifner's algorithm: a reduce-scatter by recursive halving followed
+ * by an allgather by recursive doubling, over the power of two group left
+ * after folding.  Each rank moves about 2 * count values instead of
+ * count * log2(P).  Requires count >= pof2.
+ */
+static int coll_do_allreduce_rabenseifner(struct util_coll_operation *coll_op,
+					  void *result, void *tmp_buf,
+					  uint64_t count,
+					  enum fi_datatype datatype,
+					  enum fi_op op)
+{
+	uint64_t rem, pof2, new_rank, remote, mask;
+	uint64_t send_idx, recv_idx, last_idx, send_cnt, recv_cnt;
+	size_t dt_size = ofi_datatype_size(datatype);
+	int ret;
+
+	pof2 = rounddown_power_of_two(coll_op->mc->av_set->fi_addr_count);
+	rem = coll_op->mc->av_set->fi_addr_count - pof2;
+
+	ret = coll_sched_fold(coll_op, result, tmp_buf, count, datatype, op,
+			      rem, &new_rank);
+	if (ret)
+		return ret;
+
+	if (new_rank == -1)
+		goto unfold;
+
+	/*
+	 * Reduce-scatter.  Each step exchanges half of the blocks still held
+	 * with the partner and reduces the half that is kept.
+	 */
+	send_idx = recv_idx = 0;
+	last_idx = pof2;
+	for (mask = 1; mask < pof2; mask <<= 1) {
+		remote = coll_fold_rank(new_rank ^ mask, rem);
+		if (new_rank < (new_rank ^ mask)) {
+			send_idx = recv_idx + pof2 / (mask * 2);
+			send_cnt = coll_block_disp(last_idx, count, pof2) -
+				   coll_block_disp(send_idx, count, pof2);
+			recv_cnt = coll_block_disp(send_idx, count, pof2) -
+				   coll_block_disp(recv_idx, count, pof2);
+		} else {
+			recv_idx = send_idx + pof2 / (mask * 2);
+			send_cnt = coll_block_disp(recv_idx, count, pof2) -
+				   coll_block_disp(send_idx, count, pof2);
+			recv_cnt = coll_block_disp(last_idx, count, pof2) -
+				   coll_block_disp(recv_idx, count, pof2);
+		}
+
+		ret = coll_sched_recv(coll_op, remote, (char *) tmp_buf +
+				      coll_block_disp(recv_idx, count, pof2) *
+				      dt_size, recv_cnt, datatype, 0);
+		if (ret)
+			return ret;
+
+		ret = coll_sched_send(coll_op, remote, (char *) result +
+				      coll_block_disp(send_idx, count, pof2) *
+				      dt_size, send_cnt, datatype, 1);
+		if (ret)
+			return ret;
+
+		ret = coll_sched_reduce(coll_op, (char *) tmp_buf +
+					coll_block_disp(recv_idx, count, pof2) *
+					dt_size, (char *) result +
+					coll_block_disp(recv_idx, count, pof2) *
+					dt_size, recv_cnt, datatype, op, 1);
+		if (ret)
+			return ret;
+
+		send_idx = recv_idx;
+		if (mask * 2 < pof2)
+			last_idx = recv_idx + pof2 / (mask * 2);
+	}
+
+	/* Allgather, retracing the reduce-scatter steps in reverse order */
+	for (mask = pof2 >> 1; mask > 0; mask >>= 1) {
+		remote = coll_fold_rank(new_rank ^ mask, rem);
+		if (new_rank < (new_rank ^ mask)) {
+			if (mask != pof2 / 2)
+				last_idx += pof2 / (mask * 2);
+			recv_idx = send_idx + pof2 / (mask * 2);
+			send_cnt = coll_block_disp(recv_idx, count, pof2) -
+				   coll_block_disp(send_idx, count, pof2);
+			recv_cnt = coll_block_disp(last_idx, count, pof2) -
+				   coll_block_disp(recv_idx, count, pof2);
+		} else {
+			recv_idx = send_idx - pof2 / (mask * 2);
+			send_cnt = coll_block_disp(last_idx, count, pof2) -
+				   coll_block_disp(send_idx, count, pof2);
+			recv_cnt = coll_block_disp(send_idx, count, pof2) -
+				   coll_block_disp(recv_idx, count, pof2);
+		}
+
+		ret = coll_sched_recv(coll_op, remote, (char *) result +
+				      coll_block_disp(recv_idx, count, pof2) *
+				      dt_size, recv_cnt, datatype, 0);
+		if (ret)
+			return ret;
+
+		ret = coll_sched_send(coll_op, remote, (char *) result +
+				      coll_block_disp(send_idx, count, pof2) *
+				      dt_size, send_cnt, datatype, 1);
+		if (ret)
+			return ret;
+
+		if (new_rank > (new_rank ^ mask))
+			send_idx = recv_idx;
+	}
+
+unfold:
+	return coll_sched_unfold(coll_op, result, count, datatype, rem);
+}
+
+/*
+ * Ring allreduce: a reduce-scatter followed by an allgather, both passing
+ * one block per step to the right neighbor.  Bandwidth matches
+ * Rabenseifner's algorithm without the extra full vector exchange that
+ * folding a non power of two group costs, at 2 * (P - 1) latency steps.
+ * Requires count >= P.
+ */
+/*
+ * Reduce-scatter step of the ring allreduce.  The blocks are cut into
+ * segments so that segment j - 1 is reduced while segment j is on the
+ * wire.  Received segments alternate between the two halves of tmp_buf.
+ */
+static int coll_sched_ring_step(struct util_coll_operation *coll_op,
+				void *result, void *tmp_buf, uint64_t left,
+				uint64_t right, uint64_t send_off,
+				uint64_t send_cnt, uint64_t recv_off,
+				uint64_t recv_cnt, enum fi_datatype datatype,
+				enum fi_op op)
+{
+	size_t dt_size = ofi_datatype_size(datatype);
+	uint64_t seg, nsegs, j;
+	int ret;
+
+	seg = coll_seg_count(MAX(send_cnt, recv_cnt), datatype);
+	nsegs = (MAX(send_cnt, recv_cnt) + seg - 1) / seg;
+
+	for (j = 0; j <= nsegs; j++) {
+		if (j * seg < recv_cnt) {
+			ret = coll_sched_recv(coll_op, left, (char *) tmp_buf +
+					      (j % 2) * seg * dt_size,
+					      MIN(seg, recv_cnt - j * seg),
+					      datatype, 0);
 			if (ret)
 				return ret;
-		} else {
-			ret = coll_sched_recv(coll_op, local + 1, result,
-					      count, datatype, 1);
+		}
+
+		if (j * seg < send_cnt) {
+			ret = coll_sched_send(coll_op, right, (char *) result +
+					      (send_off + j * seg) * dt_size,
+					      MIN(seg, send_cnt - j * seg),
+					      datatype, !j);
 			if (ret)
 				return ret;
 		}
+
+		if (!j || (j - 1) * seg >= recv_cnt)
+			continue;
+
+		ret = coll_sched_reduce(coll_op, (char *) tmp_buf +
+					((j - 1) % 2) * seg * dt_size,
+					(char *) result + (recv_off +
+					(j - 1) * seg) * dt_size,
+					MIN(seg, recv_cnt - (j - 1) * seg),
+					datatype, op, 1);
+		if (ret)
+			return ret;
+	}
+
+	return FI_SUCCESS;
+}
+
+static int coll_do_allreduce_ring(struct util_coll_operation *coll_op,
+				  void *result, void *tmp_buf, uint64_t count,
+				  enum fi_datatype datatype, enum fi_op op)
+{
+	uint64_t i, local, left, right, send_blk, recv_blk, numranks;
+	size_t dt_size = ofi_datatype_size(datatype);
+	int ret;
+
+	numranks = coll_op->mc->av_set->fi_addr_count;
+	local = coll_op->mc->local_rank;
+	left = (numranks + local - 1) % numranks;
+	right = (local + 1) % numranks;
+
+	/* after P - 1 steps, block (local + 1) holds the full reduction */
+	for (i = 0; i < numranks - 1; i++) {
+		send_blk = (local + numranks - i) % numranks;
+		recv_blk = (local + numranks - i - 1) % numranks;
+
+		ret = coll_sched_ring_step(coll_op, result, tmp_buf, left,
+					   right,
+					   coll_block_disp(send_blk, count,
+							   numranks),
+					   coll_block_disp(send_blk + 1, count,
+							   numranks) -
+					   coll_block_disp(send_blk, count,
+							   numranks),
+					   coll_block_disp(recv_blk, count,
+							   numranks),
+					   coll_block_disp(recv_blk + 1, count,
+							   numranks) -
+					   coll_block_disp(recv_blk, count,
+							   numranks),
+					   datatype, op);
+		if (ret)
+			return ret;
+	}
+
+	for (i = 0; i < numranks - 1; i++) {
+		send_blk = (local + 1 + numranks - i) % numranks;
+		recv_blk = (local + numranks - i) % numranks;
+
+		ret = coll_sched_recv(coll_op, left, (char *) result +
+				      coll_block_disp(recv_blk, count,
+						      numranks) * dt_size,
+				      coll_block_disp(recv_blk + 1, count,
+						      numranks) -
+				      coll_block_disp(recv_blk, count, numranks),
+				      datatype, 0);
+		if (ret)
+			return ret;
+
+		ret = coll_sched_send(coll_op, right, (char *) result +
+				      coll_block_disp(send_blk, count,
+						      numranks) * dt_size,
+				      coll_block_disp(send_blk + 1, count,
+						      numranks) -
+				      coll_block_disp(send_blk, count, numranks),
+				      datatype, 1);
+		if (ret)
+			return ret;
 	}
+
 	return FI_SUCCESS;
 }
 
+static enum coll_allreduce_algo
+coll_allreduce_select(struct util_coll_operation *coll_op, uint64_t count,
+		      enum fi_datatype datatype)
+{
+	uint64_t numranks = coll_op->mc->av_set->fi_addr_count;
+	uint64_t pof2 = rounddown_power_of_two(numranks);
+	size_t nbytes = count * ofi_datatype_size(datatype);
+	enum coll_allreduce_algo algo = coll_env.allreduce_algo;
+
+	if (algo == COLL_ALLREDUCE_AUTO) {
+		if (nbytes < coll_env.allreduce_short_size || numranks < 3)
+			algo = COLL_ALLREDUCE_RECURSIVE_DOUBLING;
+		else if (nbytes >= coll_env.allreduce_long_size &&
+			 pof2 != numranks)
+			algo = COLL_ALLREDUCE_RING;
+		else
+			algo = COLL_ALLREDUCE_RABENSEIFNER;
+	}
+
+	if ((algo == COLL_ALLREDUCE_RABENSEIFNER && count < pof2) ||
+	    (algo == COLL_ALLREDUCE_RING && count < numranks))
+		algo = COLL_ALLREDUCE_RECURSIVE_DOUBLING;
+
+	return algo;
+}
+
+/*
+ * TODO:
+ * when this fails, clean up the already scheduled work in this function
+ */
+static int coll_do_allreduce(struct util_coll_operation *coll_op,
+			     const void *send_buf, void *result,
+			     void* tmp_buf, uint64_t count,
+			     enum fi_datatype datatype, enum fi_op op)
+{
+	/* copy initial send data to result */
+	memcpy(result, send_buf, count * ofi_datatype_size(datatype));
+
+	switch (coll_allreduce_select(coll_op, count, datatype)) {
+	case COLL_ALLREDUCE_RING:
+		return coll_do_allreduce_ring(coll_op, result, tmp_buf, count,
+					      datatype, op);
+	case COLL_ALLREDUCE_RABENSEIFNER:
+		return coll_do_allreduce_rabenseifner(coll_op, result, tmp_buf,
+						      count, datatype, op);
+	default:
+		return coll_do_allreduce_recursive_doubling(coll_op, result,
+							    tmp_buf, count,
+							    datatype, op);
+	}
+}
+
 /* allgather implemented using ring algorithm */
 static int coll_do_allgather(struct util_coll_operation *coll_op,
 			     const void *send_buf, void *result, size_t count,
@@ -646,6 +978,337 @@ static int coll_do_scatter(struct util_coll_operation *coll_op,
 	return FI_SUCCESS;
 }
 
+/*
+ * Returns the number of children of a binomial tree node.  Children are
+ * relative_rank + mask for each mask below the node's lowest set bit.
+ * parent_mask is set to that bit; for the root it is >= numranks.
+ */
+static size_t coll_binomial_children(uint64_t relative_rank, size_t numranks,
+				     uint64_t *parent_mask)
+{
+	uint64_t mask;
+	size_t nchildren = 0;
+
+	for (mask = 1; mask < numranks && !(relative_rank & mask); mask <<= 1) {
+		if (relative_rank + mask < numranks)
+			nchildren++;
+	}
+
+	*parent_mask = mask;
+	return nchildren;
+}
+
+/*
+ * Reduce implemented with binomial tree algorithm.  Receives from all
+ * children are posted together, then folded in before forwarding the
+ * partial result to the parent.
+ */
+static int coll_do_reduce(struct util_coll_operation *coll_op,
+			  const void *send_buf, void *result, void **temp,
+			  size_t count, uint64_t root,
+			  enum fi_datatype datatype, enum fi_op op)
+{
+	uint64_t local_rank, relative_rank, parent_mask, mask;
+	size_t nbytes, numranks, nchildren, i;
+	void *acc;
+	int ret;
+
+	if (count == 0)
+		return FI_SUCCESS;
+
+	local_rank = coll_op->mc->local_rank;
+	numranks = coll_op->mc->av_set->fi_addr_count;
+	relative_rank = (local_rank + numranks - root) % numranks;
+	nbytes = count * ofi_datatype_size(datatype);
+	nchildren = coll_binomial_children(relative_rank, numranks,
+					   &parent_mask);
+
+	/* leaves forward their input untouched */
+	if (local_rank != root && !nchildren)
+		return coll_sched_send(coll_op,
+				       (local_rank + numranks - parent_mask) %
+				       numranks, (void *) send_buf, count,
+				       datatype, 1);
+
+	*temp = malloc(nbytes * (nchildren + (local_rank != root)));
+	if (!*temp)
+		return -FI_ENOMEM;
+
+	acc = (local_rank == root) ? result :
+	      (char *) *temp + nchildren * nbytes;
+	memcpy(acc, send_buf, nbytes);
+
+	for (i = 0, mask = 1; i < nchildren; i++, mask <<= 1) {
+		ret = coll_sched_recv(coll_op, (local_rank + mask) % numranks,
+				      (char *) *temp + i * nbytes, count,
+				      datatype, i == nchildren - 1);
+		if (ret)
+			return ret;
+	}
+
+	for (i = 0; i < nchildren; i++) {
+		ret = coll_sched_reduce(coll_op, (char *) *temp + i * nbytes,
+					acc, count, datatype, op, 1);
+		if (ret)
+			return ret;
+	}
+
+	if (local_rank == root)
+		return FI_SUCCESS;
+
+	return coll_sched_send(coll_op, (local_rank + numranks - parent_mask) %
+			       numranks, acc, count, datatype, 1);
+}
+
+/*
+ * Gather implemented with binomial tree algorithm, the reverse of scatter.
+ * Each node collects its subtree's values in relative rank order and
+ * forwards them to its parent in one message.
+ */
+static int coll_do_gather(struct util_coll_operation *coll_op,
+			  const void *send_buf, void *result, void **temp,
+			  size_t count, uint64_t root,
+			  enum fi_datatype datatype)
+{
+	uint64_t local_rank, relative_rank, parent_mask, mask;
+	size_t nbytes, numranks, nchildren, nvalues, i;
+	void *buf;
+	int ret;
+
+	if (count == 0)
+		return FI_SUCCESS;
+
+	local_rank = coll_op->mc->local_rank;
+	numranks = coll_op->mc->av_set->fi_addr_count;
+	relative_rank = (local_rank + numranks - root) % numranks;
+	nbytes = count * ofi_datatype_size(datatype);
+	nchildren = coll_binomial_children(relative_rank, numranks,
+					   &parent_mask);
+	nvalues = MIN(parent_mask, numranks - relative_rank);
+
+	if (local_rank != root && !nchildren)
+		return coll_sched_send(coll_op,
+				       (local_rank + numranks - parent_mask) %
+				       numranks, (void *) send_buf, count,
+				       datatype, 1);
+
+	/* rank 0 as root receives in place, relative order is absolute */
+	if (local_rank == root && root == 0) {
+		buf = result;
+	} else {
+		*temp = malloc(nvalues * nbytes);
+		if (!*temp)
+			return -FI_ENOMEM;
+		buf = *temp;
+	}
+	memcpy(buf, send_buf, nbytes);
+
+	for (i = 0, mask = 1; i < nchildren; i++, mask <<= 1) {
+		ret = coll_sched_recv(coll_op, (local_rank + mask) % numranks,
+				      (char *) buf + mask * nbytes,
+				      count * MIN(mask, numranks -
+						  relative_rank - mask),
+				      datatype, i == nchildren - 1);
+		if (ret)
+			return ret;
+	}
+
+	if (local_rank != root)
+		return coll_sched_send(coll_op,
+				       (local_rank + numranks - parent_mask) %
+				       numranks, buf, nvalues * count,
+				       datatype, 1);
+
+	if (buf == result)
+		return FI_SUCCESS;
+
+	/* rotate relative order back into rank order */
+	ret = coll_sched_copy(coll_op, buf, (char *) result + root * nbytes,
+			      (numranks - root) * count, datatype, 1);
+	if (ret)
+		return ret;
+
+	return coll_sched_copy(coll_op,
+			       (char *) buf + (numranks - root) * nbytes,
+			       result, root * count, datatype, 1);
+}
+
+/*
+ * Alltoall implemented with pairwise exchange.  In step i each rank sends
+ * to rank + i and receives from rank - i.  Up to COLL_XFER_WINDOW steps
+ * are in flight at once.
+ */
+static int coll_do_alltoall(struct util_coll_operation *coll_op,
+			    const void *send_buf, void *result, size_t count,
+			    enum fi_datatype datatype)
+{
+	uint64_t local_rank, dest, src, i;
+	size_t nbytes, numranks;
+	int ret;
+
+	if (count == 0)
+		return FI_SUCCESS;
+
+	local_rank = coll_op->mc->local_rank;
+	numranks = coll_op->mc->av_set->fi_addr_count;
+	nbytes = count * ofi_datatype_size(datatype);
+
+	memcpy((char *) result + local_rank * nbytes,
+	       (char *) send_buf + local_rank * nbytes, nbytes);
+
+	for (i = 1; i < numranks; i++) {
+		dest = (local_rank + i) % numranks;
+		src = (local_rank + numranks - i) % numranks;
+
+		ret = coll_sched_recv(coll_op, src,
+				      (char *) result + src * nbytes,
+				      count, datatype, 0);
+		if (ret)
+			return ret;
+
+		ret = coll_sched_send(coll_op, dest,
+				      (char *) send_buf + dest * nbytes,
+				      count, datatype,
+				      coll_window_fence(i - 1, numranks - 1));
+		if (ret)
+			return ret;
+	}
+
+	return FI_SUCCESS;
+}
+
+/*
+ * Reduce-scatter implemented with ring algorithm.  count is the number of
+ * values each rank receives; send_buf holds count values per rank.  In
+ * step i each rank passes the partial result for block (rank - i - 1) to
+ * the right and folds its own input into block (rank - i - 2) arriving
+ * from the left.  Partial results alternate between two temp buffers and
+ * the last step lands in result.
+ */
+static int coll_do_reduce_scatter(struct util_coll_operation *coll_op,
+				  const void *send_buf, void *result,
+				  void **temp, size_t count,
+				  enum fi_datatype datatype, enum fi_op op)
+{
+	uint64_t local_rank, left_rank, right_rank, blk, i;
+	size_t nbytes, numranks;
+	void *recv_buf, *send_data;
+	int ret;
+
+	if (count == 0)
+		return FI_SUCCESS;
+
+	local_rank = coll_op->mc->local_rank;
+	numranks = coll_op->mc->av_set->fi_addr_count;
+	nbytes = count * ofi_datatype_size(datatype);
+	left_rank = (numranks + local_rank - 1) % numranks;
+	right_rank = (local_rank + 1) % numranks;
+
+	if (numranks == 1)
+		return coll_sched_copy(coll_op, (void *) send_buf, result,
+				       count, datatype, 1);
+
+	if (numranks > 2) {
+		*temp = malloc(2 * nbytes);
+		if (!*temp)
+			return -FI_ENOMEM;
+	}
+
+	send_data = (char *) send_buf + left_rank * nbytes;
+	for (i = 0; i < numranks - 1; i++) {
+		blk = (local_rank + 2 * numranks - i - 2) % numranks;
+		recv_buf = (i == numranks - 2) ? result :
+			   (char *) *temp + (i % 2) * nbytes;
+
+		ret = coll_sched_recv(coll_op, left_rank, recv_buf, count,
+				      datatype, 0);
+		if (ret)
+			return ret;
+
+		ret = coll_sched_send(coll_op, right_rank, send_data, count,
+				      datatype, 1);
+		if (ret)
+			return ret;
+
+		ret = coll_sched_reduce(coll_op,
+					(char *) send_buf + blk * nbytes,
+					recv_buf, count, datatype, op, 1);
+		if (ret)
+			return ret;
+
+		send_data = recv_buf;
+	}
+
+	return FI_SUCCESS;
+}
+
+/*
+ * Pipelined binary tree broadcast.  The vector is cut into segments and
+ * interior ranks forward segment s to their children while segment s + 1
+ * arrives from the parent.  The root and the leaves keep up to
+ * COLL_XFER_WINDOW segments in flight.
+ */
+static int coll_do_bcast_pipeline(struct util_coll_operation *coll_op,
+				  void *buf, size_t count, uint64_t root,
+				  enum fi_datatype datatype)
+{
+	uint64_t local_rank, relative_rank, parent = 0, children[2];
+	size_t numranks, nchildren = 0, seg, nsegs, s, i;
+	size_t dt_size = ofi_datatype_size(datatype);
+	char *seg_buf;
+	int ret;
+
+	if (count == 0)
+		return FI_SUCCESS;
+
+	local_rank = coll_op->mc->local_rank;
+	numranks = coll_op->mc->av_set->fi_addr_count;
+	relative_rank = (local_rank + numranks - root) % numranks;
+	if (relative_rank)
+		parent = ((relative_rank - 1) / 2 + root) % numranks;
+	for (i = 1; i <= 2; i++) {
+		if (2 * relative_rank + i < numranks)
+			children[nchildren++] = (2 * relative_rank + i + root) %
+						numranks;
+	}
+
+	seg = coll_seg_count(count, datatype);
+	nsegs = (count + seg - 1) / seg;
+
+	if (relative_rank) {
+		ret = coll_sched_recv(coll_op, parent, buf, seg, datatype,
+				      nchildren || coll_window_fence(0, nsegs));
+		if (ret)
+			return ret;
+	}
+
+	for (s = 0; s < nsegs; s++) {
+		seg_buf = (char *) buf + s * seg * dt_size;
+
+		if (relative_rank && s + 1 < nsegs) {
+			ret = coll_sched_recv(coll_op, parent,
+					      seg_buf + seg * dt_size,
+					      MIN(seg, count - (s + 1) * seg),
+					      datatype, !nchildren &&
+					      coll_window_fence(s + 1, nsegs));
+			if (ret)
+				return ret;
+		}
+
+		for (i = 0; i < nchildren; i++) {
+			ret = coll_sched_send(coll_op, children[i], seg_buf,
+					      MIN(seg, count - s * seg),
+					      datatype, i == nchildren - 1 &&
+					      (relative_rank ||
+					       coll_window_fence(s, nsegs)));
+			if (ret)
+				return ret;
+		}
+	}
+
+	return FI_SUCCESS;
+}
+
 static int coll_close(struct fid *fid)
 {
 	struct util_coll_mc *coll_mc;
@@ -746,9 +1409,22 @@ void coll_collective_comp(struct util_coll_operation *coll_op)
 		free(coll_op->data.broadcast.scatter);
 		break;
 
+	case UTIL_COLL_REDUCE_OP:
+		free(coll_op->data.reduce);
+		break;
+
+	case UTIL_COLL_GATHER_OP:
+		free(coll_op->data.gather);
+		break;
+
+	case UTIL_COLL_REDUCE_SCATTER_OP:
+		free(coll_op->data.reduce_scatter);
+		break;
+
 	case UTIL_COLL_JOIN_OP:
 	case UTIL_COLL_BARRIER_OP:
 	case UTIL_COLL_ALLGATHER_OP:
+	case UTIL_COLL_ALLTOALL_OP:
 	default:
 		/* nothing to clean up */
 		break;
@@ -760,10 +1436,10 @@ static ssize_t coll_process_reduce_item(struct util_coll_reduce_item *reduce_ite
 	if (reduce_item->op < FI_MIN || reduce_item->op > FI_BXOR)
 		return -FI_ENOSYS;
 
-	ofi_atomic_write_handler(reduce_item->op, reduce_item->datatype,
-				 reduce_item->inout_buf,
-				 reduce_item->in_buf,
-				 reduce_item->count);
+	ofi_atomic_reduce_handler(reduce_item->op, reduce_item->datatype,
+				  reduce_item->inout_buf,
+				  reduce_item->in_buf,
+				  reduce_item->count);
 	return FI_SUCCESS;
 }
 
@@ -829,22 +1505,20 @@ void coll_ep_progress(struct util_ep *util_ep)
 		coll_op = work_item->coll_op;
 		switch (work_item->type) {
 		case UTIL_COLL_SEND:
+		case UTIL_COLL_RECV:
 			xfer_item = container_of(work_item,
 						 struct util_coll_xfer_item,
 						 hdr);
 			ret = coll_process_xfer_item(xfer_item);
-			if (ret && ret == -FI_EAGAIN) {
-				slist_insert_tail(&work_item->ready_entry,
+			/*
+			 * Retry from the head: later transfers to the same
+			 * peer may already be queued and share this tag.
+			 */
+			if (ret == -FI_EAGAIN) {
+				slist_insert_head(&work_item->ready_entry,
 						  &util_ep->coll_ready_queue);
 				goto out;
 			}
-			break;
-
-		case UTIL_COLL_RECV:
-			xfer_item = container_of(work_item,
-						 struct util_coll_xfer_item,
-						 hdr);
-			ret = coll_process_xfer_item(xfer_item);
 			if (ret)
 				goto out;
 			break;
@@ -1175,6 +1849,21 @@ ssize_t coll_ep_broadcast(struct fid_ep *ep, void *buf, size_t count,
 
 	local = broadcast_op->mc->local_rank;
 	numranks = broadcast_op->mc->av_set->fi_addr_count;
+
+	/*
+	 * Scatter-allgather needs the vector to split evenly across the
+	 * group.  Everything else, and vectors longer than one segment,
+	 * go down the pipelined tree.
+	 */
+	if (count % numranks || (coll_env.segment_size && count *
+	    ofi_datatype_size(datatype) > coll_env.segment_size)) {
+		ret = coll_do_bcast_pipeline(broadcast_op, buf, count,
+					     root_addr, datatype);
+		if (ret)
+			goto err1;
+		goto comp;
+	}
+
 	chunk_cnt = (count + numranks - 1) / numranks;
 	if (chunk_cnt * local > count &&
 	    chunk_cnt * local - (int) count > chunk_cnt)
@@ -1200,6 +1889,7 @@ ssize_t coll_ep_broadcast(struct fid_ep *ep, void *buf, size_t count,
 	if (ret)
 		goto err2;
 
+comp:
 	ret = coll_sched_comp(broadcast_op);
 	if (ret)
 		goto err2;
@@ -1215,6 +1905,149 @@ err1:
 	return ret;
 }
 
+ssize_t coll_ep_reduce(struct fid_ep *ep, const void *buf, size_t count,
+		       void *desc, void *result, void *result_desc,
+		       fi_addr_t coll_addr, fi_addr_t root_addr,
+		       enum fi_datatype datatype, enum fi_op op,
+		       uint64_t flags, void *context)
+{
+	struct util_coll_mc *coll_mc;
+	struct util_coll_operation *reduce_op;
+	struct util_ep *util_ep;
+	int ret;
+
+	coll_mc = (struct util_coll_mc *) ((uintptr_t) coll_addr);
+	reduce_op = coll_create_op(ep, coll_mc, UTIL_COLL_REDUCE_OP, flags,
+				   context, coll_collective_comp);
+	if (!reduce_op)
+		return -FI_ENOMEM;
+
+	ret = coll_do_reduce(reduce_op, buf, result, &reduce_op->data.reduce,
+			     count, root_addr, datatype, op);
+	if (ret)
+		goto err;
+
+	ret = coll_sched_comp(reduce_op);
+	if (ret)
+		goto err;
+
+	util_ep = container_of(ep, struct util_ep, ep_fid);
+	coll_progress_work(util_ep, reduce_op);
+
+	return FI_SUCCESS;
+err:
+	free(reduce_op->data.reduce);
+	free(reduce_op);
+	return ret;
+}
+
+ssize_t coll_ep_gather(struct fid_ep *ep, const void *buf, size_t count,
+		       void *desc, void *result, void *result_desc,
+		       fi_addr_t coll_addr, fi_addr_t root_addr,
+		       enum fi_datatype datatype, uint64_t flags,
+		       void *context)
+{
+	struct util_coll_mc *coll_mc;
+	struct util_coll_operation *gather_op;
+	struct util_ep *util_ep;
+	int ret;
+
+	coll_mc = (struct util_coll_mc *) ((uintptr_t) coll_addr);
+	gather_op = coll_create_op(ep, coll_mc, UTIL_COLL_GATHER_OP, flags,
+				   context, coll_collective_comp);
+	if (!gather_op)
+		return -FI_ENOMEM;
+
+	ret = coll_do_gather(gather_op, buf, result, &gather_op->data.gather,
+			     count, root_addr, datatype);
+	if (ret)
+		goto err;
+
+	ret = coll_sched_comp(gather_op);
+	if (ret)
+		goto err;
+
+	util_ep = container_of(ep, struct util_ep, ep_fid);
+	coll_progress_work(util_ep, gather_op);
+
+	return FI_SUCCESS;
+err:
+	free(gather_op->data.gather);
+	free(gather_op);
+	return ret;
+}
+
+ssize_t coll_ep_alltoall(struct fid_ep *ep, const void *buf, size_t count,
+			 void *desc, void *result, void *result_desc,
+			 fi_addr_t coll_addr, enum fi_datatype datatype,
+			 uint64_t flags, void *context)
+{
+	struct util_coll_mc *coll_mc;
+	struct util_coll_operation *alltoall_op;
+	struct util_ep *util_ep;
+	int ret;
+
+	coll_mc = (struct util_coll_mc *) ((uintptr_t) coll_addr);
+	alltoall_op = coll_create_op(ep, coll_mc, UTIL_COLL_ALLTOALL_OP,
+				     flags, context, coll_collective_comp);
+	if (!alltoall_op)
+		return -FI_ENOMEM;
+
+	ret = coll_do_alltoall(alltoall_op, buf, result, count, datatype);
+	if (ret)
+		goto err;
+
+	ret = coll_sched_comp(alltoall_op);
+	if (ret)
+		goto err;
+
+	util_ep = container_of(ep, struct util_ep, ep_fid);
+	coll_progress_work(util_ep, alltoall_op);
+
+	return FI_SUCCESS;
+err:
+	free(alltoall_op);
+	return ret;
+}
+
+ssize_t coll_ep_reduce_scatter(struct fid_ep *ep, const void *buf,
+			       size_t count, void *desc, void *result,
+			       void *result_desc, fi_addr_t coll_addr,
+			       enum fi_datatype datatype, enum fi_op op,
+			       uint64_t flags, void *context)
+{
+	struct util_coll_mc *coll_mc;
+	struct util_coll_operation *reduce_scatter_op;
+	struct util_ep *util_ep;
+	int ret;
+
+	coll_mc = (struct util_coll_mc *) ((uintptr_t) coll_addr);
+	reduce_scatter_op = coll_create_op(ep, coll_mc,
+					   UTIL_COLL_REDUCE_SCATTER_OP, flags,
+					   context, coll_collective_comp);
+	if (!reduce_scatter_op)
+		return -FI_ENOMEM;
+
+	ret = coll_do_reduce_scatter(reduce_scatter_op, buf, result,
+				     &reduce_scatter_op->data.reduce_scatter,
+				     count, datatype, op);
+	if (ret)
+		goto err;
+
+	ret = coll_sched_comp(reduce_scatter_op);
+	if (ret)
+		goto err;
+
+	util_ep = container_of(ep, struct util_ep, ep_fid);
+	coll_progress_work(util_ep, reduce_scatter_op);
+
+	return FI_SUCCESS;
+err:
+	free(reduce_scatter_op->data.reduce_scatter);
+	free(reduce_scatter_op);
+	return ret;
+}
+
 ssize_t coll_peer_xfer_complete(struct fid_ep *ep,
 				struct fi_cq_tagged_entry *cqe,
 				fi_addr_t src_addr)
@@ -1281,9 +2114,13 @@ int coll_query_collective(struct fid_domain *dom_fid,
 	case FI_ALLGATHER:
 	case FI_SCATTER:
 	case FI_BROADCAST:
+	case FI_GATHER:
+	case FI_ALLTOALL:
 		ret = FI_SUCCESS;
 		break;
 	case FI_ALLREDUCE:
+	case FI_REDUCE:
+	case FI_REDUCE_SCATTER:
 		if (FI_MIN <= attr->op && FI_BXOR >= attr->op)
 			ret = fi_query_atomic(peer_domain, attr->datatype,
 					      attr->op, &attr->datatype_attr,
@@ -1291,10 +2128,6 @@ int coll_query_collective(struct fid_domain *dom_fid,
 		else
 			return -FI_ENOSYS;
 		break;
-	case FI_ALLTOALL:
-	case FI_REDUCE_SCATTER:
-	case FI_REDUCE:
-	case FI_GATHER:
 	default:
 		return -FI_ENOSYS;
 	}
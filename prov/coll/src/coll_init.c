@@ -32,6 +32,38 @@
 
 #include "coll.h"
 
+struct coll_env coll_env = {
+	.allreduce_algo = COLL_ALLREDUCE_AUTO,
+	.allreduce_short_size = 2048,
+	.allreduce_long_size = 512 * 1024,
+	.segment_size = 64 * 1024,
+};
+
+static void coll_init_env(void)
+{
+	char *algo = NULL;
+
+	fi_param_get_size_t(&coll_prov, "allreduce_short_size",
+			    &coll_env.allreduce_short_size);
+	fi_param_get_size_t(&coll_prov, "allreduce_long_size",
+			    &coll_env.allreduce_long_size);
+	fi_param_get_size_t(&coll_prov, "segment_size",
+			    &coll_env.segment_size);
+
+	fi_param_get_str(&coll_prov, "allreduce_algo", &algo);
+	if (!algo || !strcasecmp(algo, "auto"))
+		coll_env.allreduce_algo = COLL_ALLREDUCE_AUTO;
+	else if (!strcasecmp(algo, "recursive_doubling"))
+		coll_env.allreduce_algo = COLL_ALLREDUCE_RECURSIVE_DOUBLING;
+	else if (!strcasecmp(algo, "rabenseifner"))
+		coll_env.allreduce_algo = COLL_ALLREDUCE_RABENSEIFNER;
+	else if (!strcasecmp(algo, "ring"))
+		coll_env.allreduce_algo = COLL_ALLREDUCE_RING;
+	else
+		FI_WARN(&coll_prov, FI_LOG_CORE,
+			"unknown allreduce algorithm %s, using auto\n", algo);
+}
+
 static int coll_getinfo(uint32_t version, const char *node, const char *service,
 			uint64_t flags, const struct fi_info *hints,
 			struct fi_info **info)
@@ -60,5 +92,28 @@ struct fi_provider coll_prov = {
 
 COLL_INI
 {
+	fi_param_define(&coll_prov, "allreduce_algo", FI_PARAM_STRING,
+			"Allreduce algorithm: auto, recursive_doubling, "
+			"rabenseifner or ring.  Auto selects by message size "
+			"and group size.  Algorithms that cannot split the "
+			"vector across the group fall back to recursive "
+			"doubling. (default: auto)");
+	fi_param_define(&coll_prov, "allreduce_short_size", FI_PARAM_SIZE_T,
+			"Vectors smaller than this many bytes are allreduced "
+			"with recursive doubling. (default: 2048)");
+	fi_param_define(&coll_prov, "allreduce_long_size", FI_PARAM_SIZE_T,
+			"Vectors of at least this many bytes are allreduced "
+			"with the ring algorithm when the group size is not "
+			"a power of two.  Other vectors above the short size "
+			"use Rabenseifner's reduce-scatter and allgather. "
+			"(default: 524288)");
+	fi_param_define(&coll_prov, "segment_size", FI_PARAM_SIZE_T,
+			"Segment size in bytes for pipelined collectives.  "
+			"Longer broadcasts are pipelined down a binary tree "
+			"and ring allreduce reduces one segment while the "
+			"next is in flight.  0 disables segmenting. "
+			"(default: 65536)");
+	coll_init_env();
+
 	return &coll_prov;
 }
@@ -211,7 +211,7 @@ void efa_av_implicit_av_lru_conn_move(struct efa_av *av,
 					struct efa_conn *conn)
 {
 	assert(av->implicit_av_size == 0 ||
-	       HASH_CNT(hh, av->util_av_implicit.hash) <= av->implicit_av_size);
+	       ofi_av_addr_cnt(&av->util_av_implicit) <= av->implicit_av_size);
 	assert(dlist_entry_in_list(&av->implicit_av_lru_list,
 				   &conn->implicit_av_lru_entry));
 
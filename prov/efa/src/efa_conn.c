@@ -54,7 +54,7 @@ static inline int efa_av_implicit_av_lru_insert(struct efa_av *av,
 	if (av->implicit_av_size == 0)
 		goto out;
 
-	cur_size = HASH_CNT(hh, av->util_av_implicit.hash);
+	cur_size = ofi_av_addr_cnt(&av->util_av_implicit);
 	if (cur_size <= av->implicit_av_size)
 		goto out;
 
@@ -81,7 +81,7 @@ static inline int efa_av_implicit_av_lru_insert(struct efa_av *av,
 	assert(ofi_genlock_held(&((struct efa_rdm_domain *) av->domain)->srx_lock));
 	efa_conn_release(av, conn_to_release, true);
 
-	assert(HASH_CNT(hh, av->util_av_implicit.hash) == av->implicit_av_size);
+	assert(ofi_av_addr_cnt(&av->util_av_implicit) == av->implicit_av_size);
 
 out:
 	dlist_insert_tail(&conn->implicit_av_lru_entry,
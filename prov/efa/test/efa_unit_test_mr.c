@@ -1151,7 +1151,7 @@ void test_efa_rdm_mr_cache_lru_behavior(void **state)
 	iov.iov_len = mr_size;
 
 	/* Initially LRU list should be empty */
-	assert_true(dlist_empty(&rdm_domain->cache->lru_list));
+	assert_true(ofi_mr_cache_lru_empty(rdm_domain->cache));
 
 	/* First registration */
 	ret = efa_rdm_mr_cache_regv(resource->domain, &iov, 1,
@@ -1162,12 +1162,12 @@ void test_efa_rdm_mr_cache_lru_behavior(void **state)
 	efa_rdm_mr1 = container_of(mr1, struct efa_rdm_mr, efa_mr.mr_fid);
 	assert_non_null(efa_rdm_mr1->entry);
 	/* LRU should be empty while entry is in use */
-	assert_true(dlist_empty(&rdm_domain->cache->lru_list));
+	assert_true(ofi_mr_cache_lru_empty(rdm_domain->cache));
 
 	/* Close first MR - should move to LRU list */
 	assert_int_equal(fi_close(&mr1->fid), 0);
 	/* LRU should now contain the entry */
-	assert_false(dlist_empty(&rdm_domain->cache->lru_list));
+	assert_false(ofi_mr_cache_lru_empty(rdm_domain->cache));
 
 	/* Register same region again - should reuse from LRU */
 	ret = efa_rdm_mr_cache_regv(resource->domain, &iov, 1,
@@ -1181,11 +1181,11 @@ void test_efa_rdm_mr_cache_lru_behavior(void **state)
 	/* Should reuse the same cache entry from LRU */
 	assert_ptr_equal(efa_rdm_mr1->entry, efa_rdm_mr2->entry);
 	/* LRU should be empty again since entry is back in use */
-	assert_true(dlist_empty(&rdm_domain->cache->lru_list));
+	assert_true(ofi_mr_cache_lru_empty(rdm_domain->cache));
 
 	assert_int_equal(fi_close(&mr2->fid), 0);
 	/* LRU should contain the entry again */
-	assert_false(dlist_empty(&rdm_domain->cache->lru_list));
+	assert_false(ofi_mr_cache_lru_empty(rdm_domain->cache));
 
 	free(buf);
 #endif
@@ -1229,7 +1229,7 @@ void test_efa_rdm_mr_cache_flush_behavior(void **state)
 	iov.iov_len = mr_size;
 
 	/* Initially LRU list should be empty */
-	assert_true(dlist_empty(&rdm_domain->cache->lru_list));
+	assert_true(ofi_mr_cache_lru_empty(rdm_domain->cache));
 
 	/* First registration */
 	ret = efa_rdm_mr_cache_regv(resource->domain, &iov, 1,
@@ -1240,17 +1240,17 @@ void test_efa_rdm_mr_cache_flush_behavior(void **state)
 	efa_rdm_mr1 = container_of(mr1, struct efa_rdm_mr, efa_mr.mr_fid);
 	assert_non_null(efa_rdm_mr1->entry);
 	/* LRU should be empty while entry is in use */
-	assert_true(dlist_empty(&rdm_domain->cache->lru_list));
+	assert_true(ofi_mr_cache_lru_empty(rdm_domain->cache));
 
 	/* Close MR - moves to LRU */
 	assert_int_equal(fi_close(&mr1->fid), 0);
 	/* LRU should now contain the entry */
-	assert_false(dlist_empty(&rdm_domain->cache->lru_list));
+	assert_false(ofi_mr_cache_lru_empty(rdm_domain->cache));
 
 	/* Force cache flush - should clean up LRU entries */
 	ofi_mr_cache_flush(rdm_domain->cache, true /* flush_lru */);
 	/* LRU should be empty after flush */
-	assert_true(dlist_empty(&rdm_domain->cache->lru_list));
+	assert_true(ofi_mr_cache_lru_empty(rdm_domain->cache));
 
 	/* Register same region again - should create new entry after flush */
 	ret = efa_rdm_mr_cache_regv(resource->domain, &iov, 1,
@@ -1306,7 +1306,7 @@ void test_efa_rdm_mr_cache_reference_counting(void **state)
 	iov.iov_len = mr_size;
 
 	/* Initially LRU list should be empty */
-	assert_true(dlist_empty(&rdm_domain->cache->lru_list));
+	assert_true(ofi_mr_cache_lru_empty(rdm_domain->cache));
 
 	/* First registration - creates cache entry with use_cnt = 1 */
 	ret = efa_rdm_mr_cache_regv(resource->domain, &iov, 1,
@@ -1318,7 +1318,7 @@ void test_efa_rdm_mr_cache_reference_counting(void **state)
 	assert_non_null(efa_rdm_mr1->entry);
 	assert_int_equal(efa_rdm_mr1->entry->use_cnt, 1);
 	/* LRU should still be empty since use_cnt > 0 */
-	assert_true(dlist_empty(&rdm_domain->cache->lru_list));
+	assert_true(ofi_mr_cache_lru_empty(rdm_domain->cache));
 
 	/* Second registration - should increment reference count to 2 */
 	ret = efa_rdm_mr_cache_regv(resource->domain, &iov, 1,
@@ -1330,7 +1330,7 @@ void test_efa_rdm_mr_cache_reference_counting(void **state)
 	assert_ptr_equal(efa_rdm_mr1->entry, efa_rdm_mr2->entry);
 	assert_int_equal(efa_rdm_mr1->entry->use_cnt, 2);
 	/* LRU should still be empty since use_cnt > 0 */
-	assert_true(dlist_empty(&rdm_domain->cache->lru_list));
+	assert_true(ofi_mr_cache_lru_empty(rdm_domain->cache));
 
 	/* Third registration - should increment reference count to 3 */
 	ret = efa_rdm_mr_cache_regv(resource->domain, &iov, 1,
@@ -1342,24 +1342,24 @@ void test_efa_rdm_mr_cache_reference_counting(void **state)
 	assert_ptr_equal(efa_rdm_mr1->entry, efa_rdm_mr3->entry);
 	assert_int_equal(efa_rdm_mr1->entry->use_cnt, 3);
 	/* LRU should still be empty since use_cnt > 0 */
-	assert_true(dlist_empty(&rdm_domain->cache->lru_list));
+	assert_true(ofi_mr_cache_lru_empty(rdm_domain->cache));
 
 	/* Close first MR - should decrement reference count to 2, not move to LRU */
 	assert_int_equal(fi_close(&mr1->fid), 0);
 	assert_int_equal(efa_rdm_mr2->entry->use_cnt, 2);
 	/* LRU should still be empty since use_cnt > 0 */
-	assert_true(dlist_empty(&rdm_domain->cache->lru_list));
+	assert_true(ofi_mr_cache_lru_empty(rdm_domain->cache));
 
 	/* Close second MR - should decrement reference count to 1, not move to LRU */
 	assert_int_equal(fi_close(&mr2->fid), 0);
 	assert_int_equal(efa_rdm_mr3->entry->use_cnt, 1);
 	/* LRU should still be empty since use_cnt > 0 */
-	assert_true(dlist_empty(&rdm_domain->cache->lru_list));
+	assert_true(ofi_mr_cache_lru_empty(rdm_domain->cache));
 
 	/* Close third MR - should decrement to zero and move to LRU */
 	assert_int_equal(fi_close(&mr3->fid), 0);
 	/* Now LRU should contain the entry since use_cnt reached 0 */
-	assert_false(dlist_empty(&rdm_domain->cache->lru_list));
+	assert_false(ofi_mr_cache_lru_empty(rdm_domain->cache));
 
 	free(buf);
 #endif
@@ -41,15 +41,23 @@
 //TODO hook into getinfo call and pass in FI_HMEM, FI_MR_HMEM,
 //and check iov_limit/adjust the hook iov limit
 #define HOOK_HMEM_IOV_LIMIT	4
+#define HOOK_HMEM_MRU_SIZE	4
+
+struct hook_hmem_desc;
 
 struct hook_hmem_domain {
 	struct hook_domain	hook_domain;
-	ofi_mutex_t		lock;
+	struct ofi_genlock	lock;
 	int			mr_mode;
+	/* no device iface is initialized, every buffer is host memory */
+	bool			host_only;
 	struct ofi_bufpool	*mr_pool;
 	struct ofi_bufpool	*ctx_pool;
 	struct ofi_rbmap	rbmap;
 	struct dlist_entry	mr_list;
+	/* most recently used regions, checked before the rbmap */
+	struct hook_hmem_desc	*mru[HOOK_HMEM_MRU_SIZE];
+	unsigned int		mru_next;
 };
 
 struct hook_hmem_ep {
@@ -64,6 +72,7 @@ struct hook_hmem_desc {
 	struct fid_mr		*mr_fid;
 	void			*desc;
 	struct iovec		iov;
+	struct ofi_rbnode	*node;
 	struct dlist_entry	entry;
 	uint64_t		device;
 	uint64_t		flags;
@@ -51,24 +51,18 @@ static int hook_hmem_iov_compare(struct ofi_rbmap *map, void *key, void *data)
 }
 
 static int hook_hmem_add_region(struct hook_hmem_domain *domain,
-		const struct iovec *iov, struct hook_hmem_desc **hmem_desc)
+		const struct iovec *iov, enum fi_hmem_iface iface,
+		uint64_t device, uint64_t flags,
+		struct hook_hmem_desc **hmem_desc)
 {
 	struct fi_mr_attr attr = {0};
 	struct iovec base_iov;
-	uint64_t iface, device, flags;
 	int ret = 0;
 
 	*hmem_desc = ofi_buf_alloc(domain->mr_pool);
 	if (!*hmem_desc)
 		return -FI_ENOMEM;
 
-	iface = ofi_get_hmem_iface(iov->iov_base, &device, &flags);
-	if (iface == FI_HMEM_SYSTEM) {
-		(*hmem_desc)->desc = NULL;
-		(*hmem_desc)->iov = *iov;
-		goto out;
-	}
-
 	ret = ofi_hmem_get_base_addr(iface, iov->iov_base, iov->iov_len,
 				     &base_iov.iov_base, &base_iov.iov_len);
 	if (ret) {
@@ -85,6 +79,7 @@ static int hook_hmem_add_region(struct hook_hmem_domain *domain,
 	attr.iface = iface;
 	attr.device.reserved = device;
 
+	(*hmem_desc)->flags = flags;
 	ret = fi_mr_regattr(domain->hook_domain.hdomain, &attr,
 			    (*hmem_desc)->flags, &(*hmem_desc)->mr_fid);
 	if (ret) {
@@ -94,66 +89,113 @@ static int hook_hmem_add_region(struct hook_hmem_domain *domain,
 
 	(*hmem_desc)->desc = fi_mr_desc((*hmem_desc)->mr_fid);
 	(*hmem_desc)->iov = base_iov;
-out:
 	(*hmem_desc)->count = 0;
 	dlist_insert_tail(&(*hmem_desc)->entry, &domain->mr_list);
 	return FI_SUCCESS;
 }
 
+static struct hook_hmem_desc *
+hook_hmem_mru_find(struct hook_hmem_domain *domain, const struct iovec *iov)
+{
+	int i;
+
+	for (i = 0; i < HOOK_HMEM_MRU_SIZE; i++) {
+		if (domain->mru[i] && ofi_iov_within(iov, &domain->mru[i]->iov))
+			return domain->mru[i];
+	}
+	return NULL;
+}
+
+static void hook_hmem_mru_insert(struct hook_hmem_domain *domain,
+				 struct hook_hmem_desc *hmem_desc)
+{
+	domain->mru[domain->mru_next] = hmem_desc;
+	domain->mru_next = (domain->mru_next + 1) % HOOK_HMEM_MRU_SIZE;
+}
+
+static void hook_hmem_mru_remove(struct hook_hmem_domain *domain,
+				 struct hook_hmem_desc *hmem_desc)
+{
+	int i;
+
+	for (i = 0; i < HOOK_HMEM_MRU_SIZE; i++) {
+		if (domain->mru[i] == hmem_desc)
+			domain->mru[i] = NULL;
+	}
+}
+
+/*
+ * Returns the device region covering iov with a reference held, or NULL
+ * if iov is host memory.  Host memory is never inserted into the rbmap,
+ * so it costs one iface query per buffer; device regions are found in
+ * the MRU array or the rbmap before falling back to the iface query.
+ */
 static int hook_hmem_cache_mr(struct hook_hmem_domain *domain,
 			      const struct iovec *iov,
 			      struct hook_hmem_desc **hmem_desc)
 {
 	struct ofi_rbnode *node;
+	enum fi_hmem_iface iface;
+	uint64_t device, flags;
 	int ret;
 
-	ret = ofi_rbmap_insert(&domain->rbmap, (void *) iov, NULL, &node);
-	if (!ret) {
-		ret = hook_hmem_add_region(domain, iov,
-				(struct hook_hmem_desc **) (&node->data));
-		if (ret) {
-			ofi_rbmap_delete(&domain->rbmap, node);
-			return ret;
-		}
-	} else if (ret != -FI_EALREADY) {
-		return ret;
+	*hmem_desc = hook_hmem_mru_find(domain, iov);
+	if (*hmem_desc)
+		goto out;
+
+	node = ofi_rbmap_find(&domain->rbmap, (void *) iov);
+	if (node) {
+		*hmem_desc = node->data;
+		goto insert;
 	}
 
-	*hmem_desc = (struct hook_hmem_desc *) (node->data);
-	(*hmem_desc)->count++;
+	iface = ofi_get_hmem_iface(iov->iov_base, &device, &flags);
+	if (iface == FI_HMEM_SYSTEM)
+		return FI_SUCCESS;
 
+	ret = hook_hmem_add_region(domain, iov, iface, device, flags,
+				   hmem_desc);
+	if (ret)
+		return ret;
+
+	ret = ofi_rbmap_insert(&domain->rbmap, &(*hmem_desc)->iov,
+			       *hmem_desc, &(*hmem_desc)->node);
+	if (ret) {
+		fi_close(&(*hmem_desc)->mr_fid->fid);
+		dlist_remove(&(*hmem_desc)->entry);
+		ofi_buf_free(*hmem_desc);
+		*hmem_desc = NULL;
+		return ret;
+	}
+insert:
+	hook_hmem_mru_insert(domain, *hmem_desc);
+out:
+	(*hmem_desc)->count++;
 	return FI_SUCCESS;
 }
 
 static void hook_hmem_uncache_mr(struct hook_hmem_domain *domain,
-				 const struct iovec *iov)
+				 struct hook_hmem_desc *hmem_desc)
 {
-	struct ofi_rbnode *node;
-	struct hook_hmem_desc *hmem_desc;
-
-	node = ofi_rbmap_find(&domain->rbmap, (void *) iov);
-	if (!node)
-		return;
-
-	hmem_desc = (struct hook_hmem_desc *) (node->data);
-	if (--hmem_desc->count)
+	if (!hmem_desc || --hmem_desc->count)
 		return;
 
-	ofi_rbmap_delete(&domain->rbmap, node);
-	if (hmem_desc->desc)
-		fi_close(&(hmem_desc->mr_fid)->fid);
+	hook_hmem_mru_remove(domain, hmem_desc);
+	ofi_rbmap_delete(&domain->rbmap, hmem_desc->node);
+	fi_close(&(hmem_desc->mr_fid)->fid);
 
 	dlist_remove(&hmem_desc->entry);
 	ofi_buf_free(hmem_desc);
 }
 
 static void hook_hmem_uncache_mr_iov(struct hook_hmem_domain *domain,
-				     const struct iovec *iov, size_t count)
+				     struct hook_hmem_desc **hmem_desc,
+				     size_t count)
 {
 	int i;
 
 	for (i = 0; i < count; i++)
-		hook_hmem_uncache_mr(domain, &iov[i]);
+		hook_hmem_uncache_mr(domain, hmem_desc[i]);
 }
 
 static int hook_hmem_cache_mr_iov(struct hook_hmem_domain *domain,
@@ -162,14 +204,20 @@ static int hook_hmem_cache_mr_iov(struct hook_hmem_domain *domain,
 {
 	int i, ret;
 
+	if (domain->host_only) {
+		memset(hmem_desc, 0, sizeof(*hmem_desc) * count);
+		return FI_SUCCESS;
+	}
+
 	for (i = 0; i < count; i++) {
 		ret = hook_hmem_cache_mr(domain, &iov[i], &hmem_desc[i]);
 		if (ret) {
-			hook_hmem_uncache_mr_iov(domain, iov, i);
+			hook_hmem_uncache_mr_iov(domain, hmem_desc, i);
 			return ret;
 		}
 
-		desc[i] = hmem_desc[i]->desc ? hmem_desc[i]->desc : desc[i];
+		if (hmem_desc[i])
+			desc[i] = hmem_desc[i]->desc;
 	}
 	return FI_SUCCESS;
 }
@@ -182,7 +230,7 @@ static int hook_hmem_track(struct hook_ep *ep, const struct iovec *iov,
 	int ret;
 
 	domain = container_of(ep->domain, struct hook_hmem_domain, hook_domain);
-	ofi_mutex_lock(&domain->lock);
+	ofi_genlock_lock(&domain->lock);
 
 	*hmem_ctx = ofi_buf_alloc(domain->ctx_pool);
 	if (!*hmem_ctx) {
@@ -194,46 +242,51 @@ static int hook_hmem_track(struct hook_ep *ep, const struct iovec *iov,
 	(*hmem_ctx)->domain = domain;
 	(*hmem_ctx)->flags = flags;
 
-	ret = hook_hmem_cache_mr_iov(domain, iov, desc, count,
-				     (*hmem_ctx)->hmem_desc);
-	if (ret)
-		goto free;
+	if (domain->host_only) {
+		(*hmem_ctx)->desc_count = 0;
+	} else {
+		ret = hook_hmem_cache_mr_iov(domain, iov, desc, count,
+					     (*hmem_ctx)->hmem_desc);
+		if (ret)
+			goto free;
+		(*hmem_ctx)->desc_count = count;
+	}
 
-	(*hmem_ctx)->desc_count = count;
 	(*hmem_ctx)->comp_count = 0;
 	(*hmem_ctx)->comp_desc = NULL;
 	(*hmem_ctx)->res_count = 0;
 	(*hmem_ctx)->res_desc = NULL;
-	ofi_mutex_unlock(&domain->lock);
+	ofi_genlock_unlock(&domain->lock);
 	return FI_SUCCESS;
 
 free:
 	ofi_buf_free(*hmem_ctx);
 unlock:
-	ofi_mutex_unlock(&domain->lock);
+	ofi_genlock_unlock(&domain->lock);
 	return ret;
 }
 
 static void hook_hmem_untrack(struct hook_hmem_ctx *hmem_ctx)
 {
-	int i;
-
-	ofi_mutex_lock(&hmem_ctx->domain->lock);
+	struct hook_hmem_domain *domain = hmem_ctx->domain;
 
-	for (i = 0; i < hmem_ctx->desc_count; i++)
-		hook_hmem_uncache_mr(hmem_ctx->domain,
-				     &hmem_ctx->hmem_desc[i]->iov);
+	ofi_genlock_lock(&domain->lock);
 
-	for (i = 0; i < hmem_ctx->comp_count; i++)
-		hook_hmem_uncache_mr(hmem_ctx->domain,
-				     &hmem_ctx->comp_desc[i]->iov);
-
-	for (i = 0; i < hmem_ctx->res_count; i++)
-		hook_hmem_uncache_mr(hmem_ctx->domain,
-				     &hmem_ctx->res_desc[i]->iov);
+	hook_hmem_uncache_mr_iov(domain, hmem_ctx->hmem_desc,
+				 hmem_ctx->desc_count);
+	if (hmem_ctx->comp_count) {
+		hook_hmem_uncache_mr_iov(domain, hmem_ctx->comp_desc,
+					 hmem_ctx->comp_count);
+		free(hmem_ctx->comp_desc);
+	}
+	if (hmem_ctx->res_count) {
+		hook_hmem_uncache_mr_iov(domain, hmem_ctx->res_desc,
+					 hmem_ctx->res_count);
+		free(hmem_ctx->res_desc);
+	}
 
 	ofi_buf_free(hmem_ctx);
-	ofi_mutex_unlock(&hmem_ctx->domain->lock);
+	ofi_genlock_unlock(&domain->lock);
 }
 
 static int hook_hmem_track_atomic(struct hook_ep *ep, const struct fi_ioc *ioc,
@@ -251,7 +304,7 @@ static int hook_hmem_track_atomic(struct hook_ep *ep, const struct fi_ioc *ioc,
 	int ret;
 
 	domain = container_of(ep->domain, struct hook_hmem_domain, hook_domain);
-	ofi_mutex_lock(&domain->lock);
+	ofi_genlock_lock(&domain->lock);
 
 	*hmem_ctx = ofi_buf_alloc(domain->ctx_pool);
 	if (!*hmem_ctx) {
@@ -270,11 +323,12 @@ static int hook_hmem_track_atomic(struct hook_ep *ep, const struct fi_ioc *ioc,
 		if (ret)
 			goto err2;
 	}
+	(*hmem_ctx)->desc_count = count;
 
 	if (comp_count) {
 		(*hmem_ctx)->comp_desc = calloc(comp_count,
 					sizeof(*(*hmem_ctx)->comp_desc));
-		if ((*hmem_ctx)->comp_desc) {
+		if (!(*hmem_ctx)->comp_desc) {
 			ret = -FI_ENOMEM;
 			goto err3;
 		}
@@ -304,7 +358,7 @@ static int hook_hmem_track_atomic(struct hook_ep *ep, const struct fi_ioc *ioc,
 		ret = hook_hmem_cache_mr_iov(domain, res_iov, res_desc,
 					res_count, (*hmem_ctx)->res_desc);
 		if (ret) {
-			free((*hmem_ctx)->comp_desc);
+			free((*hmem_ctx)->res_desc);
 			goto err4;
 		}
 		(*hmem_ctx)->res_count = res_count;
@@ -313,21 +367,23 @@ static int hook_hmem_track_atomic(struct hook_ep *ep, const struct fi_ioc *ioc,
 		(*hmem_ctx)->res_desc = NULL;
 	}
 
-	ofi_mutex_unlock(&domain->lock);
+	ofi_genlock_unlock(&domain->lock);
 	return FI_SUCCESS;
 
 err4:
 	if (comp_count) {
-		hook_hmem_uncache_mr_iov(domain, comp_iov, comp_count);
+		hook_hmem_uncache_mr_iov(domain, (*hmem_ctx)->comp_desc,
+					 comp_count);
 		free((*hmem_ctx)->comp_desc);
 	}
 err3:
 	if (count)
-		hook_hmem_uncache_mr_iov(domain, iov, count);
+		hook_hmem_uncache_mr_iov(domain, (*hmem_ctx)->hmem_desc,
+					 count);
 err2:
 	ofi_buf_free(*hmem_ctx);
 err1:
-	ofi_mutex_unlock(&domain->lock);
+	ofi_genlock_unlock(&domain->lock);
 	return ret;
 }
 
@@ -1773,7 +1829,7 @@ static int hook_hmem_domain_close(struct fid *fid)
 
 	ofi_bufpool_destroy(hmem_domain->mr_pool);
 	ofi_bufpool_destroy(hmem_domain->ctx_pool);
-	ofi_mutex_destroy(&hmem_domain->lock);
+	ofi_genlock_destroy(&hmem_domain->lock);
 
 	free(hmem_domain);
 	return 0;
@@ -1869,7 +1925,7 @@ static int hook_hmem_domain(struct fid_fabric *fabric, struct fi_info *info,
 			    struct fid_domain **domain, void *context)
 {
 	struct hook_hmem_domain *hmem_domain;
-	int ret;
+	int iface, ret;
 
 	hmem_domain = calloc(1, sizeof(*hmem_domain));
 	if (!hmem_domain)
@@ -1902,9 +1958,26 @@ static int hook_hmem_domain(struct fid_fabric *fabric, struct fi_info *info,
 	}
 
 	hmem_domain->mr_mode = info->domain_attr->mr_mode;
+	hmem_domain->host_only = true;
+	for (iface = FI_HMEM_SYSTEM + 1; iface < OFI_HMEM_MAX; iface++) {
+		if (ofi_hmem_is_initialized(iface))
+			hmem_domain->host_only = false;
+	}
 	ofi_rbmap_init(&hmem_domain->rbmap, hook_hmem_iov_compare);
 	dlist_init(&hmem_domain->mr_list);
-	ofi_mutex_init(&hmem_domain->lock);
+
+	/* Under FI_THREAD_DOMAIN the app serializes all calls into the
+	 * domain, including CQ reads that release contexts.
+	 */
+	ret = ofi_genlock_init(&hmem_domain->lock,
+			info->domain_attr->threading == FI_THREAD_DOMAIN ?
+			OFI_LOCK_NOOP : OFI_LOCK_MUTEX);
+	if (ret) {
+		ofi_bufpool_destroy(hmem_domain->ctx_pool);
+		ofi_bufpool_destroy(hmem_domain->mr_pool);
+		hook_close(&(*domain)->fid);
+		goto out;
+	}
 
 	return 0;
 out:
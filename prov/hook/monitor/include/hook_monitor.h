@@ -87,6 +87,8 @@
 	DECL(mon_cq_data_rx),	\
 	DECL(mon_cq_tagged_tx),  \
 	DECL(mon_cq_tagged_rx),    \
+	DECL(mon_xfer_tx),  \
+	DECL(mon_xfer_rx),  \
 	DECL(mon_api_size)
 
 enum mon_api_counters {
@@ -111,9 +113,18 @@ struct monitor_data {
 	uint64_t sum[MON_SIZE_MAX];
 };
 
+/* mon_xfer_tx and mon_xfer_rx are not APIs: they total the bytes sent
+ * and received by all transfer APIs, by size class.  Sent bytes are
+ * counted when a send, write or inject is posted.  Received bytes are
+ * counted when a read is posted or a receive completion with a length
+ * is read from a CQ.
+ */
 struct monitor_mapped_data {
 	struct monitor_data data[mon_api_size];
 
+	/* ofi_gettime_ns() when data was written */
+	uint64_t flush_ns;
+
 	/* Synchronisation Flag
 	 * bit 0    : data flush request
 	 * bit 1    : termination finished
@@ -182,16 +182,58 @@ mon_flush(struct monitor_context *ctx) {
 	if (request) {
 		// copy counters to share, clear request flag & reset local counters
 		memcpy(ctx->share, ctx->data, sizeof (ctx->data));
+		ctx->share->flush_ns = ofi_gettime_ns();
 		ctx->share->flags ^= 0b1;
 		memset(ctx->data, 0, sizeof (ctx->data));
 	}
 }
 
+static inline int mon_xfer_dir(int cntr)
+{
+	switch (cntr) {
+	case mon_send:
+	case mon_sendv:
+	case mon_sendmsg:
+	case mon_inject:
+	case mon_senddata:
+	case mon_injectdata:
+	case mon_tsend:
+	case mon_tsendv:
+	case mon_tsendmsg:
+	case mon_tinject:
+	case mon_tsenddata:
+	case mon_tinjectdata:
+	case mon_write:
+	case mon_writev:
+	case mon_writemsg:
+	case mon_inject_write:
+	case mon_writedata:
+	case mon_inject_writedata:
+		return mon_xfer_tx;
+	case mon_read:
+	case mon_readv:
+	case mon_readmsg:
+	case mon_cq_msg_rx:
+	case mon_cq_data_rx:
+	case mon_cq_tagged_rx:
+		return mon_xfer_rx;
+	default:
+		return -1;
+	}
+}
+
 static inline void
 mon_add_cntr(struct monitor_context *ctx, int cntr, int index, size_t size) {
+	int dir;
+
 	ctx->data[cntr].count[index]++;
 	if (size != MON_IGNORE_SIZE) {
 		ctx->data[cntr].sum[index] += size;
+		dir = mon_xfer_dir(cntr);
+		if (dir >= 0) {
+			ctx->data[dir].count[index]++;
+			ctx->data[dir].sum[index] += size;
+		}
 	}
 	ctx->tick++;
 	if (ctx->tick >= mon_env.tick_max) {
@@ -996,6 +1038,7 @@ monitor_shm_init(struct monitor_context *mon_ctx)
 	}
 
 	// flush data on init
+	mon_ctx->share->flush_ns = ofi_gettime_ns();
 	mon_ctx->share->flags = 0b0;
 
 	close(fd);
@@ -1032,6 +1075,7 @@ monitor_shm_close(struct monitor_context *mon_ctx)
 			}
 		}
 		memcpy(mon_ctx->share, mon_ctx->data, sizeof (mon_ctx->data));
+		mon_ctx->share->flush_ns = ofi_gettime_ns();
 		mon_ctx->share->flags |= 0b10; // set fin flag
 		mon_ctx->share->flags ^= 0b01; // clear request flag
 	} else {
@@ -38,9 +38,13 @@
 #include "ofi_perf.h"
 
 
+struct perf_hist_set;
+
 struct perf_fabric {
 	struct hook_fabric fabric_hook;
 	struct ofi_perfset perf_set;
+	bool pmu;
+	struct perf_hist_set *hist;
 };
 
 int hook_perf_destroy(struct fid *fabric);
@@ -95,4 +99,65 @@ enum perf_counters {
 
 extern const char *perf_counters_str[];
 
+
+/*
+ * Latency histograms
+ *
+ * When FI_OFI_HOOK_PERF_HIST_OUTPUT is set, the time spent in each call is
+ * recorded per API and per message size class.  Size classes are powers of
+ * two from 64 bytes to 1 MiB, with a last class for larger transfers.
+ * Latencies are counted in log-linear buckets: four per power of two, so
+ * reported percentiles are within 25% of the actual value.
+ *
+ * Data operations posted with a context are also tracked until their
+ * completion is read from a CQ, giving the completion latency of the
+ * operation.  In-flight operations are kept in a direct mapped table
+ * indexed by context; an operation whose slot is reused before it
+ * completes is not counted.
+ *
+ * Periodic reports are written by a separate thread, not by the calls
+ * being measured.
+ */
+#define PERF_SIZE_BUCKETS	16
+#define PERF_LAT_SUB_BITS	2
+#define PERF_LAT_BUCKETS	160
+
+/* Updated with atomics, since calls may be made from any thread */
+struct perf_hist {
+	ofi_atomic64_t	cnt;
+	ofi_atomic64_t	sum;
+	ofi_atomic64_t	min;
+	ofi_atomic64_t	max;
+	ofi_atomic64_t	bucket[PERF_LAT_BUCKETS];
+};
+
+struct perf_pending {
+	void		*context;
+	uint64_t	start;
+	uint16_t	op;
+	uint16_t	size;
+};
+
+struct perf_hist_set {
+	const struct fi_provider *prov;
+	struct perf_hist	call[perf_size][PERF_SIZE_BUCKETS];
+	struct perf_hist	comp[perf_size][PERF_SIZE_BUCKETS];
+	ofi_spin_t		pending_lock;
+	struct perf_pending	*pending;
+	size_t			pending_mask;
+	uint64_t		lost;
+	pthread_t		dump_thread;
+	volatile int		dump_stop;
+	bool			dump_started;
+};
+
+void perf_hist_init(struct fi_provider *prov);
+int perf_hist_create(const struct fi_provider *prov,
+		     struct perf_hist_set **hist);
+void perf_hist_close(struct perf_hist_set *hist);
+void perf_hist_record(struct perf_hist_set *hist, enum perf_counters op,
+		      uint64_t start, size_t len, void *context);
+void perf_hist_complete(struct perf_hist_set *hist, void *context,
+			uint64_t now);
+
 #endif /* _HOOK_PERF_H_ */
@@ -30,6 +30,7 @@
  * SOFTWARE.
  */
 
+#include "ofi_iov.h"
 #include "ofi_perf.h"
 #include "ofi_prov.h"
 #include "hook_prov.h"
@@ -40,22 +41,58 @@ const char *perf_counters_str[] = {
 };
 
 
-static inline struct ofi_perfset *perf_set(struct hook_ep *ep)
+static inline struct perf_fabric *perf_fab(struct hook_domain *domain)
 {
-	return &container_of(ep->domain->fabric, struct perf_fabric,
-			     fabric_hook)->perf_set;
+	return container_of(domain->fabric, struct perf_fabric, fabric_hook);
 }
 
-static inline struct ofi_perfset *perf_set_cq(struct hook_cq *cq)
+static inline uint64_t perf_start(struct perf_fabric *fab,
+				  enum perf_counters op)
 {
-	return &container_of(cq->domain->fabric, struct perf_fabric,
-			     fabric_hook)->perf_set;
+	if (fab->pmu)
+		ofi_perfset_start(&fab->perf_set, op);
+	return fab->hist ? ofi_gettime_ns() : 0;
 }
 
-static inline struct ofi_perfset *perf_set_cntr(struct hook_cntr *cntr)
+static inline void perf_end(struct perf_fabric *fab, enum perf_counters op,
+			    uint64_t start, size_t len, void *context)
 {
-	return &container_of(cntr->domain->fabric, struct perf_fabric,
-			     fabric_hook)->perf_set;
+	if (fab->pmu)
+		ofi_perfset_end(&fab->perf_set, op);
+	if (fab->hist)
+		perf_hist_record(fab->hist, op, start, len, context);
+}
+
+static const size_t perf_cq_entry_size[] = {
+	[FI_CQ_FORMAT_UNSPEC] = 0,
+	[FI_CQ_FORMAT_CONTEXT] = sizeof(struct fi_cq_entry),
+	[FI_CQ_FORMAT_MSG] = sizeof(struct fi_cq_msg_entry),
+	[FI_CQ_FORMAT_DATA] = sizeof(struct fi_cq_data_entry),
+	[FI_CQ_FORMAT_TAGGED] = sizeof(struct fi_cq_tagged_entry),
+};
+
+/* All completion formats start with the op_context. */
+static inline void perf_cq_end(struct hook_cq *cq, enum perf_counters op,
+			       uint64_t start, const void *buf, ssize_t count,
+			       size_t entry_size)
+{
+	struct perf_fabric *fab = perf_fab(cq->domain);
+	uint64_t now;
+	ssize_t i;
+
+	if (fab->pmu)
+		ofi_perfset_end(&fab->perf_set, op);
+	if (!fab->hist)
+		return;
+
+	perf_hist_record(fab->hist, op, start, 0, NULL);
+	if (count <= 0 || !entry_size)
+		return;
+
+	now = ofi_gettime_ns();
+	for (i = 0; i < count; i++)
+		perf_hist_complete(fab->hist, *(void **) ((char *) buf +
+							  i * entry_size), now);
 }
 
 /*
@@ -267,11 +304,13 @@ perf_msg_recv(struct fid_ep *ep, void *buf, size_t len, void *desc,
 	      fi_addr_t src_addr, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_recv);
+	start = perf_start(perf_fab(myep->domain), perf_recv);
 	ret = fi_recv(myep->hep, buf, len, desc, src_addr, context);
-	ofi_perfset_end(perf_set(myep), perf_recv);
+	perf_end(perf_fab(myep->domain), perf_recv, start,
+		 len, ret ? NULL : context);
 	return ret;
 }
 
@@ -280,11 +319,13 @@ perf_msg_recvv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 	       size_t count, fi_addr_t src_addr, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_recvv);
+	start = perf_start(perf_fab(myep->domain), perf_recvv);
 	ret = fi_recvv(myep->hep, iov, desc, count, src_addr, context);
-	ofi_perfset_end(perf_set(myep), perf_recvv);
+	perf_end(perf_fab(myep->domain), perf_recvv, start,
+		 ofi_total_iov_len(iov, count), ret ? NULL : context);
 	return ret;
 }
 
@@ -292,11 +333,14 @@ static ssize_t
 perf_msg_recvmsg(struct fid_ep *ep, const struct fi_msg *msg, uint64_t flags)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_recvmsg);
+	start = perf_start(perf_fab(myep->domain), perf_recvmsg);
 	ret = fi_recvmsg(myep->hep, msg, flags);
-	ofi_perfset_end(perf_set(myep), perf_recvmsg);
+	perf_end(perf_fab(myep->domain), perf_recvmsg, start,
+		 ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+		 ret ? NULL : msg->context);
 	return ret;
 }
 
@@ -305,11 +349,13 @@ perf_msg_send(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 	      fi_addr_t dest_addr, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_send);
+	start = perf_start(perf_fab(myep->domain), perf_send);
 	ret = fi_send(myep->hep, buf, len, desc, dest_addr, context);
-	ofi_perfset_end(perf_set(myep), perf_send);
+	perf_end(perf_fab(myep->domain), perf_send, start,
+		 len, ret ? NULL : context);
 	return ret;
 }
 
@@ -318,11 +364,13 @@ perf_msg_sendv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 	       size_t count, fi_addr_t dest_addr, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_sendv);
+	start = perf_start(perf_fab(myep->domain), perf_sendv);
 	ret = fi_sendv(myep->hep, iov, desc, count, dest_addr, context);
-	ofi_perfset_end(perf_set(myep), perf_sendv);
+	perf_end(perf_fab(myep->domain), perf_sendv, start,
+		 ofi_total_iov_len(iov, count), ret ? NULL : context);
 	return ret;
 }
 
@@ -331,11 +379,14 @@ perf_msg_sendmsg(struct fid_ep *ep, const struct fi_msg *msg,
 		 uint64_t flags)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_sendmsg);
+	start = perf_start(perf_fab(myep->domain), perf_sendmsg);
 	ret = fi_sendmsg(myep->hep, msg, flags);
-	ofi_perfset_end(perf_set(myep), perf_sendmsg);
+	perf_end(perf_fab(myep->domain), perf_sendmsg, start,
+		 ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+		 ret ? NULL : msg->context);
 	return ret;
 }
 
@@ -344,11 +395,12 @@ perf_msg_inject(struct fid_ep *ep, const void *buf, size_t len,
 		fi_addr_t dest_addr)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_inject);
+	start = perf_start(perf_fab(myep->domain), perf_inject);
 	ret = fi_inject(myep->hep, buf, len, dest_addr);
-	ofi_perfset_end(perf_set(myep), perf_inject);
+	perf_end(perf_fab(myep->domain), perf_inject, start, len, NULL);
 	return ret;
 }
 
@@ -357,11 +409,13 @@ perf_msg_senddata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 		  uint64_t data, fi_addr_t dest_addr, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_senddata);
+	start = perf_start(perf_fab(myep->domain), perf_senddata);
 	ret = fi_senddata(myep->hep, buf, len, desc, data, dest_addr, context);
-	ofi_perfset_end(perf_set(myep), perf_senddata);
+	perf_end(perf_fab(myep->domain), perf_senddata, start,
+		 len, ret ? NULL : context);
 	return ret;
 }
 
@@ -370,11 +424,12 @@ perf_msg_injectdata(struct fid_ep *ep, const void *buf, size_t len,
 		    uint64_t data, fi_addr_t dest_addr)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_injectdata);
+	start = perf_start(perf_fab(myep->domain), perf_injectdata);
 	ret = fi_injectdata(myep->hep, buf, len, data, dest_addr);
-	ofi_perfset_end(perf_set(myep), perf_injectdata);
+	perf_end(perf_fab(myep->domain), perf_injectdata, start, len, NULL);
 	return ret;
 }
 
@@ -397,11 +452,13 @@ perf_rma_read(struct fid_ep *ep, void *buf, size_t len, void *desc,
 	      fi_addr_t src_addr, uint64_t addr, uint64_t key, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_read);
+	start = perf_start(perf_fab(myep->domain), perf_read);
 	ret = fi_read(myep->hep, buf, len, desc, src_addr, addr, key, context);
-	ofi_perfset_end(perf_set(myep), perf_read);
+	perf_end(perf_fab(myep->domain), perf_read, start,
+		 len, ret ? NULL : context);
 	return ret;
 }
 
@@ -411,12 +468,14 @@ perf_rma_readv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 	       void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_readv);
+	start = perf_start(perf_fab(myep->domain), perf_readv);
 	ret = fi_readv(myep->hep, iov, desc, count, src_addr,
 		       addr, key, context);
-	ofi_perfset_end(perf_set(myep), perf_readv);
+	perf_end(perf_fab(myep->domain), perf_readv, start,
+		 ofi_total_iov_len(iov, count), ret ? NULL : context);
 	return ret;
 }
 
@@ -425,11 +484,14 @@ perf_rma_readmsg(struct fid_ep *ep, const struct fi_msg_rma *msg,
 		 uint64_t flags)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_readmsg);
+	start = perf_start(perf_fab(myep->domain), perf_readmsg);
 	ret = fi_readmsg(myep->hep, msg, flags);
-	ofi_perfset_end(perf_set(myep), perf_readmsg);
+	perf_end(perf_fab(myep->domain), perf_readmsg, start,
+		 ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+		 ret ? NULL : msg->context);
 	return ret;
 }
 
@@ -438,12 +500,14 @@ perf_rma_write(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 	       fi_addr_t dest_addr, uint64_t addr, uint64_t key, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_write);
+	start = perf_start(perf_fab(myep->domain), perf_write);
 	ret = fi_write(myep->hep, buf, len, desc, dest_addr,
 		       addr, key, context);
-	ofi_perfset_end(perf_set(myep), perf_write);
+	perf_end(perf_fab(myep->domain), perf_write, start,
+		 len, ret ? NULL : context);
 	return ret;
 }
 
@@ -453,12 +517,14 @@ perf_rma_writev(struct fid_ep *ep, const struct iovec *iov, void **desc,
 		void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_writev);
+	start = perf_start(perf_fab(myep->domain), perf_writev);
 	ret = fi_writev(myep->hep, iov, desc, count, dest_addr,
 			addr, key, context);
-	ofi_perfset_end(perf_set(myep), perf_writev);
+	perf_end(perf_fab(myep->domain), perf_writev, start,
+		 ofi_total_iov_len(iov, count), ret ? NULL : context);
 	return ret;
 }
 
@@ -467,11 +533,14 @@ perf_rma_writemsg(struct fid_ep *ep, const struct fi_msg_rma *msg,
 		  uint64_t flags)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_writemsg);
+	start = perf_start(perf_fab(myep->domain), perf_writemsg);
 	ret = fi_writemsg(myep->hep, msg, flags);
-	ofi_perfset_end(perf_set(myep), perf_writemsg);
+	perf_end(perf_fab(myep->domain), perf_writemsg, start,
+		 ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+		 ret ? NULL : msg->context);
 	return ret;
 }
 
@@ -480,11 +549,12 @@ perf_rma_inject(struct fid_ep *ep, const void *buf, size_t len,
 		fi_addr_t dest_addr, uint64_t addr, uint64_t key)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_inject_write);
+	start = perf_start(perf_fab(myep->domain), perf_inject_write);
 	ret = fi_inject_write(myep->hep, buf, len, dest_addr, addr, key);
-	ofi_perfset_end(perf_set(myep), perf_inject_write);
+	perf_end(perf_fab(myep->domain), perf_inject_write, start, len, NULL);
 	return ret;
 }
 
@@ -494,12 +564,14 @@ perf_rma_writedata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 		   uint64_t key, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_writedata);
+	start = perf_start(perf_fab(myep->domain), perf_writedata);
 	ret = fi_writedata(myep->hep, buf, len, desc, data,
 			   dest_addr, addr, key, context);
-	ofi_perfset_end(perf_set(myep), perf_writedata);
+	perf_end(perf_fab(myep->domain), perf_writedata, start,
+		 len, ret ? NULL : context);
 	return ret;
 }
 
@@ -509,12 +581,13 @@ perf_rma_injectdata(struct fid_ep *ep, const void *buf, size_t len,
 		    uint64_t key)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_inject_writedata);
+	start = perf_start(perf_fab(myep->domain), perf_inject_writedata);
 	ret = fi_inject_writedata(myep->hep, buf, len, data, dest_addr,
 				  addr, key);
-	ofi_perfset_end(perf_set(myep), perf_inject_writedata);
+	perf_end(perf_fab(myep->domain), perf_inject_writedata, start, len, NULL);
 	return ret;
 }
 
@@ -538,12 +611,14 @@ perf_tagged_recv(struct fid_ep *ep, void *buf, size_t len, void *desc,
 		 void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_trecv);
+	start = perf_start(perf_fab(myep->domain), perf_trecv);
 	ret = fi_trecv(myep->hep, buf, len, desc, src_addr,
 		       tag, ignore, context);
-	ofi_perfset_end(perf_set(myep), perf_trecv);
+	perf_end(perf_fab(myep->domain), perf_trecv, start,
+		 len, ret ? NULL : context);
 	return ret;
 }
 
@@ -553,12 +628,14 @@ perf_tagged_recvv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 		  uint64_t ignore, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_trecvv);
+	start = perf_start(perf_fab(myep->domain), perf_trecvv);
 	ret = fi_trecvv(myep->hep, iov, desc, count, src_addr,
 			tag, ignore, context);
-	ofi_perfset_end(perf_set(myep), perf_trecvv);
+	perf_end(perf_fab(myep->domain), perf_trecvv, start,
+		 ofi_total_iov_len(iov, count), ret ? NULL : context);
 	return ret;
 }
 
@@ -567,11 +644,14 @@ perf_tagged_recvmsg(struct fid_ep *ep, const struct fi_msg_tagged *msg,
 		    uint64_t flags)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_trecvmsg);
+	start = perf_start(perf_fab(myep->domain), perf_trecvmsg);
 	ret = fi_trecvmsg(myep->hep, msg, flags);
-	ofi_perfset_end(perf_set(myep), perf_trecvmsg);
+	perf_end(perf_fab(myep->domain), perf_trecvmsg, start,
+		 ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+		 ret ? NULL : msg->context);
 	return ret;
 }
 
@@ -580,11 +660,13 @@ perf_tagged_send(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 		 fi_addr_t dest_addr, uint64_t tag, void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_tsend);
+	start = perf_start(perf_fab(myep->domain), perf_tsend);
 	ret = fi_tsend(myep->hep, buf, len, desc, dest_addr, tag, context);
-	ofi_perfset_end(perf_set(myep), perf_tsend);
+	perf_end(perf_fab(myep->domain), perf_tsend, start,
+		 len, ret ? NULL : context);
 	return ret;
 }
 
@@ -594,11 +676,13 @@ perf_tagged_sendv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 		  void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_tsendv);
+	start = perf_start(perf_fab(myep->domain), perf_tsendv);
 	ret = fi_tsendv(myep->hep, iov, desc, count, dest_addr, tag, context);
-	ofi_perfset_end(perf_set(myep), perf_tsendv);
+	perf_end(perf_fab(myep->domain), perf_tsendv, start,
+		 ofi_total_iov_len(iov, count), ret ? NULL : context);
 	return ret;
 }
 
@@ -607,11 +691,14 @@ perf_tagged_sendmsg(struct fid_ep *ep, const struct fi_msg_tagged *msg,
 		    uint64_t flags)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_tsendmsg);
+	start = perf_start(perf_fab(myep->domain), perf_tsendmsg);
 	ret = fi_tsendmsg(myep->hep, msg, flags);
-	ofi_perfset_end(perf_set(myep), perf_tsendmsg);
+	perf_end(perf_fab(myep->domain), perf_tsendmsg, start,
+		 ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+		 ret ? NULL : msg->context);
 	return ret;
 }
 
@@ -620,11 +707,12 @@ perf_tagged_inject(struct fid_ep *ep, const void *buf, size_t len,
 		   fi_addr_t dest_addr, uint64_t tag)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_tinject);
+	start = perf_start(perf_fab(myep->domain), perf_tinject);
 	ret = fi_tinject(myep->hep, buf, len, dest_addr, tag);
-	ofi_perfset_end(perf_set(myep), perf_tinject);
+	perf_end(perf_fab(myep->domain), perf_tinject, start, len, NULL);
 	return ret;
 }
 
@@ -634,12 +722,14 @@ perf_tagged_senddata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 		     void *context)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_tsenddata);
+	start = perf_start(perf_fab(myep->domain), perf_tsenddata);
 	ret = fi_tsenddata(myep->hep, buf, len, desc, data,
 			   dest_addr, tag, context);
-	ofi_perfset_end(perf_set(myep), perf_tsenddata);
+	perf_end(perf_fab(myep->domain), perf_tsenddata, start,
+		 len, ret ? NULL : context);
 	return ret;
 }
 
@@ -648,11 +738,12 @@ perf_tagged_injectdata(struct fid_ep *ep, const void *buf, size_t len,
 		       uint64_t data, fi_addr_t dest_addr, uint64_t tag)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set(myep), perf_tinjectdata);
+	start = perf_start(perf_fab(myep->domain), perf_tinjectdata);
 	ret = fi_tinjectdata(myep->hep, buf, len, data, dest_addr, tag);
-	ofi_perfset_end(perf_set(myep), perf_tinjectdata);
+	perf_end(perf_fab(myep->domain), perf_tinjectdata, start, len, NULL);
 	return ret;
 }
 
@@ -673,11 +764,13 @@ static struct fi_ops_tagged perf_tagged_ops = {
 static ssize_t perf_cq_read_op(struct fid_cq *cq, void *buf, size_t count)
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set_cq(mycq), perf_cq_read);
+	start = perf_start(perf_fab(mycq->domain), perf_cq_read);
 	ret = fi_cq_read(mycq->hcq, buf, count);
-	ofi_perfset_end(perf_set_cq(mycq), perf_cq_read);
+	perf_cq_end(mycq, perf_cq_read, start, buf, ret,
+		    perf_cq_entry_size[mycq->format]);
 	return ret;
 }
 
@@ -685,11 +778,13 @@ static ssize_t
 perf_cq_readerr_op(struct fid_cq *cq, struct fi_cq_err_entry *buf, uint64_t flags)
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set_cq(mycq), perf_cq_readerr);
+	start = perf_start(perf_fab(mycq->domain), perf_cq_readerr);
 	ret = fi_cq_readerr(mycq->hcq, buf, flags);
-	ofi_perfset_end(perf_set_cq(mycq), perf_cq_readerr);
+	perf_cq_end(mycq, perf_cq_readerr, start, buf, ret,
+		    sizeof(*buf));
 	return ret;
 }
 
@@ -697,11 +792,13 @@ static ssize_t
 perf_cq_readfrom_op(struct fid_cq *cq, void *buf, size_t count, fi_addr_t *src_addr)
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set_cq(mycq), perf_cq_readfrom);
+	start = perf_start(perf_fab(mycq->domain), perf_cq_readfrom);
 	ret = fi_cq_readfrom(mycq->hcq, buf, count, src_addr);
-	ofi_perfset_end(perf_set_cq(mycq), perf_cq_readfrom);
+	perf_cq_end(mycq, perf_cq_readfrom, start, buf, ret,
+		    perf_cq_entry_size[mycq->format]);
 	return ret;
 }
 
@@ -710,11 +807,13 @@ perf_cq_sread_op(struct fid_cq *cq, void *buf, size_t count,
 	      const void *cond, int timeout)
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set_cq(mycq), perf_cq_sread);
+	start = perf_start(perf_fab(mycq->domain), perf_cq_sread);
 	ret = fi_cq_sread(mycq->hcq, buf, count, cond, timeout);
-	ofi_perfset_end(perf_set_cq(mycq), perf_cq_sread);
+	perf_cq_end(mycq, perf_cq_sread, start, buf, ret,
+		    perf_cq_entry_size[mycq->format]);
 	return ret;
 }
 
@@ -723,22 +822,25 @@ perf_cq_sreadfrom_op(struct fid_cq *cq, void *buf, size_t count,
 		  fi_addr_t *src_addr, const void *cond, int timeout)
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
+	uint64_t start;
 	ssize_t ret;
 
-	ofi_perfset_start(perf_set_cq(mycq), perf_cq_sreadfrom);
+	start = perf_start(perf_fab(mycq->domain), perf_cq_sreadfrom);
 	ret = fi_cq_sreadfrom(mycq->hcq, buf, count, src_addr, cond, timeout);
-	ofi_perfset_end(perf_set_cq(mycq), perf_cq_sreadfrom);
+	perf_cq_end(mycq, perf_cq_sreadfrom, start, buf, ret,
+		    perf_cq_entry_size[mycq->format]);
 	return ret;
 }
 
 static int perf_cq_signal_op(struct fid_cq *cq)
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
+	uint64_t start;
 	int ret;
 
-	ofi_perfset_start(perf_set_cq(mycq), perf_cq_signal);
+	start = perf_start(perf_fab(mycq->domain), perf_cq_signal);
 	ret = fi_cq_signal(mycq->hcq);
-	ofi_perfset_end(perf_set_cq(mycq), perf_cq_signal);
+	perf_end(perf_fab(mycq->domain), perf_cq_signal, start, 0, NULL);
 	return ret;
 }
 
@@ -757,77 +859,84 @@ struct fi_ops_cq perf_cq_ops = {
 static uint64_t perf_cntr_read_op(struct fid_cntr *cntr)
 {
 	struct hook_cntr *mycntr = container_of(cntr, struct hook_cntr, cntr);
+	uint64_t start;
 	uint64_t ret;
 
-	ofi_perfset_start(perf_set_cntr(mycntr), perf_cntr_read);
+	start = perf_start(perf_fab(mycntr->domain), perf_cntr_read);
 	ret = fi_cntr_read(mycntr->hcntr);
-	ofi_perfset_end(perf_set_cntr(mycntr), perf_cntr_read);
+	perf_end(perf_fab(mycntr->domain), perf_cntr_read, start, 0, NULL);
 	return ret;
 }
 
 static uint64_t perf_cntr_readerr_op(struct fid_cntr *cntr)
 {
 	struct hook_cntr *mycntr = container_of(cntr, struct hook_cntr, cntr);
+	uint64_t start;
 	uint64_t ret;
 
-	ofi_perfset_start(perf_set_cntr(mycntr), perf_cntr_readerr);
+	start = perf_start(perf_fab(mycntr->domain), perf_cntr_readerr);
 	ret = fi_cntr_readerr(mycntr->hcntr);
-	ofi_perfset_end(perf_set_cntr(mycntr), perf_cntr_readerr);
+	perf_end(perf_fab(mycntr->domain), perf_cntr_readerr, start, 0, NULL);
 	return ret;
 }
 
 static int perf_cntr_add_op(struct fid_cntr *cntr, uint64_t value)
 {
 	struct hook_cntr *mycntr = container_of(cntr, struct hook_cntr, cntr);
+	uint64_t start;
 	int ret;
 
-	ofi_perfset_start(perf_set_cntr(mycntr), perf_cntr_add);
+	start = perf_start(perf_fab(mycntr->domain), perf_cntr_add);
 	ret = fi_cntr_add(mycntr->hcntr, value);
-	ofi_perfset_end(perf_set_cntr(mycntr), perf_cntr_add);
+	perf_end(perf_fab(mycntr->domain), perf_cntr_add, start, 0, NULL);
 	return ret;
 }
 
 static int perf_cntr_set_op(struct fid_cntr *cntr, uint64_t value)
 {
 	struct hook_cntr *mycntr = container_of(cntr, struct hook_cntr, cntr);
+	uint64_t start;
 	int ret;
 
-	ofi_perfset_start(perf_set_cntr(mycntr), perf_cntr_set);
+	start = perf_start(perf_fab(mycntr->domain), perf_cntr_set);
 	ret = fi_cntr_set(mycntr->hcntr, value);
-	ofi_perfset_end(perf_set_cntr(mycntr), perf_cntr_set);
+	perf_end(perf_fab(mycntr->domain), perf_cntr_set, start, 0, NULL);
 	return ret;
 }
 
 static int perf_cntr_wait_op(struct fid_cntr *cntr, uint64_t threshold, int timeout)
 {
 	struct hook_cntr *mycntr = container_of(cntr, struct hook_cntr, cntr);
+	uint64_t start;
 	int ret;
 
-	ofi_perfset_start(perf_set_cntr(mycntr), perf_cntr_wait);
+	start = perf_start(perf_fab(mycntr->domain), perf_cntr_wait);
 	ret = fi_cntr_wait(mycntr->hcntr, threshold, timeout);
-	ofi_perfset_end(perf_set_cntr(mycntr), perf_cntr_wait);
+	perf_end(perf_fab(mycntr->domain), perf_cntr_wait, start, 0, NULL);
 	return ret;
 }
 
 static int perf_cntr_adderr_op(struct fid_cntr *cntr, uint64_t value)
 {
 	struct hook_cntr *mycntr = container_of(cntr, struct hook_cntr, cntr);
+	uint64_t start;
 	int ret;
 
-	ofi_perfset_start(perf_set_cntr(mycntr), perf_cntr_adderr);
+	start = perf_start(perf_fab(mycntr->domain), perf_cntr_adderr);
 	ret = fi_cntr_adderr(mycntr->hcntr, value);
-	ofi_perfset_end(perf_set_cntr(mycntr), perf_cntr_adderr);
+	perf_end(perf_fab(mycntr->domain), perf_cntr_adderr, start, 0, NULL);
 	return ret;
 }
 
 static int perf_cntr_seterr_op(struct fid_cntr *cntr, uint64_t value)
 {
 	struct hook_cntr *mycntr = container_of(cntr, struct hook_cntr, cntr);
+	uint64_t start;
 	int ret;
 
-	ofi_perfset_start(perf_set_cntr(mycntr), perf_cntr_seterr);
+	start = perf_start(perf_fab(mycntr->domain), perf_cntr_seterr);
 	ret = fi_cntr_seterr(mycntr->hcntr, value);
-	ofi_perfset_end(perf_set_cntr(mycntr), perf_cntr_seterr);
+	perf_end(perf_fab(mycntr->domain), perf_cntr_seterr, start, 0, NULL);
 	return ret;
 }
 
@@ -856,8 +965,12 @@ int hook_perf_destroy(struct fid *fid)
 	struct perf_fabric *fab;
 
 	fab = container_of(fid, struct perf_fabric, fabric_hook);
-	ofi_perfset_log(&fab->perf_set, perf_counters_str);
-	ofi_perfset_close(&fab->perf_set);
+	if (fab->hist)
+		perf_hist_close(fab->hist);
+	if (fab->pmu) {
+		ofi_perfset_log(&fab->perf_set, perf_counters_str);
+		ofi_perfset_close(&fab->perf_set);
+	}
 	hook_close(fid);
 
 	return FI_SUCCESS;
@@ -877,12 +990,20 @@ static int hook_perf_fabric(struct fi_fabric_attr *attr,
 	if (!fab)
 		return -FI_ENOMEM;
 
+	ret = perf_hist_create(hprov, &fab->hist);
+	if (ret) {
+		free(fab);
+		return ret;
+	}
+
+	/* Latency histograms do not need the PMU. */
 	ret = ofi_perfset_create(hprov, &fab->perf_set, perf_size,
 				 perf_domain, perf_cntr, perf_flags);
-	if (ret) {
+	if (ret && !fab->hist) {
 		free(fab);
 		return ret;
 	}
+	fab->pmu = !ret;
 
 	/*
 	 * TODO
@@ -934,6 +1055,7 @@ static int perf_endpoint_init(struct fid *fid)
 
 HOOK_PERF_INI
 {
+	perf_hist_init(&hook_perf_ctx.prov);
 	hook_perf_ctx.ini_fid[FI_CLASS_CQ] = perf_cq_init;
 	hook_perf_ctx.ini_fid[FI_CLASS_CNTR] = perf_cntr_init;
 	hook_perf_ctx.ini_fid[FI_CLASS_EP] = perf_endpoint_init;
@@ -0,0 +1,471 @@
+/*
+ * Copyright (c) 2024 Hewlett Packard Enterprise Development LP. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <errno.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ofi_prov.h"
+#include "hook_prov.h"
+
+
+#define PERF_HIST_POLL_US	100000
+
+/* Copy of a histogram taken when writing a report */
+struct perf_hist_data {
+	uint64_t	cnt;
+	uint64_t	sum;
+	uint64_t	min;
+	uint64_t	max;
+	uint64_t	bucket[PERF_LAT_BUCKETS];
+};
+
+static struct {
+	char	*output;
+	char	*format;
+	int	interval;
+	size_t	pending;
+} perf_hist_env = {
+	.format = "csv",
+	.pending = 4096,
+};
+
+static inline unsigned int perf_log2(uint64_t val)
+{
+#ifdef __GNUC__
+	return 63 - __builtin_clzll(val);
+#else
+	return ofi_msb(val) - 1;
+#endif
+}
+
+static inline unsigned int perf_size_bucket(size_t len)
+{
+	if (len <= 64)
+		return 0;
+	return MIN(perf_log2(len - 1) - 5, PERF_SIZE_BUCKETS - 1);
+}
+
+static inline unsigned int perf_lat_bucket(uint64_t ns)
+{
+	unsigned int shift;
+
+	if (ns < (1 << PERF_LAT_SUB_BITS))
+		return (unsigned int) ns;
+
+	shift = perf_log2(ns) - PERF_LAT_SUB_BITS;
+	return MIN(((shift + 1) << PERF_LAT_SUB_BITS) +
+		   (unsigned int) ((ns >> shift) &
+				   ((1 << PERF_LAT_SUB_BITS) - 1)),
+		   PERF_LAT_BUCKETS - 1);
+}
+
+/* Largest latency counted in a bucket */
+static uint64_t perf_lat_bucket_max(unsigned int bucket)
+{
+	unsigned int shift;
+
+	if (bucket < (1 << PERF_LAT_SUB_BITS))
+		return bucket;
+
+	shift = (bucket >> PERF_LAT_SUB_BITS) - 1;
+	return ((uint64_t) ((1 << PERF_LAT_SUB_BITS) +
+			    (bucket & ((1 << PERF_LAT_SUB_BITS) - 1)) + 1)
+		<< shift) - 1;
+}
+
+static inline void perf_hist_add(struct perf_hist *hist, uint64_t ns)
+{
+	int64_t val;
+
+	val = ofi_atomic_get64(&hist->min);
+	while ((int64_t) ns < val &&
+	       !ofi_atomic_compare_exchange_weak64(&hist->min, &val, ns))
+		;
+	val = ofi_atomic_get64(&hist->max);
+	while ((int64_t) ns > val &&
+	       !ofi_atomic_compare_exchange_weak64(&hist->max, &val, ns))
+		;
+	ofi_atomic_inc64(&hist->cnt);
+	ofi_atomic_add64(&hist->sum, ns);
+	ofi_atomic_inc64(&hist->bucket[perf_lat_bucket(ns)]);
+}
+
+static void perf_hist_init_one(struct perf_hist *hist)
+{
+	unsigned int i;
+
+	ofi_atomic_initialize64(&hist->cnt, 0);
+	ofi_atomic_initialize64(&hist->sum, 0);
+	ofi_atomic_initialize64(&hist->min, INT64_MAX);
+	ofi_atomic_initialize64(&hist->max, 0);
+	for (i = 0; i < PERF_LAT_BUCKETS; i++)
+		ofi_atomic_initialize64(&hist->bucket[i], 0);
+}
+
+/* Counters may be updated while they are read, so the copy is only
+ * approximately consistent; the count is taken from the buckets.
+ */
+static void perf_hist_read(struct perf_hist *hist,
+			   struct perf_hist_data *data)
+{
+	unsigned int i;
+
+	data->cnt = 0;
+	for (i = 0; i < PERF_LAT_BUCKETS; i++) {
+		data->bucket[i] = ofi_atomic_get64(&hist->bucket[i]);
+		data->cnt += data->bucket[i];
+	}
+	data->sum = ofi_atomic_get64(&hist->sum);
+	data->min = ofi_atomic_get64(&hist->min);
+	data->max = ofi_atomic_get64(&hist->max);
+}
+
+static inline size_t perf_pending_index(struct perf_hist_set *hist,
+					void *context)
+{
+	return (size_t) (((uintptr_t) context >> 3) *
+			 0x9e3779b97f4a7c15ULL >> 32) & hist->pending_mask;
+}
+
+static uint64_t perf_hist_pct(struct perf_hist_data *hist,
+			      uint64_t permille)
+{
+	uint64_t target, sum = 0;
+	unsigned int i;
+
+	target = (hist->cnt * permille + 999) / 1000;
+	for (i = 0; i < PERF_LAT_BUCKETS; i++) {
+		sum += hist->bucket[i];
+		if (sum >= target)
+			return MIN(perf_lat_bucket_max(i), hist->max);
+	}
+	return hist->max;
+}
+
+static void perf_size_str(char *buf, size_t len, enum perf_counters op,
+			  unsigned int size)
+{
+	if (op >= perf_cq_read)
+		snprintf(buf, len, "-");
+	else if (size == PERF_SIZE_BUCKETS - 1)
+		snprintf(buf, len, ">%zu", (size_t) 64 << (size - 1));
+	else
+		snprintf(buf, len, "%zu", (size_t) 64 << size);
+}
+
+static void perf_hist_csv(FILE *out, const char *kind, enum perf_counters op,
+			  unsigned int size, struct perf_hist_data *hist)
+{
+	char size_str[16];
+
+	perf_size_str(size_str, sizeof(size_str), op, size);
+	fprintf(out, "%s,%s,%s,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+		",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+		kind, perf_counters_str[op] + strlen("perf_"), size_str,
+		hist->cnt, hist->min, hist->sum / hist->cnt,
+		perf_hist_pct(hist, 500), perf_hist_pct(hist, 900),
+		perf_hist_pct(hist, 990), perf_hist_pct(hist, 999),
+		hist->max);
+}
+
+static void perf_hist_json(FILE *out, const char *kind, enum perf_counters op,
+			   unsigned int size, struct perf_hist_data *hist,
+			   bool first)
+{
+	char size_str[16];
+	unsigned int i;
+	bool first_bucket = true;
+
+	perf_size_str(size_str, sizeof(size_str), op, size);
+	fprintf(out, "%s\n{\"kind\":\"%s\",\"api\":\"%s\",\"size\":\"%s\","
+		"\"count\":%" PRIu64 ",\"min_ns\":%" PRIu64 ",\"mean_ns\":%"
+		PRIu64 ",\"p50_ns\":%" PRIu64 ",\"p90_ns\":%" PRIu64
+		",\"p99_ns\":%" PRIu64 ",\"p999_ns\":%" PRIu64 ",\"max_ns\":%"
+		PRIu64 ",\"buckets\":[", first ? "" : ",", kind,
+		perf_counters_str[op] + strlen("perf_"), size_str,
+		hist->cnt, hist->min, hist->sum / hist->cnt,
+		perf_hist_pct(hist, 500), perf_hist_pct(hist, 900),
+		perf_hist_pct(hist, 990), perf_hist_pct(hist, 999),
+		hist->max);
+	for (i = 0; i < PERF_LAT_BUCKETS; i++) {
+		if (!hist->bucket[i])
+			continue;
+		fprintf(out, "%s[%" PRIu64 ",%" PRIu64 "]",
+			first_bucket ? "" : ",", perf_lat_bucket_max(i),
+			hist->bucket[i]);
+		first_bucket = false;
+	}
+	fprintf(out, "]}");
+}
+
+static void perf_hist_write(struct perf_hist_set *hist, FILE *out)
+{
+	bool json, first = true;
+	int op, kind;
+	unsigned int size;
+	struct perf_hist_data h;
+
+	json = !strcasecmp(perf_hist_env.format, "json");
+	if (json)
+		fprintf(out, "{\"pid\":%d,\"lost\":%" PRIu64
+			",\"histograms\":[", getpid(), hist->lost);
+	else
+		fprintf(out, "kind,api,size,count,min_ns,mean_ns,p50_ns,"
+			"p90_ns,p99_ns,p999_ns,max_ns\n");
+
+	for (kind = 0; kind < 2; kind++) {
+		for (op = 0; op < perf_size; op++) {
+			for (size = 0; size < PERF_SIZE_BUCKETS; size++) {
+				perf_hist_read(kind ? &hist->comp[op][size] :
+					       &hist->call[op][size], &h);
+				if (!h.cnt)
+					continue;
+				if (json) {
+					perf_hist_json(out, kind ? "completion" :
+						       "call", op, size, &h,
+						       first);
+				} else {
+					perf_hist_csv(out, kind ? "completion" :
+						      "call", op, size, &h);
+				}
+				first = false;
+			}
+		}
+	}
+
+	if (json)
+		fprintf(out, "\n]}\n");
+}
+
+/*
+ * Files are written under a temporary name and renamed, so that a reader
+ * polling the output while the application runs always sees a complete
+ * report.  Windows rename() does not replace an existing file, so the old
+ * report is removed first there.
+ */
+static void perf_hist_dump(struct perf_hist_set *hist)
+{
+	char path[PATH_MAX], tmp[PATH_MAX + 8];
+	const char *pos;
+	FILE *out;
+	size_t len;
+
+	if (!strcmp(perf_hist_env.output, "stdout")) {
+		perf_hist_write(hist, stdout);
+		fflush(stdout);
+		return;
+	}
+	if (!strcmp(perf_hist_env.output, "stderr")) {
+		perf_hist_write(hist, stderr);
+		return;
+	}
+
+	pos = strstr(perf_hist_env.output, "%p");
+	if (pos) {
+		len = pos - perf_hist_env.output;
+		snprintf(path, sizeof(path), "%.*s%d%s", (int) len,
+			 perf_hist_env.output, getpid(), pos + 2);
+	} else {
+		snprintf(path, sizeof(path), "%s", perf_hist_env.output);
+	}
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+	out = fopen(tmp, "w");
+	if (!out) {
+		FI_WARN(hist->prov, FI_LOG_FABRIC, "could not open %s: %s\n",
+			tmp, strerror(errno));
+		return;
+	}
+
+	perf_hist_write(hist, out);
+#ifdef _WIN32
+	remove(path);
+#endif
+	if (fclose(out) || rename(tmp, path)) {
+		FI_WARN(hist->prov, FI_LOG_FABRIC, "could not write %s: %s\n",
+			path, strerror(errno));
+		remove(tmp);
+	}
+}
+
+static void *perf_hist_dump_thread(void *arg)
+{
+	struct perf_hist_set *hist = arg;
+	uint64_t next_dump;
+
+	next_dump = ofi_gettime_ns() + perf_hist_env.interval * 1000000000ULL;
+	while (!hist->dump_stop) {
+		usleep(PERF_HIST_POLL_US);
+		if (ofi_gettime_ns() < next_dump)
+			continue;
+
+		perf_hist_dump(hist);
+		next_dump = ofi_gettime_ns() +
+			    perf_hist_env.interval * 1000000000ULL;
+	}
+	return NULL;
+}
+
+void perf_hist_record(struct perf_hist_set *hist, enum perf_counters op,
+		      uint64_t start, size_t len, void *context)
+{
+	struct perf_pending *entry;
+	unsigned int size;
+	uint64_t now;
+
+	now = ofi_gettime_ns();
+	size = perf_size_bucket(len);
+	perf_hist_add(&hist->call[op][size], now - start);
+
+	if (context && hist->pending) {
+		entry = &hist->pending[perf_pending_index(hist, context)];
+		ofi_spin_lock(&hist->pending_lock);
+		if (entry->context)
+			hist->lost++;
+		entry->context = context;
+		entry->start = start;
+		entry->op = (uint16_t) op;
+		entry->size = (uint16_t) size;
+		ofi_spin_unlock(&hist->pending_lock);
+	}
+}
+
+void perf_hist_complete(struct perf_hist_set *hist, void *context,
+			uint64_t now)
+{
+	struct perf_pending *entry;
+
+	if (!hist->pending || !context)
+		return;
+
+	entry = &hist->pending[perf_pending_index(hist, context)];
+	ofi_spin_lock(&hist->pending_lock);
+	if (entry->context == context) {
+		perf_hist_add(&hist->comp[entry->op][entry->size],
+			      now - entry->start);
+		entry->context = NULL;
+	}
+	ofi_spin_unlock(&hist->pending_lock);
+}
+
+int perf_hist_create(const struct fi_provider *prov,
+		     struct perf_hist_set **hist)
+{
+	struct perf_hist_set *set;
+	int op, size;
+
+	*hist = NULL;
+	if (!perf_hist_env.output || !*perf_hist_env.output)
+		return 0;
+
+	set = calloc(1, sizeof(*set));
+	if (!set)
+		return -FI_ENOMEM;
+
+	if (perf_hist_env.pending) {
+		set->pending_mask = roundup_power_of_two(perf_hist_env.pending)
+				    - 1;
+		set->pending = calloc(set->pending_mask + 1,
+				      sizeof(*set->pending));
+		if (!set->pending) {
+			free(set);
+			return -FI_ENOMEM;
+		}
+	}
+
+	for (op = 0; op < perf_size; op++) {
+		for (size = 0; size < PERF_SIZE_BUCKETS; size++) {
+			perf_hist_init_one(&set->call[op][size]);
+			perf_hist_init_one(&set->comp[op][size]);
+		}
+	}
+
+	set->prov = prov;
+	ofi_spin_init(&set->pending_lock);
+	if (perf_hist_env.interval) {
+		if (pthread_create(&set->dump_thread, NULL,
+				   perf_hist_dump_thread, set))
+			FI_WARN(prov, FI_LOG_FABRIC, "unable to start "
+				"histogram thread, reporting only at close\n");
+		else
+			set->dump_started = true;
+	}
+	*hist = set;
+	return 0;
+}
+
+void perf_hist_close(struct perf_hist_set *hist)
+{
+	if (hist->dump_started) {
+		hist->dump_stop = 1;
+		pthread_join(hist->dump_thread, NULL);
+	}
+	perf_hist_dump(hist);
+	ofi_spin_destroy(&hist->pending_lock);
+	free(hist->pending);
+	free(hist);
+}
+
+void perf_hist_init(struct fi_provider *prov)
+{
+	fi_param_define(prov, "hist_output", FI_PARAM_STRING,
+			"File to write latency histograms to when the fabric "
+			"is closed.  %%p is replaced by the process id; "
+			"'stdout' and 'stderr' are accepted.  Histograms are "
+			"only collected when set.");
+	fi_param_define(prov, "hist_format", FI_PARAM_STRING,
+			"Histogram output format, 'csv' or 'json'. "
+			"(default: csv)");
+	fi_param_define(prov, "hist_interval", FI_PARAM_INT,
+			"Also rewrite the histogram file every N seconds "
+			"while the fabric is open. (default: 0, only at "
+			"close)");
+	fi_param_define(prov, "hist_pending", FI_PARAM_SIZE_T,
+			"In-flight operations tracked for completion latency, "
+			"0 to disable. (default: %zu)", perf_hist_env.pending);
+
+	fi_param_get_str(prov, "hist_output",
+			 &perf_hist_env.output);
+	fi_param_get_str(prov, "hist_format",
+			 &perf_hist_env.format);
+	fi_param_get_int(prov, "hist_interval",
+			 &perf_hist_env.interval);
+	fi_param_get_size_t(prov, "hist_pending",
+			    &perf_hist_env.pending);
+	if (perf_hist_env.interval < 0)
+		perf_hist_env.interval = 0;
+}
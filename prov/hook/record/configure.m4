@@ -0,0 +1,16 @@
+dnl Configury specific to the libfabrics record hooking provider
+
+dnl Called to configure this provider
+dnl
+dnl Arguments:
+dnl
+dnl $1: action if configured successfully
+dnl $2: action if not configured successfully
+dnl
+
+AC_DEFUN([FI_RECORD_CONFIGURE],[
+    # Determine if we can support the record hooking provider
+    record_happy=0
+    AS_IF([test x"$enable_record" != x"no"], [record_happy=1])
+    AS_IF([test $record_happy -eq 1], [$1], [$2])
+])
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2024 Hewlett Packard Enterprise Development LP. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _HOOK_RECORD_H_
+#define _HOOK_RECORD_H_
+
+#include <stdint.h>
+
+#include "ofi.h"
+
+/*
+ * Capture file, written by ofi_hook_record and replayed by fi_replay.
+ *
+ * The file starts with a record_file_hdr, followed by one record per data
+ * transfer call that was accepted by the provider, in the order the calls
+ * were made.  Calls returning an error, including -FI_EAGAIN, are not
+ * recorded.  Every API variant of an operation maps to one record op: the
+ * length is the total of the iov, and inject flags or remote CQ data on
+ * the msg calls select the inject op or set RECORD_FLAG_DATA.
+ *
+ * The header is rewritten whenever records are flushed, so record_cnt is
+ * valid for the data that reached the file.
+ *
+ * Note: keep in sync with fabtests/benchmarks/replay.c
+ */
+#define RECORD_MAGIC		0x44524f4345524946ULL	/* "FIRECORD" */
+#define RECORD_VERSION		1
+#define RECORD_BASEPATH_DEFAULT	"/tmp"
+#define RECORD_BUF_CNT		1024
+
+#define RECORD_OPS(DECL)  \
+	DECL(record_op_recv), \
+	DECL(record_op_send), \
+	DECL(record_op_inject), \
+	DECL(record_op_trecv), \
+	DECL(record_op_tsend), \
+	DECL(record_op_tinject), \
+	DECL(record_op_read), \
+	DECL(record_op_write), \
+	DECL(record_op_inject_write), \
+	DECL(record_op_max)
+
+enum record_op {
+	RECORD_OPS(OFI_ENUM_VAL)
+};
+
+#define RECORD_FLAG_DATA	(1 << 0)	/* data holds remote CQ data */
+#define RECORD_FLAG_MULTI_RECV	(1 << 1)
+
+#define RECORD_PEER_UNSPEC	UINT32_MAX
+
+struct record_entry {
+	uint64_t	ts;		/* ns since the capture started */
+	uint64_t	len;
+	uint64_t	tag;
+	uint64_t	data;		/* CQ data, or ignore bits of trecv */
+	uint32_t	peer;		/* fi_addr_t, RECORD_PEER_UNSPEC if any */
+	uint16_t	ep;		/* endpoint, in order of opening */
+	uint8_t		op;
+	uint8_t		flags;
+};
+
+struct record_file_hdr {
+	uint64_t	magic;
+	uint32_t	version;
+	uint32_t	record_size;
+	uint32_t	pid;
+	uint32_t	ep_cnt;
+	uint64_t	record_cnt;
+	uint64_t	start_wall_ns;	/* wall clock at creation */
+	uint64_t	duration_ns;	/* capture start to last record */
+	uint64_t	caps;		/* of the first endpoint */
+	uint32_t	ep_type;	/* of the first endpoint */
+	uint32_t	reserved;
+	char		prov_name[64];
+};
+
+#endif /* _HOOK_RECORD_H_ */
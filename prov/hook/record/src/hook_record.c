@@ -0,0 +1,797 @@
+/*
+ * Copyright (c) 2024 Hewlett Packard Enterprise Development LP. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "ofi_hook.h"
+#include "ofi_prov.h"
+#include "ofi_iov.h"
+#include "hook_prov.h"
+
+#include "hook_record.h"
+
+struct record_ep {
+	struct hook_ep	hook_ep;
+	uint16_t	index;
+};
+
+static struct {
+	char basepath[PATH_MAX];
+} record_env = {
+	.basepath = RECORD_BASEPATH_DEFAULT,
+};
+
+/* One capture per process, shared by all fabrics and serialized by
+ * record_lock, so the records keep the order of the calls.
+ */
+static ofi_mutex_t record_lock;
+static int record_fd = -1;
+static uint64_t record_start_ns;
+static struct record_file_hdr record_hdr;
+static struct record_entry record_buf[RECORD_BUF_CNT];
+static size_t record_buf_cnt;
+static char record_path[PATH_MAX];
+
+struct hook_prov_ctx hook_record_ctx;
+
+static int record_pwrite(const void *buf, size_t len, off_t offset)
+{
+	ssize_t ret;
+
+	while (len) {
+		ret = pwrite(record_fd, buf, len, offset);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -ofi_syserr();
+		}
+		buf = (const char *) buf + ret;
+		len -= ret;
+		offset += ret;
+	}
+	return 0;
+}
+
+/* Called with record_lock held.  Recording stops on a write error. */
+static void record_flush(void)
+{
+	off_t offset;
+	int ret;
+
+	if (record_fd < 0)
+		return;
+
+	offset = sizeof(record_hdr) + record_hdr.record_cnt *
+		 sizeof(struct record_entry);
+	ret = record_pwrite(record_buf, record_buf_cnt * sizeof(*record_buf),
+			   offset);
+	if (!ret) {
+		record_hdr.record_cnt += record_buf_cnt;
+		if (record_buf_cnt)
+			record_hdr.duration_ns =
+				record_buf[record_buf_cnt - 1].ts;
+		record_buf_cnt = 0;
+		ret = record_pwrite(&record_hdr, sizeof(record_hdr), 0);
+	}
+
+	if (ret) {
+		FI_WARN(&hook_record_ctx.prov, FI_LOG_EP_DATA,
+			"capture write to %s failed (%s), recording stopped\n",
+			record_path, fi_strerror(-ret));
+		close(record_fd);
+		record_fd = -1;
+	}
+}
+
+static void record_add(struct record_ep *ep, enum record_op op, uint64_t ts,
+		       uint64_t len, fi_addr_t peer, uint64_t tag,
+		       uint64_t data, uint8_t flags)
+{
+	struct record_entry *entry;
+
+	if (record_fd < 0)
+		return;
+
+	ofi_mutex_lock(&record_lock);
+	if (record_fd >= 0) {
+		entry = &record_buf[record_buf_cnt++];
+		entry->ts = ts - record_start_ns;
+		entry->len = len;
+		entry->tag = tag;
+		entry->data = data;
+		entry->peer = peer == FI_ADDR_UNSPEC ?
+			      RECORD_PEER_UNSPEC : (uint32_t) peer;
+		entry->ep = ep->index;
+		entry->op = (uint8_t) op;
+		entry->flags = flags;
+		if (record_buf_cnt == RECORD_BUF_CNT)
+			record_flush();
+	}
+	ofi_mutex_unlock(&record_lock);
+}
+
+static inline struct record_ep *record_ep(struct fid_ep *ep)
+{
+	return container_of(ep, struct record_ep, hook_ep.ep);
+}
+
+static inline struct fid_ep *record_hep(struct fid_ep *ep)
+{
+	return record_ep(ep)->hook_ep.hep;
+}
+
+static int record_file_init(const struct fi_provider *hprov)
+{
+	char hostname[HOST_NAME_MAX + 1];
+	struct timespec wall;
+
+	if (gethostname(hostname, sizeof(hostname)))
+		strcpy(hostname, "localhost");
+	hostname[HOST_NAME_MAX] = '\0';
+
+	memset(&record_hdr, 0, sizeof(record_hdr));
+	record_hdr.magic = RECORD_MAGIC;
+	record_hdr.version = RECORD_VERSION;
+	record_hdr.record_size = sizeof(struct record_entry);
+	record_hdr.pid = (uint32_t) getpid();
+
+	if (snprintf(record_path, sizeof(record_path), "%s/fi_record_%s_%u",
+		     record_env.basepath, hostname, record_hdr.pid) >=
+	    (int) sizeof(record_path)) {
+		FI_WARN(hprov, FI_LOG_FABRIC, "capture file path too long\n");
+		return -FI_EINVAL;
+	}
+
+	record_fd = open(record_path, O_CREAT | O_TRUNC | O_WRONLY,
+			 S_IRUSR | S_IWUSR);
+	if (record_fd < 0) {
+		FI_WARN(hprov, FI_LOG_FABRIC, "could not create %s: %s\n",
+			record_path, strerror(errno));
+		return -ofi_syserr();
+	}
+
+	clock_gettime(CLOCK_REALTIME, &wall);
+	record_hdr.start_wall_ns = (uint64_t) wall.tv_sec * 1000000000 +
+				   wall.tv_nsec;
+	record_start_ns = ofi_gettime_ns();
+	record_flush();
+	if (record_fd < 0)
+		return -FI_EIO;
+
+	FI_INFO(hprov, FI_LOG_FABRIC, "capture file %s\n", record_path);
+	return 0;
+}
+
+/*
+ * msg ops
+ */
+static ssize_t
+record_recv(struct fid_ep *ep, void *buf, size_t len, void *desc,
+	    fi_addr_t src_addr, void *context)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_recv(record_hep(ep), buf, len, desc, src_addr, context);
+	if (!ret)
+		record_add(record_ep(ep), record_op_recv, ts, len, src_addr,
+			   0, 0, 0);
+	return ret;
+}
+
+static ssize_t
+record_recvv(struct fid_ep *ep, const struct iovec *iov, void **desc,
+	     size_t count, fi_addr_t src_addr, void *context)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_recvv(record_hep(ep), iov, desc, count, src_addr, context);
+	if (!ret)
+		record_add(record_ep(ep), record_op_recv, ts,
+			   ofi_total_iov_len(iov, count), src_addr, 0, 0, 0);
+	return ret;
+}
+
+static ssize_t
+record_recvmsg(struct fid_ep *ep, const struct fi_msg *msg, uint64_t flags)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_recvmsg(record_hep(ep), msg, flags);
+	if (!ret)
+		record_add(record_ep(ep), record_op_recv, ts,
+			   ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+			   msg->addr, 0, 0, (flags & FI_MULTI_RECV) ?
+			   RECORD_FLAG_MULTI_RECV : 0);
+	return ret;
+}
+
+static ssize_t
+record_send(struct fid_ep *ep, const void *buf, size_t len, void *desc,
+	    fi_addr_t dest_addr, void *context)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_send(record_hep(ep), buf, len, desc, dest_addr, context);
+	if (!ret)
+		record_add(record_ep(ep), record_op_send, ts, len, dest_addr,
+			   0, 0, 0);
+	return ret;
+}
+
+static ssize_t
+record_sendv(struct fid_ep *ep, const struct iovec *iov, void **desc,
+	     size_t count, fi_addr_t dest_addr, void *context)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_sendv(record_hep(ep), iov, desc, count, dest_addr, context);
+	if (!ret)
+		record_add(record_ep(ep), record_op_send, ts,
+			   ofi_total_iov_len(iov, count), dest_addr, 0, 0, 0);
+	return ret;
+}
+
+static ssize_t
+record_sendmsg(struct fid_ep *ep, const struct fi_msg *msg, uint64_t flags)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_sendmsg(record_hep(ep), msg, flags);
+	if (!ret)
+		record_add(record_ep(ep), (flags & FI_INJECT) ?
+			   record_op_inject : record_op_send, ts,
+			   ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+			   msg->addr, 0, msg->data,
+			   (flags & FI_REMOTE_CQ_DATA) ? RECORD_FLAG_DATA : 0);
+	return ret;
+}
+
+static ssize_t
+record_inject(struct fid_ep *ep, const void *buf, size_t len,
+	      fi_addr_t dest_addr)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_inject(record_hep(ep), buf, len, dest_addr);
+	if (!ret)
+		record_add(record_ep(ep), record_op_inject, ts, len, dest_addr,
+			   0, 0, 0);
+	return ret;
+}
+
+static ssize_t
+record_senddata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
+		uint64_t data, fi_addr_t dest_addr, void *context)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_senddata(record_hep(ep), buf, len, desc, data, dest_addr,
+			  context);
+	if (!ret)
+		record_add(record_ep(ep), record_op_send, ts, len, dest_addr,
+			   0, data, RECORD_FLAG_DATA);
+	return ret;
+}
+
+static ssize_t
+record_injectdata(struct fid_ep *ep, const void *buf, size_t len,
+		  uint64_t data, fi_addr_t dest_addr)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_injectdata(record_hep(ep), buf, len, data, dest_addr);
+	if (!ret)
+		record_add(record_ep(ep), record_op_inject, ts, len, dest_addr,
+			   0, data, RECORD_FLAG_DATA);
+	return ret;
+}
+
+static struct fi_ops_msg record_msg_ops = {
+	.size = sizeof(struct fi_ops_msg),
+	.recv = record_recv,
+	.recvv = record_recvv,
+	.recvmsg = record_recvmsg,
+	.send = record_send,
+	.sendv = record_sendv,
+	.sendmsg = record_sendmsg,
+	.inject = record_inject,
+	.senddata = record_senddata,
+	.injectdata = record_injectdata,
+};
+
+/*
+ * rma ops
+ */
+static ssize_t
+record_read(struct fid_ep *ep, void *buf, size_t len, void *desc,
+	    fi_addr_t src_addr, uint64_t addr, uint64_t key, void *context)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_read(record_hep(ep), buf, len, desc, src_addr, addr, key,
+		      context);
+	if (!ret)
+		record_add(record_ep(ep), record_op_read, ts, len, src_addr,
+			   0, 0, 0);
+	return ret;
+}
+
+static ssize_t
+record_readv(struct fid_ep *ep, const struct iovec *iov, void **desc,
+	     size_t count, fi_addr_t src_addr, uint64_t addr, uint64_t key,
+	     void *context)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_readv(record_hep(ep), iov, desc, count, src_addr, addr, key,
+		       context);
+	if (!ret)
+		record_add(record_ep(ep), record_op_read, ts,
+			   ofi_total_iov_len(iov, count), src_addr, 0, 0, 0);
+	return ret;
+}
+
+static ssize_t
+record_readmsg(struct fid_ep *ep, const struct fi_msg_rma *msg,
+	       uint64_t flags)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_readmsg(record_hep(ep), msg, flags);
+	if (!ret)
+		record_add(record_ep(ep), record_op_read, ts,
+			   ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+			   msg->addr, 0, 0, 0);
+	return ret;
+}
+
+static ssize_t
+record_write(struct fid_ep *ep, const void *buf, size_t len, void *desc,
+	     fi_addr_t dest_addr, uint64_t addr, uint64_t key, void *context)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_write(record_hep(ep), buf, len, desc, dest_addr, addr, key,
+		       context);
+	if (!ret)
+		record_add(record_ep(ep), record_op_write, ts, len, dest_addr,
+			   0, 0, 0);
+	return ret;
+}
+
+static ssize_t
+record_writev(struct fid_ep *ep, const struct iovec *iov, void **desc,
+	      size_t count, fi_addr_t dest_addr, uint64_t addr, uint64_t key,
+	      void *context)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_writev(record_hep(ep), iov, desc, count, dest_addr, addr, key,
+			context);
+	if (!ret)
+		record_add(record_ep(ep), record_op_write, ts,
+			   ofi_total_iov_len(iov, count), dest_addr, 0, 0, 0);
+	return ret;
+}
+
+static ssize_t
+record_writemsg(struct fid_ep *ep, const struct fi_msg_rma *msg,
+		uint64_t flags)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_writemsg(record_hep(ep), msg, flags);
+	if (!ret)
+		record_add(record_ep(ep), (flags & FI_INJECT) ?
+			   record_op_inject_write : record_op_write, ts,
+			   ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+			   msg->addr, 0, msg->data,
+			   (flags & FI_REMOTE_CQ_DATA) ? RECORD_FLAG_DATA : 0);
+	return ret;
+}
+
+static ssize_t
+record_inject_write(struct fid_ep *ep, const void *buf, size_t len,
+		    fi_addr_t dest_addr, uint64_t addr, uint64_t key)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_inject_write(record_hep(ep), buf, len, dest_addr, addr, key);
+	if (!ret)
+		record_add(record_ep(ep), record_op_inject_write, ts, len,
+			   dest_addr, 0, 0, 0);
+	return ret;
+}
+
+static ssize_t
+record_writedata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
+		 uint64_t data, fi_addr_t dest_addr, uint64_t addr,
+		 uint64_t key, void *context)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_writedata(record_hep(ep), buf, len, desc, data, dest_addr,
+			   addr, key, context);
+	if (!ret)
+		record_add(record_ep(ep), record_op_write, ts, len, dest_addr,
+			   0, data, RECORD_FLAG_DATA);
+	return ret;
+}
+
+static ssize_t
+record_inject_writedata(struct fid_ep *ep, const void *buf, size_t len,
+			uint64_t data, fi_addr_t dest_addr, uint64_t addr,
+			uint64_t key)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_inject_writedata(record_hep(ep), buf, len, data, dest_addr,
+				  addr, key);
+	if (!ret)
+		record_add(record_ep(ep), record_op_inject_write, ts, len,
+			   dest_addr, 0, data, RECORD_FLAG_DATA);
+	return ret;
+}
+
+static struct fi_ops_rma record_rma_ops = {
+	.size = sizeof(struct fi_ops_rma),
+	.read = record_read,
+	.readv = record_readv,
+	.readmsg = record_readmsg,
+	.write = record_write,
+	.writev = record_writev,
+	.writemsg = record_writemsg,
+	.inject = record_inject_write,
+	.writedata = record_writedata,
+	.injectdata = record_inject_writedata,
+};
+
+/*
+ * tagged ops
+ */
+static ssize_t
+record_trecv(struct fid_ep *ep, void *buf, size_t len, void *desc,
+	     fi_addr_t src_addr, uint64_t tag, uint64_t ignore, void *context)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_trecv(record_hep(ep), buf, len, desc, src_addr, tag, ignore,
+		       context);
+	if (!ret)
+		record_add(record_ep(ep), record_op_trecv, ts, len, src_addr,
+			   tag, ignore, 0);
+	return ret;
+}
+
+static ssize_t
+record_trecvv(struct fid_ep *ep, const struct iovec *iov, void **desc,
+	      size_t count, fi_addr_t src_addr, uint64_t tag, uint64_t ignore,
+	      void *context)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_trecvv(record_hep(ep), iov, desc, count, src_addr, tag,
+			ignore, context);
+	if (!ret)
+		record_add(record_ep(ep), record_op_trecv, ts,
+			   ofi_total_iov_len(iov, count), src_addr, tag,
+			   ignore, 0);
+	return ret;
+}
+
+/* Peeks do not post a buffer and are not recorded. */
+static ssize_t
+record_trecvmsg(struct fid_ep *ep, const struct fi_msg_tagged *msg,
+		uint64_t flags)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_trecvmsg(record_hep(ep), msg, flags);
+	if (!ret && !(flags & FI_PEEK))
+		record_add(record_ep(ep), record_op_trecv, ts,
+			   ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+			   msg->addr, msg->tag, msg->ignore, 0);
+	return ret;
+}
+
+static ssize_t
+record_tsend(struct fid_ep *ep, const void *buf, size_t len, void *desc,
+	     fi_addr_t dest_addr, uint64_t tag, void *context)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_tsend(record_hep(ep), buf, len, desc, dest_addr, tag,
+		       context);
+	if (!ret)
+		record_add(record_ep(ep), record_op_tsend, ts, len, dest_addr,
+			   tag, 0, 0);
+	return ret;
+}
+
+static ssize_t
+record_tsendv(struct fid_ep *ep, const struct iovec *iov, void **desc,
+	      size_t count, fi_addr_t dest_addr, uint64_t tag, void *context)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_tsendv(record_hep(ep), iov, desc, count, dest_addr, tag,
+			context);
+	if (!ret)
+		record_add(record_ep(ep), record_op_tsend, ts,
+			   ofi_total_iov_len(iov, count), dest_addr, tag, 0, 0);
+	return ret;
+}
+
+static ssize_t
+record_tsendmsg(struct fid_ep *ep, const struct fi_msg_tagged *msg,
+		uint64_t flags)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_tsendmsg(record_hep(ep), msg, flags);
+	if (!ret)
+		record_add(record_ep(ep), (flags & FI_INJECT) ?
+			   record_op_tinject : record_op_tsend, ts,
+			   ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+			   msg->addr, msg->tag, msg->data,
+			   (flags & FI_REMOTE_CQ_DATA) ? RECORD_FLAG_DATA : 0);
+	return ret;
+}
+
+static ssize_t
+record_tinject(struct fid_ep *ep, const void *buf, size_t len,
+	       fi_addr_t dest_addr, uint64_t tag)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_tinject(record_hep(ep), buf, len, dest_addr, tag);
+	if (!ret)
+		record_add(record_ep(ep), record_op_tinject, ts, len, dest_addr,
+			   tag, 0, 0);
+	return ret;
+}
+
+static ssize_t
+record_tsenddata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
+		 uint64_t data, fi_addr_t dest_addr, uint64_t tag,
+		 void *context)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_tsenddata(record_hep(ep), buf, len, desc, data, dest_addr,
+			   tag, context);
+	if (!ret)
+		record_add(record_ep(ep), record_op_tsend, ts, len, dest_addr,
+			   tag, data, RECORD_FLAG_DATA);
+	return ret;
+}
+
+static ssize_t
+record_tinjectdata(struct fid_ep *ep, const void *buf, size_t len,
+		   uint64_t data, fi_addr_t dest_addr, uint64_t tag)
+{
+	uint64_t ts = ofi_gettime_ns();
+	ssize_t ret;
+
+	ret = fi_tinjectdata(record_hep(ep), buf, len, data, dest_addr, tag);
+	if (!ret)
+		record_add(record_ep(ep), record_op_tinject, ts, len, dest_addr,
+			   tag, data, RECORD_FLAG_DATA);
+	return ret;
+}
+
+static struct fi_ops_tagged record_tagged_ops = {
+	.size = sizeof(struct fi_ops_tagged),
+	.recv = record_trecv,
+	.recvv = record_trecvv,
+	.recvmsg = record_trecvmsg,
+	.send = record_tsend,
+	.sendv = record_tsendv,
+	.sendmsg = record_tsendmsg,
+	.inject = record_tinject,
+	.senddata = record_tsenddata,
+	.injectdata = record_tinjectdata,
+};
+
+static int
+record_endpoint(struct fid_domain *domain, struct fi_info *info,
+		struct fid_ep **ep, void *context)
+{
+	struct record_ep *myep;
+	int ret;
+
+	myep = calloc(1, sizeof *myep);
+	if (!myep)
+		return -FI_ENOMEM;
+
+	ret = hook_endpoint_init(domain, info, ep, context, &myep->hook_ep);
+	if (ret) {
+		free(myep);
+		return ret;
+	}
+
+	myep->hook_ep.ep.msg = &record_msg_ops;
+	myep->hook_ep.ep.rma = &record_rma_ops;
+	myep->hook_ep.ep.tagged = &record_tagged_ops;
+
+	ofi_mutex_lock(&record_lock);
+	if (!record_hdr.ep_cnt++) {
+		record_hdr.caps = info->caps;
+		record_hdr.ep_type = info->ep_attr ? info->ep_attr->type : 0;
+		if (info->fabric_attr && info->fabric_attr->prov_name)
+			snprintf(record_hdr.prov_name,
+				 sizeof(record_hdr.prov_name), "%s",
+				 info->fabric_attr->prov_name);
+	}
+	myep->index = (uint16_t) (record_hdr.ep_cnt - 1);
+	ofi_mutex_unlock(&record_lock);
+	return 0;
+}
+
+static struct fi_ops_domain record_domain_ops = {
+	.size = sizeof(struct fi_ops_domain),
+	.av_open = hook_av_open,
+	.cq_open = hook_cq_open,
+	.endpoint = record_endpoint,
+	.scalable_ep = hook_scalable_ep,
+	.cntr_open = hook_cntr_open,
+	.poll_open = hook_poll_open,
+	.stx_ctx = hook_stx_ctx,
+	.srx_ctx = hook_srx_ctx,
+	.query_atomic = hook_query_atomic,
+	.query_collective = hook_query_collective,
+};
+
+static int record_domain_init(struct fid *fid)
+{
+	struct fid_domain *domain = container_of(fid, struct fid_domain, fid);
+
+	domain->ops = &record_domain_ops;
+	return 0;
+}
+
+/* Flush on every fabric close, so the capture is complete even if the
+ * application never calls fi_fini.
+ */
+static int record_fabric_close(struct fid *fid)
+{
+	ofi_mutex_lock(&record_lock);
+	record_flush();
+	ofi_mutex_unlock(&record_lock);
+
+	return hook_close(fid);
+}
+
+static struct fi_ops record_fabric_fid_ops = {
+	.size = sizeof(struct fi_ops),
+	.close = record_fabric_close,
+	.bind = hook_bind,
+	.control = hook_control,
+	.ops_open = hook_ops_open,
+};
+
+static void hook_record_cleanup(void)
+{
+	ofi_mutex_lock(&record_lock);
+	record_flush();
+	if (record_fd >= 0) {
+		close(record_fd);
+		record_fd = -1;
+	}
+	ofi_mutex_unlock(&record_lock);
+	ofi_mutex_destroy(&record_lock);
+}
+
+static int hook_record_fabric(struct fi_fabric_attr *attr,
+			      struct fid_fabric **fabric, void *context)
+{
+	struct fi_provider *hprov = context;
+	struct hook_fabric *fab;
+
+	FI_TRACE(hprov, FI_LOG_FABRIC, "Installing record hook\n");
+	fab = calloc(1, sizeof *fab);
+	if (!fab)
+		return -FI_ENOMEM;
+
+	ofi_mutex_lock(&record_lock);
+	if (record_fd < 0 && !record_hdr.magic && record_file_init(hprov))
+		FI_WARN(hprov, FI_LOG_FABRIC,
+			"capture unavailable, calls are not recorded\n");
+	ofi_mutex_unlock(&record_lock);
+
+	hook_fabric_init(fab, HOOK_RECORD, attr->fabric, hprov,
+			 &record_fabric_fid_ops, &hook_record_ctx);
+	*fabric = &fab->fabric;
+	return 0;
+}
+
+struct hook_prov_ctx hook_record_ctx = {
+	.prov = {
+		.version = OFI_VERSION_DEF_PROV,
+		/* We're a pass-through provider, so the fi_version is always the latest */
+		.fi_version = OFI_VERSION_LATEST,
+		.name = "ofi_hook_record",
+		.getinfo = NULL,
+		.fabric = hook_record_fabric,
+		.cleanup = hook_record_cleanup,
+	},
+};
+
+HOOK_RECORD_INI
+{
+	struct fi_provider *prov = &hook_record_ctx.prov;
+	char *basepath = NULL;
+
+	fi_param_define(prov, "basepath", FI_PARAM_STRING,
+			"Directory of the capture file, which is named "
+			"fi_record_<hostname>_<pid>.  (default: %s)",
+			RECORD_BASEPATH_DEFAULT);
+
+	fi_param_get_str(prov, "basepath", &basepath);
+	if (basepath && strlen(basepath) < PATH_MAX)
+		snprintf(record_env.basepath, PATH_MAX, "%s", basepath);
+
+	ofi_mutex_init(&record_lock);
+	hook_record_ctx.ini_fid[FI_CLASS_DOMAIN] = record_domain_init;
+
+	return &hook_record_ctx.prov;
+}
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2024 Hewlett Packard Enterprise Development LP. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _HOOK_TRACE_H_
+#define _HOOK_TRACE_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "ofi.h"
+
+/*
+ * Binary trace file, written by ofi_hook_trace in binary mode and read by
+ * fi_trace_decode.
+ *
+ * The file starts with a trace_file_hdr, followed by ring_cnt rings.  Each
+ * ring is owned by a single thread: a trace_ring_hdr and ring_size
+ * records.  The writer fills the record at head modulo ring_size, then
+ * publishes it by incrementing head, so a ring holds the last ring_size
+ * calls of its thread.  Records are one cache line.
+ *
+ * Note: keep in sync with util/trace_decode.c
+ */
+#define TRACE_MAGIC		0x454341525449464fULL	/* "OFITRACE" */
+#define TRACE_VERSION		1
+#define TRACE_BASEPATH_DEFAULT	"/dev/shm"
+#define TRACE_RING_SIZE_DEFAULT	65536
+#define TRACE_RING_CNT_DEFAULT	64
+
+#define TRACE_OPS(DECL)  \
+	DECL(trace_op_recv), \
+	DECL(trace_op_recvv), \
+	DECL(trace_op_recvmsg), \
+	DECL(trace_op_send), \
+	DECL(trace_op_sendv), \
+	DECL(trace_op_sendmsg), \
+	DECL(trace_op_inject), \
+	DECL(trace_op_senddata), \
+	DECL(trace_op_injectdata), \
+	DECL(trace_op_read), \
+	DECL(trace_op_readv), \
+	DECL(trace_op_readmsg), \
+	DECL(trace_op_write), \
+	DECL(trace_op_writev), \
+	DECL(trace_op_writemsg), \
+	DECL(trace_op_inject_write), \
+	DECL(trace_op_writedata), \
+	DECL(trace_op_inject_writedata), \
+	DECL(trace_op_trecv), \
+	DECL(trace_op_trecvv), \
+	DECL(trace_op_trecvmsg), \
+	DECL(trace_op_tsend), \
+	DECL(trace_op_tsendv), \
+	DECL(trace_op_tsendmsg), \
+	DECL(trace_op_tinject), \
+	DECL(trace_op_tsenddata), \
+	DECL(trace_op_tinjectdata), \
+	DECL(trace_op_cq_read), \
+	DECL(trace_op_cq_readfrom), \
+	DECL(trace_op_cq_readerr), \
+	DECL(trace_op_cq_sread), \
+	DECL(trace_op_cq_sreadfrom), \
+	DECL(trace_op_max)
+
+enum trace_op {
+	TRACE_OPS(OFI_ENUM_VAL)
+};
+
+/* Data operations record their arguments.  CQ operations write one record
+ * per completion read, with the completion flags in place of the address;
+ * the tag holds remote CQ data for non-tagged completions.  Calls that
+ * read no completion are only recorded on error.
+ */
+struct trace_record {
+	uint64_t	ts;		/* ns, when the call was made */
+	uint64_t	fid;
+	uint64_t	context;
+	uint64_t	len;
+	uint64_t	tag;		/* tag, RMA key or CQ data */
+	union {
+		uint64_t addr;		/* peer fi_addr_t */
+		uint64_t flags;		/* CQ completion flags */
+	};
+	uint32_t	dur;		/* ns spent in the call */
+	int32_t		ret;
+	uint16_t	op;
+	uint16_t	reserved[3];
+};
+
+struct trace_ring_hdr {
+	uint64_t	tid;
+	_Atomic uint64_t head;
+	uint64_t	reserved[6];
+};
+
+struct trace_file_hdr {
+	uint64_t	magic;
+	uint32_t	version;
+	uint32_t	record_size;
+	uint32_t	ring_cnt;
+	uint32_t	ring_size;
+	uint32_t	pid;
+	uint32_t	reserved;
+	uint64_t	start_ns;	/* ofi_gettime_ns() at creation */
+	uint64_t	start_wall_ns;	/* wall clock at creation */
+	_Atomic uint32_t rings_used;
+	uint32_t	reserved2;
+	_Atomic uint64_t dropped;	/* calls from threads without a ring */
+};
+
+static inline size_t trace_ring_bytes(const struct trace_file_hdr *hdr)
+{
+	return sizeof(struct trace_ring_hdr) +
+	       (size_t) hdr->ring_size * sizeof(struct trace_record);
+}
+
+static inline size_t trace_file_bytes(const struct trace_file_hdr *hdr)
+{
+	return sizeof(*hdr) + hdr->ring_cnt * trace_ring_bytes(hdr);
+}
+
+static inline struct trace_ring_hdr *
+trace_ring(struct trace_file_hdr *hdr, uint32_t index)
+{
+	return (struct trace_ring_hdr *) ((char *) (hdr + 1) +
+					  index * trace_ring_bytes(hdr));
+}
+
+static inline struct trace_record *trace_ring_records(struct trace_ring_hdr *ring)
+{
+	return (struct trace_record *) (ring + 1);
+}
+
+#endif /* _HOOK_TRACE_H_ */
@@ -32,8 +32,15 @@
 #include "ofi_hook.h"
 #include "ofi_prov.h"
 #include "ofi_iov.h"
+#include "hook_trace.h"
 #include <config.h>
 #include <inttypes.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 
 #include <rdma/fi_profile.h>
 struct hook_trace_ep {
@@ -198,6 +205,151 @@ static void hook_trace_prof_init(void *context)
 
 #define TRACE_BUF_SIZE	1024
 
+/*
+ * Binary mode: calls are written as fixed size records to a per thread
+ * ring in a file mapped from FI_OFI_HOOK_TRACE_BASEPATH, which is left
+ * in place for fi_trace_decode.  A record costs two clock reads and a
+ * cache line store, with no locking or formatting on the data path.
+ */
+static int trace_binary;
+
+static struct trace_env {
+	char basepath[PATH_MAX];
+	size_t ring_size;
+	int ring_cnt;
+} trace_env = {
+	.basepath = TRACE_BASEPATH_DEFAULT,
+	.ring_size = TRACE_RING_SIZE_DEFAULT,
+	.ring_cnt = TRACE_RING_CNT_DEFAULT,
+};
+
+static struct trace_file_hdr *trace_hdr;
+static size_t trace_hdr_size;
+static char trace_path[PATH_MAX];
+static ofi_mutex_t trace_lock;
+
+static OFI_THREAD_LOCAL struct trace_ring_hdr *trace_tls_ring;
+static OFI_THREAD_LOCAL bool trace_tls_claimed;
+
+static inline uint64_t trace_ts(void)
+{
+	return trace_binary ? ofi_gettime_ns() : 0;
+}
+
+static struct trace_ring_hdr *trace_ring_claim(void)
+{
+	struct trace_ring_hdr *ring;
+	uint32_t index;
+
+	trace_tls_claimed = true;
+	index = atomic_fetch_add(&trace_hdr->rings_used, 1);
+	if (index >= trace_hdr->ring_cnt)
+		return NULL;
+
+	ring = trace_ring(trace_hdr, index);
+#ifdef __linux__
+	ring->tid = (uint64_t) syscall(SYS_gettid);
+#else
+	ring->tid = (uint64_t) (uintptr_t) pthread_self();
+#endif
+	trace_tls_ring = ring;
+	return ring;
+}
+
+static inline void
+trace_bin(enum trace_op op, uint64_t start, ssize_t ret, const void *fid,
+	  uint64_t len, uint64_t addr, uint64_t tag, const void *context)
+{
+	struct trace_ring_hdr *ring = trace_tls_ring;
+	struct trace_record *rec;
+	uint64_t head, now;
+
+	now = ofi_gettime_ns();
+	if (OFI_UNLIKELY(!ring)) {
+		ring = trace_tls_claimed ? NULL : trace_ring_claim();
+		if (!ring) {
+			atomic_fetch_add_explicit(&trace_hdr->dropped, 1,
+						  memory_order_relaxed);
+			return;
+		}
+	}
+
+	head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+	rec = &trace_ring_records(ring)[head & (trace_hdr->ring_size - 1)];
+	rec->ts = start;
+	rec->fid = (uintptr_t) fid;
+	rec->context = (uintptr_t) context;
+	rec->len = len;
+	rec->tag = tag;
+	rec->addr = addr;
+	rec->dur = (uint32_t) MIN(now - start, UINT32_MAX);
+	rec->ret = (int32_t) ret;
+	rec->op = (uint16_t) op;
+	atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+static int trace_file_init(const struct fi_provider *hprov)
+{
+	struct trace_file_hdr hdr = {
+		.magic = TRACE_MAGIC,
+		.version = TRACE_VERSION,
+		.record_size = sizeof(struct trace_record),
+		.ring_cnt = (uint32_t) trace_env.ring_cnt,
+		.ring_size = (uint32_t) trace_env.ring_size,
+		.pid = (uint32_t) getpid(),
+	};
+	struct timespec wall;
+	char hostname[HOST_NAME_MAX + 1];
+	int fd;
+
+	if (gethostname(hostname, sizeof(hostname)))
+		strcpy(hostname, "localhost");
+	hostname[HOST_NAME_MAX] = '\0';
+
+	if (snprintf(trace_path, sizeof(trace_path), "%s/fi_trace_%s_%u",
+		     trace_env.basepath, hostname, hdr.pid) >=
+	    (int) sizeof(trace_path)) {
+		FI_WARN(hprov, FI_LOG_FABRIC, "trace file path too long\n");
+		return -FI_EINVAL;
+	}
+
+	fd = open(trace_path, O_CREAT | O_TRUNC | O_RDWR, S_IRUSR | S_IWUSR);
+	if (fd < 0) {
+		FI_WARN(hprov, FI_LOG_FABRIC, "could not create %s: %s\n",
+			trace_path, strerror(errno));
+		return -ofi_syserr();
+	}
+
+	/* The rings are sparse until threads touch them */
+	trace_hdr_size = trace_file_bytes(&hdr);
+	if (ftruncate(fd, trace_hdr_size)) {
+		FI_WARN(hprov, FI_LOG_FABRIC, "could not size %s: %s\n",
+			trace_path, strerror(errno));
+		goto err;
+	}
+
+	trace_hdr = mmap(NULL, trace_hdr_size, PROT_READ | PROT_WRITE,
+			 MAP_SHARED, fd, 0);
+	if (trace_hdr == MAP_FAILED) {
+		FI_WARN(hprov, FI_LOG_FABRIC, "could not map %s: %s\n",
+			trace_path, strerror(errno));
+		trace_hdr = NULL;
+		goto err;
+	}
+	close(fd);
+
+	clock_gettime(CLOCK_REALTIME, &wall);
+	hdr.start_wall_ns = (uint64_t) wall.tv_sec * 1000000000 + wall.tv_nsec;
+	hdr.start_ns = ofi_gettime_ns();
+	memcpy(trace_hdr, &hdr, sizeof(hdr));
+	FI_INFO(hprov, FI_LOG_FABRIC, "binary trace file %s\n", trace_path);
+	return 0;
+err:
+	close(fd);
+	unlink(trace_path);
+	return -FI_EIO;
+}
+
 #define IOV_BASE(iov, count)	(count ? iov[0].iov_base : NULL)
 #define IOV_LEN(iov, count)	    ofi_total_iov_len(iov, count)
 #define MSG_DATA(data, flags)   (flags & FI_REMOTE_CQ_DATA ? data : 0)
@@ -219,27 +371,36 @@ static void hook_trace_prof_init(void *context)
 				"addr", addr);	\
 	}
 
-#define TRACE_EP_MSG(ret, ep, buf, len, addr, data, flags, context) \
-	if (!(ret)) { \
-		FI_TRACE((ep)->domain->fabric->hprov, FI_LOG_EP_DATA, \
+#define TRACE_EP_MSG(op, start, ret, hook_ep, buf, len, addr, data, flags, context) \
+	if (trace_binary) { \
+		trace_bin(trace_op_##op, start, ret, &(hook_ep)->ep.fid, len, \
+			  addr, 0, context); \
+	} else if (!(ret)) { \
+		FI_TRACE((hook_ep)->domain->fabric->hprov, FI_LOG_EP_DATA, \
 			"buf %p len %zu addr %" PRIuPTR " data 0x%" PRIx64 " " \
 			"flags 0x%" PRIxPTR " ctx %p\n", \
 			(void *)(buf), (size_t)(len), (uintptr_t)(addr), (uint64_t)(data), \
 			(uintptr_t)flags, (void *)(context)); \
 	}
 
-#define TRACE_EP_RMA(ret, ep, buf, len, addr, raddr, data, flags, key, context) \
-	if (!(ret)) { \
-		FI_TRACE((ep)->domain->fabric->hprov, FI_LOG_EP_DATA, \
+#define TRACE_EP_RMA(op, start, ret, hook_ep, buf, len, addr, raddr, data, flags, key, context) \
+	if (trace_binary) { \
+		trace_bin(trace_op_##op, start, ret, &(hook_ep)->ep.fid, len, \
+			  addr, key, context); \
+	} else if (!(ret)) { \
+		FI_TRACE((hook_ep)->domain->fabric->hprov, FI_LOG_EP_DATA, \
 			"buf %p len %zu addr %" PRIuPTR " raddr %" PRIu64 " data %" PRIu64 " " \
 			"flags 0x%" PRIxPTR " key 0x%" PRIxPTR " ctx %p\n", \
 			(void *)(buf), (size_t)(len), (uintptr_t)(addr), (uint64_t)(raddr),  \
 			(uint64_t)(data), (uintptr_t)(flags), (uintptr_t)(key), (void *)(context)); \
 	}
 
-#define TRACE_EP_TAGGED(ret, ep, buf, len, addr, data, flags, tag, ignore, context) \
-	if (!(ret)) { \
-		FI_TRACE((ep)->domain->fabric->hprov, FI_LOG_EP_DATA, \
+#define TRACE_EP_TAGGED(op, start, ret, hook_ep, buf, len, addr, data, flags, tag, ignore, context) \
+	if (trace_binary) { \
+		trace_bin(trace_op_##op, start, ret, &(hook_ep)->ep.fid, len, \
+			  addr, tag, context); \
+	} else if (!(ret)) { \
+		FI_TRACE((hook_ep)->domain->fabric->hprov, FI_LOG_EP_DATA, \
 			"buf %p len %zu addr %" PRIuPTR " data %" PRIu64 " " \
 			"flags 0x%" PRIxPTR " tag 0x%" PRIxPTR " ignore 0x%" PRIxPTR " ctx %p\n", \
 			(void *)(buf), (size_t)(len), (uintptr_t)(addr), (uint64_t)(data),  \
@@ -366,9 +527,61 @@ static trace_cq_entry_fn trace_cq_entry[] = {
 };
 
 static inline void
-trace_cq(struct hook_cq *cq, const char *func, int line,
-	 int count, void *buf, uint64_t data)
+trace_bin_cq(struct hook_cq *cq, enum trace_op op, uint64_t start,
+	     int count, void *buf)
+{
+	struct fi_cq_tagged_entry *tagged;
+	struct fi_cq_data_entry *data;
+	struct fi_cq_msg_entry *msg;
+	struct fi_cq_entry *entry;
+	int i;
+
+	if (count <= 0) {
+		if (count != -FI_EAGAIN)
+			trace_bin(op, start, count, &cq->cq.fid, 0, 0, 0, NULL);
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		switch (cq->format) {
+		case FI_CQ_FORMAT_CONTEXT:
+			entry = (struct fi_cq_entry *) buf + i;
+			trace_bin(op, start, count, &cq->cq.fid, 0, 0, 0,
+				  entry->op_context);
+			break;
+		case FI_CQ_FORMAT_MSG:
+			msg = (struct fi_cq_msg_entry *) buf + i;
+			trace_bin(op, start, count, &cq->cq.fid, msg->len,
+				  msg->flags, 0, msg->op_context);
+			break;
+		case FI_CQ_FORMAT_DATA:
+			data = (struct fi_cq_data_entry *) buf + i;
+			trace_bin(op, start, count, &cq->cq.fid, data->len,
+				  data->flags, MSG_DATA(data->data, data->flags),
+				  data->op_context);
+			break;
+		case FI_CQ_FORMAT_TAGGED:
+			tagged = (struct fi_cq_tagged_entry *) buf + i;
+			trace_bin(op, start, count, &cq->cq.fid, tagged->len,
+				  tagged->flags, tagged->tag,
+				  tagged->op_context);
+			break;
+		default:
+			trace_bin(op, start, count, &cq->cq.fid, 0, 0, 0, NULL);
+			return;
+		}
+	}
+}
+
+static inline void
+trace_cq(struct hook_cq *cq, enum trace_op op, uint64_t start,
+	 const char *func, int line, int count, void *buf, uint64_t data)
 {
+	if (trace_binary) {
+		trace_bin_cq(cq, op, start, count, buf);
+		return;
+	}
+
 	if ((count > 0) &&
 	    fi_log_enabled(cq->domain->fabric->hprov, FI_LOG_TRACE, FI_LOG_CQ)) {
 		trace_cq_entry[cq->format](cq->domain->fabric->hprov, func,
@@ -377,11 +590,18 @@ trace_cq(struct hook_cq *cq, const char *func, int line,
 }
 
 static inline void
-trace_cq_err(struct hook_cq *cq, const char *func, int line,
+trace_cq_err(struct hook_cq *cq, uint64_t start, const char *func, int line,
 	     struct fi_cq_err_entry *entry,  uint64_t flags)
 {
 	char err_buf[80];
 
+	if (trace_binary) {
+		trace_bin(trace_op_cq_readerr, start, -entry->err,
+			  &cq->cq.fid, entry->len, entry->flags, entry->tag,
+			  entry->op_context);
+		return;
+	}
+
 	if (!fi_log_enabled(cq->domain->fabric->hprov, FI_LOG_TRACE, FI_LOG_CQ))
 		return;
 
@@ -617,9 +837,10 @@ trace_recv(struct fid_ep *ep, void *buf, size_t len, void *desc,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_recv(myep->hep, buf, len, desc, src_addr, context);
-	TRACE_EP_MSG(ret, myep, buf, len, src_addr, 0, 0, context);
+	TRACE_EP_MSG(recv, start, ret, myep, buf, len, src_addr, 0, 0, context);
 
 	return ret;
 }
@@ -630,9 +851,10 @@ trace_recvv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_recvv(myep->hep, iov, desc, count, src_addr, context);
-	TRACE_EP_MSG(ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
+	TRACE_EP_MSG(recvv, start, ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
 		     src_addr, 0, 0, context);
 
 	return ret;
@@ -643,9 +865,10 @@ trace_recvmsg(struct fid_ep *ep, const struct fi_msg *msg, uint64_t flags)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_recvmsg(myep->hep, msg, flags);
-	TRACE_EP_MSG(ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
+	TRACE_EP_MSG(recvmsg, start, ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
 		     IOV_LEN(msg->msg_iov, msg->iov_count), msg->addr,
 		     flags & FI_REMOTE_CQ_DATA ? msg->data : 0,
 		     flags, msg->context);
@@ -659,9 +882,10 @@ trace_send(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_send(myep->hep, buf, len, desc, dest_addr, context);
-	TRACE_EP_MSG(ret, myep, buf, len, dest_addr, 0, 0, context);
+	TRACE_EP_MSG(send, start, ret, myep, buf, len, dest_addr, 0, 0, context);
 
 	return ret;
 }
@@ -672,9 +896,10 @@ trace_sendv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_sendv(myep->hep, iov, desc, count, dest_addr, context);
-	TRACE_EP_MSG(ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
+	TRACE_EP_MSG(sendv, start, ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
 		     dest_addr, 0, 0, context);
 
 	return ret;
@@ -685,9 +910,10 @@ trace_sendmsg(struct fid_ep *ep, const struct fi_msg *msg, uint64_t flags)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_sendmsg(myep->hep, msg, flags);
-	TRACE_EP_MSG(ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
+	TRACE_EP_MSG(sendmsg, start, ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
 		     IOV_LEN(msg->msg_iov, msg->iov_count), msg->addr,
 		     MSG_DATA(msg->data, flags), flags, msg->context);
 
@@ -700,9 +926,10 @@ trace_inject(struct fid_ep *ep, const void *buf, size_t len,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_inject(myep->hep, buf, len, dest_addr);
-	TRACE_EP_MSG(ret, myep, buf, len, dest_addr, 0, 0, NULL);
+	TRACE_EP_MSG(inject, start, ret, myep, buf, len, dest_addr, 0, 0, NULL);
 
 	return ret;
 }
@@ -713,9 +940,10 @@ trace_senddata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_senddata(myep->hep, buf, len, desc, data, dest_addr, context);
-	TRACE_EP_MSG(ret, myep, buf, len, dest_addr, data, 0, context);
+	TRACE_EP_MSG(senddata, start, ret, myep, buf, len, dest_addr, data, 0, context);
 
 	return ret;
 }
@@ -726,9 +954,10 @@ trace_injectdata(struct fid_ep *ep, const void *buf, size_t len,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_injectdata(myep->hep, buf, len, data, dest_addr);
-	TRACE_EP_MSG(ret, myep, buf, len, dest_addr, data, 0,  NULL);
+	TRACE_EP_MSG(injectdata, start, ret, myep, buf, len, dest_addr, data, 0,  NULL);
 
 	return ret;
 }
@@ -753,9 +982,10 @@ trace_read(struct fid_ep *ep, void *buf, size_t len, void *desc,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_read(myep->hep, buf, len, desc, src_addr, addr, key, context);
-	TRACE_EP_RMA(ret, myep, buf, len, src_addr, addr, 0, 0, key, context);
+	TRACE_EP_RMA(read, start, ret, myep, buf, len, src_addr, addr, 0, 0, key, context);
 
 	return ret;
 }
@@ -767,10 +997,11 @@ trace_readv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_readv(myep->hep, iov, desc, count, src_addr,
 		       addr, key, context);
-	TRACE_EP_RMA(ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
+	TRACE_EP_RMA(readv, start, ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
 		     src_addr, addr, 0, 0, key, context);
 
 	return ret;
@@ -781,9 +1012,10 @@ trace_readmsg(struct fid_ep *ep, const struct fi_msg_rma *msg, uint64_t flags)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_readmsg(myep->hep, msg, flags);
-	TRACE_EP_RMA(ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
+	TRACE_EP_RMA(readmsg, start, ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
 		     IOV_LEN(msg->msg_iov, msg->iov_count), msg->addr,
 		     msg->rma_iov_count ? msg->rma_iov[0].addr : 0,
 		     MSG_DATA(msg->data, flags), flags,
@@ -799,10 +1031,11 @@ trace_write(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_write(myep->hep, buf, len, desc, dest_addr,
 		       addr, key, context);
-	TRACE_EP_RMA(ret, myep, buf, len, dest_addr, addr, 0, 0, key, context);
+	TRACE_EP_RMA(write, start, ret, myep, buf, len, dest_addr, addr, 0, 0, key, context);
 
 	return ret;
 }
@@ -814,10 +1047,11 @@ trace_writev(struct fid_ep *ep, const struct iovec *iov, void **desc,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_writev(myep->hep, iov, desc, count, dest_addr,
 			addr, key, context);
-	TRACE_EP_RMA(ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
+	TRACE_EP_RMA(writev, start, ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
 		     dest_addr, addr, 0, 0, key, context);
 
 	return ret;
@@ -828,9 +1062,10 @@ trace_writemsg(struct fid_ep *ep, const struct fi_msg_rma *msg, uint64_t flags)
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_writemsg(myep->hep, msg, flags);
-	TRACE_EP_RMA(ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
+	TRACE_EP_RMA(writemsg, start, ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
 		     IOV_LEN(msg->msg_iov, msg->iov_count), msg->addr,
 		     msg->rma_iov_count ? msg->rma_iov[0].addr : 0,
 		     MSG_DATA(msg->data, flags), flags,
@@ -846,9 +1081,10 @@ trace_inject_write(struct fid_ep *ep, const void *buf, size_t len,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_inject_write(myep->hep, buf, len, dest_addr, addr, key);
-	TRACE_EP_RMA(ret, myep, buf, len, dest_addr, addr, 0, 0, key, NULL);
+	TRACE_EP_RMA(inject_write, start, ret, myep, buf, len, dest_addr, addr, 0, 0, key, NULL);
 
 	return ret;
 }
@@ -860,10 +1096,11 @@ trace_writedata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_writedata(myep->hep, buf, len, desc, data,
 			   dest_addr, addr, key, context);
-	TRACE_EP_RMA(ret, myep, buf, len, dest_addr, addr, data, 0, key, context);
+	TRACE_EP_RMA(writedata, start, ret, myep, buf, len, dest_addr, addr, data, 0, key, context);
 
 	return ret;
 }
@@ -875,10 +1112,11 @@ trace_inject_writedata(struct fid_ep *ep, const void *buf, size_t len,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_inject_writedata(myep->hep, buf, len, data, dest_addr,
 				  addr, key);
-	TRACE_EP_RMA(ret, myep, buf, len, dest_addr, addr, data, 0, key, NULL);
+	TRACE_EP_RMA(inject_writedata, start, ret, myep, buf, len, dest_addr, addr, data, 0, key, NULL);
 
 	return ret;
 }
@@ -904,10 +1142,11 @@ trace_trecv(struct fid_ep *ep, void *buf, size_t len, void *desc,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_trecv(myep->hep, buf, len, desc, src_addr,
 		       tag, ignore, context);
-	TRACE_EP_TAGGED(ret, myep, buf, len, src_addr, 0, 0, tag, ignore, context);
+	TRACE_EP_TAGGED(trecv, start, ret, myep, buf, len, src_addr, 0, 0, tag, ignore, context);
 
 	return ret;
 }
@@ -919,10 +1158,11 @@ trace_trecvv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_trecvv(myep->hep, iov, desc, count, src_addr,
 			tag, ignore, context);
-	TRACE_EP_TAGGED(ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
+	TRACE_EP_TAGGED(trecvv, start, ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
 			src_addr, 0, 0, tag, ignore, context);
 
 	return ret;
@@ -934,9 +1174,10 @@ trace_trecvmsg(struct fid_ep *ep, const struct fi_msg_tagged *msg,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_trecvmsg(myep->hep, msg, flags);
-	TRACE_EP_TAGGED(ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
+	TRACE_EP_TAGGED(trecvmsg, start, ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
 			IOV_LEN(msg->msg_iov, msg->iov_count), msg->addr,
 			MSG_DATA(msg->data, flags), flags,
 			msg->tag, msg->ignore, msg->context);
@@ -950,9 +1191,10 @@ trace_tsend(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_tsend(myep->hep, buf, len, desc, dest_addr, tag, context);
-	TRACE_EP_TAGGED(ret, myep, buf, len, dest_addr, 0, 0, tag, 0, context);
+	TRACE_EP_TAGGED(tsend, start, ret, myep, buf, len, dest_addr, 0, 0, tag, 0, context);
 
 	return ret;
 }
@@ -963,9 +1205,10 @@ trace_tsendv(struct fid_ep *ep, const struct iovec *iov, void **desc,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_tsendv(myep->hep, iov, desc, count, dest_addr, tag, context);
-	TRACE_EP_TAGGED(ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
+	TRACE_EP_TAGGED(tsendv, start, ret, myep, IOV_BASE(iov, count), IOV_LEN(iov, count),
 			dest_addr, 0, 0, tag, 0, context);
 
 	return ret;
@@ -977,9 +1220,10 @@ trace_tsendmsg(struct fid_ep *ep, const struct fi_msg_tagged *msg,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_tsendmsg(myep->hep, msg, flags);
-	TRACE_EP_TAGGED(ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
+	TRACE_EP_TAGGED(tsendmsg, start, ret, myep, IOV_BASE(msg->msg_iov, msg->iov_count),
 			IOV_LEN(msg->msg_iov, msg->iov_count), msg->addr,
 			MSG_DATA(msg->data, flags), flags,
 			msg->tag, 0, msg->context);
@@ -993,9 +1237,10 @@ trace_tinject(struct fid_ep *ep, const void *buf, size_t len,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_tinject(myep->hep, buf, len, dest_addr, tag);
-	TRACE_EP_TAGGED(ret, myep, buf, len, dest_addr, 0, 0, tag, 0, NULL);
+	TRACE_EP_TAGGED(tinject, start, ret, myep, buf, len, dest_addr, 0, 0, tag, 0, NULL);
 
 	return ret;
 }
@@ -1007,10 +1252,11 @@ trace_tsenddata(struct fid_ep *ep, const void *buf, size_t len, void *desc,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_tsenddata(myep->hep, buf, len, desc, data,
 			   dest_addr, tag, context);
-	TRACE_EP_TAGGED(ret, myep, buf, len, dest_addr, data, 0, tag, 0, context);
+	TRACE_EP_TAGGED(tsenddata, start, ret, myep, buf, len, dest_addr, data, 0, tag, 0, context);
 
 	return ret;
 }
@@ -1021,9 +1267,10 @@ trace_tinjectdata(struct fid_ep *ep, const void *buf, size_t len,
 {
 	struct hook_ep *myep = container_of(ep, struct hook_ep, ep);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_tinjectdata(myep->hep, buf, len, data, dest_addr, tag);
-	TRACE_EP_TAGGED(ret, myep, buf, len, dest_addr, data, 0, tag, 0, NULL);
+	TRACE_EP_TAGGED(tinjectdata, start, ret, myep, buf, len, dest_addr, data, 0, tag, 0, NULL);
 
 	return ret;
 }
@@ -1181,9 +1428,11 @@ static ssize_t trace_cq_read(struct fid_cq *cq, void *buf, size_t count)
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_cq_read(mycq->hcq, buf, count);
-	trace_cq(mycq, __func__, __LINE__, ret, buf, 0);
+	trace_cq(mycq, trace_op_cq_read, start, __func__, __LINE__, ret, buf,
+		 0);
 	return ret;
 }
 
@@ -1192,10 +1441,11 @@ trace_cq_readerr(struct fid_cq *cq, struct fi_cq_err_entry *buf, uint64_t flags)
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_cq_readerr(mycq->hcq, buf, flags);
 	if (ret > 0)
-		trace_cq_err(mycq, __func__, __LINE__, buf, flags);
+		trace_cq_err(mycq, start, __func__, __LINE__, buf, flags);
 	return ret;
 }
 
@@ -1204,9 +1454,11 @@ trace_cq_readfrom(struct fid_cq *cq, void *buf, size_t count, fi_addr_t *src_add
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_cq_readfrom(mycq->hcq, buf, count, src_addr);
-	trace_cq(mycq, __func__, __LINE__, ret, buf, src_addr ? *src_addr : 0);
+	trace_cq(mycq, trace_op_cq_readfrom, start, __func__, __LINE__, ret, buf,
+		 src_addr ? *src_addr : 0);
 	return ret;
 }
 
@@ -1216,9 +1468,11 @@ trace_cq_sread(struct fid_cq *cq, void *buf, size_t count,
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_cq_sread(mycq->hcq, buf, count, cond, timeout);
-	trace_cq(mycq, __func__, __LINE__, ret, buf, 0);
+	trace_cq(mycq, trace_op_cq_sread, start, __func__, __LINE__, ret, buf,
+		 0);
 	return ret;
 }
 
@@ -1228,9 +1482,11 @@ trace_cq_sreadfrom(struct fid_cq *cq, void *buf, size_t count,
 {
 	struct hook_cq *mycq = container_of(cq, struct hook_cq, cq);
 	ssize_t ret;
+	uint64_t start = trace_ts();
 
 	ret = fi_cq_sreadfrom(mycq->hcq, buf, count, src_addr, cond, timeout);
-	trace_cq(mycq, __func__, __LINE__, ret, buf, src_addr ? *src_addr : 0);
+	trace_cq(mycq, trace_op_cq_sreadfrom, start, __func__, __LINE__, ret, buf,
+		 src_addr ? *src_addr : 0);
 	return ret;
 }
 
@@ -1595,6 +1851,17 @@ static struct fi_ops trace_fabric_fid_ops = {
 
 struct hook_prov_ctx hook_trace_ctx;
 
+static void hook_trace_cleanup(void)
+{
+	/* The trace file is kept for decoding */
+	trace_binary = 0;
+	if (trace_hdr) {
+		munmap(trace_hdr, trace_hdr_size);
+		trace_hdr = NULL;
+	}
+	ofi_mutex_destroy(&trace_lock);
+}
+
 static int hook_trace_fabric(struct fi_fabric_attr *attr,
 			     struct fid_fabric **fabric, void *context)
 {
@@ -1606,6 +1873,14 @@ static int hook_trace_fabric(struct fi_fabric_attr *attr,
 	if (!fab)
 		return -FI_ENOMEM;
 
+	ofi_mutex_lock(&trace_lock);
+	if (trace_binary && !trace_hdr && trace_file_init(hprov)) {
+		FI_WARN(hprov, FI_LOG_FABRIC,
+			"binary trace unavailable, falling back to log\n");
+		trace_binary = 0;
+	}
+	ofi_mutex_unlock(&trace_lock);
+
 	hook_fabric_init(fab, HOOK_TRACE, attr->fabric, hprov,
 			 &trace_fabric_fid_ops, &hook_trace_ctx);
 	*fabric = &fab->fabric;
@@ -1620,12 +1895,54 @@ struct hook_prov_ctx hook_trace_ctx = {
 		.name = "ofi_hook_trace",
 		.getinfo = NULL,
 		.fabric = hook_trace_fabric,
-		.cleanup = NULL,
+		.cleanup = hook_trace_cleanup,
 	},
 };
 
+static void trace_env_init(void)
+{
+	struct fi_provider *prov = &hook_trace_ctx.prov;
+	char *mode = NULL, *basepath = NULL;
+	size_t ring_size;
+
+	fi_param_define(prov, "mode", FI_PARAM_STRING,
+			"Trace output.  'log' formats each call through "
+			"FI_LOG at trace level, 'binary' writes fixed size "
+			"records to a file for fi_trace_decode.  "
+			"(default: log)");
+	fi_param_define(prov, "basepath", FI_PARAM_STRING,
+			"Directory of the binary trace file, which is named "
+			"fi_trace_<hostname>_<pid>.  (default: %s)",
+			TRACE_BASEPATH_DEFAULT);
+	fi_param_define(prov, "ring_size", FI_PARAM_SIZE_T,
+			"Records kept per thread in binary mode, rounded up "
+			"to a power of two.  (default: %d)",
+			TRACE_RING_SIZE_DEFAULT);
+	fi_param_define(prov, "threads", FI_PARAM_INT,
+			"Threads traced in binary mode.  Calls from further "
+			"threads are only counted.  (default: %d)",
+			TRACE_RING_CNT_DEFAULT);
+
+	fi_param_get_str(prov, "mode", &mode);
+	trace_binary = mode && !strcasecmp(mode, "binary");
+
+	fi_param_get_str(prov, "basepath", &basepath);
+	if (basepath && strlen(basepath) < PATH_MAX)
+		snprintf(trace_env.basepath, PATH_MAX, "%s", basepath);
+
+	if (!fi_param_get_size_t(prov, "ring_size", &ring_size) && ring_size)
+		trace_env.ring_size = MIN(roundup_power_of_two(ring_size),
+					  1U << 30);
+	fi_param_get_int(prov, "threads", &trace_env.ring_cnt);
+	if (trace_env.ring_cnt <= 0)
+		trace_env.ring_cnt = TRACE_RING_CNT_DEFAULT;
+}
+
 HOOK_TRACE_INI
 {
+	trace_env_init();
+	ofi_mutex_init(&trace_lock);
+
 	hook_trace_ctx.ini_fid[FI_CLASS_DOMAIN] = trace_domain_init;
 	hook_trace_ctx.ini_fid[FI_CLASS_PEP] = trace_pep_init;
 
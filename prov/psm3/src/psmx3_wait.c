@@ -170,9 +170,7 @@ static int psmx3_wait_wait_wait(struct fid_wait *wait_fid, int timeout)
 		if (ofi_adjust_timeout(endtime, &timeout))
 			return -FI_ETIMEDOUT;
 
-		ret = (wait->util_wait.wait_obj == FI_WAIT_FD) ?
-		      ofi_epoll_wait(wait->epoll_fd, &event, 1, 100) :
-		      ofi_pollfds_wait(wait->pollfds, &event, 1, 100);
+		ret = ofi_dynpoll_wait(&wait->dynpoll, &event, 1, 100);
 		if (ret > 0)
 			return FI_SUCCESS;
 
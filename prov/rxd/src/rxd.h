@@ -42,6 +42,7 @@
 #include <rdma/fi_endpoint.h>
 #include <rdma/fi_eq.h>
 #include <rdma/fi_errno.h>
+#include <rdma/fi_ext.h>
 #include <rdma/fi_rma.h>
 #include <rdma/fi_tagged.h>
 #include <rdma/fi_trigger.h>
@@ -53,6 +54,7 @@
 #include <ofi_list.h>
 #include <ofi_util.h>
 #include <ofi_tree.h>
+#include <ofi_timer.h>
 #include <ofi_atomic.h>
 #include <ofi_indexer.h>
 #include "rxd_proto.h"
@@ -60,9 +62,10 @@
 #ifndef _RXD_H_
 #define _RXD_H_
 
-#define RXD_PROTOCOL_VERSION 	(2)
+#define RXD_PROTOCOL_VERSION 	(4)
 
 #define RXD_MAX_MTU_SIZE	4096
+#define RXD_MAX_SEG_SIZE	(64 * 1024)
 
 #define RXD_MAX_TX_BITS 	10
 #define RXD_MAX_RX_BITS 	10
@@ -71,11 +74,18 @@
 #define RXD_TX_POOL_CHUNK_CNT	1024
 #define RXD_RX_POOL_CHUNK_CNT	1024
 #define RXD_MAX_PENDING		128
+#define RXD_CQ_BATCH		32
 #define RXD_MAX_PKT_RETRY	50
+#define RXD_DUP_ACK_THRESH	3
+#define RXD_MIN_CWND		2
+#define RXD_MAX_RTO		4000000 /* usec */
+#define RXD_TIMER_TICK		10000 /* nsec */
 #define RXD_ADDR_INVALID	0
 
 #define RXD_PKT_IN_USE		(1 << 0)
 #define RXD_PKT_ACKED		(1 << 1)
+#define RXD_PKT_SACKED		(1 << 2)
+#define RXD_PKT_RETRANS		(1 << 3)
 
 #define RXD_REMOTE_CQ_DATA	(1 << 0)
 #define RXD_NO_TX_COMP		(1 << 1)
@@ -93,6 +103,11 @@ struct rxd_env {
 	int max_peers;
 	int max_unacked;
 	int rescan;
+	double drop_rate;
+	int cc;
+	int init_cwnd;
+	int min_rto;
+	int seg_size;
 };
 
 extern struct rxd_env rxd_env;
@@ -119,10 +134,30 @@ struct rxd_domain {
 	ssize_t max_inline_rma;
 	ssize_t max_inline_atom;
 	ssize_t max_seg_sz;
+
+	/* data segments larger than max_mtu_sz, negotiated per peer */
+	ssize_t seg_mtu_sz;
+	ssize_t max_rx_seg_sz;
+};
+
+struct rxd_cc {
+	uint64_t srtt;
+	uint64_t rttvar;
+	uint64_t rto;
+	uint32_t cwnd;
+	uint32_t cwnd_cnt;
+	uint32_t ssthresh;
+	uint64_t recover;
+	uint64_t loss_cnt;
+	uint64_t timeout_cnt;
 };
 
+struct rxd_ep;
+
 struct rxd_peer {
 	struct dlist_entry entry;
+	struct rxd_ep *ep;
+	fi_addr_t rxd_addr;
 	fi_addr_t peer_addr;
 	uint64_t tx_seq_no;
 	uint64_t rx_seq_no;
@@ -131,6 +166,12 @@ struct rxd_peer {
 	uint16_t rx_window;
 	uint16_t tx_window;
 	int retry_cnt;
+	int dup_ack_cnt;
+	uint8_t fast_rexmit;
+	uint8_t ack_pending;
+	uint32_t tx_seg_sz;
+	struct rxd_cc cc;
+	struct ofi_timer retry_timer;
 
 	uint16_t unacked_cnt;
 	uint8_t active;
@@ -197,6 +238,11 @@ struct rxd_ep {
 	int dg_cq_fd;
 	uint32_t tx_flags;
 	uint32_t rx_flags;
+	uint32_t drop_seed;
+
+	uint64_t drop_cnt;
+	uint64_t fast_rexmit_cnt;
+	uint64_t rto_rexmit_cnt;
 
 	size_t tx_msg_avail;
 	size_t rx_msg_avail;
@@ -217,6 +263,7 @@ struct rxd_ep {
 	struct dlist_entry active_peers;
 	struct dlist_entry rts_sent_list;
 	struct dlist_entry ctrl_pkts;
+	struct ofi_timer_wheel timer_wheel;
 
 	struct index_map peers_idm;
 };
@@ -255,6 +302,7 @@ struct rxd_x_entry {
 	uint64_t start_seq;
 	uint64_t offset;
 	uint64_t num_segs;
+	uint32_t seg_sz;
 	uint32_t op;
 
 	uint32_t flags;
@@ -345,6 +393,16 @@ static inline struct rxd_ext_hdr *rxd_get_ext_hdr(struct rxd_pkt_entry *pkt_entr
 	return &((struct rxd_ack_pkt *) (pkt_entry->pkt))->ext_hdr;
 }
 
+static inline void rxd_sack_set(struct rxd_sack_hdr *sack, uint64_t bit)
+{
+	sack->bitmap[bit / 64] |= 1ULL << (bit % 64);
+}
+
+static inline int rxd_sack_test(struct rxd_sack_hdr *sack, uint64_t bit)
+{
+	return (sack->bitmap[bit / 64] >> (bit % 64)) & 1;
+}
+
 static inline struct rxd_sar_hdr *rxd_get_sar_hdr(struct rxd_pkt_entry *pkt_entry)
 {
 	return (struct rxd_sar_hdr *) ((char *) pkt_entry->pkt +
@@ -429,7 +487,7 @@ int rxd_av_insert_dg_addr(struct rxd_av *av, const void *addr,
 			  void *context);
 
 /* Pkt resource functions */
-ssize_t rxd_ep_post_buf(struct rxd_ep *ep);
+ssize_t rxd_ep_post_bufs(struct rxd_ep *ep, size_t count);
 void rxd_ep_send_ack(struct rxd_ep *rxd_ep, fi_addr_t peer);
 struct rxd_pkt_entry *rxd_get_tx_pkt(struct rxd_ep *ep);
 struct rxd_x_entry *rxd_get_tx_entry(struct rxd_ep *ep, uint32_t op);
@@ -474,8 +532,39 @@ struct rxd_x_entry *rxd_rx_entry_init(struct rxd_ep *ep,
 			uint32_t op, uint32_t flags);
 void rxd_tx_entry_free(struct rxd_ep *ep, struct rxd_x_entry *tx_entry);
 void rxd_rx_entry_free(struct rxd_ep *ep, struct rxd_x_entry *rx_entry);
-int rxd_get_timeout(int retry_cnt);
-uint64_t rxd_get_retry_time(uint64_t start, int retry_cnt);
+
+/* Congestion control */
+void rxd_cc_init(struct rxd_peer *peer);
+void rxd_cc_rtt_sample(struct rxd_peer *peer, uint64_t rtt);
+void rxd_cc_ack(struct rxd_peer *peer, uint32_t acked);
+void rxd_cc_loss(struct rxd_peer *peer);
+void rxd_cc_timeout(struct rxd_peer *peer);
+void rxd_cc_get_state(struct rxd_peer *peer, struct fi_rxd_cc_state *state);
+
+static inline uint32_t rxd_peer_window(struct rxd_peer *peer)
+{
+	return MIN((uint32_t) peer->tx_window, peer->cc.cwnd);
+}
+
+/*
+ * With only a few packets in flight there may not be enough duplicate acks
+ * to reach the threshold, so retransmit early in that case (RFC 5827).
+ */
+static inline int rxd_dup_ack_thresh(struct rxd_peer *peer)
+{
+	return MAX(MIN(RXD_DUP_ACK_THRESH, peer->unacked_cnt - 1), 1);
+}
+
+/* Segment size used by the data packets of a transfer, never larger than
+ * what the local endpoint can send or receive */
+static inline uint32_t rxd_sar_seg_sz(struct rxd_ep *ep,
+				      struct rxd_sar_hdr *sar_hdr)
+{
+	if (!sar_hdr->seg_size)
+		return (uint32_t) rxd_ep_domain(ep)->max_seg_sz;
+	return (uint32_t) MIN((ssize_t) sar_hdr->seg_size,
+			      rxd_ep_domain(ep)->max_rx_seg_sz);
+}
 
 /* Generic message functions */
 ssize_t rxd_ep_generic_recvmsg(struct rxd_ep *rxd_ep, const struct iovec *iov,
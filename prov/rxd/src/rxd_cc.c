@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2024 Hewlett Packard Enterprise Development LP. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "rxd.h"
+
+/*
+ * Per-peer congestion control.
+ *
+ * The number of packets in flight to a peer is limited by the smaller of
+ * the receive window advertised by the peer and a congestion window.  The
+ * congestion window follows TCP style AIMD: it grows by one packet per
+ * acked packet during slow start, by one packet per window afterwards,
+ * and is halved when a loss is detected through duplicate acks, at most
+ * once per window of data.  A retransmission timeout collapses it to the
+ * minimum window, unless no round trip time has been measured yet, in
+ * which case the timeout cannot be told apart from a slow peer.
+ *
+ * The retransmission timeout is derived from smoothed round trip time
+ * samples as described in RFC 6298, with min_rto as the lower bound of
+ * the variance term rather than of the timeout itself.  Samples are only
+ * taken from packets which have neither been retransmitted nor
+ * selectively acked.  Each timeout doubles the retransmission timeout,
+ * and the backed off value is kept until the next valid sample.
+ */
+
+void rxd_cc_init(struct rxd_peer *peer)
+{
+	memset(&peer->cc, 0, sizeof(peer->cc));
+	peer->cc.rto = rxd_env.min_rto;
+	peer->cc.ssthresh = rxd_env.max_unacked;
+	peer->cc.cwnd = rxd_env.cc ? MIN(MAX(rxd_env.init_cwnd, RXD_MIN_CWND),
+					 rxd_env.max_unacked) :
+				     rxd_env.max_unacked;
+}
+
+void rxd_cc_rtt_sample(struct rxd_peer *peer, uint64_t rtt)
+{
+	uint64_t err;
+
+	if (!peer->cc.srtt) {
+		peer->cc.srtt = rtt;
+		peer->cc.rttvar = rtt / 2;
+	} else {
+		err = peer->cc.srtt > rtt ? peer->cc.srtt - rtt :
+					    rtt - peer->cc.srtt;
+		peer->cc.rttvar = (3 * peer->cc.rttvar + err) / 4;
+		peer->cc.srtt = (7 * peer->cc.srtt + rtt) / 8;
+	}
+
+	peer->cc.rto = peer->cc.srtt + MAX(4 * peer->cc.rttvar,
+					   (uint64_t) rxd_env.min_rto);
+	peer->cc.rto = MIN(peer->cc.rto, RXD_MAX_RTO);
+}
+
+void rxd_cc_ack(struct rxd_peer *peer, uint32_t acked)
+{
+	if (!rxd_env.cc)
+		return;
+
+	for (; acked && peer->cc.cwnd < (uint32_t) rxd_env.max_unacked;
+	     acked--) {
+		if (peer->cc.cwnd < peer->cc.ssthresh) {
+			peer->cc.cwnd++;
+		} else if (++peer->cc.cwnd_cnt >= peer->cc.cwnd) {
+			peer->cc.cwnd++;
+			peer->cc.cwnd_cnt = 0;
+		}
+	}
+}
+
+void rxd_cc_loss(struct rxd_peer *peer)
+{
+	if (ofi_before(peer->last_rx_ack, peer->cc.recover))
+		return;
+
+	peer->cc.recover = peer->tx_seq_no;
+	peer->cc.loss_cnt++;
+	if (!rxd_env.cc)
+		return;
+
+	peer->cc.ssthresh = MAX(peer->cc.cwnd / 2, RXD_MIN_CWND);
+	peer->cc.cwnd = peer->cc.ssthresh;
+	peer->cc.cwnd_cnt = 0;
+	FI_DBG(&rxd_prov, FI_LOG_EP_DATA, "loss detected, cwnd %u\n",
+	       peer->cc.cwnd);
+}
+
+void rxd_cc_timeout(struct rxd_peer *peer)
+{
+	peer->cc.timeout_cnt++;
+	peer->cc.rto = MIN(peer->cc.rto * 2, RXD_MAX_RTO);
+	if (!rxd_env.cc || !peer->cc.srtt)
+		return;
+
+	peer->cc.recover = peer->tx_seq_no;
+
+	peer->cc.ssthresh = MAX(peer->cc.cwnd / 2, RXD_MIN_CWND);
+	peer->cc.cwnd = RXD_MIN_CWND;
+	peer->cc.cwnd_cnt = 0;
+	FI_DBG(&rxd_prov, FI_LOG_EP_DATA, "retransmit timeout, rto %" PRIu64
+	       " usec, ssthresh %u\n", peer->cc.rto, peer->cc.ssthresh);
+}
+
+void rxd_cc_get_state(struct rxd_peer *peer, struct fi_rxd_cc_state *state)
+{
+	state->srtt = peer->cc.srtt;
+	state->rttvar = peer->cc.rttvar;
+	state->rto = peer->cc.rto;
+	state->cwnd = peer->cc.cwnd;
+	state->ssthresh = peer->cc.ssthresh;
+	state->tx_window = peer->tx_window;
+	state->unacked = peer->unacked_cnt;
+	state->loss_events = peer->cc.loss_cnt;
+	state->timeouts = peer->cc.timeout_cnt;
+}
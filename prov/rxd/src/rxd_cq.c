@@ -165,10 +165,50 @@ static int rxd_comp_pkt_seq_no(struct dlist_entry *item, const void *arg)
 	return new_hdr->seq_no > list_hdr->seq_no;
 }
 
+/*
+ * Hold on to an out of order packet so that it can be selectively acked
+ * and doesn't need to be retransmitted.  Only packets within the receive
+ * window which are not already buffered are kept.
+ */
+static int rxd_buffer_pkt(struct rxd_peer *peer, struct rxd_pkt_entry *pkt_entry)
+{
+	struct rxd_pkt_entry *buf_entry;
+	uint64_t seq_no = rxd_get_base_hdr(pkt_entry)->seq_no;
+
+	if (ofi_after_eq(peer->rx_seq_no, seq_no) ||
+	    seq_no - peer->rx_seq_no > (uint64_t) rxd_env.max_unacked)
+		return 0;
+
+	dlist_foreach_container(&peer->buf_pkts, struct rxd_pkt_entry,
+				buf_entry, d_entry) {
+		if (rxd_get_base_hdr(buf_entry)->seq_no == seq_no)
+			return 0;
+		if (ofi_before(seq_no, rxd_get_base_hdr(buf_entry)->seq_no)) {
+			dlist_insert_before(&pkt_entry->d_entry,
+					    &buf_entry->d_entry);
+			return 1;
+		}
+	}
+	dlist_insert_tail(&pkt_entry->d_entry, &peer->buf_pkts);
+	return 1;
+}
+
+static void rxd_unexp_data(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
+{
+	struct rxd_data_pkt *pkt = (struct rxd_data_pkt *) (pkt_entry->pkt);
+	struct rxd_unexp_msg *unexp_msg;
+
+	unexp_msg = rxd_peer(ep, pkt->base_hdr.peer)->curr_unexp;
+	dlist_insert_tail(&pkt_entry->d_entry, &unexp_msg->pkt_list);
+	if (pkt->ext_hdr.seg_no + 1 == unexp_msg->sar_hdr->num_segs - 1) {
+		rxd_peer(ep, pkt->base_hdr.peer)->curr_unexp = NULL;
+		rxd_ep_send_ack(ep, pkt->base_hdr.peer);
+	}
+}
+
 void rxd_ep_recv_data(struct rxd_ep *ep, struct rxd_x_entry *x_entry,
 		      struct rxd_data_pkt *pkt, size_t size)
 {
-	struct rxd_domain *rxd_domain = rxd_ep_domain(ep);
 	uint64_t done;
 	struct iovec *iov;
 	size_t iov_count;
@@ -182,7 +222,7 @@ void rxd_ep_recv_data(struct rxd_ep *ep, struct rxd_x_entry *x_entry,
 	}
 
 	done = ofi_copy_to_iov(iov, iov_count, x_entry->offset +
-			       (pkt->ext_hdr.seg_no * rxd_domain->max_seg_sz),
+			       (pkt->ext_hdr.seg_no * x_entry->seg_sz),
 			       pkt->msg, size - sizeof(struct rxd_data_pkt) -
 			       ep->rx_prefix_size);
 
@@ -193,6 +233,8 @@ void rxd_ep_recv_data(struct rxd_ep *ep, struct rxd_x_entry *x_entry,
 		if (!(rxd_peer(ep, pkt->base_hdr.peer)->rx_seq_no %
 		    rxd_peer(ep, pkt->base_hdr.peer)->rx_window))
 			rxd_ep_send_ack(ep, pkt->base_hdr.peer);
+		else
+			rxd_peer(ep, pkt->base_hdr.peer)->ack_pending = 1;
 		return;
 	}
 	rxd_ep_send_ack(ep, pkt->base_hdr.peer);
@@ -242,7 +284,7 @@ int rxd_start_xfer(struct rxd_ep *ep, struct rxd_x_entry *tx_entry)
 	struct rxd_base_hdr *hdr = rxd_get_base_hdr(tx_entry->pkt);
 
 	if (rxd_peer(ep, tx_entry->peer)->unacked_cnt >=
-	    rxd_peer(ep, tx_entry->peer)->tx_window)
+	    rxd_peer_window(rxd_peer(ep, tx_entry->peer)))
 		return 0;
 
 	tx_entry->start_seq = rxd_set_pkt_seq(rxd_peer(ep, tx_entry->peer),
@@ -264,7 +306,7 @@ int rxd_start_xfer(struct rxd_ep *ep, struct rxd_x_entry *tx_entry)
 	}
 
 	return rxd_peer(ep, tx_entry->peer)->unacked_cnt <
-	       rxd_peer(ep,tx_entry->peer)->tx_window;
+	       rxd_peer_window(rxd_peer(ep, tx_entry->peer));
 }
 
 void rxd_progress_tx_list(struct rxd_ep *ep, struct rxd_peer *peer)
@@ -309,7 +351,7 @@ void rxd_progress_tx_list(struct rxd_ep *ep, struct rxd_peer *peer)
 
 		if (tx_entry->op == RXD_DATA_READ && !tx_entry->bytes_done) {
 			if (rxd_peer(ep, tx_entry->peer)->unacked_cnt >=
-		    	    rxd_peer(ep, tx_entry->peer)->tx_window) {
+		    	    rxd_peer_window(rxd_peer(ep, tx_entry->peer))) {
 				break;
 			}
 			tx_entry->start_seq = rxd_peer(ep,tx_entry->peer)->tx_seq_no;
@@ -331,6 +373,24 @@ void rxd_progress_tx_list(struct rxd_ep *ep, struct rxd_peer *peer)
 		peer->retry_cnt = 0;
 }
 
+/*
+ * Data packets sent to a peer carry at most the smaller of the segment size
+ * the peer advertised in its RTS or CTS and the one supported locally.
+ * Transfers keep the size they were started with, which is carried in
+ * their SAR header, so segments of different sizes may be in flight.
+ */
+static void rxd_set_tx_seg_sz(struct rxd_ep *ep, fi_addr_t peer,
+			      uint32_t seg_size)
+{
+	if (!seg_size)
+		return;
+
+	rxd_peer(ep, peer)->tx_seg_sz = (uint32_t)
+		MIN((ssize_t) seg_size, rxd_ep_domain(ep)->max_rx_seg_sz);
+	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "peer %" PRIu64 " segment size %u\n",
+	       peer, rxd_peer(ep, peer)->tx_seg_sz);
+}
+
 static void rxd_update_peer(struct rxd_ep *ep, fi_addr_t peer, fi_addr_t peer_addr)
 {
 	rxd_verify_active(ep, peer, peer_addr);
@@ -358,6 +418,7 @@ static int rxd_send_cts(struct rxd_ep *rxd_ep, struct rxd_rts_pkt *rts_pkt,
 	cts->base_hdr.type = RXD_CTS;
 	cts->cts_addr = peer;
 	cts->rts_addr = rts_pkt->rts_addr;
+	cts->seg_size = (uint32_t) rxd_ep_domain(rxd_ep)->max_rx_seg_sz;
 
 	dlist_insert_tail(&pkt_entry->d_entry, &rxd_ep->ctrl_pkts);
 	ret = rxd_ep_send_pkt(rxd_ep, pkt_entry);
@@ -447,6 +508,7 @@ static void rxd_handle_rts(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
 			return;
 	}
 
+	rxd_set_tx_seg_sz(ep, rxd_addr, pkt->seg_size);
 	if (rxd_send_cts(ep, pkt, rxd_addr)) {
 		FI_WARN(&rxd_prov, FI_LOG_EP_CTRL,
 			"error posting CTS\n");
@@ -578,7 +640,6 @@ static struct rxd_x_entry *rxd_rma_read_entry_init(struct rxd_ep *ep,
 			struct rxd_rma_hdr *rma_hdr)
 {
 	struct rxd_x_entry *rx_entry;
-	struct rxd_domain *rxd_domain = rxd_ep_domain(ep);
 	int ret;
 
 	rx_entry = rxd_get_rx_entry(ep, base_hdr->type);
@@ -593,7 +654,8 @@ static struct rxd_x_entry *rxd_rma_read_entry_init(struct rxd_ep *ep,
 	rx_entry->flags = RXD_NO_TX_COMP;
 	rx_entry->bytes_done = 0;
 	rx_entry->next_seg_no = 0;
-	rx_entry->num_segs = ofi_div_ceil(sar_hdr->size, rxd_domain->max_seg_sz);
+	rx_entry->seg_sz = rxd_sar_seg_sz(ep, sar_hdr);
+	rx_entry->num_segs = ofi_div_ceil(sar_hdr->size, rx_entry->seg_sz);
 	rx_entry->pkt = NULL;
 
  	ret = rxd_verify_iov(ep, rma_hdr->rma, sar_hdr->iov_count,
@@ -667,6 +729,7 @@ static struct rxd_x_entry *rxd_rx_atomic_fetch(struct rxd_ep *ep,
 	rx_entry->bytes_done = 0;
 	rx_entry->next_seg_no = 0;
 	rx_entry->num_segs = 1;
+	rx_entry->seg_sz = (uint32_t) rxd_ep_domain(ep)->max_seg_sz;
 
 	rx_entry->iov_count = sar_hdr->iov_count;
  	ret = rxd_verify_iov(ep, rma_hdr->rma, rx_entry->iov_count,
@@ -887,6 +950,7 @@ void rxd_progress_op(struct rxd_ep *ep, struct rxd_x_entry *rx_entry,
 
 	rx_entry->tx_id = (uint16_t) sar_hdr->tx_id;
 	rx_entry->num_segs = sar_hdr->num_segs;
+	rx_entry->seg_sz = rxd_sar_seg_sz(ep, sar_hdr);
 	rx_entry->next_seg_no++;
 	rx_entry->start_seq = base_hdr->seq_no;
 }
@@ -923,45 +987,68 @@ static void rxd_progress_buf_pkts(struct rxd_ep *ep, fi_addr_t peer)
 		pkt_entry = container_of(bufpkts->next, struct rxd_pkt_entry,
 					 d_entry);
 		base_hdr = rxd_get_base_hdr(pkt_entry);
+		if (ofi_before(base_hdr->seq_no, rxd_peer(ep, peer)->rx_seq_no)) {
+			/* retransmitted copy was already processed in order */
+			rxd_remove_free_pkt_entry(pkt_entry);
+			continue;
+		}
 		if (base_hdr->seq_no != rxd_peer(ep, peer)->rx_seq_no)
 			return;
+
+		dlist_remove(&pkt_entry->d_entry);
 		if (base_hdr->type == RXD_DATA || base_hdr->type == RXD_DATA_READ) {
+			rxd_peer(ep, peer)->rx_seq_no++;
+			if (base_hdr->type == RXD_DATA &&
+			    rxd_peer(ep, peer)->curr_unexp) {
+				rxd_unexp_data(ep, pkt_entry);
+				continue;
+			}
 			data_pkt = (struct rxd_data_pkt *) pkt_entry->pkt;
 			rx_entry = rxd_get_data_x_entry(ep, data_pkt);
 			rxd_ep_recv_data(ep, rx_entry, data_pkt, pkt_entry->pkt_size);
-		} else {
-			ret = rxd_unpack_init_rx(ep, &rx_entry, pkt_entry, base_hdr, &sar_hdr,
-					      &tag_hdr, &data_hdr, &rma_hdr, &atom_hdr,
-					      &msg, &msg_size);
-			if (ret) {
-				memset(&err_entry, 0, sizeof(err_entry));
-				err_entry.err = FI_ETRUNC;
-				err_entry.prov_errno = 0;
-				ret = ofi_cq_write_error(&rxd_ep_rx_cq(ep)->util_cq,
-							 &err_entry);
-				if (ret)
-					FI_WARN(&rxd_prov, FI_LOG_EP_CTRL,
-						"could not write error entry\n");
-				rxd_peer(ep, base_hdr->peer)->rx_seq_no++;
-				rxd_remove_free_pkt_entry(pkt_entry);
+			ofi_buf_free(pkt_entry);
+			continue;
+		}
+
+		ret = rxd_unpack_init_rx(ep, &rx_entry, pkt_entry, base_hdr, &sar_hdr,
+				      &tag_hdr, &data_hdr, &rma_hdr, &atom_hdr,
+				      &msg, &msg_size);
+		if (ret) {
+			memset(&err_entry, 0, sizeof(err_entry));
+			err_entry.err = FI_ETRUNC;
+			err_entry.prov_errno = 0;
+			ret = ofi_cq_write_error(&rxd_ep_rx_cq(ep)->util_cq,
+						 &err_entry);
+			if (ret)
+				FI_WARN(&rxd_prov, FI_LOG_EP_CTRL,
+					"could not write error entry\n");
+			rxd_peer(ep, peer)->rx_seq_no++;
+			ofi_buf_free(pkt_entry);
+			continue;
+		}
+		if (!rx_entry) {
+			if ((base_hdr->type == RXD_MSG ||
+			     base_hdr->type == RXD_TAGGED) &&
+			    rxd_peer(ep, peer)->curr_unexp) {
+				/* packet is now owned by the unexpected msg */
+				rxd_peer(ep, peer)->rx_seq_no++;
+				if (!sar_hdr)
+					rxd_peer(ep, peer)->curr_unexp = NULL;
 				continue;
 			}
-			if (!rx_entry) {
-				if (base_hdr->type == RXD_MSG ||
-				    base_hdr->type == RXD_TAGGED) {
-					rxd_peer(ep, base_hdr->peer)->rx_seq_no++;
-					continue;
-				}
-				break;
-			}
-
-			rxd_progress_op(ep, rx_entry, pkt_entry, base_hdr,
-					sar_hdr, tag_hdr, data_hdr, rma_hdr,
-					atom_hdr, &msg, msg_size);
+			if (base_hdr->type != RXD_MSG &&
+			    base_hdr->type != RXD_TAGGED)
+				rxd_peer(ep, peer)->rx_window = 0;
+			dlist_insert_head(&pkt_entry->d_entry, bufpkts);
+			return;
 		}
 
-		rxd_peer(ep,base_hdr->peer)->rx_seq_no++;
-		rxd_remove_free_pkt_entry(pkt_entry);
+		rxd_peer(ep, peer)->rx_seq_no++;
+		rxd_peer(ep, peer)->rx_window = (uint16_t) rxd_env.max_unacked;
+		rxd_progress_op(ep, rx_entry, pkt_entry, base_hdr,
+				sar_hdr, tag_hdr, data_hdr, rma_hdr,
+				atom_hdr, &msg, msg_size);
+		ofi_buf_free(pkt_entry);
 	}
 }
 
@@ -969,7 +1056,7 @@ static void rxd_handle_data(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
 {
 	struct rxd_data_pkt *pkt = (struct rxd_data_pkt *) (pkt_entry->pkt);
 	struct rxd_x_entry *x_entry;
-	struct rxd_unexp_msg *unexp_msg;
+	int ret;
 
 	if (pkt_entry->pkt_size < sizeof(*pkt) + ep->rx_prefix_size) {
 		FI_WARN(&rxd_prov, FI_LOG_CQ,
@@ -982,19 +1069,20 @@ static void rxd_handle_data(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
 		rxd_peer(ep, pkt->base_hdr.peer)->rx_seq_no++;
 		if (pkt->base_hdr.type == RXD_DATA &&
 		    rxd_peer(ep, pkt->base_hdr.peer)->curr_unexp) {
-			unexp_msg = rxd_peer(ep, pkt->base_hdr.peer)->curr_unexp;
-			dlist_insert_tail(&pkt_entry->d_entry, &unexp_msg->pkt_list);
-			if (pkt->ext_hdr.seg_no + 1 == unexp_msg->sar_hdr->num_segs - 1) {
-				rxd_peer(ep, pkt->base_hdr.peer)->curr_unexp = NULL;
-				rxd_ep_send_ack(ep, pkt->base_hdr.peer);
-			}
-			return;
+			rxd_unexp_data(ep, pkt_entry);
+			pkt_entry = NULL;
+		} else {
+			x_entry = rxd_get_data_x_entry(ep, pkt);
+			rxd_ep_recv_data(ep, x_entry, pkt, pkt_entry->pkt_size);
 		}
-		x_entry = rxd_get_data_x_entry(ep, pkt);
-		rxd_ep_recv_data(ep, x_entry, pkt, pkt_entry->pkt_size);
 		if (!dlist_empty(&(rxd_peer(ep,
-				   pkt->base_hdr.peer)->buf_pkts)))
+				   pkt->base_hdr.peer)->buf_pkts))) {
 			rxd_progress_buf_pkts(ep, pkt->base_hdr.peer);
+			if (rxd_env.retry)
+				rxd_ep_send_ack(ep, pkt->base_hdr.peer);
+		}
+		if (!pkt_entry)
+			return;
 	} else if (!rxd_env.retry) {
 		dlist_insert_order(&(rxd_peer(ep,
 				     pkt->base_hdr.peer)->buf_pkts),
@@ -1002,7 +1090,11 @@ static void rxd_handle_data(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
 		return;
 	} else if (rxd_peer(ep, pkt->base_hdr.peer)->peer_addr !=
 		   RXD_ADDR_INVALID) {
+		ret = rxd_buffer_pkt(rxd_peer(ep, pkt->base_hdr.peer),
+				     pkt_entry);
 		rxd_ep_send_ack(ep, pkt->base_hdr.peer);
+		if (ret)
+			return;
 	}
 free:
 	ofi_buf_free(pkt_entry);
@@ -1028,9 +1120,14 @@ static void rxd_handle_op(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
 			return;
 		}
 
-		if (rxd_peer(ep, base_hdr->peer)->peer_addr != RXD_ADDR_INVALID)
-			goto ack;
-		goto release;
+		if (rxd_peer(ep, base_hdr->peer)->peer_addr == RXD_ADDR_INVALID)
+			goto release;
+
+		if (rxd_buffer_pkt(rxd_peer(ep, base_hdr->peer), pkt_entry)) {
+			rxd_ep_send_ack(ep, base_hdr->peer);
+			return;
+		}
+		goto ack;
 	}
 
 	if (rxd_peer(ep, base_hdr->peer)->peer_addr == RXD_ADDR_INVALID)
@@ -1052,6 +1149,9 @@ static void rxd_handle_op(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
 			if (!sar_hdr)
 				rxd_peer(ep, base_hdr->peer)->curr_unexp = NULL;
 
+			if (!dlist_empty(&(rxd_peer(ep, base_hdr->peer)->buf_pkts)))
+				rxd_progress_buf_pkts(ep, base_hdr->peer);
+
 			rxd_ep_send_ack(ep, base_hdr->peer);
 			return;
 		}
@@ -1083,22 +1183,99 @@ static void rxd_handle_cts(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
 		return;
 	}
 
+	rxd_set_tx_seg_sz(ep, cts->rts_addr, cts->seg_size);
 	rxd_update_peer(ep, cts->rts_addr, cts->cts_addr);
 }
 
+/*
+ * Mark packets the peer reported as received out of order.  Returns the
+ * sequence number just past the highest selectively acked packet, or the
+ * cumulative ack if none were reported.
+ */
+static uint64_t rxd_apply_sack(struct rxd_peer *peer, struct rxd_ack_pkt *ack)
+{
+	struct rxd_pkt_entry *pkt_entry;
+	uint64_t seq_no, end = ack->base_hdr.seq_no;
+
+	dlist_foreach_container(&peer->unacked, struct rxd_pkt_entry,
+				pkt_entry, d_entry) {
+		seq_no = rxd_get_base_hdr(pkt_entry)->seq_no;
+		if (seq_no == ack->base_hdr.seq_no) {
+			/* the peer is still waiting for this one */
+			pkt_entry->flags &= ~RXD_PKT_SACKED;
+			continue;
+		}
+		if (ofi_after_eq(ack->base_hdr.seq_no, seq_no))
+			continue;
+		if (seq_no - ack->base_hdr.seq_no > RXD_SACK_BITS)
+			break;
+		if (!rxd_sack_test(&ack->sack_hdr,
+				   seq_no - ack->base_hdr.seq_no - 1))
+			continue;
+		pkt_entry->flags |= RXD_PKT_SACKED;
+		end = seq_no + 1;
+	}
+	return end;
+}
+
+/*
+ * Resend only the packets which fall in the gaps of the selective ack,
+ * without waiting for the retry timer to expire.
+ */
+static void rxd_fast_retransmit(struct rxd_ep *ep, struct rxd_peer *peer,
+				uint64_t end)
+{
+	struct rxd_pkt_entry *pkt_entry;
+
+	dlist_foreach_container(&peer->unacked, struct rxd_pkt_entry,
+				pkt_entry, d_entry) {
+		if (!ofi_before(rxd_get_base_hdr(pkt_entry)->seq_no, end))
+			break;
+		if (pkt_entry->flags & (RXD_PKT_IN_USE | RXD_PKT_ACKED |
+					RXD_PKT_SACKED))
+			continue;
+		if (rxd_ep_send_pkt(ep, pkt_entry))
+			break;
+		pkt_entry->flags |= RXD_PKT_RETRANS;
+		ep->fast_rexmit_cnt++;
+	}
+}
+
 static void rxd_handle_ack(struct rxd_ep *ep, struct rxd_pkt_entry *ack_entry)
 {
 	struct rxd_ack_pkt *ack = (struct rxd_ack_pkt *) (ack_entry->pkt);
 	struct rxd_pkt_entry *pkt_entry;
 	fi_addr_t peer = ack->base_hdr.peer;
 	struct rxd_base_hdr *hdr;
+	uint64_t sack_end, sent = 0;
+	uint32_t acked = 0;
+
+	if (ack_entry->pkt_size < sizeof(*ack) + ep->rx_prefix_size) {
+		FI_WARN(&rxd_prov, FI_LOG_CQ,
+			"Cannot process ACK smaller than minimum size\n");
+		return;
+	}
 
 	rxd_peer(ep, peer)->tx_window = (uint16_t) ack->ext_hdr.rx_id;
 
-	if (rxd_peer(ep, peer)->last_rx_ack == ack->base_hdr.seq_no)
+	if (rxd_peer(ep, peer)->last_rx_ack == ack->base_hdr.seq_no) {
+		sack_end = rxd_apply_sack(rxd_peer(ep, peer), ack);
+		/* the threshold shrinks as packets are sacked, so it can be
+		 * passed without being hit; retransmit once until the
+		 * cumulative ack advances */
+		if (sack_end != ack->base_hdr.seq_no &&
+		    ++rxd_peer(ep, peer)->dup_ack_cnt >=
+		    rxd_dup_ack_thresh(rxd_peer(ep, peer)) &&
+		    !rxd_peer(ep, peer)->fast_rexmit) {
+			rxd_peer(ep, peer)->fast_rexmit = 1;
+			rxd_cc_loss(rxd_peer(ep, peer));
+			rxd_fast_retransmit(ep, rxd_peer(ep, peer), sack_end);
+		}
 		return;
+	}
 
 	rxd_peer(ep, peer)->last_rx_ack = ack->base_hdr.seq_no;
+	rxd_peer(ep, peer)->fast_rexmit = 0;
 
 	if (dlist_empty(&(rxd_peer(ep, peer)->unacked)))
 		return;
@@ -1113,6 +1290,14 @@ static void rxd_handle_ack(struct rxd_ep *ep, struct rxd_pkt_entry *ack_entry)
 		if (ofi_after_eq(hdr->seq_no, ack->base_hdr.seq_no))
 			break;
 
+		if (!(pkt_entry->flags & RXD_PKT_ACKED)) {
+			acked++;
+			/* selectively acked packets were received earlier */
+			if (!(pkt_entry->flags &
+			      (RXD_PKT_RETRANS | RXD_PKT_SACKED)))
+				sent = MAX(sent, pkt_entry->timestamp);
+		}
+
 		if (pkt_entry->flags & RXD_PKT_IN_USE) {
 			pkt_entry->flags |= RXD_PKT_ACKED;
 			pkt_entry = container_of((&pkt_entry->d_entry)->next,
@@ -1127,6 +1312,14 @@ static void rxd_handle_ack(struct rxd_ep *ep, struct rxd_pkt_entry *ack_entry)
 					struct rxd_pkt_entry, d_entry);
 	}
 
+	if (sent)
+		rxd_cc_rtt_sample(rxd_peer(ep, peer), ofi_gettime_us() - sent);
+	rxd_cc_ack(rxd_peer(ep, peer), acked);
+
+	/* the first ack reporting a gap counts towards fast retransmit */
+	sack_end = rxd_apply_sack(rxd_peer(ep, peer), ack);
+	rxd_peer(ep, peer)->dup_ack_cnt = sack_end != ack->base_hdr.seq_no;
+
 	rxd_progress_tx_list(ep, rxd_peer(ep, ack->base_hdr.peer));
 }
 
@@ -1157,6 +1350,14 @@ void rxd_handle_send_comp(struct rxd_ep *ep, struct fi_cq_msg_entry *comp)
 	}
 }
 
+/* Loss injection for testing retransmission under a lossy network */
+static inline int rxd_drop_pkt(struct rxd_ep *ep)
+{
+	return rxd_env.drop_rate > 0 &&
+	       ofi_xorshift_random_r(&ep->drop_seed) <
+	       rxd_env.drop_rate * UINT32_MAX;
+}
+
 void rxd_handle_recv_comp(struct rxd_ep *ep, struct fi_cq_msg_entry *comp)
 {
 	struct rxd_pkt_entry *pkt_entry =
@@ -1166,9 +1367,14 @@ void rxd_handle_recv_comp(struct rxd_ep *ep, struct fi_cq_msg_entry *comp)
 	       "got recv completion (type: %s)\n",
 	       rxd_pkt_type_str[(rxd_pkt_type(pkt_entry))]);
 
-	rxd_ep_post_buf(ep);
 	rxd_remove_rx_pkt(ep, pkt_entry);
 
+	if (rxd_drop_pkt(ep)) {
+		ep->drop_cnt++;
+		ofi_buf_free(pkt_entry);
+		return;
+	}
+
 	pkt_entry->pkt_size = comp->len;
 	switch (rxd_pkt_type(pkt_entry)) {
 	case RXD_RTS:
@@ -1274,7 +1480,7 @@ ssize_t rxd_cq_sreadfrom(struct fid_cq *cq_fid, void *buf, size_t count,
 		ofi_genlock_unlock(&cq->ep_list_lock);
 
 		ret = ofi_wait(&cq->wait->wait_fid, ep_retry == -1 ?
-			       timeout : rxd_get_timeout(ep_retry));
+			       timeout : ep_retry);
 
 		if (ep_retry != -1 && ret == -FI_ETIMEDOUT)
 			ret = 0;
@@ -123,6 +123,12 @@ int rxd_domain_open(struct fid_fabric *fabric, struct fi_info *info,
 					sizeof(struct rxd_atom_hdr);
 	rxd_domain->max_seg_sz = rxd_domain->max_mtu_sz - sizeof(struct rxd_data_pkt) -
 				 dg_info->ep_attr->msg_prefix_size;
+	rxd_domain->seg_mtu_sz = MAX(rxd_domain->max_mtu_sz,
+				     MIN(dg_info->ep_attr->max_msg_size,
+					 (size_t) rxd_env.seg_size));
+	rxd_domain->max_rx_seg_sz = rxd_domain->seg_mtu_sz -
+				    sizeof(struct rxd_data_pkt) -
+				    dg_info->ep_attr->msg_prefix_size;
 
 	ret = ofi_domain_init(fabric, info, &rxd_domain->util_domain, context,
 			      OFI_LOCK_MUTEX);
@@ -148,13 +148,48 @@ out:
 	return 0;
 }
 
+static int rxd_ep_get_cc_state(struct rxd_ep *ep, void *optval,
+			       size_t *optlen)
+{
+	struct fi_rxd_cc_state *state = optval;
+	struct rxd_peer *peer;
+	fi_addr_t rxd_addr;
+	int ret = -FI_EINVAL;
+
+	if (*optlen < sizeof(*state))
+		return -FI_ETOOSMALL;
+
+	ofi_genlock_lock(&ep->util_ep.lock);
+	rxd_addr = (intptr_t) ofi_idx_lookup(&(rxd_ep_av(ep)->fi_addr_idx),
+					     RXD_IDX_OFFSET((int) state->addr));
+	if (!rxd_addr)
+		goto out;
+
+	peer = rxd_peer(ep, rxd_addr);
+	if (!peer)
+		goto out;
+
+	rxd_cc_get_state(peer, state);
+	*optlen = sizeof(*state);
+	ret = FI_SUCCESS;
+out:
+	ofi_genlock_unlock(&ep->util_ep.lock);
+	return ret;
+}
+
 static int rxd_ep_getopt(fid_t fid, int level, int optname,
 		   void *optval, size_t *optlen)
 {
 	struct rxd_ep *rxd_ep =
 		container_of(fid, struct rxd_ep, util_ep.ep_fid);
 
-	if ((level != FI_OPT_ENDPOINT) || (optname != FI_OPT_MIN_MULTI_RECV))
+	if (level != FI_OPT_ENDPOINT)
+		return -FI_ENOPROTOOPT;
+
+	if (optname == FI_OPT_RXD_CC_STATE)
+		return rxd_ep_get_cc_state(rxd_ep, optval, optlen);
+
+	if (optname != FI_OPT_MIN_MULTI_RECV)
 		return -FI_ENOPROTOOPT;
 
 	*(size_t *)optval = rxd_ep->min_multi_recv_size;
@@ -223,19 +258,27 @@ struct rxd_x_entry *rxd_rx_entry_init(struct rxd_ep *ep,
 	return rx_entry;
 }
 
-ssize_t rxd_ep_post_buf(struct rxd_ep *ep)
+static ssize_t rxd_ep_post_buf(struct rxd_ep *ep, uint64_t flags)
 {
 	struct rxd_pkt_entry *pkt_entry;
+	struct iovec iov;
+	struct fi_msg msg;
 	ssize_t ret;
 
 	pkt_entry = ofi_buf_alloc(ep->rx_pkt_pool.pool);
 	if (!pkt_entry)
 		return -FI_ENOMEM;
 
-	ret = fi_recv(ep->dg_ep, rxd_pkt_start(pkt_entry),
-		      rxd_ep_domain(ep)->max_mtu_sz,
-		      pkt_entry->desc, FI_ADDR_UNSPEC,
-		      &pkt_entry->context);
+	iov.iov_base = rxd_pkt_start(pkt_entry);
+	iov.iov_len = rxd_ep_domain(ep)->seg_mtu_sz;
+	msg.msg_iov = &iov;
+	msg.desc = &pkt_entry->desc;
+	msg.iov_count = 1;
+	msg.addr = FI_ADDR_UNSPEC;
+	msg.context = &pkt_entry->context;
+	msg.data = 0;
+
+	ret = fi_recvmsg(ep->dg_ep, &msg, flags);
 	if (ret) {
 		ofi_buf_free(pkt_entry);
 		FI_WARN(&rxd_prov, FI_LOG_EP_CTRL, "failed to repost\n");
@@ -247,9 +290,24 @@ ssize_t rxd_ep_post_buf(struct rxd_ep *ep)
 	return 0;
 }
 
+/*
+ * Post receive buffers in a batch, hinting the core provider with FI_MORE
+ * that more buffers follow.
+ */
+ssize_t rxd_ep_post_bufs(struct rxd_ep *ep, size_t count)
+{
+	ssize_t ret;
+
+	for (; count; count--) {
+		ret = rxd_ep_post_buf(ep, count > 1 ? FI_MORE : 0);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
 static int rxd_ep_enable(struct rxd_ep *ep)
 {
-	size_t i;
 	int ret;
 
 	ret = fi_ep_bind(ep->dg_ep, &ep->dg_cq->fid, FI_TRANSMIT | FI_RECV);
@@ -264,27 +322,11 @@ static int rxd_ep_enable(struct rxd_ep *ep)
 	ep->rx_flags = rxd_rx_flags(ep->util_ep.rx_op_flags);
 
 	ofi_genlock_lock(&ep->util_ep.lock);
-	for (i = 0; i < ep->rx_size; i++) {
-		if (rxd_ep_post_buf(ep))
-			break;
-	}
+	rxd_ep_post_bufs(ep, ep->rx_size);
 	ofi_genlock_unlock(&ep->util_ep.lock);
 	return 0;
 }
 
-/*
- * Exponential back-off starting at 1ms, max 4s.
- */
-int rxd_get_timeout(int retry_cnt)
-{
-	return MIN(1 << retry_cnt, 4000);
-}
-
-uint64_t rxd_get_retry_time(uint64_t start, int retry_cnt)
-{
-	return start + rxd_get_timeout(retry_cnt);
-}
-
 void rxd_init_data_pkt(struct rxd_ep *ep, struct rxd_x_entry *tx_entry,
 		       struct rxd_pkt_entry *pkt_entry)
 {
@@ -292,7 +334,7 @@ void rxd_init_data_pkt(struct rxd_ep *ep, struct rxd_x_entry *tx_entry,
 	uint32_t seg_size;
 
 	seg_size = (uint32_t) (tx_entry->cq_entry.len - tx_entry->bytes_done);
-	seg_size = (uint32_t) MIN(rxd_ep_domain(ep)->max_seg_sz, seg_size);
+	seg_size = MIN(tx_entry->seg_sz, seg_size);
 
 	data_pkt->base_hdr.version = RXD_PROTOCOL_VERSION;
 	data_pkt->base_hdr.type = (tx_entry->cq_entry.flags &
@@ -341,6 +383,7 @@ struct rxd_x_entry *rxd_tx_entry_init_common(struct rxd_ep *ep, fi_addr_t addr,
 	tx_entry->bytes_done = 0;
 	tx_entry->offset = 0;
 	tx_entry->next_seg_no = 0;
+	tx_entry->seg_sz = rxd_peer(ep, addr)->tx_seg_sz;
 	tx_entry->iov_count = (uint8_t) iov_count;
 	memcpy(&tx_entry->iov[0], iov, sizeof(*iov) * iov_count);
 
@@ -377,21 +420,70 @@ void rxd_insert_unacked(struct rxd_ep *ep, fi_addr_t peer,
 	dlist_insert_tail(&pkt_entry->d_entry,
 			  &(rxd_peer(ep, peer)->unacked));
 	rxd_peer(ep, peer)->unacked_cnt++;
+	if (!ofi_timer_armed(&rxd_peer(ep, peer)->retry_timer))
+		ofi_timer_arm(&ep->timer_wheel, &rxd_peer(ep, peer)->retry_timer,
+			      ofi_gettime_ns() + rxd_peer(ep, peer)->cc.rto * 1000);
+}
+
+static ssize_t rxd_ep_sendmsg_pkt(struct rxd_ep *ep,
+				  struct rxd_pkt_entry *pkt_entry,
+				  uint64_t flags)
+{
+	struct iovec iov;
+	struct fi_msg msg;
+	ssize_t ret;
+
+	pkt_entry->timestamp = ofi_gettime_us();
+
+	iov.iov_base = rxd_pkt_start(pkt_entry);
+	iov.iov_len = pkt_entry->pkt_size;
+	msg.msg_iov = &iov;
+	msg.desc = &pkt_entry->desc;
+	msg.iov_count = 1;
+	msg.addr = (intptr_t) ofi_idx_lookup(&(rxd_ep_av(ep)->rxdaddr_dg_idx),
+					     (int)pkt_entry->peer);
+	msg.context = &pkt_entry->context;
+	msg.data = 0;
+
+	ret = fi_sendmsg(ep->dg_ep, &msg, flags);
+	if (ret) {
+		FI_WARN(&rxd_prov, FI_LOG_EP_CTRL, "error sending packet: %d (%s)\n",
+			(int) ret, fi_strerror((int) -ret));
+		return ret;
+	}
+	pkt_entry->flags |= RXD_PKT_IN_USE;
+
+	return 0;
+}
+
+ssize_t rxd_ep_send_pkt(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
+{
+	return rxd_ep_sendmsg_pkt(ep, pkt_entry, 0);
 }
 
+/*
+ * Data packets are posted to the core provider as a burst: every packet
+ * but the last of the burst is sent with FI_MORE, so that the core can
+ * submit them together.  A packet the core could not take stays on the
+ * unacked list and is sent by the retry timer, and the error is returned
+ * so that no further packets are posted.
+ */
 ssize_t rxd_ep_post_data_pkts(struct rxd_ep *ep, struct rxd_x_entry *tx_entry)
 {
-	struct rxd_pkt_entry *pkt_entry;
+	struct rxd_pkt_entry *pkt_entry, *prev = NULL;
 	struct rxd_data_pkt *data;
+	ssize_t ret = 0, err;
 
 	while (tx_entry->bytes_done != tx_entry->cq_entry.len) {
 		if (rxd_peer(ep, tx_entry->peer)->unacked_cnt >=
-		    rxd_peer(ep, tx_entry->peer)->tx_window)
-			return 0;
+		    rxd_peer_window(rxd_peer(ep, tx_entry->peer)))
+			goto out;
 
 		pkt_entry = rxd_get_tx_pkt(ep);
-		if (!pkt_entry)
-			return -FI_ENOMEM;
+		if (!pkt_entry) {
+			ret = -FI_ENOMEM;
+			goto out;
+		}
 
 		rxd_init_data_pkt(ep, tx_entry, pkt_entry);
 
@@ -401,33 +493,23 @@ ssize_t rxd_ep_post_data_pkts(struct rxd_ep *ep, struct rxd_x_entry *tx_entry)
 		if (data->base_hdr.type != RXD_DATA_READ)
 			data->base_hdr.seq_no++;
 
-		rxd_ep_send_pkt(ep, pkt_entry);
 		rxd_insert_unacked(ep, tx_entry->peer, pkt_entry);
+		if (prev) {
+			ret = rxd_ep_sendmsg_pkt(ep, prev, FI_MORE);
+			if (ret)
+				return ret;
+		}
+		prev = pkt_entry;
 	}
-
-	return rxd_peer(ep, tx_entry->peer)->unacked_cnt >=
-	       rxd_peer(ep, tx_entry->peer)->tx_window;
-}
-
-ssize_t rxd_ep_send_pkt(struct rxd_ep *ep, struct rxd_pkt_entry *pkt_entry)
-{
-	ssize_t ret;
-	fi_addr_t dg_addr;
-	pkt_entry->timestamp = ofi_gettime_ms();
-
-	dg_addr = (intptr_t) ofi_idx_lookup(&(rxd_ep_av(ep)->rxdaddr_dg_idx),
-					    (int)pkt_entry->peer);
-	ret = fi_send(ep->dg_ep, (const void *) rxd_pkt_start(pkt_entry),
-		      pkt_entry->pkt_size, pkt_entry->desc, dg_addr,
-		      &pkt_entry->context);
-	if (ret) {
-		FI_WARN(&rxd_prov, FI_LOG_EP_CTRL, "error sending packet: %d (%s)\n",
-			(int) ret, fi_strerror((int) -ret));
-		return ret;
+	ret = rxd_peer(ep, tx_entry->peer)->unacked_cnt >=
+	      rxd_peer_window(rxd_peer(ep, tx_entry->peer));
+out:
+	if (prev) {
+		err = rxd_ep_sendmsg_pkt(ep, prev, 0);
+		if (err)
+			ret = err;
 	}
-	pkt_entry->flags |= RXD_PKT_IN_USE;
-
-	return 0;
+	return ret;
 }
 
 static ssize_t rxd_ep_send_rts(struct rxd_ep *rxd_ep, fi_addr_t rxd_addr)
@@ -448,6 +530,7 @@ static ssize_t rxd_ep_send_rts(struct rxd_ep *rxd_ep, fi_addr_t rxd_addr)
 	rts_pkt->base_hdr.version = RXD_PROTOCOL_VERSION;
 	rts_pkt->base_hdr.type = RXD_RTS;
 	rts_pkt->rts_addr = rxd_addr;
+	rts_pkt->seg_size = (uint32_t) rxd_ep_domain(rxd_ep)->max_rx_seg_sz;
 
 	addrlen = RXD_NAME_LENGTH;
 	memset(rts_pkt->source, 0, RXD_NAME_LENGTH);
@@ -502,6 +585,8 @@ void rxd_init_sar_hdr(void **ptr, struct rxd_x_entry *tx_entry,
 	hdr->num_segs = tx_entry->num_segs;
 	hdr->tx_id = tx_entry->tx_id;
 	hdr->iov_count = (uint8_t) iov_count;
+	hdr->resv = 0;
+	hdr->seg_size = (uint16_t) tx_entry->seg_sz;
 
 	*ptr = (char *) (*ptr) + sizeof(*hdr);
 }
@@ -557,6 +642,23 @@ size_t rxd_init_msg(void **ptr, const struct iovec *iov, size_t iov_count,
 	return done;
 }
 
+static void rxd_init_sack_hdr(struct rxd_sack_hdr *sack, struct rxd_peer *peer)
+{
+	struct rxd_pkt_entry *pkt_entry;
+	uint64_t seq_no;
+
+	memset(sack, 0, sizeof(*sack));
+	dlist_foreach_container(&peer->buf_pkts, struct rxd_pkt_entry,
+				pkt_entry, d_entry) {
+		seq_no = rxd_get_base_hdr(pkt_entry)->seq_no;
+		if (ofi_after_eq(peer->rx_seq_no, seq_no))
+			continue;
+		if (seq_no - peer->rx_seq_no > RXD_SACK_BITS)
+			break;
+		rxd_sack_set(sack, seq_no - peer->rx_seq_no - 1);
+	}
+}
+
 void rxd_ep_send_ack(struct rxd_ep *rxd_ep, fi_addr_t peer)
 {
 	struct rxd_pkt_entry *pkt_entry;
@@ -577,7 +679,9 @@ void rxd_ep_send_ack(struct rxd_ep *rxd_ep, fi_addr_t peer)
 	ack->base_hdr.peer = (uint32_t) rxd_peer(rxd_ep, peer)->peer_addr;
 	ack->base_hdr.seq_no = rxd_peer(rxd_ep, peer)->rx_seq_no;
 	ack->ext_hdr.rx_id = rxd_peer(rxd_ep, peer)->rx_window;
+	rxd_init_sack_hdr(&ack->sack_hdr, rxd_peer(rxd_ep, peer));
 	rxd_peer(rxd_ep, peer)->last_tx_ack = ack->base_hdr.seq_no;
+	rxd_peer(rxd_ep, peer)->ack_pending = 0;
 
 	dlist_insert_tail(&pkt_entry->d_entry, &rxd_ep->ctrl_pkts);
 	if (rxd_ep_send_pkt(rxd_ep, pkt_entry))
@@ -604,6 +708,13 @@ static void rxd_close_peer(struct rxd_ep *ep, struct rxd_peer *peer)
 	struct rxd_pkt_entry *pkt_entry;
 	struct rxd_x_entry *x_entry;
 
+	FI_INFO(&rxd_prov, FI_LOG_EP_CTRL, "peer %" PRIu64 ": srtt %" PRIu64
+		" usec, rttvar %" PRIu64 " usec, rto %" PRIu64 " usec, cwnd %u,"
+		" ssthresh %u, losses %" PRIu64 ", timeouts %" PRIu64 "\n",
+		peer->peer_addr, peer->cc.srtt, peer->cc.rttvar, peer->cc.rto,
+		peer->cc.cwnd, peer->cc.ssthresh, peer->cc.loss_cnt,
+		peer->cc.timeout_cnt);
+
 	while (!dlist_empty(&peer->unacked)) {
 		dlist_pop_front(&peer->unacked, struct rxd_pkt_entry,
 				pkt_entry, d_entry);
@@ -611,6 +722,12 @@ static void rxd_close_peer(struct rxd_ep *ep, struct rxd_peer *peer)
 		peer->unacked_cnt--;
 	}
 
+	while (!dlist_empty(&peer->buf_pkts)) {
+		dlist_pop_front(&peer->buf_pkts, struct rxd_pkt_entry,
+				pkt_entry, d_entry);
+		ofi_buf_free(pkt_entry);
+	}
+
 	while (!dlist_empty(&peer->tx_list)) {
 		dlist_pop_front(&peer->tx_list, struct rxd_x_entry,
 				x_entry, entry);
@@ -666,6 +783,12 @@ static int rxd_ep_close(struct fid *fid)
 
 	ep = container_of(fid, struct rxd_ep, util_ep.ep_fid.fid);
 
+	if (ep->drop_cnt || ep->fast_rexmit_cnt || ep->rto_rexmit_cnt)
+		FI_INFO(&rxd_prov, FI_LOG_EP_CTRL,
+			"packets dropped: %" PRIu64 ", fast retransmits: %"
+			PRIu64 ", timeout retransmits: %" PRIu64 "\n",
+			ep->drop_cnt, ep->fast_rexmit_cnt, ep->rto_rexmit_cnt);
+
 	dlist_foreach_container(&ep->active_peers, struct rxd_peer, peer, entry)
 		rxd_close_peer(ep, peer);
 	dlist_foreach_container(&ep->rts_sent_list, struct rxd_peer, peer, entry)
@@ -914,45 +1037,70 @@ static void rxd_peer_timeout(struct rxd_ep *rxd_ep, struct rxd_peer *peer)
 	dlist_remove(&peer->entry);
 }
 
+/* Retransmit the expired packets of a peer and rearm its retry timer for
+ * the first packet that has not expired yet.
+ */
 static void rxd_progress_pkt_list(struct rxd_ep *ep, struct rxd_peer *peer)
 {
 	struct rxd_pkt_entry *pkt_entry;
-	uint64_t current;
+	uint64_t current, timeout, next;
 	ssize_t ret;
 	int retry = 0;
 
-	current = ofi_gettime_ms();
+	current = ofi_gettime_us();
+	timeout = peer->cc.rto;
 	if (peer->retry_cnt > RXD_MAX_PKT_RETRY) {
 		rxd_peer_timeout(ep, peer);
 		return;
 	}
 
+	next = current + timeout;
 	dlist_foreach_container(&peer->unacked, struct rxd_pkt_entry,
 				pkt_entry, d_entry) {
+		/* the peer already holds selectively acked packets */
+		if (pkt_entry->flags & RXD_PKT_SACKED)
+			continue;
 		if (pkt_entry->flags & (RXD_PKT_IN_USE | RXD_PKT_ACKED) ||
-		    current < rxd_get_retry_time(pkt_entry->timestamp,
-						 (uint8_t) peer->retry_cnt))
+		    current < pkt_entry->timestamp + timeout) {
+			next = pkt_entry->timestamp + timeout;
 			break;
+		}
+		if (!retry)
+			rxd_cc_timeout(peer);
 		retry = 1;
 		ret = rxd_ep_send_pkt(ep, pkt_entry);
-		if (ret)
+		if (ret) {
+			next = current;
 			break;
+		}
+		pkt_entry->flags |= RXD_PKT_RETRANS;
+		ep->rto_rexmit_cnt++;
 	}
 	if (retry)
 		peer->retry_cnt++;
 
 	if (!dlist_empty(&peer->unacked))
-		ep->next_retry = ep->next_retry == -1 ? peer->retry_cnt :
-				 MIN(ep->next_retry, peer->retry_cnt);
+		ofi_timer_arm(&ep->timer_wheel, &peer->retry_timer,
+			      next * 1000);
+}
+
+static void rxd_peer_retry(struct ofi_timer *timer)
+{
+	struct rxd_peer *peer;
+
+	peer = container_of(timer, struct rxd_peer, retry_timer);
+	rxd_progress_pkt_list(peer->ep, peer);
 }
 
 void rxd_ep_progress(struct util_ep *util_ep)
 {
 	struct rxd_peer *peer;
-	struct fi_cq_msg_entry cq_entry;
+	struct fi_cq_msg_entry cq_entry[RXD_CQ_BATCH];
 	struct dlist_entry *tmp;
 	struct rxd_ep *ep;
-	ssize_t ret;
+	uint64_t current;
+	size_t rx_cnt;
+	ssize_t ret, j;
 	int i;
 
 	ep = container_of(util_ep, struct rxd_ep, util_ep);
@@ -960,33 +1108,42 @@ void rxd_ep_progress(struct util_ep *util_ep)
 	ofi_genlock_lock(&ep->util_ep.lock);
 	for(ret = 1, i = 0;
 	    ret > 0 && (!rxd_env.spin_count || i < rxd_env.spin_count);
-	    i++) {
-		ret = fi_cq_read(ep->dg_cq, &cq_entry, 1);
+	    i += (int) ret) {
+		ret = fi_cq_read(ep->dg_cq, cq_entry, RXD_CQ_BATCH);
 		if (ret == -FI_EAGAIN)
 			break;
 
 		if (ret == -FI_EAVAIL) {
 			rxd_handle_error(ep);
-			continue;
+			break;
 		}
 
-		if (cq_entry.flags & FI_RECV)
-			rxd_handle_recv_comp(ep, &cq_entry);
-		else
-			rxd_handle_send_comp(ep, &cq_entry);
+		for (j = 0, rx_cnt = 0; j < ret; j++) {
+			if (cq_entry[j].flags & FI_RECV) {
+				rxd_handle_recv_comp(ep, &cq_entry[j]);
+				rx_cnt++;
+			} else {
+				rxd_handle_send_comp(ep, &cq_entry[j]);
+			}
+		}
+		rxd_ep_post_bufs(ep, rx_cnt);
+	}
+
+	/* ack everything received in this pass */
+	dlist_foreach_container(&ep->active_peers, struct rxd_peer, peer, entry) {
+		if (peer->ack_pending)
+			rxd_ep_send_ack(ep, peer->rxd_addr);
 	}
 
 	if (!rxd_env.retry)
 		goto out;
 
-	ep->next_retry = -1;
-	dlist_foreach_container_safe(&ep->rts_sent_list, struct rxd_peer,
-				     peer, entry, tmp)
-		rxd_progress_pkt_list(ep, peer);
+	current = ofi_gettime_ns();
+	ofi_timer_wheel_expire(&ep->timer_wheel, current);
+	ep->next_retry = ofi_timer_wheel_timeout(&ep->timer_wheel, current, -1);
 
 	dlist_foreach_container_safe(&ep->active_peers, struct rxd_peer,
 				     peer, entry, tmp) {
-		rxd_progress_pkt_list(ep, peer);
 		if (dlist_empty(&peer->unacked))
 			rxd_progress_tx_list(ep, peer);
 	}
@@ -1070,7 +1227,7 @@ static int rxd_pkt_pool_create(struct rxd_ep *ep,
 			       enum rxd_pool_type type)
 {
 	struct ofi_bufpool_attr attr = {
-		.size		= rxd_ep_domain(ep)->max_mtu_sz +
+		.size		= rxd_ep_domain(ep)->seg_mtu_sz +
 				  sizeof(struct rxd_pkt_entry),
 		.alignment	= RXD_BUF_POOL_ALIGNMENT,
 		.max_cnt	= 0,
@@ -1108,14 +1265,17 @@ static int rxd_entry_pool_create(struct rxd_ep *ep,
 
 int rxd_ep_init_res(struct rxd_ep *ep, struct fi_info *fi_info)
 {
+	size_t scale;
 	int ret;
 
-	ret = rxd_pkt_pool_create(ep, RXD_TX_POOL_CHUNK_CNT,
+	/* keep the pool chunks the same size when using large segments */
+	scale = ofi_div_ceil(rxd_ep_domain(ep)->seg_mtu_sz, RXD_MAX_MTU_SIZE);
+	ret = rxd_pkt_pool_create(ep, RXD_TX_POOL_CHUNK_CNT / scale,
 				  &ep->tx_pkt_pool, RXD_BUF_POOL_TX);
 	if (ret)
 		goto err;
 
-	ret = rxd_pkt_pool_create(ep, RXD_RX_POOL_CHUNK_CNT,
+	ret = rxd_pkt_pool_create(ep, RXD_RX_POOL_CHUNK_CNT / scale,
 				  &ep->rx_pkt_pool, RXD_BUF_POOL_RX);
 	if (ret)
 		goto err;
@@ -1155,6 +1315,8 @@ int rxd_create_peer(struct rxd_ep *ep, uint64_t rxd_addr)
 	if (!peer)
 		return -FI_ENOMEM;
 
+	peer->ep = ep;
+	peer->rxd_addr = rxd_addr;
 	peer->peer_addr = RXD_ADDR_INVALID;
 	peer->tx_seq_no = 0;
 	peer->rx_seq_no = 0;
@@ -1164,7 +1326,13 @@ int rxd_create_peer(struct rxd_ep *ep, uint64_t rxd_addr)
 	peer->tx_window = (uint16_t) rxd_env.max_unacked;
 	peer->unacked_cnt = 0;
 	peer->retry_cnt = 0;
+	peer->dup_ack_cnt = 0;
+	peer->fast_rexmit = 0;
+	peer->ack_pending = 0;
+	peer->tx_seg_sz = (uint32_t) rxd_ep_domain(ep)->max_seg_sz;
 	peer->active = 0;
+	rxd_cc_init(peer);
+	ofi_timer_init(&peer->retry_timer, rxd_peer_retry);
 	dlist_init(&(peer->unacked));
 	dlist_init(&(peer->tx_list));
 	dlist_init(&(peer->rx_list));
@@ -1226,6 +1394,9 @@ int rxd_endpoint(struct fid_domain *domain, struct fi_info *info,
 	fi_freeinfo(dg_info);
 
 	rxd_ep->next_retry = -1;
+	ofi_timer_wheel_init(&rxd_ep->timer_wheel, RXD_TIMER_TICK,
+			     ofi_gettime_ns());
+	rxd_ep->drop_seed = ofi_generate_seed() | 1;
 	ret = rxd_ep_init_res(rxd_ep, info);
 	if (ret)
 		goto err3;
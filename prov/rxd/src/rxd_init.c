@@ -44,6 +44,10 @@ struct rxd_env rxd_env = {
 	.max_peers	= 1024,
 	.max_unacked	= 128,
 	.rescan		= -1,
+	.cc		= 1,
+	.init_cwnd	= 16,
+	.min_rto	= 1000,
+	.seg_size	= RXD_MAX_SEG_SIZE,
 };
 
 char *rxd_pkt_type_str[] = {
@@ -52,11 +56,39 @@ char *rxd_pkt_type_str[] = {
 
 static void rxd_init_env(void)
 {
+	char *drop_rate = NULL;
+
 	fi_param_get_int(&rxd_prov, "spin_count", &rxd_env.spin_count);
 	fi_param_get_bool(&rxd_prov, "retry", &rxd_env.retry);
 	fi_param_get_int(&rxd_prov, "max_peers", &rxd_env.max_peers);
 	fi_param_get_int(&rxd_prov, "max_unacked", &rxd_env.max_unacked);
 	fi_param_get_bool(&rxd_prov, "rescan", &rxd_env.rescan);
+	fi_param_get_bool(&rxd_prov, "cc", &rxd_env.cc);
+	fi_param_get_int(&rxd_prov, "init_cwnd", &rxd_env.init_cwnd);
+	fi_param_get_int(&rxd_prov, "min_rto", &rxd_env.min_rto);
+	if (rxd_env.min_rto <= 0) {
+		FI_WARN(&rxd_prov, FI_LOG_CORE,
+			"invalid min_rto %d, using 1000 usec\n",
+			rxd_env.min_rto);
+		rxd_env.min_rto = 1000;
+	}
+	fi_param_get_int(&rxd_prov, "seg_size", &rxd_env.seg_size);
+	if (rxd_env.seg_size <= 0 || rxd_env.seg_size > RXD_MAX_SEG_SIZE) {
+		FI_WARN(&rxd_prov, FI_LOG_CORE,
+			"invalid seg_size %d, using %d\n",
+			rxd_env.seg_size, RXD_MAX_SEG_SIZE);
+		rxd_env.seg_size = RXD_MAX_SEG_SIZE;
+	}
+
+	fi_param_get_str(&rxd_prov, "drop_rate", &drop_rate);
+	if (drop_rate) {
+		rxd_env.drop_rate = strtod(drop_rate, NULL);
+		if (rxd_env.drop_rate < 0 || rxd_env.drop_rate > 1) {
+			FI_WARN(&rxd_prov, FI_LOG_CORE,
+				"invalid drop_rate %s, disabling\n", drop_rate);
+			rxd_env.drop_rate = 0;
+		}
+	}
 }
 
 void rxd_info_to_core_mr_modes(uint32_t version, const struct fi_info *hints,
@@ -157,6 +189,25 @@ RXD_INI
 			"Force or disable rescanning for network interface changes. "
 			"Setting this to true will force rescanning on each fi_getinfo() invocation; "
 			"setting it to false will disable rescanning. (default: unset)");
+	fi_param_define(&rxd_prov, "drop_rate", FI_PARAM_STRING,
+			"Fraction of received packets to drop, used to test "
+			"retransmission over lossy networks (e.g. 0.01). "
+			"(default: 0)");
+	fi_param_define(&rxd_prov, "cc", FI_PARAM_BOOL,
+			"Toggle per-peer congestion control. When disabled, "
+			"the send window is only limited by the receiver "
+			"(default: yes)");
+	fi_param_define(&rxd_prov, "init_cwnd", FI_PARAM_INT,
+			"Initial congestion window in packets (default: 16)");
+	fi_param_define(&rxd_prov, "min_rto", FI_PARAM_INT,
+			"Minimum margin in microseconds added to the measured "
+			"round trip time to form the retransmission timeout "
+			"(default: 1000)");
+	fi_param_define(&rxd_prov, "seg_size", FI_PARAM_INT,
+			"Maximum datagram size, including headers, used for "
+			"data segments. The size is negotiated with each peer "
+			"and limited by the core provider's maximum message "
+			"size (default: 65536)");
 
 	rxd_init_env();
 
@@ -331,7 +331,7 @@ static struct rxd_x_entry *rxd_tx_entry_init_msg(struct rxd_ep *ep, fi_addr_t ad
 	if (tx_entry->cq_entry.len > max_inline) {
 		max_inline -= sizeof(struct rxd_sar_hdr);
 		tx_entry->num_segs = ofi_div_ceil(tx_entry->cq_entry.len - max_inline,
-						  rxd_domain->max_seg_sz) + 1;
+						  tx_entry->seg_sz) + 1;
 		rxd_init_sar_hdr(&ptr, tx_entry, 0);
 	} else {
 		tx_entry->flags |= RXD_INLINE;
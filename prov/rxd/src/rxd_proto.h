@@ -100,31 +100,49 @@ struct rxd_ext_hdr {
  * Ready to send: initialize peer communication and exchange addressing info
  * 	- rts_addr: local address for peer sending RTS
  * 	- source: name of transmitting endpoint for peer to add to AV
+ * 	- seg_size: largest data segment payload the sender can receive
  */
 struct rxd_rts_pkt {
 	struct rxd_base_hdr	base_hdr;
 	uint64_t		rts_addr;
 	uint8_t			source[RXD_NAME_LENGTH];
+	uint32_t		seg_size;
 };
 
 /*
  * Clear to send: response to RTS request
  * 	- rts_addr: peer address packet is responding to
  * 	- cts_addr: local address for peer
+ * 	- seg_size: largest data segment payload the sender can receive
  */
 struct rxd_cts_pkt {
 	struct	rxd_base_hdr	base_hdr;
 	uint64_t		rts_addr;
 	uint64_t		cts_addr;
+	uint32_t		seg_size;
+};
+
+/*
+ * Selective ack header: reports packets received past the first gap
+ * 	- bitmap: bit i is set if seq_no + 1 + i (base_hdr->seq_no of the
+ * 		  ACK) has been received and buffered by the peer
+ */
+#define RXD_SACK_BITS		128
+
+struct rxd_sack_hdr {
+	uint64_t	bitmap[RXD_SACK_BITS / 64];
 };
 
 /*
  * ACK: to signal received packets and send tx/rx id info
+ * 	- base_hdr->seq_no: next in-order sequence number expected
+ * 	- ext_hdr->rx_id: receive window
+ * 	- sack_hdr: out of order packets already received
  */
 struct rxd_ack_pkt {
 	struct rxd_base_hdr	base_hdr;
 	struct rxd_ext_hdr	ext_hdr;
-	//TODO fill in more fields? Selective ack?
+	struct rxd_sack_hdr	sack_hdr;
 };
 
 /*
@@ -149,6 +167,8 @@ struct rxd_data_pkt {
  * 	- signaled by base_hdr->flags & RXD_REMOTE_CQ_DATA
  * sar_hdr: for all messages requiring more than one packet
  * 	- lack of the sar_hdr is signaled by base_hdr->flags & RXD_INLINE
+ * 	- seg_size: payload of each data packet of the transfer (for read
+ * 	  requests, of the data packets returned by the peer)
  * rma_hdr: for FI_RMA and FI_ATOMIC operations
  * 	- signaled by base_hdr->type = RXD_READ_REQ, RXD_WRITE, RXD_ATOMIC,
  * 	  RXD_ATOMIC_FETCH, and RXD_ATOMIC_COMPARE
@@ -164,7 +184,8 @@ struct rxd_sar_hdr {
 	uint64_t		num_segs;
 	uint32_t		tx_id;
 	uint8_t			iov_count;
-	uint8_t			resv[3];
+	uint8_t			resv;
+	uint16_t		seg_size;
 };
 
 struct rxd_tag_hdr {
@@ -54,7 +54,7 @@ static struct rxd_x_entry *rxd_tx_entry_init_rma(struct rxd_ep *ep, fi_addr_t ad
 
 	if (tx_entry->cq_entry.flags & FI_READ) {
 		tx_entry->num_segs = ofi_div_ceil(tx_entry->cq_entry.len,
-						  rxd_domain->max_seg_sz);
+						  tx_entry->seg_sz);
 		rxd_init_sar_hdr(&ptr, tx_entry, rma_count);
 		rxd_init_rma_hdr(&ptr, rma_iov, rma_count);
 	} else {
@@ -65,7 +65,7 @@ static struct rxd_x_entry *rxd_tx_entry_init_rma(struct rxd_ep *ep, fi_addr_t ad
 		if (rma_count > 1 || tx_entry->cq_entry.len > max_inline) {
 			max_inline -= sizeof(struct rxd_sar_hdr);
 			tx_entry->num_segs = ofi_div_ceil(tx_entry->cq_entry.len -
-				max_inline, rxd_domain->max_seg_sz) + 1;
+				max_inline, tx_entry->seg_sz) + 1;
 			rxd_init_sar_hdr(&ptr, tx_entry, rma_count);
 		} else {
 			tx_entry->flags |= RXD_INLINE;
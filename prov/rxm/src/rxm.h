@@ -85,7 +85,7 @@ union rxm_cm_data {
 		uint8_t op_version;
 		uint16_t port;
 		uint8_t flow_ctrl;
-		uint8_t padding;
+		uint8_t rail;
 		uint32_t eager_limit;
 		uint32_t rx_size; /* used? */
 		uint64_t client_conn_id;
@@ -202,6 +202,8 @@ extern size_t rxm_msg_tx_size;
 extern size_t rxm_msg_rx_size;
 extern size_t rxm_cm_progress_interval;
 extern size_t rxm_cq_eq_fairness;
+extern size_t rxm_rndv_rails;
+extern size_t rxm_rail_min_size;
 extern int rxm_passthru;
 extern int force_auto_progress;
 extern int rxm_use_write_rndv;
@@ -223,6 +225,20 @@ enum {
 	RXM_CONN_INDEXED = BIT(0),
 };
 
+#define RXM_MAX_RAILS	4
+
+/* A rail is an additional msg ep connected to the same peer, used only
+ * to carry rendezvous RMA.  Rail 0 is the connection's primary msg_ep,
+ * which is not duplicated here; its entry only tracks bandwidth.
+ * Bandwidth is kept as an estimate in bytes per microsecond.
+ */
+struct rxm_rail {
+	struct fid_ep *msg_ep;
+	enum rxm_cm_state state;
+	uint64_t bw;
+	uint64_t bytes;
+};
+
 /* Each local rxm ep will have at most 1 connection to a single
  * remote rxm ep.  A local rxm ep may not be connected to all
  * remote rxm ep's.
@@ -249,8 +265,15 @@ struct rxm_conn {
 	struct dlist_entry deferred_sar_msgs;
 	struct dlist_entry deferred_sar_segments;
 	struct dlist_entry loopback_entry;
+
+	struct rxm_rail rails[RXM_MAX_RAILS];
 };
 
+static inline bool rxm_rail_connected(struct rxm_conn *conn, size_t rail)
+{
+	return rail && conn->rails[rail].state == RXM_CM_CONNECTED;
+}
+
 void rxm_freeall_conns(struct rxm_ep *ep);
 
 struct rxm_fabric {
@@ -394,7 +417,8 @@ struct rxm_atomic_resp_hdr {
 	FUNC(RXM_RNDV_FINISH), /* not needed */	\
 	FUNC(RXM_ATOMIC_RESP_WAIT),	\
 	FUNC(RXM_ATOMIC_RESP_SENT),	\
-	FUNC(RXM_RNDV_WRITE_TX_WAIT)
+	FUNC(RXM_RNDV_WRITE_TX_WAIT),	\
+	FUNC(RXM_RNDV_RAIL_XFER)
 
 enum rxm_proto_state {
 	RXM_PROTO_STATES(OFI_ENUM_VAL)
@@ -498,6 +522,7 @@ struct rxm_rx_buf {
 	struct dlist_entry rndv_wait_entry;
 	struct rxm_rndv_hdr *remote_rndv_hdr;
 	size_t rndv_rma_index;
+	size_t rndv_rma_count;
 	struct fid_mr *mr[RXM_IOV_LIMIT];
 
 	/* Only differs from pkt.data for unexpected messages */
@@ -536,6 +561,24 @@ struct rxm_tx_buf {
 	struct rxm_pkt pkt;
 };
 
+/* Context for a piece of a rendezvous RMA striped across rails.  The
+ * owning rx_buf (read) or tx_buf (write) is completed once all of its
+ * pieces have completed.  The piece is kept so that it can be posted
+ * again if its rail fails.
+ */
+struct rxm_rail_xfer {
+	/* Must stay at top */
+	struct rxm_buf hdr;
+
+	struct rxm_conn *conn;
+	struct rxm_rail *rail;
+	void *buf;
+	struct fi_rma_iov rma_iov;
+	struct rxm_iov rxm_iov;
+	uint64_t start;
+	bool retried;
+};
+
 struct rxm_coll_buf {
 	/* Must stay at top */
 	struct rxm_buf hdr;
@@ -581,11 +624,15 @@ struct rxm_deferred_tx_entry {
 			struct rxm_rx_buf *rx_buf;
 			struct fi_rma_iov rma_iov;
 			struct rxm_iov rxm_iov;
+			void *context;
+			size_t rail;
 		} rndv_read;
 		struct {
 			struct rxm_tx_buf *tx_buf;
 			struct fi_rma_iov rma_iov;
 			struct rxm_iov rxm_iov;
+			void *context;
+			size_t rail;
 		} rndv_write;
 		struct {
 			struct rxm_tx_buf *cur_seg_tx_buf;
@@ -630,10 +677,14 @@ struct rxm_rndv_ops {
 	ssize_t (*xfer)(struct fid_ep *ep, const struct iovec *iov, void **desc,
 			size_t count, fi_addr_t remote_addr, uint64_t addr,
 			uint64_t key, void *context);
+	/* Used on rails other than the primary msg ep */
+	ssize_t (*rail_xfer)(struct fid_ep *ep, const struct iovec *iov,
+			     void **desc, size_t count, fi_addr_t remote_addr,
+			     uint64_t addr, uint64_t key, void *context);
 	ssize_t (*defer_xfer)(struct rxm_deferred_tx_entry **def_tx_entry,
-			      size_t index, struct iovec *iov,
+			      struct fi_rma_iov *rma_iov, struct iovec *iov,
 			      void *desc[RXM_IOV_LIMIT], size_t count,
-			      void *buf);
+			      void *buf, void *context, size_t rail);
 };
 
 struct rxm_ep {
@@ -684,6 +735,8 @@ struct rxm_ep {
 	struct ofi_bufpool	*tx_pool;
 	struct ofi_bufpool	*coll_pool;
 	struct ofi_bufpool	*proto_info_pool;
+	struct ofi_bufpool	*rail_xfer_pool;
+	size_t			rails;
 
 	struct rxm_pkt		*inject_pkt;
 
@@ -807,6 +860,23 @@ rxm_atomic_send_respmsg(struct rxm_ep *rxm_ep, struct rxm_conn *conn,
 void rxm_ep_progress_deferred_queue(struct rxm_ep *rxm_ep,
 				    struct rxm_conn *rxm_conn);
 
+/* Falls back to the primary msg_ep if the rail has since been closed */
+static inline ssize_t
+rxm_rndv_rail_xfer(struct rxm_ep *rxm_ep, struct rxm_conn *conn, size_t rail,
+		   const struct iovec *iov, void **desc, size_t count,
+		   fi_addr_t remote_addr, uint64_t addr, uint64_t key,
+		   void *context)
+{
+	if (rxm_rail_connected(conn, rail))
+		return rxm_ep->rndv_ops->rail_xfer(conn->rails[rail].msg_ep,
+						   iov, desc, count,
+						   remote_addr, addr, key,
+						   context);
+
+	return rxm_ep->rndv_ops->xfer(conn->msg_ep, iov, desc, count,
+				      remote_addr, addr, key, context);
+}
+
 struct rxm_deferred_tx_entry *
 rxm_ep_alloc_deferred_tx_entry(struct rxm_ep *rxm_ep, struct rxm_conn *rxm_conn,
 			       enum rxm_deferred_tx_entry_type type);
@@ -52,11 +52,31 @@ struct rxm_eq_cm_entry {
 };
 
 
+static void rxm_close_rail(struct rxm_conn *conn, size_t rail)
+{
+	FI_DBG(&rxm_prov, FI_LOG_EP_CTRL, "closing conn %p rail %zu\n",
+	       conn, rail);
+
+	assert(rail && rail < RXM_MAX_RAILS);
+	if (!conn->rails[rail].msg_ep)
+		return;
+
+	fi_close(&conn->rails[rail].msg_ep->fid);
+	conn->rails[rail].msg_ep = NULL;
+
+	if (conn->rails[rail].state == RXM_CM_CONNECTING ||
+	    conn->rails[rail].state == RXM_CM_ACCEPTING)
+		conn->ep->connecting_cnt--;
+	assert(conn->ep->connecting_cnt >= 0);
+	conn->rails[rail].state = RXM_CM_IDLE;
+}
+
 static void rxm_close_conn(struct rxm_conn *conn)
 {
 	struct rxm_deferred_tx_entry *tx_entry;
 	struct fi_peer_rx_entry *rx_entry;
 	struct rxm_rx_buf *buf;
+	size_t i;
 
 	FI_DBG(&rxm_prov, FI_LOG_EP_CTRL, "closing conn %p\n", conn);
 
@@ -79,6 +99,8 @@ static void rxm_close_conn(struct rxm_conn *conn)
 		rx_entry = (struct fi_peer_rx_entry*)conn->deferred_sar_msgs.next;
 		rx_entry->srx->owner_ops->free_entry(rx_entry);
 	}
+	for (i = 1; i < RXM_MAX_RAILS; i++)
+		rxm_close_rail(conn, i);
 	fi_close(&conn->msg_ep->fid);
 	rxm_flush_msg_cq(conn->ep);
 	dlist_remove_init(&conn->loopback_entry);
@@ -225,6 +247,67 @@ err:
 	return ret;
 }
 
+/* Rails only carry RMA issued by either side, so no receive buffers
+ * are posted to them.
+ */
+static int rxm_open_rail(struct rxm_conn *conn, size_t rail,
+			 struct fi_info *msg_info)
+{
+	struct rxm_domain *domain;
+	struct rxm_ep *ep;
+	struct fid_ep *msg_ep;
+	int ret;
+
+	FI_DBG(&rxm_prov, FI_LOG_EP_CTRL, "open msg ep %p rail %zu\n",
+	       conn, rail);
+
+	assert(ofi_genlock_held(&conn->ep->util_ep.lock));
+	ep = conn->ep;
+	domain = container_of(ep->util_ep.domain, struct rxm_domain,
+			      util_domain);
+	ret = fi_endpoint(domain->msg_domain, msg_info, &msg_ep, conn);
+	if (ret) {
+		RXM_WARN_ERR(FI_LOG_EP_CTRL, "fi_endpoint", ret);
+		return ret;
+	}
+
+	ret = fi_ep_bind(msg_ep, &ep->msg_eq->fid, 0);
+	if (ret) {
+		RXM_WARN_ERR(FI_LOG_EP_CTRL, "fi_ep_bind", ret);
+		goto err;
+	}
+
+	ret = rxm_bind_comp(ep, msg_ep);
+	if (ret)
+		goto err;
+
+	ret = fi_enable(msg_ep);
+	if (ret) {
+		RXM_WARN_ERR(FI_LOG_EP_CTRL, "fi_enable", ret);
+		goto err;
+	}
+
+	conn->rails[rail].msg_ep = msg_ep;
+	conn->rails[rail].bw = conn->rails[0].bw;
+	conn->rails[rail].bytes = 0;
+	return 0;
+err:
+	fi_close(&msg_ep->fid);
+	return ret;
+}
+
+/* Map a CM event's fid back to the rail it was reported on. */
+static size_t rxm_conn_rail(struct rxm_conn *conn, fid_t fid)
+{
+	size_t i;
+
+	for (i = 1; i < RXM_MAX_RAILS; i++) {
+		if (conn->rails[i].msg_ep && &conn->rails[i].msg_ep->fid == fid)
+			return i;
+	}
+	return 0;
+}
+
 /* We send passive endpoint's port to the server as connection request
  * would be from a different one.
  */
@@ -304,6 +387,72 @@ err:
 	return ret;
 }
 
+static int rxm_send_rail_connect(struct rxm_conn *conn, size_t rail)
+{
+	union rxm_cm_data cm_data;
+	struct fi_info *info;
+	int ret;
+
+	FI_DBG(&rxm_prov, FI_LOG_EP_CTRL, "connecting %p rail %zu\n",
+	       conn, rail);
+	assert(ofi_genlock_held(&conn->ep->util_ep.lock));
+
+	info = conn->ep->msg_info;
+	info->dest_addrlen = conn->ep->msg_info->src_addrlen;
+
+	free(info->dest_addr);
+	info->dest_addr = mem_dup(&conn->peer->addr, info->dest_addrlen);
+	if (!info->dest_addr)
+		return -FI_ENOMEM;
+
+	ret = rxm_open_rail(conn, rail, info);
+	if (ret)
+		return ret;
+
+	ret = rxm_init_connect_data(conn, &cm_data);
+	if (ret)
+		goto err;
+
+	cm_data.connect.rail = (uint8_t) rail;
+	ret = fi_connect(conn->rails[rail].msg_ep, info->dest_addr, &cm_data,
+			 sizeof(cm_data));
+	if (ret) {
+		RXM_WARN_ERR(FI_LOG_EP_CTRL, "fi_connect", ret);
+		goto err;
+	}
+	conn->rails[rail].state = RXM_CM_CONNECTING;
+	conn->ep->connecting_cnt++;
+	return 0;
+
+err:
+	fi_close(&conn->rails[rail].msg_ep->fid);
+	conn->rails[rail].msg_ep = NULL;
+	return ret;
+}
+
+/* Rails are opened by the side that initiated the primary connection,
+ * once that connection is established.  A rail that fails to connect
+ * is simply left idle; the primary msg_ep is always usable.
+ */
+static void rxm_connect_rails(struct rxm_conn *conn)
+{
+	size_t i;
+	int ret;
+
+	for (i = 1; i < conn->ep->rails; i++) {
+		if (conn->rails[i].state != RXM_CM_IDLE)
+			continue;
+
+		ret = rxm_send_rail_connect(conn, i);
+		if (ret) {
+			FI_INFO(&rxm_prov, FI_LOG_EP_CTRL,
+				"unable to connect rail %zu: %s (%d)\n", i,
+				fi_strerror(-ret), ret);
+			break;
+		}
+	}
+}
+
 static int rxm_connect(struct rxm_conn *conn)
 {
 	int ret;
@@ -406,6 +555,8 @@ rxm_alloc_conn(struct rxm_ep *ep, struct util_peer_addr *peer)
 	dlist_init(&conn->deferred_sar_msgs);
 	dlist_init(&conn->deferred_sar_segments);
 	dlist_init(&conn->loopback_entry);
+	memset(conn->rails, 0, sizeof(conn->rails));
+	conn->rails[0].bw = 1;
 
 	conn->peer = peer;
 	rxm_ref_peer(peer);
@@ -495,17 +646,38 @@ static void rxm_set_peer_flow_ctrl(struct rxm_conn *conn, int cm_flow_ctrl_flag)
 	}
 }
 
+static void rxm_process_rail_connect(struct rxm_conn *conn, size_t rail)
+{
+	FI_DBG(&rxm_prov, FI_LOG_EP_CTRL,
+	       "processing connected for handle: %p rail %zu\n", conn, rail);
+
+	assert(conn->rails[rail].state == RXM_CM_CONNECTING ||
+	       conn->rails[rail].state == RXM_CM_ACCEPTING);
+	conn->ep->connecting_cnt--;
+	assert(conn->ep->connecting_cnt >= 0);
+	conn->rails[rail].state = RXM_CM_CONNECTED;
+}
+
 void rxm_process_connect(struct rxm_eq_cm_entry *cm_entry)
 {
 	struct rxm_conn *conn;
 	struct rxm_domain *domain;
+	size_t rail;
+	bool initiator;
 
 	conn = cm_entry->fid->context;
+	assert(ofi_genlock_held(&conn->ep->util_ep.lock));
+	rail = rxm_conn_rail(conn, cm_entry->fid);
+	if (rail) {
+		rxm_process_rail_connect(conn, rail);
+		return;
+	}
+
 	FI_DBG(&rxm_prov, FI_LOG_EP_CTRL,
 	       "processing connected for handle: %p\n", conn);
 
-	assert(ofi_genlock_held(&conn->ep->util_ep.lock));
-	if (conn->state == RXM_CM_CONNECTING) {
+	initiator = (conn->state == RXM_CM_CONNECTING);
+	if (initiator) {
 		conn->remote_index = rxm_peer_index(cm_entry->data.accept.
 						    server_conn_id);
 		conn->remote_pid = rxm_peer_pid(cm_entry->data.accept.
@@ -523,6 +695,10 @@ void rxm_process_connect(struct rxm_eq_cm_entry *cm_entry)
 	conn->ep->connecting_cnt--;
 	assert(conn->ep->connecting_cnt >= 0);
 	conn->state = RXM_CM_CONNECTED;
+
+	if (initiator && conn->ep->rails > 1 &&
+	    ofi_addr_cmp(&rxm_prov, &conn->peer->addr.sa, &conn->ep->addr.sa))
+		rxm_connect_rails(conn);
 }
 
 /* For simultaneous connection requests, if the peer won the coin
@@ -533,11 +709,18 @@ rxm_process_reject(struct rxm_conn *conn, struct fi_eq_err_entry *entry)
 {
 	union rxm_cm_data *cm_data;
 	uint8_t reason;
+	size_t rail;
 
 	FI_INFO(&rxm_prov, FI_LOG_EP_CTRL,
 	       "Processing reject for handle: %p\n", conn);
 	assert(ofi_genlock_held(&conn->ep->util_ep.lock));
 
+	rail = rxm_conn_rail(conn, entry->fid);
+	if (rail) {
+		rxm_close_rail(conn, rail);
+		return;
+	}
+
 	if (entry->err_data_size >= sizeof(cm_data->reject)) {
 		cm_data = entry->err_data;
 		if (cm_data->reject.version != RXM_CM_DATA_VERSION) {
@@ -621,7 +804,8 @@ rxm_reject_connreq(struct rxm_ep *ep, struct rxm_eq_cm_entry *cm_entry,
 }
 
 static int
-rxm_accept_connreq(struct rxm_conn *conn, struct rxm_eq_cm_entry *cm_entry)
+rxm_accept_connreq(struct rxm_conn *conn, struct fid_ep *msg_ep,
+		   struct rxm_eq_cm_entry *cm_entry)
 {
 	union rxm_cm_data cm_data;
 	int ret;
@@ -634,12 +818,66 @@ rxm_accept_connreq(struct rxm_conn *conn, struct rxm_eq_cm_entry *cm_entry)
 	cm_data.accept.align_pad[1] = 0;
 	cm_data.accept.align_pad[2] = 0;
 
-	ret = fi_accept(conn->msg_ep, &cm_data.accept, sizeof(cm_data.accept));
+	ret = fi_accept(msg_ep, &cm_data.accept, sizeof(cm_data.accept));
 	if (ret)
 		RXM_WARN_ERR(FI_LOG_EP_CTRL, "fi_accept", ret);
 	return ret;
 }
 
+/* A rail request is only accepted on top of an existing connection from
+ * the same peer process.  It never replaces the primary connection.
+ */
+static int
+rxm_process_rail_connreq(struct rxm_ep *ep, struct util_peer_addr *peer,
+			 struct rxm_eq_cm_entry *cm_entry)
+{
+	struct rxm_conn *conn;
+	size_t rail;
+	int ret;
+
+	rail = cm_entry->data.connect.rail;
+	if (rail >= RXM_MAX_RAILS) {
+		FI_WARN(&rxm_prov, FI_LOG_EP_CTRL, "invalid rail %zu\n", rail);
+		return -FI_EINVAL;
+	}
+
+	/* Loopback connections do not use rails */
+	if (!ofi_addr_cmp(&rxm_prov, &peer->addr.sa, &ep->addr.sa))
+		return -FI_ECONNREFUSED;
+
+	conn = ofi_idm_lookup(&ep->conn_idx_map, peer->index);
+	if (!conn || (conn->state != RXM_CM_ACCEPTING &&
+		      conn->state != RXM_CM_CONNECTED) ||
+	    conn->remote_pid != rxm_peer_pid(cm_entry->data.connect.
+					     client_conn_id)) {
+		FI_INFO(&rxm_prov, FI_LOG_EP_CTRL,
+			"no connection for rail %zu request\n", rail);
+		return -FI_ECONNREFUSED;
+	}
+
+	FI_INFO(&rxm_prov, FI_LOG_EP_CTRL, "connreq for %p rail %zu\n",
+		conn, rail);
+	if (conn->rails[rail].state != RXM_CM_IDLE) {
+		FI_INFO(&rxm_prov, FI_LOG_EP_CTRL,
+			"old rail exists, replacing %p rail %zu\n", conn, rail);
+		rxm_close_rail(conn, rail);
+	}
+
+	ret = rxm_open_rail(conn, rail, cm_entry->info);
+	if (ret)
+		return ret;
+
+	ret = rxm_accept_connreq(conn, conn->rails[rail].msg_ep, cm_entry);
+	if (ret) {
+		rxm_close_rail(conn, rail);
+		return ret;
+	}
+
+	conn->rails[rail].state = RXM_CM_ACCEPTING;
+	conn->ep->connecting_cnt++;
+	return 0;
+}
+
 static void
 rxm_process_connreq(struct rxm_ep *ep, struct rxm_eq_cm_entry *cm_entry)
 {
@@ -665,6 +903,12 @@ rxm_process_connreq(struct rxm_ep *ep, struct rxm_eq_cm_entry *cm_entry)
 		goto reject;
 	}
 
+	if (cm_entry->data.connect.rail) {
+		if (rxm_process_rail_connreq(ep, peer, cm_entry))
+			goto remove;
+		goto put;
+	}
+
 	conn = rxm_add_conn(ep, peer);
 	if (!conn)
 		goto remove;
@@ -729,7 +973,7 @@ rxm_process_connreq(struct rxm_ep *ep, struct rxm_eq_cm_entry *cm_entry)
 
 	rxm_set_peer_flow_ctrl(conn, cm_entry->data.connect.flow_ctrl);
 
-	ret = rxm_accept_connreq(conn, cm_entry);
+	ret = rxm_accept_connreq(conn, conn->msg_ep, cm_entry);
 	if (ret)
 		goto close;
 
@@ -751,6 +995,13 @@ reject:
 	fi_freeinfo(cm_entry->info);
 }
 
+static void rxm_process_rail_shutdown(struct rxm_conn *conn, size_t rail)
+{
+	FI_INFO(&rxm_prov, FI_LOG_EP_CTRL, "shutdown conn %p rail %zu\n",
+		conn, rail);
+	rxm_close_rail(conn, rail);
+}
+
 void rxm_process_shutdown(struct rxm_conn *conn)
 {
 	assert(ofi_genlock_held(&conn->ep->util_ep.lock));
@@ -772,6 +1023,18 @@ void rxm_process_shutdown(struct rxm_conn *conn)
 	}
 }
 
+static void rxm_handle_shutdown(fid_t fid)
+{
+	struct rxm_conn *conn = fid->context;
+	size_t rail;
+
+	rail = rxm_conn_rail(conn, fid);
+	if (rail)
+		rxm_process_rail_shutdown(conn, rail);
+	else
+		rxm_process_shutdown(conn);
+}
+
 static void rxm_handle_error(struct rxm_ep *ep)
 {
 	struct fi_eq_err_entry entry = {0};
@@ -807,7 +1070,7 @@ static void rxm_handle_error(struct rxm_ep *ep)
 	if (entry.err == ECONNREFUSED) {
 		rxm_process_reject(entry.fid->context, &entry);
 	} else {
-		rxm_process_shutdown(entry.fid->context);
+		rxm_handle_shutdown(entry.fid);
 	}
 }
 
@@ -826,7 +1089,7 @@ rxm_handle_event(struct rxm_ep *ep, uint32_t event,
 		rxm_process_connect(cm_entry);
 		break;
 	case FI_SHUTDOWN:
-		rxm_process_shutdown(cm_entry->fid->context);
+		rxm_handle_shutdown(cm_entry->fid);
 		break;
 	default:
 		FI_WARN(&rxm_prov, FI_LOG_EP_CTRL,
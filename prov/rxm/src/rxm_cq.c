@@ -207,6 +207,26 @@ release:
 	rxm_free_rx_buf(rx_buf);
 }
 
+/*
+ * Sends posted by util_coll with FI_PEER_TRANSFER complete to it, not to
+ * the application CQ, whatever protocol carried them.
+ */
+static bool rxm_coll_tx_comp(struct rxm_ep *rxm_ep, uint64_t tag,
+			     void *app_context)
+{
+	struct fi_cq_tagged_entry cqe = {
+		.tag = tag,
+		.op_context = app_context,
+	};
+
+	if (!rxm_ep->util_coll_ep || !(tag & RXM_PEER_XFER_TAG_FLAG))
+		return false;
+
+	rxm_ep->util_coll_peer_xfer_ops->complete(rxm_ep->util_coll_ep,
+						  &cqe, 0);
+	return true;
+}
+
 static void
 rxm_cq_write_tx_comp(struct rxm_ep *rxm_ep, uint64_t comp_flags,
 		     void *app_context,  uint64_t flags)
@@ -276,15 +296,19 @@ static void rxm_handle_sar_comp(struct rxm_ep *rxm_ep,
 				struct rxm_tx_buf *tx_buf)
 {
 	void *app_context;
-	uint64_t comp_flags, tx_flags;
+	uint64_t comp_flags, tx_flags, tag;
 
 	app_context = tx_buf->app_context;
 	comp_flags = ofi_tx_cq_flags(tx_buf->pkt.hdr.op);
 	tx_flags = tx_buf->flags;
+	tag = tx_buf->pkt.hdr.tag;
 
 	if (!rxm_complete_sar(rxm_ep, tx_buf))
 		return;
 
+	if (rxm_coll_tx_comp(rxm_ep, tag, app_context))
+		return;
+
 	rxm_cq_write_tx_comp(rxm_ep, comp_flags, app_context, tx_flags);
 	ofi_ep_peer_tx_cntr_inc(&rxm_ep->util_ep, ofi_op_msg);
 }
@@ -316,8 +340,11 @@ static void rxm_rndv_tx_finish(struct rxm_ep *rxm_ep,
 	if (!rxm_ep->rdm_mr_local)
 		rxm_msg_mr_closev(tx_buf->rma.mr, tx_buf->rma.count);
 
-	rxm_cq_write_tx_comp(rxm_ep, ofi_tx_cq_flags(tx_buf->pkt.hdr.op),
-			     tx_buf->app_context, tx_buf->flags);
+	if (!rxm_coll_tx_comp(rxm_ep, tx_buf->pkt.hdr.tag,
+			      tx_buf->app_context))
+		rxm_cq_write_tx_comp(rxm_ep,
+				     ofi_tx_cq_flags(tx_buf->pkt.hdr.op),
+				     tx_buf->app_context, tx_buf->flags);
 
 	if (rxm_ep->rndv_ops == &rxm_rndv_ops_write &&
 	    tx_buf->write_rndv.done_buf) {
@@ -533,46 +560,189 @@ ssize_t rxm_handle_unexp_sar(struct fi_peer_rx_entry *peer_entry)
 	return FI_SUCCESS;
 }
 
-static ssize_t rxm_rndv_xfer(struct rxm_ep *rxm_ep, struct fid_ep *msg_ep,
+/* Select the rails used to transfer a rendezvous segment of the given
+ * length.  Rail 0 (the primary msg ep) is always available.  Each rail
+ * used must carry at least rxm_rail_min_size bytes.
+ */
+static size_t rxm_rndv_get_rails(struct rxm_conn *conn, size_t len,
+				 size_t *rails)
+{
+	size_t i, cnt = 1, max_cnt;
+
+	rails[0] = 0;
+	max_cnt = rxm_rail_min_size ? len / rxm_rail_min_size : RXM_MAX_RAILS;
+	for (i = 1; i < RXM_MAX_RAILS && cnt < max_cnt; i++) {
+		if (conn->rails[i].state == RXM_CM_CONNECTED)
+			rails[cnt++] = i;
+	}
+	return cnt;
+}
+
+/* Split len across the selected rails in proportion to their observed
+ * bandwidth.  A fraction of the segment is spread evenly, so that a
+ * rail with a low estimate keeps being sampled and can recover.
+ */
+static void rxm_rndv_split(struct rxm_conn *conn, size_t len,
+			   size_t *rails, size_t cnt, size_t *rail_len)
+{
+	uint64_t bw_total = 0, weight_total = 0, floor;
+	size_t i, off = 0;
+
+	for (i = 0; i < cnt; i++)
+		bw_total += conn->rails[rails[i]].bw;
+
+	floor = MAX(bw_total / (8 * cnt), 1);
+	weight_total = bw_total + floor * cnt;
+
+	for (i = 0; i < cnt - 1; i++) {
+		rail_len[i] = (size_t) ((len * (conn->rails[rails[i]].bw +
+					 floor)) / weight_total);
+		rail_len[i] &= ~((size_t) 63);
+		off += rail_len[i];
+	}
+	rail_len[cnt - 1] = len - off;
+}
+
+static ssize_t rxm_rndv_post_rail(struct rxm_ep *rxm_ep, struct rxm_conn *conn,
+				  size_t rail, struct fi_rma_iov *rma_iov,
+				  struct iovec *iov, void **desc, size_t count,
+				  void *buf, void *context)
+{
+	struct rxm_deferred_tx_entry *def_tx_entry;
+	ssize_t ret;
+
+	ret = rxm_rndv_rail_xfer(rxm_ep, conn, rail, iov, desc, count, 0,
+				 rma_iov->addr, rma_iov->key, context);
+	if (ret == -FI_EAGAIN) {
+		ret = rxm_ep->rndv_ops->defer_xfer(&def_tx_entry, rma_iov,
+						   iov, desc, count, buf,
+						   context, rail);
+		if (!ret)
+			rxm_queue_deferred_tx(def_tx_entry, OFI_LIST_TAIL);
+	}
+	return ret;
+}
+
+static ssize_t rxm_rndv_post(struct rxm_ep *rxm_ep, struct rxm_conn *conn,
+			     size_t rail, bool striped,
+			     struct fi_rma_iov *rma_iov, struct iovec *iov,
+			     void **desc, size_t count, void *buf)
+{
+	struct rxm_rail_xfer *xfer = NULL;
+	void *context = buf;
+	ssize_t ret;
+
+	if (striped) {
+		xfer = ofi_buf_alloc(rxm_ep->rail_xfer_pool);
+		if (!xfer)
+			return -FI_ENOMEM;
+
+		xfer->hdr.state = RXM_RNDV_RAIL_XFER;
+		xfer->conn = conn;
+		xfer->rail = &conn->rails[rail];
+		xfer->buf = buf;
+		xfer->rma_iov = *rma_iov;
+		memcpy(xfer->rxm_iov.iov, iov, count * sizeof(*iov));
+		memcpy(xfer->rxm_iov.desc, desc, count * sizeof(*desc));
+		xfer->rxm_iov.count = (uint8_t) count;
+		xfer->start = ofi_gettime_ns();
+		xfer->retried = false;
+		context = xfer;
+	}
+
+	ret = rxm_rndv_post_rail(rxm_ep, conn, rail, rma_iov, iov, desc,
+				 count, buf, context);
+	if (ret && xfer)
+		ofi_buf_free(xfer);
+	return ret;
+}
+
+/* A rail other than the primary msg ep can fail, for example when it
+ * is shut down, while the connection itself survives.  Post the piece
+ * again on the fastest remaining rail, and on the primary msg ep if
+ * that fails as well, so that only an error on the primary connection
+ * fails the transfer.
+ */
+static bool rxm_rail_xfer_retry(struct rxm_ep *rxm_ep,
+				struct rxm_rail_xfer *xfer)
+{
+	struct rxm_conn *conn = xfer->conn;
+	size_t i, failed, rail = 0;
+
+	failed = xfer->rail - conn->rails;
+	if (!failed || conn->state != RXM_CM_CONNECTED)
+		return false;
+
+	for (i = 1; i < RXM_MAX_RAILS && !xfer->retried; i++) {
+		if (i != failed && rxm_rail_connected(conn, i) &&
+		    (!rail || conn->rails[i].bw > conn->rails[rail].bw))
+			rail = i;
+	}
+
+	FI_INFO(&rxm_prov, FI_LOG_CQ,
+		"rail %zu failed, posting %zu bytes on rail %zu\n", failed,
+		xfer->rma_iov.len, rail);
+	xfer->retried = true;
+	xfer->rail = &conn->rails[rail];
+	xfer->start = ofi_gettime_ns();
+	return !rxm_rndv_post_rail(rxm_ep, conn, rail, &xfer->rma_iov,
+				   xfer->rxm_iov.iov, xfer->rxm_iov.desc,
+				   xfer->rxm_iov.count, xfer->buf, xfer);
+}
+
+/* Issue the RMA operations for a rendezvous transfer.  Large segments
+ * are striped across the connection's rails.  The number of RMA
+ * operations whose completions must be reaped before the transfer is
+ * done is returned through rma_count.
+ */
+static ssize_t rxm_rndv_xfer(struct rxm_ep *rxm_ep, struct rxm_conn *conn,
 			     struct rxm_rndv_hdr *remote_hdr, struct iovec *local_iov,
 			     void **local_desc, size_t local_count, size_t total_len,
-			     void *context)
+			     void *buf, size_t *rma_count)
 {
-	size_t i, index = 0, offset = 0, count, copy_len;
+	size_t i, r, index = 0, offset = 0, count, copy_len, seg_off;
+	size_t rails[RXM_MAX_RAILS], rail_len[RXM_MAX_RAILS], rail_cnt;
 	struct iovec iov[RXM_IOV_LIMIT];
 	void *desc[RXM_IOV_LIMIT];
+	struct fi_rma_iov rma_iov;
 	ssize_t ret = FI_SUCCESS;
 
+	*rma_count = 0;
 	for (i = 0; i < remote_hdr->count && total_len > 0; i++) {
 		copy_len = MIN(remote_hdr->iov[i].len, total_len);
 
-		ret = ofi_copy_iov_desc(&iov[0], &desc[0], &count,
-					&local_iov[0],
-					&local_desc[0],
-					local_count,
-					&index, &offset, copy_len);
-		if (ret)
-			return ret;
-		total_len -= copy_len;
-		ret = rxm_ep->rndv_ops->xfer(msg_ep, iov, desc, count, 0,
-			       remote_hdr->iov[i].addr, remote_hdr->iov[i].key,
-			       context);
-
-		if (ret) {
-			if (ret == -FI_EAGAIN) {
-				struct rxm_deferred_tx_entry *def_tx_entry;
-
-				ret = rxm_ep->rndv_ops->defer_xfer(
-					&def_tx_entry, i, iov, desc, count,
-					context);
+		rail_cnt = rxm_rndv_get_rails(conn, copy_len, rails);
+		if (rail_cnt > 1)
+			rxm_rndv_split(conn, copy_len, rails, rail_cnt,
+				       rail_len);
+		else
+			rail_len[0] = copy_len;
 
-				if (ret)
-					break;
-				rxm_queue_deferred_tx(def_tx_entry, OFI_LIST_TAIL);
+		for (r = 0, seg_off = 0; r < rail_cnt; r++) {
+			if (!rail_len[r])
 				continue;
-			}
-			break;
+
+			ret = ofi_copy_iov_desc(&iov[0], &desc[0], &count,
+						&local_iov[0],
+						&local_desc[0],
+						local_count,
+						&index, &offset, rail_len[r]);
+			if (ret)
+				return ret;
+
+			rma_iov.addr = remote_hdr->iov[i].addr + seg_off;
+			rma_iov.len = rail_len[r];
+			rma_iov.key = remote_hdr->iov[i].key;
+			ret = rxm_rndv_post(rxm_ep, conn, rails[r],
+					    rail_cnt > 1, &rma_iov, iov, desc,
+					    count, buf);
+			if (ret)
+				return ret;
+
+			seg_off += rail_len[r];
+			(*rma_count)++;
 		}
+		total_len -= copy_len;
 	}
 	assert(!total_len);
 	return ret;
@@ -587,12 +757,12 @@ ssize_t rxm_rndv_read(struct rxm_rx_buf *rx_buf)
 	rx_buf->peer_entry->msg_size = total_len;
 	RXM_UPDATE_STATE(FI_LOG_CQ, rx_buf, RXM_RNDV_READ);
 
-	ret = rxm_rndv_xfer(rx_buf->ep, rx_buf->conn->msg_ep,
+	ret = rxm_rndv_xfer(rx_buf->ep, rx_buf->conn,
 			    rx_buf->remote_rndv_hdr,
 			    rx_buf->peer_entry->iov,
 			    rx_buf->peer_entry->desc,
 			    rx_buf->peer_entry->count, total_len,
-			    rx_buf);
+			    rx_buf, &rx_buf->rndv_rma_count);
 	if (ret) {
 		rxm_cq_write_rx_error(rx_buf->ep, ofi_op_msg, rx_buf,
 				      (int) ret);
@@ -602,10 +772,9 @@ ssize_t rxm_rndv_read(struct rxm_rx_buf *rx_buf)
 
 static ssize_t rxm_rndv_handle_wr_data(struct rxm_rx_buf *rx_buf)
 {
-	int i;
 	ssize_t ret;
 	struct rxm_tx_buf *tx_buf;
-	size_t total_len, rma_len = 0;
+	size_t total_len;
 	struct rxm_rndv_hdr *rx_hdr = (struct rxm_rndv_hdr *) rx_buf->pkt.data;
 
 	tx_buf = ofi_bufpool_get_ibuf(rx_buf->ep->tx_pool,
@@ -619,16 +788,6 @@ static ssize_t rxm_rndv_handle_wr_data(struct rxm_rx_buf *rx_buf)
 	memcpy(tx_buf->write_rndv.remote_hdr.iov, rx_hdr->iov,
 	       rx_hdr->count * sizeof(rx_hdr->iov[0]));
 
-	// calculate number of RMA writes required to complete the transfer.
-	// there me be less than iov count RMA writes required,
-	// depending on differences between remote and local IOV sizes.
-	for (i = 0; i < tx_buf->write_rndv.remote_hdr.count; i++) {
-		if (total_len > rma_len) {
-			tx_buf->write_rndv.rndv_rma_count++;
-			rma_len += tx_buf->write_rndv.remote_hdr.iov[i].len;
-		}
-	}
-
 	/* Valid states here depends on whether the completion of the original
 	 * send has been processed:
 	 *
@@ -643,7 +802,9 @@ static ssize_t rxm_rndv_handle_wr_data(struct rxm_rx_buf *rx_buf)
 	 *
 	 * The RXM_RNDV_WRITE_TX_WAIT state is used to indicate that the
 	 * next completion should be the completion of the original send
-	 * even though the write operation has been posted.
+	 * even though the write operation has been posted.  Writes striped
+	 * across rails may complete before that send; they are counted
+	 * and the done message is sent once the send completes.
 	 */
 	assert(tx_buf->hdr.state == RXM_RNDV_TX ||
 	       tx_buf->hdr.state == RXM_RNDV_WRITE_DATA_WAIT);
@@ -653,9 +814,10 @@ static ssize_t rxm_rndv_handle_wr_data(struct rxm_rx_buf *rx_buf)
 	else
 		RXM_UPDATE_STATE(FI_LOG_CQ, tx_buf, RXM_RNDV_WRITE_TX_WAIT);
 
-	ret = rxm_rndv_xfer(rx_buf->ep, tx_buf->write_rndv.conn->msg_ep, rx_hdr,
+	ret = rxm_rndv_xfer(rx_buf->ep, tx_buf->write_rndv.conn, rx_hdr,
 			    tx_buf->write_rndv.iov, tx_buf->write_rndv.desc,
-			    tx_buf->rma.count, total_len, tx_buf);
+			    tx_buf->rma.count, total_len, tx_buf,
+			    &tx_buf->write_rndv.rndv_rma_count);
 
 	if (ret)
 		rxm_cq_write_rx_error(rx_buf->ep, ofi_op_msg, tx_buf, (int) ret);
@@ -686,6 +848,7 @@ static ssize_t rxm_handle_rndv(struct rxm_rx_buf *rx_buf)
 
 	rx_buf->remote_rndv_hdr = (struct rxm_rndv_hdr *) rx_buf->pkt.data;
 	rx_buf->rndv_rma_index = 0;
+	rx_buf->rndv_rma_count = 0;
 
 	if (!rx_buf->ep->rdm_mr_local) {
 		total_recv_len = MIN(rx_buf->peer_entry->msg_size,
@@ -1397,21 +1560,29 @@ static ssize_t rxm_handle_credit(struct rxm_ep *rxm_ep, struct rxm_rx_buf *rx_bu
 void rxm_finish_coll_eager_send(struct rxm_ep *rxm_ep,
 			        struct rxm_tx_buf *tx_eager_buf)
 {
-	if (rxm_ep->util_coll_ep &&
-	    (tx_eager_buf->pkt.hdr.tag & RXM_PEER_XFER_TAG_FLAG)) {
-		struct fi_cq_tagged_entry cqe = {
-			.tag = tx_eager_buf->pkt.hdr.tag,
-			.op_context = tx_eager_buf->app_context,
-		};
-		rxm_ep->util_coll_peer_xfer_ops->
-			complete(rxm_ep->util_coll_ep, &cqe, 0);
-	} else {
+	if (!rxm_coll_tx_comp(rxm_ep, tx_eager_buf->pkt.hdr.tag,
+			      tx_eager_buf->app_context))
 		rxm_finish_eager_send(rxm_ep, tx_eager_buf);
-	}
+}
+
+/* Update the rail's bandwidth estimate, as a moving average over the
+ * observed throughput of the RMA operations issued on it.
+ */
+static void rxm_rail_xfer_done(struct rxm_rail_xfer *xfer)
+{
+	struct rxm_rail *rail = xfer->rail;
+	uint64_t elapsed, sample;
+
+	elapsed = (ofi_gettime_ns() - xfer->start) / 1000;
+	sample = xfer->rma_iov.len / MAX(elapsed, 1);
+	rail->bw = MAX((rail->bw * 7 + sample) / 8, 1);
+	rail->bytes += xfer->rma_iov.len;
+	ofi_buf_free(xfer);
 }
 
 ssize_t rxm_handle_comp(struct rxm_ep *rxm_ep, struct fi_cq_data_entry *comp)
 {
+	struct rxm_rail_xfer *xfer;
 	struct rxm_rx_buf *rx_buf;
 	struct rxm_tx_buf *tx_buf;
 
@@ -1492,7 +1663,7 @@ ssize_t rxm_handle_comp(struct rxm_ep *rxm_ep, struct fi_cq_data_entry *comp)
 	case RXM_RNDV_READ:
 		rx_buf = comp->op_context;
 		assert(comp->flags & FI_READ);
-		if (++rx_buf->rndv_rma_index < rx_buf->remote_rndv_hdr->count)
+		if (++rx_buf->rndv_rma_index < rx_buf->rndv_rma_count)
 			return 0;
 
 		rxm_rndv_send_rd_done(rx_buf);
@@ -1510,7 +1681,23 @@ ssize_t rxm_handle_comp(struct rxm_ep *rxm_ep, struct fi_cq_data_entry *comp)
 		tx_buf = comp->op_context;
 		assert(comp->flags & FI_SEND);
 		RXM_UPDATE_STATE(FI_LOG_CQ, tx_buf, RXM_RNDV_WRITE);
+		if (tx_buf->write_rndv.rndv_rma_index ==
+		    tx_buf->write_rndv.rndv_rma_count)
+			rxm_rndv_send_wr_done(rxm_ep, tx_buf);
 		return 0;
+	case RXM_RNDV_RAIL_XFER:
+		xfer = comp->op_context;
+		comp->op_context = xfer->buf;
+		rxm_rail_xfer_done(xfer);
+
+		if (RXM_GET_PROTO_STATE(comp->op_context) ==
+		    RXM_RNDV_WRITE_TX_WAIT) {
+			tx_buf = comp->op_context;
+			assert(comp->flags & FI_WRITE);
+			tx_buf->write_rndv.rndv_rma_index++;
+			return 0;
+		}
+		return rxm_handle_comp(rxm_ep, comp);
 	case RXM_RNDV_READ_DONE_SENT:
 		assert(comp->flags & FI_SEND);
 		rxm_rndv_rx_finish(comp->op_context);
@@ -1614,6 +1801,7 @@ void rxm_cq_write_error_all(struct rxm_ep *rxm_ep, int err)
 
 void rxm_handle_comp_error(struct rxm_ep *rxm_ep)
 {
+	struct rxm_rail_xfer *xfer;
 	struct rxm_tx_buf *tx_buf;
 	struct rxm_rx_buf *rx_buf;
 	struct util_cq *cq;
@@ -1641,6 +1829,14 @@ void rxm_handle_comp_error(struct rxm_ep *rxm_ep)
 	cq = rxm_ep->util_ep.tx_cq;
 	cntr = rxm_ep->util_ep.cntrs[CNTR_TX];
 
+	if (RXM_GET_PROTO_STATE(err_entry.op_context) == RXM_RNDV_RAIL_XFER) {
+		xfer = err_entry.op_context;
+		if (rxm_rail_xfer_retry(rxm_ep, xfer))
+			return;
+		err_entry.op_context = xfer->buf;
+		ofi_buf_free(xfer);
+	}
+
 	switch (RXM_GET_PROTO_STATE(err_entry.op_context)) {
 	case RXM_TX:
 	case RXM_RNDV_TX:
@@ -2035,8 +2231,8 @@ int rxm_cq_open(struct fid_domain *domain, struct fi_cq_attr *attr,
 	if (!rxm_cq)
 		return -FI_ENOMEM;
 
-	ret = ofi_cq_init(&rxm_prov, domain, attr, &rxm_cq->util_cq,
-			  &ofi_cq_progress, context);
+	ret = ofi_cq_init_mpsc(&rxm_prov, domain, attr, &rxm_cq->util_cq,
+			       &ofi_cq_progress, context);
 	if (ret)
 		goto err1;
 
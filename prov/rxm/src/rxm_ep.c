@@ -163,6 +163,16 @@ static int rxm_ep_create_pools(struct rxm_ep *rxm_ep)
 		goto free_tx_pool;
 	}
 
+	/* Rails may be opened by the peer, even if we don't request any */
+	ret = ofi_bufpool_create(&rxm_ep->rail_xfer_pool,
+				 sizeof(struct rxm_rail_xfer), 16, 0, 1024,
+				 OFI_BUFPOOL_NO_TRACK);
+	if (ret) {
+		FI_WARN(&rxm_prov, FI_LOG_EP_CTRL,
+			"Unable to create rail xfer pool\n");
+		goto free_tx_pool;
+	}
+
 	return 0;
 free_tx_pool:
 	ofi_bufpool_destroy(rxm_ep->tx_pool);
@@ -196,6 +206,10 @@ static void rxm_ep_txrx_res_close(struct rxm_ep *ep)
 		ofi_bufpool_destroy(ep->coll_pool);
 		ep->coll_pool = NULL;
 	}
+	if (ep->rail_xfer_pool) {
+		ofi_bufpool_destroy(ep->rail_xfer_pool);
+		ep->rail_xfer_pool = NULL;
+	}
 }
 
 static int rxm_setname(fid_t fid, void *addr, size_t addrlen)
@@ -577,14 +591,15 @@ void rxm_ep_progress_deferred_queue(struct rxm_ep *rxm_ep,
 					 RXM_RNDV_WRITE_DONE_SENT);
 			break;
 		case RXM_DEFERRED_TX_RNDV_READ:
-			ret = rxm_ep->rndv_ops->xfer(
-				def_tx_entry->rxm_conn->msg_ep,
+			ret = rxm_rndv_rail_xfer(rxm_ep,
+				def_tx_entry->rxm_conn,
+				def_tx_entry->rndv_read.rail,
 				def_tx_entry->rndv_read.rxm_iov.iov,
 				def_tx_entry->rndv_read.rxm_iov.desc,
 				def_tx_entry->rndv_read.rxm_iov.count, 0,
 				def_tx_entry->rndv_read.rma_iov.addr,
 				def_tx_entry->rndv_read.rma_iov.key,
-				def_tx_entry->rndv_read.rx_buf);
+				def_tx_entry->rndv_read.context);
 			if (ret) {
 				if (ret == -FI_EAGAIN)
 					return;
@@ -595,14 +610,15 @@ void rxm_ep_progress_deferred_queue(struct rxm_ep *rxm_ep,
 			}
 			break;
 		case RXM_DEFERRED_TX_RNDV_WRITE:
-			ret = rxm_ep->rndv_ops->xfer(
-				def_tx_entry->rxm_conn->msg_ep,
+			ret = rxm_rndv_rail_xfer(rxm_ep,
+				def_tx_entry->rxm_conn,
+				def_tx_entry->rndv_write.rail,
 				def_tx_entry->rndv_write.rxm_iov.iov,
 				def_tx_entry->rndv_write.rxm_iov.desc,
 				def_tx_entry->rndv_write.rxm_iov.count, 0,
 				def_tx_entry->rndv_write.rma_iov.addr,
 				def_tx_entry->rndv_write.rma_iov.key,
-				def_tx_entry->rndv_write.tx_buf);
+				def_tx_entry->rndv_write.context);
 			if (ret) {
 				if (ret == -FI_EAGAIN)
 					return;
@@ -828,18 +844,130 @@ ssize_t rxm_ep_broadcast(struct fid_ep *ep, void *buf, size_t count,
 	return ret;
 }
 
+ssize_t rxm_ep_alltoall(struct fid_ep *ep, const void *buf, size_t count,
+			void *desc, void *result, void *result_desc,
+			fi_addr_t coll_addr, enum fi_datatype datatype,
+			uint64_t flags, void *context)
+{
+	struct rxm_ep *rxm_ep;
+	struct fid_ep *coll_ep;
+	struct rxm_coll_buf *req;
+	ssize_t ret;
+
+        rxm_ep = container_of(ep, struct rxm_ep, util_ep.ep_fid.fid);
+
+	ret = rxm_ep_init_coll_req(rxm_ep, FI_ALLTOALL, flags, context,
+				   &req, &coll_ep);
+	if (ret)
+		return ret;
+
+	flags &= ~FI_PEER_TRANSFER;
+
+	ret = fi_alltoall(coll_ep, buf, count, desc, result, result_desc,
+			  coll_addr, datatype, flags, req);
+	if (ret)
+		rxm_ep_free_coll_req(rxm_ep, req);
+
+	return ret;
+}
+
+ssize_t rxm_ep_reduce_scatter(struct fid_ep *ep, const void *buf,
+			      size_t count, void *desc, void *result,
+			      void *result_desc, fi_addr_t coll_addr,
+			      enum fi_datatype datatype, enum fi_op op,
+			      uint64_t flags, void *context)
+{
+	struct rxm_ep *rxm_ep;
+	struct fid_ep *coll_ep;
+	struct rxm_coll_buf *req;
+	ssize_t ret;
+
+        rxm_ep = container_of(ep, struct rxm_ep, util_ep.ep_fid.fid);
+
+	ret = rxm_ep_init_coll_req(rxm_ep, FI_REDUCE_SCATTER, flags, context,
+				   &req, &coll_ep);
+	if (ret)
+		return ret;
+
+	flags &= ~FI_PEER_TRANSFER;
+
+	ret = fi_reduce_scatter(coll_ep, buf, count, desc, result,
+				result_desc, coll_addr, datatype, op, flags,
+				req);
+	if (ret)
+		rxm_ep_free_coll_req(rxm_ep, req);
+
+	return ret;
+}
+
+ssize_t rxm_ep_reduce(struct fid_ep *ep, const void *buf, size_t count,
+		      void *desc, void *result, void *result_desc,
+		      fi_addr_t coll_addr, fi_addr_t root_addr,
+		      enum fi_datatype datatype, enum fi_op op,
+		      uint64_t flags, void *context)
+{
+	struct rxm_ep *rxm_ep;
+	struct fid_ep *coll_ep;
+	struct rxm_coll_buf *req;
+	ssize_t ret;
+
+        rxm_ep = container_of(ep, struct rxm_ep, util_ep.ep_fid.fid);
+
+	ret = rxm_ep_init_coll_req(rxm_ep, FI_REDUCE, flags, context,
+				   &req, &coll_ep);
+	if (ret)
+		return ret;
+
+	flags &= ~FI_PEER_TRANSFER;
+
+	ret = fi_reduce(coll_ep, buf, count, desc, result, result_desc,
+			coll_addr, root_addr, datatype, op, flags, req);
+	if (ret)
+		rxm_ep_free_coll_req(rxm_ep, req);
+
+	return ret;
+}
+
+ssize_t rxm_ep_gather(struct fid_ep *ep, const void *buf, size_t count,
+		      void *desc, void *result, void *result_desc,
+		      fi_addr_t coll_addr, fi_addr_t root_addr,
+		      enum fi_datatype datatype, uint64_t flags,
+		      void *context)
+{
+	struct rxm_ep *rxm_ep;
+	struct fid_ep *coll_ep;
+	struct rxm_coll_buf *req;
+	ssize_t ret;
+
+        rxm_ep = container_of(ep, struct rxm_ep, util_ep.ep_fid.fid);
+
+	ret = rxm_ep_init_coll_req(rxm_ep, FI_GATHER, flags, context,
+				   &req, &coll_ep);
+	if (ret)
+		return ret;
+
+	flags &= ~FI_PEER_TRANSFER;
+
+	ret = fi_gather(coll_ep, buf, count, desc, result, result_desc,
+			coll_addr, root_addr, datatype, flags, req);
+	if (ret)
+		rxm_ep_free_coll_req(rxm_ep, req);
+
+	return ret;
+}
+
 static struct fi_ops_collective rxm_ops_collective = {
 	.size = sizeof(struct fi_ops_collective),
 	.barrier = rxm_ep_barrier,
 	.barrier2 = rxm_ep_barrier2,
 	.broadcast = rxm_ep_broadcast,
-	.alltoall = fi_coll_no_alltoall,
+	.alltoall = rxm_ep_alltoall,
 	.allreduce = rxm_ep_allreduce,
 	.allgather = rxm_ep_allgather,
-	.reduce_scatter = fi_coll_no_reduce_scatter,
-	.reduce = fi_coll_no_reduce,
+	.reduce_scatter = rxm_ep_reduce_scatter,
+	.reduce = rxm_ep_reduce,
 	.scatter = rxm_ep_scatter,
-	.gather = fi_coll_no_gather,
+	.gather = rxm_ep_gather,
 	.msg = fi_coll_no_msg,
 };
 
@@ -1151,16 +1279,21 @@ static void rxm_ep_settings_init(struct rxm_ep *rxm_ep)
 	rxm_config_direct_send(rxm_ep);
 	rxm_ep_init_proto(rxm_ep);
 
+	rxm_ep->rails = rxm_passthru_info(rxm_ep->rxm_info) ? 1 :
+			MIN(MAX(rxm_rndv_rails, 1), RXM_MAX_RAILS);
+
  	FI_INFO(&rxm_prov, FI_LOG_CORE,
 		"Settings:\n"
 		"\t\t MR local: MSG - %d, RxM - %d\n"
 		"\t\t Completions per progress: MSG - %zu\n"
 	        "\t\t Buffered min: %zu\n"
 	        "\t\t inject size: %zu\n"
-		"\t\t Protocol limits: Eager: %zu, SAR: %zu\n",
+		"\t\t Protocol limits: Eager: %zu, SAR: %zu\n"
+		"\t\t Rendezvous rails: %zu\n",
 		rxm_ep->msg_mr_local, rxm_ep->rdm_mr_local,
 		rxm_ep->comp_per_progress, rxm_ep->buffered_min,
-		rxm_ep->inject_limit, rxm_ep->eager_limit, rxm_ep->sar_limit);
+		rxm_ep->inject_limit, rxm_ep->eager_limit, rxm_ep->sar_limit,
+		rxm_ep->rails);
 }
 
 static int rxm_ep_txrx_res_open(struct rxm_ep *rxm_ep)
@@ -1577,9 +1710,9 @@ err1:
 
 static ssize_t
 rxm_prepare_deferred_rndv_read(struct rxm_deferred_tx_entry **def_tx_entry,
-			       size_t index, struct iovec *iov,
+			       struct fi_rma_iov *rma_iov, struct iovec *iov,
 			       void *desc[RXM_IOV_LIMIT], size_t count,
-			       void *buf)
+			       void *buf, void *context, size_t rail)
 {
 	uint8_t i;
 	struct rxm_rx_buf *rx_buf = buf;
@@ -1590,10 +1723,9 @@ rxm_prepare_deferred_rndv_read(struct rxm_deferred_tx_entry **def_tx_entry,
 		return -FI_ENOMEM;
 
 	(*def_tx_entry)->rndv_read.rx_buf = rx_buf;
-	(*def_tx_entry)->rndv_read.rma_iov.addr =
-			rx_buf->remote_rndv_hdr->iov[index].addr;
-	(*def_tx_entry)->rndv_read.rma_iov.key =
-			rx_buf->remote_rndv_hdr->iov[index].key;
+	(*def_tx_entry)->rndv_read.context = context;
+	(*def_tx_entry)->rndv_read.rail = rail;
+	(*def_tx_entry)->rndv_read.rma_iov = *rma_iov;
 
 	for (i = 0; i < count; i++) {
 		(*def_tx_entry)->rndv_read.rxm_iov.iov[i] = iov[i];
@@ -1606,9 +1738,9 @@ rxm_prepare_deferred_rndv_read(struct rxm_deferred_tx_entry **def_tx_entry,
 
 static ssize_t
 rxm_prepare_deferred_rndv_write(struct rxm_deferred_tx_entry **def_tx_entry,
-			       size_t index, struct iovec *iov,
+			       struct fi_rma_iov *rma_iov, struct iovec *iov,
 			       void *desc[RXM_IOV_LIMIT], size_t count,
-			       void *buf)
+			       void *buf, void *context, size_t rail)
 {
 	uint8_t i;
 	struct rxm_tx_buf *tx_buf = buf;
@@ -1620,10 +1752,9 @@ rxm_prepare_deferred_rndv_write(struct rxm_deferred_tx_entry **def_tx_entry,
 		return -FI_ENOMEM;
 
 	(*def_tx_entry)->rndv_write.tx_buf = tx_buf;
-	(*def_tx_entry)->rndv_write.rma_iov.addr =
-			tx_buf->write_rndv.remote_hdr.iov[index].addr;
-	(*def_tx_entry)->rndv_write.rma_iov.key =
-			tx_buf->write_rndv.remote_hdr.iov[index].key;
+	(*def_tx_entry)->rndv_write.context = context;
+	(*def_tx_entry)->rndv_write.rail = rail;
+	(*def_tx_entry)->rndv_write.rma_iov = *rma_iov;
 
 	for (i = 0; i < count; i++) {
 		(*def_tx_entry)->rndv_write.rxm_iov.iov[i] = iov[i];
@@ -1634,11 +1765,40 @@ rxm_prepare_deferred_rndv_write(struct rxm_deferred_tx_entry **def_tx_entry,
 	return 0;
 }
 
+/* The write done message is sent over the primary msg ep, which is
+ * not ordered with writes issued over other rails.  Those writes must
+ * be delivered before they are reported complete.
+ */
+static ssize_t
+rxm_rndv_rail_writev(struct fid_ep *ep, const struct iovec *iov, void **desc,
+		     size_t count, fi_addr_t remote_addr, uint64_t addr,
+		     uint64_t key, void *context)
+{
+	struct fi_rma_iov rma_iov = {
+		.addr = addr,
+		.len = ofi_total_iov_len(iov, count),
+		.key = key,
+	};
+	struct fi_msg_rma msg = {
+		.msg_iov = iov,
+		.desc = desc,
+		.iov_count = count,
+		.addr = remote_addr,
+		.rma_iov = &rma_iov,
+		.rma_iov_count = 1,
+		.context = context,
+		.data = 0,
+	};
+
+	return fi_writemsg(ep, &msg, FI_DELIVERY_COMPLETE | FI_COMPLETION);
+}
+
 struct rxm_rndv_ops rxm_rndv_ops_read = {
 	.rx_mr_access = FI_READ,
 	.tx_mr_access = FI_REMOTE_READ,
 	.handle_rx = rxm_rndv_read,
 	.xfer = fi_readv,
+	.rail_xfer = fi_readv,
 	.defer_xfer = rxm_prepare_deferred_rndv_read
 };
 
@@ -1647,6 +1807,7 @@ struct rxm_rndv_ops rxm_rndv_ops_write = {
 	.tx_mr_access = FI_WRITE,
 	.handle_rx = rxm_rndv_send_wr_data,
 	.xfer = fi_writev,
+	.rail_xfer = rxm_rndv_rail_writev,
 	.defer_xfer = rxm_prepare_deferred_rndv_write
 };
 
@@ -54,6 +54,8 @@ size_t rxm_def_tx_size = 2048;
 
 size_t rxm_buffer_size = 16384;
 size_t rxm_packet_size;
+size_t rxm_rndv_rails = 1;
+size_t rxm_rail_min_size = 65536;
 
 int rxm_passthru = 0; /* disable by default, need to analyze performance */
 int force_auto_progress;
@@ -688,6 +690,19 @@ RXM_INI
 			"RMA writes rather than RMA reads during Rendezvous "
 			"transactions. (default: false/no).");
 
+	fi_param_define(&rxm_prov, "rndv_rails", FI_PARAM_SIZE_T,
+			"Number of msg endpoint connections opened to each "
+			"peer for rendezvous transfers.  Rendezvous RMA is "
+			"striped across the connections in proportion to "
+			"their observed bandwidth.  Additional connections "
+			"are opened over the same core domain (e.g. separate "
+			"tcp sockets).  (default: 1, max: %d)", RXM_MAX_RAILS);
+
+	fi_param_define(&rxm_prov, "rail_min_size", FI_PARAM_SIZE_T,
+			"Minimum number of bytes of a rendezvous transfer "
+			"that is assigned to each rail.  Smaller transfers "
+			"use fewer rails. (default: %zu)", rxm_rail_min_size);
+
 	fi_param_define(&rxm_prov, "enable_direct_send", FI_PARAM_BOOL,
 			"Enable support to pass application buffers directly "
 			"to the core provider when possible.  This avoids "
@@ -731,6 +746,8 @@ RXM_INI
 		rxm_cq_eq_fairness = 128;
 	fi_param_get_bool(&rxm_prov, "data_auto_progress", &force_auto_progress);
 	fi_param_get_bool(&rxm_prov, "use_rndv_write", &rxm_use_write_rndv);
+	fi_param_get_size_t(&rxm_prov, "rndv_rails", &rxm_rndv_rails);
+	fi_param_get_size_t(&rxm_prov, "rail_min_size", &rxm_rail_min_size);
 
 	rxm_get_def_wait();
 
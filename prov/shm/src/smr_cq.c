@@ -54,8 +54,8 @@ int smr_cq_open(struct fid_domain *domain, struct fi_cq_attr *attr,
 	if (!cq)
 		return -FI_ENOMEM;
 
-	ret = ofi_cq_init(&smr_prov, domain, attr, cq, &ofi_cq_progress,
-			  context);
+	ret = ofi_cq_init_mpsc(&smr_prov, domain, attr, cq, &ofi_cq_progress,
+			       context);
 	if (ret)
 		return ret;
 
@@ -60,6 +60,7 @@
 #include <ofi_util.h>
 #include <ofi_proto.h>
 #include <ofi_net.h>
+#include <ofi_timer.h>
 
 #include "xnet_proto.h"
 
@@ -97,6 +98,7 @@ typedef void  xnet_profile_t;
 #define XNET_MAX_EVENTS		128
 #define XNET_MIN_MULTI_RECV	16384
 #define XNET_PORT_MAX_RANGE	(USHRT_MAX)
+#define XNET_TIMER_TICK		1000000 /* nsec */
 
 extern struct fi_provider	xnet_prov;
 extern struct util_prov		xnet_util_prov;
@@ -120,6 +122,7 @@ extern size_t xnet_max_saved_size;
 extern size_t xnet_max_inject;
 extern size_t xnet_buf_size;
 extern int xnet_firewall_addr;
+extern int xnet_cm_timeout;
 
 struct xnet_xfer_entry;
 struct xnet_ep;
@@ -173,6 +176,7 @@ void xnet_connect_done(struct xnet_ep *ep);
 void xnet_req_done(struct xnet_ep *ep);
 int xnet_send_cm_msg(struct xnet_ep *ep);
 void xnet_uring_req_done(struct xnet_ep *ep, int res);
+void xnet_cm_timer_expired(struct ofi_timer *timer);
 
 /* Inject buffer space is included */
 union xnet_hdrs {
@@ -262,6 +266,7 @@ struct xnet_ep {
 	struct xnet_conn_handle *conn;
 	struct xnet_cm_msg	*cm_msg;
 	struct sockaddr		*addr;
+	struct ofi_timer	cm_timer;
 
 	void (*hdr_bswap)(struct xnet_ep *ep, struct xnet_base_hdr *hdr);
 
@@ -376,6 +381,7 @@ struct xnet_progress {
 
 	struct ofi_dynpoll	epoll_fd;
 	struct ofi_epollfds_event events[XNET_MAX_EVENTS];
+	struct ofi_timer_wheel	timer_wheel;
 
 	bool			auto_progress;
 	pthread_t		thread;
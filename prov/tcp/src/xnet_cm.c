@@ -163,6 +163,7 @@ static int xnet_req_done_internal(struct xnet_ep *ep)
 	}
 
 	assert(!ofi_bsock_readable(&ep->bsock) && !ep->cur_rx.handler);
+	ofi_timer_cancel(&xnet_ep2_progress(ep)->timer_wheel, &ep->cm_timer);
 	ep->state = XNET_CONNECTED;
 	free(ep->cm_msg);
 	ep->cm_msg = NULL;
@@ -247,6 +248,18 @@ disable:
 
 }
 
+void xnet_cm_timer_expired(struct ofi_timer *timer)
+{
+	struct xnet_ep *ep;
+
+	ep = container_of(timer, struct xnet_ep, cm_timer);
+	assert(xnet_progress_locked(xnet_ep2_progress(ep)));
+	FI_WARN(&xnet_prov, FI_LOG_EP_CTRL,
+		"%p connection not established after %d ms\n", ep,
+		xnet_cm_timeout);
+	xnet_ep_disable(ep, FI_ETIMEDOUT, NULL, 0);
+}
+
 void xnet_handle_conn(struct xnet_conn_handle *conn, bool error)
 {
 	struct xnet_cm_msg msg;
@@ -300,7 +300,18 @@ static int xnet_ep_connect(struct fid_ep *ep_fid, const void *addr,
 	if (!ep->addr)
 		return -FI_ENOMEM;
 
+	/* Armed before connecting, since a connect submitted to io_uring
+	 * may complete before this call returns.
+	 */
+	progress = xnet_ep2_progress(ep);
+	ofi_genlock_lock(&progress->ep_lock);
 	ep->state = XNET_CONNECTING;
+	if (xnet_cm_timeout > 0)
+		ofi_timer_arm(&progress->timer_wheel, &ep->cm_timer,
+			      ofi_gettime_ns() +
+			      (uint64_t) xnet_cm_timeout * 1000000);
+	ofi_genlock_unlock(&progress->ep_lock);
+
 	ret = ofi_bsock_connect(&ep->bsock, ep->addr,
 				(socklen_t) ofi_sizeofaddr(ep->addr));
 	if (ret) {
@@ -310,7 +321,11 @@ static int xnet_ep_connect(struct fid_ep *ep_fid, const void *addr,
 		/* FIXME: handle EAGAIN */
 
 		if (!OFI_SOCK_TRY_CONN_AGAIN(-ret)) {
+			ofi_genlock_lock(&progress->ep_lock);
+			ofi_timer_cancel(&progress->timer_wheel,
+					 &ep->cm_timer);
 			ep->state = XNET_IDLE;
+			ofi_genlock_unlock(&progress->ep_lock);
 			FI_WARN(&xnet_prov, FI_LOG_EP_CTRL,
 				"connect failure %d(%s)\n", -ret,
 				fi_strerror(-ret));
@@ -318,7 +333,6 @@ static int xnet_ep_connect(struct fid_ep *ep_fid, const void *addr,
 		}
 	}
 
-	progress = xnet_ep2_progress(ep);
 	ofi_genlock_lock(&progress->ep_lock);
 	ep->pollflags = POLLOUT;
 	ret = xnet_monitor_ep(progress, ep);
@@ -511,6 +525,7 @@ void xnet_ep_disable(struct xnet_ep *ep, int cm_err, void* err_data,
 	};
 
 	ep->state = XNET_DISCONNECTED;
+	ofi_timer_cancel(&xnet_ep2_progress(ep)->timer_wheel, &ep->cm_timer);
 	dlist_remove_init(&ep->unexp_entry);
 	if (!xnet_io_uring)
 		xnet_halt_sock(xnet_ep2_progress(ep), ep->bsock.sock);
@@ -663,6 +678,7 @@ static int xnet_ep_close(struct fid *fid)
 	progress = xnet_ep2_progress(ep);
 	ofi_genlock_lock(&progress->ep_lock);
 	ep->state = XNET_DISCONNECTED;
+	ofi_timer_cancel(&progress->timer_wheel, &ep->cm_timer);
 	dlist_remove_init(&ep->unexp_entry);
 	if (!xnet_io_uring)
 		xnet_halt_sock(progress, ep->bsock.sock);
@@ -810,6 +826,7 @@ int xnet_endpoint(struct fid_domain *domain, struct fi_info *info,
 		goto err1;
 
 	assert(info->ep_attr->type == FI_EP_MSG);
+	ofi_timer_init(&ep->cm_timer, xnet_cm_timer_expired);
 	ofi_bsock_init(&ep->bsock, &xnet_ep2_progress(ep)->sockapi,
 		       xnet_staging_sbuf_size, xnet_prefetch_rbuf_size,
 		       &ep->util_ep.ep_fid);
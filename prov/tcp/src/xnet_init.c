@@ -72,6 +72,7 @@ size_t xnet_max_inject = XNET_DEF_INJECT;
 size_t xnet_buf_size = XNET_DEF_BUF_SIZE;
 size_t xnet_max_saved_size = SIZE_MAX;
 int xnet_firewall_addr = 0;
+int xnet_cm_timeout;
 
 
 static void xnet_init_env(void)
@@ -190,6 +191,13 @@ static void xnet_init_env(void)
 
 	fi_param_define(&xnet_prov, "firewall_addr", FI_PARAM_BOOL, "if this node is behind firewall");
 	fi_param_get_bool(&xnet_prov, "firewall_addr", &xnet_firewall_addr);
+
+	fi_param_define(&xnet_prov, "cm_timeout", FI_PARAM_INT,
+			"Time in milliseconds an active endpoint waits for "
+			"its connection to be established before reporting "
+			"FI_ETIMEDOUT.  0 waits indefinitely (default: %d)",
+			xnet_cm_timeout);
+	fi_param_get_int(&xnet_prov, "cm_timeout", &xnet_cm_timeout);
 }
 
 static void xnet_fini(void)
@@ -1552,6 +1552,8 @@ void xnet_run_progress(struct xnet_progress *progress, bool clear_signal)
 	int nfds;
 
 	assert(ofi_genlock_held(progress->active_lock));
+	if (progress->timer_wheel.cnt)
+		ofi_timer_wheel_expire(&progress->timer_wheel, ofi_gettime_ns());
 	if (xnet_io_uring) {
 		xnet_progress_uring(progress, &progress->tx_uring);
 		xnet_progress_uring(progress, &progress->rx_uring);
@@ -1598,7 +1600,7 @@ static void xnet_reset_wait(struct util_wait *wait)
 		return;
 
 	wait_fd = container_of(wait, struct util_wait_fd, util_wait);
-	fd_signal_reset(&wait_fd->signal);
+	ofi_wait_fd_reset(wait_fd);
 }
 
 /* The epoll fd is updated dynamically for polling/pollout events on the
@@ -1694,14 +1696,16 @@ int xnet_progress_wait(struct xnet_progress *progress, int timeout)
 static void *xnet_auto_progress(void *arg)
 {
 	struct xnet_progress *progress = arg;
-	int nfds;
+	int nfds, timeout;
 
 	FI_INFO(&xnet_prov, FI_LOG_DOMAIN, "progress thread starting\n");
 	ofi_genlock_lock(progress->active_lock);
 	while (progress->auto_progress) {
+		timeout = ofi_timer_wheel_timeout(&progress->timer_wheel,
+						  ofi_gettime_ns(), -1);
 		ofi_genlock_unlock(progress->active_lock);
 
-		nfds = xnet_progress_wait(progress, -1);
+		nfds = xnet_progress_wait(progress, timeout);
 		ofi_genlock_lock(progress->active_lock);
 		if (nfds >= 0)
 			xnet_run_progress(progress, true);
@@ -1853,10 +1857,13 @@ static void xnet_destroy_uring(struct xnet_uring *uring,
 
 int xnet_init_progress(struct xnet_progress *progress, struct fi_info *info)
 {
+	int pool_flags = 0;
 	int ret;
 
 	progress->fid.fclass = XNET_CLASS_PROGRESS;
 	progress->auto_progress = false;
+	ofi_timer_wheel_init(&progress->timer_wheel, XNET_TIMER_TICK,
+			     ofi_gettime_ns());
 	dlist_init(&progress->unexp_msg_list);
 	dlist_init(&progress->unexp_tag_list);
 	dlist_init(&progress->saved_tag_list);
@@ -1876,9 +1883,14 @@ int xnet_init_progress(struct xnet_progress *progress, struct fi_info *info)
 	if (ret)
 		goto err2;
 
+	/* Threads of a thread safe domain keep freed entries cached */
+	if (info && info->domain_attr &&
+	    info->domain_attr->threading == FI_THREAD_SAFE)
+		pool_flags = OFI_BUFPOOL_THREAD_CACHE;
+
 	ret = ofi_bufpool_create(&progress->xfer_pool,
 			sizeof(struct xnet_xfer_entry) + xnet_buf_size,
-			16, 0, 1024, 0);
+			16, 0, 1024, pool_flags);
 	if (ret)
 		goto err3;
 
@@ -41,6 +41,9 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
+#ifdef HAVE_SENDMMSG
+#include <netinet/udp.h>
+#endif
 
 #include <rdma/fabric.h>
 #include <rdma/fi_atomic.h>
@@ -79,6 +82,19 @@ int udpx_eq_open(struct fid_fabric *fabric, struct fi_eq_attr *attr,
 
 #define UDPX_FLAG_MULTI_RECV	1
 #define UDPX_IOV_LIMIT		4
+#define UDPX_DEF_MSG_SIZE	1472
+#define UDPX_MAX_MSG_SIZE	65507
+#define UDPX_TX_BATCH		64
+#define UDPX_RX_BATCH		64
+#define UDPX_GSO_MAX_SEGS	64
+#define UDPX_GSO_MAX_SIZE	65000
+
+struct udpx_env {
+	int gso;
+	int max_msg_size;
+};
+
+extern struct udpx_env udpx_env;
 
 struct udpx_ep_entry {
 	void			*context;
@@ -90,6 +106,16 @@ struct udpx_ep_entry {
 
 OFI_DECLARE_CIRQUE(struct udpx_ep_entry, udpx_rx_cirq);
 
+/* Send posted with FI_MORE, queued until the batch is flushed */
+struct udpx_tx_entry {
+	void			*context;
+	struct iovec		iov[UDPX_IOV_LIMIT];
+	size_t			iov_count;
+	size_t			len;
+	struct sockaddr_in6	addr;
+	socklen_t		addrlen;
+};
+
 struct udpx_ep;
 typedef void (*udpx_rx_comp_func)(struct udpx_ep *ep, void *context, size_t len,
 				  void *addr);
@@ -102,7 +128,12 @@ struct udpx_ep {
 	struct udpx_rx_cirq	*rxq;    /* protected by rx_cq lock */
 	SOCKET			sock;
 	int			is_bound;
+	int			gso;
 	ofi_atomic32_t		ref;
+
+	/* protected by tx_cq lock */
+	int			tx_batch_cnt;
+	struct udpx_tx_entry	tx_batch[UDPX_TX_BATCH];
 };
 
 int udpx_endpoint(struct fid_domain *domain, struct fi_info *info,
@@ -272,25 +272,193 @@ static void udpx_rx_src_comp_signal(struct udpx_ep *ep, void *context,
 	ep->util_ep.rx_cq->wait->signal(ep->util_ep.rx_cq->wait);
 }
 
-static void udpx_ep_progress(struct util_ep *util_ep)
+/*
+ * Sends queued with FI_MORE are submitted with a single sendmmsg call.
+ * Consecutive sends of the same size to the same address are coalesced
+ * into one message which the kernel splits into datagrams (UDP GSO).
+ * Only datagrams that fit the default message size are coalesced, as
+ * GSO segments may not exceed the path MTU.
+ * Datagrams that cannot be sent because of a hard error are completed
+ * as lost, matching the unreliable datagram semantics.
+ */
+#ifdef HAVE_SENDMMSG
+static int udpx_tx_build(struct udpx_ep *ep, struct mmsghdr *msgs,
+			 struct iovec *iov, char (*ctrl)[CMSG_SPACE(sizeof(uint16_t))],
+			 int *ent_cnt)
+{
+	struct udpx_tx_entry *entry, *next;
+	struct cmsghdr *cmsg;
+	size_t len;
+	int i, j, n, m;
+
+	for (i = 0, m = 0; i < ep->tx_batch_cnt; i += n, m++) {
+		entry = &ep->tx_batch[i];
+		len = entry->len;
+		for (n = 1; ep->gso && entry->len <= UDPX_DEF_MSG_SIZE &&
+		     i + n < ep->tx_batch_cnt && n < UDPX_GSO_MAX_SEGS; n++) {
+			next = &ep->tx_batch[i + n];
+			if (ep->tx_batch[i + n - 1].len != entry->len ||
+			    next->len > entry->len ||
+			    len + next->len > UDPX_GSO_MAX_SIZE ||
+			    next->addrlen != entry->addrlen ||
+			    memcmp(&next->addr, &entry->addr, entry->addrlen))
+				break;
+			len += next->len;
+		}
+
+		memset(&msgs[m], 0, sizeof(msgs[m]));
+		msgs[m].msg_hdr.msg_name = &entry->addr;
+		msgs[m].msg_hdr.msg_namelen = entry->addrlen;
+		msgs[m].msg_hdr.msg_iov = iov;
+		for (j = 0; j < n; j++) {
+			memcpy(iov, entry[j].iov,
+			       entry[j].iov_count * sizeof(*iov));
+			iov += entry[j].iov_count;
+			msgs[m].msg_hdr.msg_iovlen += entry[j].iov_count;
+		}
+
+#ifdef UDP_SEGMENT
+		if (n > 1) {
+			msgs[m].msg_hdr.msg_control = ctrl[m];
+			msgs[m].msg_hdr.msg_controllen = sizeof(ctrl[m]);
+			cmsg = CMSG_FIRSTHDR(&msgs[m].msg_hdr);
+			cmsg->cmsg_level = IPPROTO_UDP;
+			cmsg->cmsg_type = UDP_SEGMENT;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+			*(uint16_t *) CMSG_DATA(cmsg) = (uint16_t) entry->len;
+		}
+#endif
+		ent_cnt[m] = n;
+	}
+	return m;
+}
+
+static void udpx_tx_flush(struct udpx_ep *ep)
+{
+	struct mmsghdr msgs[UDPX_TX_BATCH];
+	struct iovec iov[UDPX_TX_BATCH * UDPX_IOV_LIMIT];
+	char ctrl[UDPX_TX_BATCH][CMSG_SPACE(sizeof(uint16_t))];
+	int ent_cnt[UDPX_TX_BATCH];
+	int i, m, sent, done;
+
+	while (ep->tx_batch_cnt) {
+		m = udpx_tx_build(ep, msgs, iov, ctrl, ent_cnt);
+		sent = sendmmsg(ep->sock, msgs, m, 0);
+		if (sent < 0) {
+			if (OFI_SOCK_TRY_SND_RCV_AGAIN(errno))
+				return;
+
+			if (ent_cnt[0] > 1 && (errno == EINVAL || errno == EIO)) {
+				FI_INFO(&udpx_prov, FI_LOG_EP_DATA,
+					"UDP GSO not usable, disabling: %s\n",
+					strerror(errno));
+				ep->gso = 0;
+				continue;
+			}
+
+			FI_WARN(&udpx_prov, FI_LOG_EP_DATA,
+				"sendmmsg failed, dropping datagram: %s\n",
+				strerror(errno));
+			sent = 1;
+		}
+
+		for (i = 0, done = 0; i < sent; i++)
+			done += ent_cnt[i];
+		for (i = 0; i < done; i++)
+			ep->tx_comp(ep, ep->tx_batch[i].context);
+
+		ep->tx_batch_cnt -= done;
+		memmove(ep->tx_batch, &ep->tx_batch[done],
+			ep->tx_batch_cnt * sizeof(*ep->tx_batch));
+	}
+}
+#else
+static void udpx_tx_flush(struct udpx_ep *ep)
+{
+	struct udpx_tx_entry *entry;
+	struct msghdr hdr;
+	int i;
+
+	for (i = 0; i < ep->tx_batch_cnt; i++) {
+		entry = &ep->tx_batch[i];
+		hdr.msg_name = &entry->addr;
+		hdr.msg_namelen = entry->addrlen;
+		hdr.msg_iov = entry->iov;
+		hdr.msg_iovlen = entry->iov_count;
+		hdr.msg_control = NULL;
+		hdr.msg_controllen = 0;
+		hdr.msg_flags = 0;
+
+		if (ofi_sendmsg_udp(ep->sock, &hdr, 0) < 0 &&
+		    OFI_SOCK_TRY_SND_RCV_AGAIN(ofi_sockerr()))
+			break;
+		ep->tx_comp(ep, entry->context);
+	}
+
+	ep->tx_batch_cnt -= i;
+	memmove(ep->tx_batch, &ep->tx_batch[i],
+		ep->tx_batch_cnt * sizeof(*ep->tx_batch));
+}
+#endif
+
+static void udpx_tx_progress(struct udpx_ep *ep)
+{
+	ofi_genlock_lock(&ep->util_ep.tx_cq->cq_lock);
+	if (ep->tx_batch_cnt)
+		udpx_tx_flush(ep);
+	ofi_genlock_unlock(&ep->util_ep.tx_cq->cq_lock);
+}
+
+#ifdef HAVE_RECVMMSG
+/* Receive up to one datagram per posted buffer with a single call */
+static void udpx_rx_progress(struct udpx_ep *ep)
+{
+	struct mmsghdr msgs[UDPX_RX_BATCH];
+	struct sockaddr_in6 addr[UDPX_RX_BATCH];
+	struct udpx_ep_entry *entry;
+	size_t cnt, i;
+	int ret;
+
+	cnt = MIN(ofi_cirque_usedcnt(ep->rxq),
+		  ofi_cirque_freecnt(ep->util_ep.rx_cq->cirq));
+	cnt = MIN(cnt, UDPX_RX_BATCH);
+	if (!cnt)
+		return;
+
+	memset(msgs, 0, sizeof(*msgs) * cnt);
+	for (i = 0; i < cnt; i++) {
+		entry = &ep->rxq->buf[(ep->rxq->rcnt + i) &
+				      ep->rxq->size_mask];
+		msgs[i].msg_hdr.msg_name = &addr[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(addr[i]);
+		msgs[i].msg_hdr.msg_iov = entry->iov;
+		msgs[i].msg_hdr.msg_iovlen = entry->iov_count;
+	}
+
+	ret = recvmmsg(ep->sock, msgs, (unsigned int) cnt, 0, NULL);
+	for (i = 0; ret > 0 && i < (size_t) ret; i++) {
+		entry = ofi_cirque_head(ep->rxq);
+		ep->rx_comp(ep, entry->context, msgs[i].msg_len, &addr[i]);
+		ofi_cirque_discard(ep->rxq);
+	}
+}
+#else
+static void udpx_rx_progress(struct udpx_ep *ep)
 {
-	struct udpx_ep *ep;
 	struct udpx_ep_entry *entry;
 	struct msghdr hdr;
 	struct sockaddr_in6 addr;
 	ssize_t ret;
 
-	ep = container_of(util_ep, struct udpx_ep, util_ep);
 	hdr.msg_name = &addr;
 	hdr.msg_namelen = sizeof(addr);
 	hdr.msg_control = NULL;
 	hdr.msg_controllen = 0;
 	hdr.msg_flags = 0;
 
-	ofi_genlock_lock(&ep->util_ep.rx_cq->cq_lock);
 	if (ofi_cirque_isempty(ep->rxq) ||
 	    ofi_cirque_isfull(ep->util_ep.rx_cq->cirq))
-		goto out;
+		return;
 
 	entry = ofi_cirque_head(ep->rxq);
 	hdr.msg_iov = entry->iov;
@@ -301,7 +469,22 @@ static void udpx_ep_progress(struct util_ep *util_ep)
 		ep->rx_comp(ep, entry->context, ret, &addr);
 		ofi_cirque_discard(ep->rxq);
 	}
-out:
+}
+#endif
+
+static void udpx_ep_progress(struct util_ep *util_ep)
+{
+	struct udpx_ep *ep;
+
+	ep = container_of(util_ep, struct udpx_ep, util_ep);
+	if (ep->util_ep.tx_cq)
+		udpx_tx_progress(ep);
+
+	if (!ep->util_ep.rx_cq)
+		return;
+
+	ofi_genlock_lock(&ep->util_ep.rx_cq->cq_lock);
+	udpx_rx_progress(ep);
 	ofi_genlock_unlock(&ep->util_ep.rx_cq->cq_lock);
 }
 
@@ -396,7 +579,11 @@ static ssize_t udpx_sendto(struct udpx_ep *ep, const void *buf, size_t len,
 	ssize_t ret;
 
 	ofi_genlock_lock(&ep->util_ep.tx_cq->cq_lock);
-	if (ofi_cirque_isfull(ep->util_ep.tx_cq->cirq)) {
+	if (ep->tx_batch_cnt)
+		udpx_tx_flush(ep);
+
+	if (ofi_cirque_freecnt(ep->util_ep.tx_cq->cirq) <=
+	    (size_t) ep->tx_batch_cnt) {
 		ret = -FI_EAGAIN;
 		goto out;
 	}
@@ -435,6 +622,36 @@ static ssize_t udpx_send_mc(struct fid_ep *ep_fid, const void *buf, size_t len,
 			   context);
 }
 
+static ssize_t udpx_queue_send(struct udpx_ep *ep, const struct fi_msg *msg,
+			       uint64_t flags)
+{
+	struct udpx_tx_entry *entry;
+	size_t i;
+
+	if (ep->tx_batch_cnt == UDPX_TX_BATCH)
+		udpx_tx_flush(ep);
+
+	if (ep->tx_batch_cnt == UDPX_TX_BATCH ||
+	    ofi_cirque_freecnt(ep->util_ep.tx_cq->cirq) <=
+	    (size_t) ep->tx_batch_cnt)
+		return -FI_EAGAIN;
+
+	entry = &ep->tx_batch[ep->tx_batch_cnt++];
+	entry->context = msg->context;
+	entry->iov_count = msg->iov_count;
+	for (i = 0, entry->len = 0; i < msg->iov_count; i++) {
+		entry->iov[i] = msg->msg_iov[i];
+		entry->len += msg->msg_iov[i].iov_len;
+	}
+	entry->addrlen = (socklen_t) udpx_dest_addrlen(ep, msg->addr, flags);
+	memcpy(&entry->addr, udpx_dest_addr(ep, msg->addr, flags),
+	       entry->addrlen);
+
+	if (!(flags & FI_MORE))
+		udpx_tx_flush(ep);
+	return 0;
+}
+
 static ssize_t udpx_sendmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
 			    uint64_t flags)
 {
@@ -452,6 +669,22 @@ static ssize_t udpx_sendmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
 	hdr.msg_flags = 0;
 
 	ofi_genlock_lock(&ep->util_ep.tx_cq->cq_lock);
+	/* Queued sends reference the caller's buffers until the batch is
+	 * flushed, which inject data may not outlive.  Send it now, behind
+	 * anything already queued.
+	 */
+	if (flags & FI_INJECT) {
+		if (ep->tx_batch_cnt)
+			udpx_tx_flush(ep);
+		if (ep->tx_batch_cnt) {
+			ret = -FI_EAGAIN;
+			goto out;
+		}
+	} else if ((flags & FI_MORE) || ep->tx_batch_cnt) {
+		ret = udpx_queue_send(ep, msg, flags);
+		goto out;
+	}
+
 	if (ofi_cirque_isfull(ep->util_ep.tx_cq->cirq)) {
 		ret = -FI_EAGAIN;
 		goto out;
@@ -560,11 +793,21 @@ static int udpx_ep_close(struct fid *fid)
 		return -FI_EBUSY;
 	}
 
+	if (ep->util_ep.tx_cq) {
+		ofi_genlock_lock(&ep->util_ep.tx_cq->cq_lock);
+		if (ep->tx_batch_cnt)
+			udpx_tx_flush(ep);
+		ofi_genlock_unlock(&ep->util_ep.tx_cq->cq_lock);
+		fid_list_remove2(&ep->util_ep.tx_cq->ep_list,
+				&ep->util_ep.tx_cq->ep_list_lock,
+				&ep->util_ep.ep_fid.fid);
+	}
+
 	if (ep->util_ep.rx_cq) {
 		if (ep->util_ep.rx_cq->wait) {
 			wait = container_of(ep->util_ep.rx_cq->wait,
 					    struct util_wait_fd, util_wait);
-			ofi_epoll_del(wait->epoll_fd, (int)ep->sock);
+			ofi_wait_fdset_del(wait, (int)ep->sock);
 		}
 		fid_list_remove2(&ep->util_ep.rx_cq->ep_list,
 				&ep->util_ep.rx_cq->ep_list_lock,
@@ -593,6 +836,13 @@ static int udpx_ep_bind_cq(struct udpx_ep *ep, struct util_cq *cq,
 		ofi_atomic_inc32(&cq->ref);
 		ep->tx_comp = cq->wait ? udpx_tx_comp_signal :
 					 udpx_tx_comp;
+
+		/* sends queued with FI_MORE are flushed by CQ progress */
+		ret = fid_list_insert2(&cq->ep_list,
+				      &cq->ep_list_lock,
+				      &ep->util_ep.ep_fid.fid);
+		if (ret)
+			return ret;
 	}
 
 	if (flags & FI_RECV) {
@@ -607,8 +857,8 @@ static int udpx_ep_bind_cq(struct udpx_ep *ep, struct util_cq *cq,
 
 			wait = container_of(cq->wait,
 					    struct util_wait_fd, util_wait);
-			ret = ofi_epoll_add(wait->epoll_fd, (int)ep->sock,
-					   OFI_EPOLL_IN, &ep->util_ep.ep_fid.fid);
+			ret = ofi_wait_fdset_add(wait, (int)ep->sock, POLLIN,
+						 &ep->util_ep.ep_fid.fid);
 			if (ret)
 				return ret;
 		} else {
@@ -724,6 +974,20 @@ static struct fi_ops udpx_ep_fi_ops = {
 	.ops_open = fi_no_ops_open,
 };
 
+static void udpx_gso_init(struct udpx_ep *ep)
+{
+#if defined(HAVE_SENDMMSG) && defined(UDP_SEGMENT)
+	socklen_t len;
+	int val;
+
+	len = sizeof(val);
+	ep->gso = udpx_env.gso &&
+		  !getsockopt(ep->sock, IPPROTO_UDP, UDP_SEGMENT, &val, &len);
+#else
+	ep->gso = 0;
+#endif
+}
+
 static int udpx_ep_init(struct udpx_ep *ep, struct fi_info *info)
 {
 	int family;
@@ -755,6 +1019,7 @@ static int udpx_ep_init(struct udpx_ep *ep, struct fi_info *info)
 	if (ret)
 		goto err2;
 
+	udpx_gso_init(ep);
 	return 0;
 err2:
 	ofi_close_socket(ep->sock);
@@ -38,6 +38,11 @@
 #include <sys/types.h>
 
 
+struct udpx_env udpx_env = {
+	.gso = 1,
+	.max_msg_size = UDPX_DEF_MSG_SIZE,
+};
+
 static int udpx_getinfo(uint32_t version, const char *node, const char *service,
 			uint64_t flags, const struct fi_info *hints,
 			struct fi_info **info)
@@ -64,6 +69,24 @@ UDP_INI
 {
 	fi_param_define(&udpx_prov, "iface", FI_PARAM_STRING,
 			"Specify interface name");
+	fi_param_define(&udpx_prov, "gso", FI_PARAM_BOOL,
+			"Coalesce back to back sends of the same size to the "
+			"same peer using UDP segmentation offload (default: "
+			"yes)");
+	fi_param_get_bool(&udpx_prov, "gso", &udpx_env.gso);
+	fi_param_define(&udpx_prov, "max_msg_size", FI_PARAM_INT,
+			"Maximum datagram size to report. Datagrams larger "
+			"than the path MTU are fragmented by IP (default: "
+			"1472, max: 65507)");
+	fi_param_get_int(&udpx_prov, "max_msg_size", &udpx_env.max_msg_size);
+	if (udpx_env.max_msg_size < UDPX_DEF_MSG_SIZE ||
+	    udpx_env.max_msg_size > UDPX_MAX_MSG_SIZE) {
+		FI_WARN(&udpx_prov, FI_LOG_CORE,
+			"invalid max_msg_size %d, using %d\n",
+			udpx_env.max_msg_size, UDPX_DEF_MSG_SIZE);
+		udpx_env.max_msg_size = UDPX_DEF_MSG_SIZE;
+	}
+	udpx_info.ep_attr->max_msg_size = udpx_env.max_msg_size;
 
 	return &udpx_prov;
 }
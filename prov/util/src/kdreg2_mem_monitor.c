@@ -89,12 +89,33 @@ static bool kdreg2_monitor_valid(struct ofi_mem_monitor *monitor,
 	return !kdreg2_mapping_changed(kdreg2->status_data, params);
 }
 
+static void kdreg2_notify_batch(struct ofi_kdreg2 *kdreg2,
+				struct ofi_monitor_batch *batch)
+{
+	if (!batch->cnt)
+		return;
+
+	pthread_rwlock_rdlock(&mm_list_rwlock);
+	pthread_mutex_lock(&mm_lock);
+
+	ofi_monitor_notify_batch(&kdreg2->monitor, batch);
+
+	pthread_mutex_unlock(&mm_lock);
+	pthread_rwlock_unlock(&mm_list_rwlock);
+}
+
+/* Mapping changes are queued and reported to the caches in batches.  The
+ * caches' valid() check catches any lookup made before the batch is
+ * delivered.
+ */
 static int kdreg2_read_evictions(struct ofi_kdreg2 *kdreg2)
 {
+	struct ofi_monitor_batch batch;
 	struct kdreg2_event event;
 	ssize_t bytes;
 	int err;
 
+	ofi_monitor_batch_init(&batch);
 	while (kdreg2_read_counter(&kdreg2->status_data->pending_events) > 0) {
 
 		/* The read should return a multiple of sizeof(event) or
@@ -112,33 +133,33 @@ static int kdreg2_read_evictions(struct ofi_kdreg2 *kdreg2)
 			/* Nothing left */
 			if ((err == EAGAIN) ||
 			    (err == EWOULDBLOCK))
-				return 0;
+				break;
 
 			/* All other errors */
+			kdreg2_notify_batch(kdreg2, &batch);
 			return err;
 		}
 
 		switch (event.type) {
 		case KDREG2_EVENT_MAPPING_CHANGE:
 
-			pthread_rwlock_rdlock(&mm_list_rwlock);
-			pthread_mutex_lock(&mm_lock);
-
-			ofi_monitor_notify(&kdreg2->monitor,
-					   event.u.mapping_change.addr,
-					   event.u.mapping_change.len);
+			if (ofi_monitor_batch_full(&batch))
+				kdreg2_notify_batch(kdreg2, &batch);
 
-			pthread_mutex_unlock(&mm_lock);
-			pthread_rwlock_unlock(&mm_list_rwlock);
+			ofi_monitor_batch_add(&batch,
+					      event.u.mapping_change.addr,
+					      event.u.mapping_change.len);
 
 			break;
 
 		default:
 
+			kdreg2_notify_batch(kdreg2, &batch);
 			return -ENOMSG;
 		}
 	}
 
+	kdreg2_notify_batch(kdreg2, &batch);
 	return 0;
 }
 
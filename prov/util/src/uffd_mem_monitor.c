@@ -97,15 +97,17 @@ static void ofi_uffd_unsubscribe(struct ofi_mem_monitor *monitor,
  */
 static void *ofi_uffd_handler(void *arg)
 {
-	struct uffd_msg msg;
+	struct uffd_msg msg[OFI_MONITOR_BATCH_SIZE];
+	struct ofi_monitor_batch batch;
 	struct pollfd fds[2];
-	int ret;
+	int i, ret;
 
 	fds[0].fd     = uffd.fd;
 	fds[0].events = POLLIN;
 	fds[1].fd     = uffd.exit_pipe[0];
 	fds[1].events = POLLIN;
 
+	ofi_monitor_batch_init(&batch);
 	for (;;) {
 		ret = poll(fds, 2, -1);
 		if (ret < 0 && errno == EINTR)
@@ -114,10 +116,13 @@ static void *ofi_uffd_handler(void *arg)
 		if (ret < 0 || fds[1].revents)
 			break;
 
+		/* Drain all pending events so that the caches are walked
+		 * once for all the ranges they invalidate.
+		 */
 		pthread_rwlock_rdlock(&mm_list_rwlock);
 		pthread_mutex_lock(&mm_lock);
-		ret = read(uffd.fd, &msg, sizeof(msg));
-		if (ret != sizeof(msg)) {
+		ret = read(uffd.fd, msg, sizeof(msg));
+		if (ret < (int) sizeof(*msg)) {
 			pthread_mutex_unlock(&mm_lock);
 			pthread_rwlock_unlock(&mm_list_rwlock);
 			if (errno != EAGAIN && errno != EINTR)
@@ -125,34 +130,39 @@ static void *ofi_uffd_handler(void *arg)
 			continue;
 		}
 
-		FI_DBG(&core_prov, FI_LOG_MR, "Received UFFD event %d\n", msg.event);
-
-		switch (msg.event) {
-		case UFFD_EVENT_REMOVE:
-			ofi_uffd_unsubscribe(&uffd.monitor,
-				(void *) (uintptr_t) msg.arg.remove.start,
-				(size_t) (msg.arg.remove.end -
-					  msg.arg.remove.start), NULL);
-			/* fall through */
-		case UFFD_EVENT_UNMAP:
-			ofi_monitor_notify(&uffd.monitor,
-				(void *) (uintptr_t) msg.arg.remove.start,
-				(size_t) (msg.arg.remove.end -
-					  msg.arg.remove.start));
-			break;
-		case UFFD_EVENT_REMAP:
-			ofi_monitor_notify(&uffd.monitor,
-				(void *) (uintptr_t) msg.arg.remap.from,
-				(size_t) msg.arg.remap.len);
-			break;
-		case UFFD_EVENT_PAGEFAULT:
-			ofi_uffd_pagefault_handler(&msg);
-			break;
-		default:
-			FI_WARN(&core_prov, FI_LOG_MR,
-				"Unhandled uffd event %d\n", msg.event);
-			break;
+		for (i = 0; i < ret / (int) sizeof(*msg); i++) {
+			FI_DBG(&core_prov, FI_LOG_MR,
+			       "Received UFFD event %d\n", msg[i].event);
+
+			switch (msg[i].event) {
+			case UFFD_EVENT_REMOVE:
+				ofi_uffd_unsubscribe(&uffd.monitor,
+					(void *) (uintptr_t) msg[i].arg.remove.start,
+					(size_t) (msg[i].arg.remove.end -
+						  msg[i].arg.remove.start), NULL);
+				/* fall through */
+			case UFFD_EVENT_UNMAP:
+				ofi_monitor_batch_add(&batch,
+					(void *) (uintptr_t) msg[i].arg.remove.start,
+					(size_t) (msg[i].arg.remove.end -
+						  msg[i].arg.remove.start));
+				break;
+			case UFFD_EVENT_REMAP:
+				ofi_monitor_batch_add(&batch,
+					(void *) (uintptr_t) msg[i].arg.remap.from,
+					(size_t) msg[i].arg.remap.len);
+				break;
+			case UFFD_EVENT_PAGEFAULT:
+				ofi_uffd_pagefault_handler(&msg[i]);
+				break;
+			default:
+				FI_WARN(&core_prov, FI_LOG_MR,
+					"Unhandled uffd event %d\n",
+					msg[i].event);
+				break;
+			}
 		}
+		ofi_monitor_notify_batch(&uffd.monitor, &batch);
 		pthread_mutex_unlock(&mm_lock);
 		pthread_rwlock_unlock(&mm_list_rwlock);
 	}
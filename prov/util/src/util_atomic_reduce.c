@@ -0,0 +1,472 @@
+/*
+ * Copyright (c) 2024 Hewlett Packard Enterprise Development LP. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ofi_atomic.h"
+
+/*
+ * The vector kernels rely on GCC target attributes and on
+ * __builtin_cpu_supports for dispatch; other compilers, MSVC included,
+ * only get the scalar loops.
+ */
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(_MSC_VER)
+#define OFI_REDUCE_X86 1
+#define OFI_REDUCE_NEON 0
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON) && !defined(_MSC_VER)
+#define OFI_REDUCE_X86 0
+#define OFI_REDUCE_NEON 1
+#include <arm_neon.h>
+#else
+#define OFI_REDUCE_X86 0
+#define OFI_REDUCE_NEON 0
+#endif
+
+/*
+ * Reduction handlers combine two buffers owned by the caller.  Unlike the
+ * write handlers, which must update each target element atomically, they
+ * are free to load and store whole vectors.  The table starts out with the
+ * write handlers, is overlaid with plain loops for the common integer and
+ * floating point types and then with the vector kernels of each instruction
+ * set the CPU supports, up to the one selected by FI_REDUCE_ISA.
+ *
+ * MIN and MAX keep the scalar semantics for NaN: the destination element
+ * is only replaced when the comparison against the source is true.
+ */
+void (*ofi_atomic_reduce_handlers[OFI_WRITE_OP_CNT][OFI_DATATYPE_CNT])
+	(void *dst, const void *src, size_t cnt);
+
+static const char *ofi_reduce_isa = "scalar";
+
+#define OFI_REDUCE_MIN(dst, src)	if ((dst) > (src)) (dst) = (src)
+#define OFI_REDUCE_MAX(dst, src)	if ((dst) < (src)) (dst) = (src)
+#define OFI_REDUCE_SUM(dst, src)	(dst) += (src)
+#define OFI_REDUCE_PROD(dst, src)	(dst) *= (src)
+#define OFI_REDUCE_BOR(dst, src)	(dst) |= (src)
+#define OFI_REDUCE_BAND(dst, src)	(dst) &= (src)
+#define OFI_REDUCE_BXOR(dst, src)	(dst) ^= (src)
+
+#define OFI_DEF_REDUCE_FUNC(op, type)					\
+static void ofi_reduce_## op ##_## type(void *dst, const void *src,	\
+					size_t cnt)			\
+{									\
+	type *d = dst;							\
+	const type *s = src;						\
+	size_t i;							\
+									\
+	for (i = 0; i < cnt; i++)					\
+		OFI_REDUCE_## op(d[i], s[i]);				\
+}
+
+#define OFI_DEF_REDUCE_FUNCS(type)					\
+	OFI_DEF_REDUCE_FUNC(MIN, type)					\
+	OFI_DEF_REDUCE_FUNC(MAX, type)					\
+	OFI_DEF_REDUCE_FUNC(SUM, type)					\
+	OFI_DEF_REDUCE_FUNC(PROD, type)
+
+#define OFI_DEF_REDUCE_INT_FUNCS(type)					\
+	OFI_DEF_REDUCE_FUNCS(type)					\
+	OFI_DEF_REDUCE_FUNC(BOR, type)					\
+	OFI_DEF_REDUCE_FUNC(BAND, type)					\
+	OFI_DEF_REDUCE_FUNC(BXOR, type)
+
+OFI_DEF_REDUCE_INT_FUNCS(int8_t)
+OFI_DEF_REDUCE_INT_FUNCS(uint8_t)
+OFI_DEF_REDUCE_INT_FUNCS(int16_t)
+OFI_DEF_REDUCE_INT_FUNCS(uint16_t)
+OFI_DEF_REDUCE_INT_FUNCS(int32_t)
+OFI_DEF_REDUCE_INT_FUNCS(uint32_t)
+OFI_DEF_REDUCE_INT_FUNCS(int64_t)
+OFI_DEF_REDUCE_INT_FUNCS(uint64_t)
+OFI_DEF_REDUCE_FUNCS(float)
+OFI_DEF_REDUCE_FUNCS(double)
+
+#define OFI_SET_REDUCE(op, dt, func)					\
+	ofi_atomic_reduce_handlers[FI_## op][dt] = func
+
+#define OFI_SET_REDUCE_FUNCS(dt, type)					\
+	OFI_SET_REDUCE(MIN, dt, ofi_reduce_MIN_## type);		\
+	OFI_SET_REDUCE(MAX, dt, ofi_reduce_MAX_## type);		\
+	OFI_SET_REDUCE(SUM, dt, ofi_reduce_SUM_## type);		\
+	OFI_SET_REDUCE(PROD, dt, ofi_reduce_PROD_## type)
+
+#define OFI_SET_REDUCE_INT_FUNCS(dt, type)				\
+	OFI_SET_REDUCE_FUNCS(dt, type);					\
+	OFI_SET_REDUCE(BOR, dt, ofi_reduce_BOR_## type);		\
+	OFI_SET_REDUCE(BAND, dt, ofi_reduce_BAND_## type);		\
+	OFI_SET_REDUCE(BXOR, dt, ofi_reduce_BXOR_## type)
+
+static void ofi_reduce_set_scalar(void)
+{
+	OFI_SET_REDUCE_INT_FUNCS(FI_INT8, int8_t);
+	OFI_SET_REDUCE_INT_FUNCS(FI_UINT8, uint8_t);
+	OFI_SET_REDUCE_INT_FUNCS(FI_INT16, int16_t);
+	OFI_SET_REDUCE_INT_FUNCS(FI_UINT16, uint16_t);
+	OFI_SET_REDUCE_INT_FUNCS(FI_INT32, int32_t);
+	OFI_SET_REDUCE_INT_FUNCS(FI_UINT32, uint32_t);
+	OFI_SET_REDUCE_INT_FUNCS(FI_INT64, int64_t);
+	OFI_SET_REDUCE_INT_FUNCS(FI_UINT64, uint64_t);
+	OFI_SET_REDUCE_FUNCS(FI_FLOAT, float);
+	OFI_SET_REDUCE_FUNCS(FI_DOUBLE, double);
+}
+
+/*
+ * Vector kernels.  The source vector is passed first to vop, which matters
+ * for MIN and MAX only: the x86 min/max instructions return their second
+ * operand when the comparison is false, matching OFI_REDUCE_MIN/MAX.  The
+ * tail that does not fill a whole vector goes through the scalar macro.
+ */
+#define OFI_DEF_REDUCE_VEC(isa, op, type, ld, st, vop)			\
+static void OFI_REDUCE_TARGET_## isa					\
+ofi_reduce_## op ##_## type ##_## isa(void *dst, const void *src,	\
+				     size_t cnt)			\
+{									\
+	type *d = dst;							\
+	const type *s = src;						\
+	size_t i;							\
+									\
+	for (i = 0; i + OFI_REDUCE_WIDTH_## isa / sizeof(type) <= cnt;	\
+	     i += OFI_REDUCE_WIDTH_## isa / sizeof(type))		\
+		st(d + i, vop(ld(s + i), ld(d + i)));			\
+	for (; i < cnt; i++)						\
+		OFI_REDUCE_## op(d[i], s[i]);				\
+}
+
+#define OFI_SET_REDUCE_VEC(isa, op, dt, type)				\
+	OFI_SET_REDUCE(op, dt, ofi_reduce_## op ##_## type ##_## isa)
+
+#if OFI_REDUCE_X86
+
+#define OFI_REDUCE_TARGET_sse41		__attribute__((target("sse4.1")))
+#define OFI_REDUCE_TARGET_avx2		__attribute__((target("avx2")))
+#define OFI_REDUCE_TARGET_avx512f	__attribute__((target("avx512f")))
+#define OFI_REDUCE_WIDTH_sse41		16
+#define OFI_REDUCE_WIDTH_avx2		32
+#define OFI_REDUCE_WIDTH_avx512f	64
+
+#define OFI_LD_SI_sse41(p)	_mm_loadu_si128((const void *) (p))
+#define OFI_ST_SI_sse41(p, v)	_mm_storeu_si128((void *) (p), v)
+#define OFI_LD_SI_avx2(p)	_mm256_loadu_si256((const void *) (p))
+#define OFI_ST_SI_avx2(p, v)	_mm256_storeu_si256((void *) (p), v)
+#define OFI_LD_SI_avx512f(p)	_mm512_loadu_si512((const void *) (p))
+#define OFI_ST_SI_avx512f(p, v)	_mm512_storeu_si512((void *) (p), v)
+
+/* w is the intrinsic prefix width (empty for 128-bit), b the si suffix */
+#define OFI_DEF_REDUCE_X86_FP(isa, w, type, sfx)			\
+	OFI_DEF_REDUCE_VEC(isa, MIN, type, _mm## w ##_loadu_## sfx,	\
+			   _mm## w ##_storeu_## sfx, _mm## w ##_min_## sfx) \
+	OFI_DEF_REDUCE_VEC(isa, MAX, type, _mm## w ##_loadu_## sfx,	\
+			   _mm## w ##_storeu_## sfx, _mm## w ##_max_## sfx) \
+	OFI_DEF_REDUCE_VEC(isa, SUM, type, _mm## w ##_loadu_## sfx,	\
+			   _mm## w ##_storeu_## sfx, _mm## w ##_add_## sfx) \
+	OFI_DEF_REDUCE_VEC(isa, PROD, type, _mm## w ##_loadu_## sfx,	\
+			   _mm## w ##_storeu_## sfx, _mm## w ##_mul_## sfx)
+
+#define OFI_DEF_REDUCE_X86_BIT(isa, w, b, type)				\
+	OFI_DEF_REDUCE_VEC(isa, BOR, type, OFI_LD_SI_## isa,		\
+			   OFI_ST_SI_## isa, _mm## w ##_or_si## b)	\
+	OFI_DEF_REDUCE_VEC(isa, BAND, type, OFI_LD_SI_## isa,		\
+			   OFI_ST_SI_## isa, _mm## w ##_and_si## b)	\
+	OFI_DEF_REDUCE_VEC(isa, BXOR, type, OFI_LD_SI_## isa,		\
+			   OFI_ST_SI_## isa, _mm## w ##_xor_si## b)
+
+#define OFI_DEF_REDUCE_X86_I32(isa, w, b, type, sign)			\
+	OFI_DEF_REDUCE_VEC(isa, MIN, type, OFI_LD_SI_## isa,		\
+			   OFI_ST_SI_## isa, _mm## w ##_min_ep## sign ##32) \
+	OFI_DEF_REDUCE_VEC(isa, MAX, type, OFI_LD_SI_## isa,		\
+			   OFI_ST_SI_## isa, _mm## w ##_max_ep## sign ##32) \
+	OFI_DEF_REDUCE_VEC(isa, SUM, type, OFI_LD_SI_## isa,		\
+			   OFI_ST_SI_## isa, _mm## w ##_add_epi32)	\
+	OFI_DEF_REDUCE_VEC(isa, PROD, type, OFI_LD_SI_## isa,		\
+			   OFI_ST_SI_## isa, _mm## w ##_mullo_epi32)	\
+	OFI_DEF_REDUCE_X86_BIT(isa, w, b, type)
+
+#define OFI_DEF_REDUCE_X86_I64(isa, w, b, type)				\
+	OFI_DEF_REDUCE_VEC(isa, SUM, type, OFI_LD_SI_## isa,		\
+			   OFI_ST_SI_## isa, _mm## w ##_add_epi64)	\
+	OFI_DEF_REDUCE_X86_BIT(isa, w, b, type)
+
+#define OFI_DEF_REDUCE_X86(isa, w, b)					\
+	OFI_DEF_REDUCE_X86_FP(isa, w, float, ps)			\
+	OFI_DEF_REDUCE_X86_FP(isa, w, double, pd)			\
+	OFI_DEF_REDUCE_X86_I32(isa, w, b, int32_t, i)			\
+	OFI_DEF_REDUCE_X86_I32(isa, w, b, uint32_t, u)			\
+	OFI_DEF_REDUCE_X86_I64(isa, w, b, int64_t)			\
+	OFI_DEF_REDUCE_X86_I64(isa, w, b, uint64_t)
+
+OFI_DEF_REDUCE_X86(sse41, , 128)
+OFI_DEF_REDUCE_X86(avx2, 256, 256)
+OFI_DEF_REDUCE_X86(avx512f, 512, 512)
+
+/* 64-bit integer min/max first appear with AVX-512 */
+OFI_DEF_REDUCE_VEC(avx512f, MIN, int64_t, OFI_LD_SI_avx512f,
+		   OFI_ST_SI_avx512f, _mm512_min_epi64)
+OFI_DEF_REDUCE_VEC(avx512f, MAX, int64_t, OFI_LD_SI_avx512f,
+		   OFI_ST_SI_avx512f, _mm512_max_epi64)
+OFI_DEF_REDUCE_VEC(avx512f, MIN, uint64_t, OFI_LD_SI_avx512f,
+		   OFI_ST_SI_avx512f, _mm512_min_epu64)
+OFI_DEF_REDUCE_VEC(avx512f, MAX, uint64_t, OFI_LD_SI_avx512f,
+		   OFI_ST_SI_avx512f, _mm512_max_epu64)
+
+#define OFI_SET_REDUCE_X86(isa)						\
+	OFI_SET_REDUCE_VEC(isa, MIN, FI_FLOAT, float);			\
+	OFI_SET_REDUCE_VEC(isa, MAX, FI_FLOAT, float);			\
+	OFI_SET_REDUCE_VEC(isa, SUM, FI_FLOAT, float);			\
+	OFI_SET_REDUCE_VEC(isa, PROD, FI_FLOAT, float);			\
+	OFI_SET_REDUCE_VEC(isa, MIN, FI_DOUBLE, double);		\
+	OFI_SET_REDUCE_VEC(isa, MAX, FI_DOUBLE, double);		\
+	OFI_SET_REDUCE_VEC(isa, SUM, FI_DOUBLE, double);		\
+	OFI_SET_REDUCE_VEC(isa, PROD, FI_DOUBLE, double);		\
+	OFI_SET_REDUCE_VEC(isa, MIN, FI_INT32, int32_t);		\
+	OFI_SET_REDUCE_VEC(isa, MAX, FI_INT32, int32_t);		\
+	OFI_SET_REDUCE_VEC(isa, SUM, FI_INT32, int32_t);		\
+	OFI_SET_REDUCE_VEC(isa, PROD, FI_INT32, int32_t);		\
+	OFI_SET_REDUCE_VEC(isa, BOR, FI_INT32, int32_t);		\
+	OFI_SET_REDUCE_VEC(isa, BAND, FI_INT32, int32_t);		\
+	OFI_SET_REDUCE_VEC(isa, BXOR, FI_INT32, int32_t);		\
+	OFI_SET_REDUCE_VEC(isa, MIN, FI_UINT32, uint32_t);		\
+	OFI_SET_REDUCE_VEC(isa, MAX, FI_UINT32, uint32_t);		\
+	OFI_SET_REDUCE_VEC(isa, SUM, FI_UINT32, uint32_t);		\
+	OFI_SET_REDUCE_VEC(isa, PROD, FI_UINT32, uint32_t);		\
+	OFI_SET_REDUCE_VEC(isa, BOR, FI_UINT32, uint32_t);		\
+	OFI_SET_REDUCE_VEC(isa, BAND, FI_UINT32, uint32_t);		\
+	OFI_SET_REDUCE_VEC(isa, BXOR, FI_UINT32, uint32_t);		\
+	OFI_SET_REDUCE_VEC(isa, SUM, FI_INT64, int64_t);		\
+	OFI_SET_REDUCE_VEC(isa, BOR, FI_INT64, int64_t);		\
+	OFI_SET_REDUCE_VEC(isa, BAND, FI_INT64, int64_t);		\
+	OFI_SET_REDUCE_VEC(isa, BXOR, FI_INT64, int64_t);		\
+	OFI_SET_REDUCE_VEC(isa, SUM, FI_UINT64, uint64_t);		\
+	OFI_SET_REDUCE_VEC(isa, BOR, FI_UINT64, uint64_t);		\
+	OFI_SET_REDUCE_VEC(isa, BAND, FI_UINT64, uint64_t);		\
+	OFI_SET_REDUCE_VEC(isa, BXOR, FI_UINT64, uint64_t)
+
+static bool ofi_reduce_has_sse41(void)
+{
+	return __builtin_cpu_supports("sse4.1");
+}
+
+static void ofi_reduce_set_sse41(void)
+{
+	OFI_SET_REDUCE_X86(sse41);
+}
+
+static bool ofi_reduce_has_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+
+static void ofi_reduce_set_avx2(void)
+{
+	OFI_SET_REDUCE_X86(avx2);
+}
+
+static bool ofi_reduce_has_avx512f(void)
+{
+	return __builtin_cpu_supports("avx512f");
+}
+
+static void ofi_reduce_set_avx512f(void)
+{
+	OFI_SET_REDUCE_X86(avx512f);
+	OFI_SET_REDUCE_VEC(avx512f, MIN, FI_INT64, int64_t);
+	OFI_SET_REDUCE_VEC(avx512f, MAX, FI_INT64, int64_t);
+	OFI_SET_REDUCE_VEC(avx512f, MIN, FI_UINT64, uint64_t);
+	OFI_SET_REDUCE_VEC(avx512f, MAX, FI_UINT64, uint64_t);
+}
+
+#elif OFI_REDUCE_NEON
+
+#define OFI_REDUCE_TARGET_neon
+#define OFI_REDUCE_WIDTH_neon	16
+
+/* NEON min/max propagate NaN, so select on the comparison instead. */
+static inline float32x4_t ofi_neon_min_f32(float32x4_t s, float32x4_t d)
+{
+	return vbslq_f32(vcltq_f32(s, d), s, d);
+}
+
+static inline float32x4_t ofi_neon_max_f32(float32x4_t s, float32x4_t d)
+{
+	return vbslq_f32(vcgtq_f32(s, d), s, d);
+}
+
+static inline float64x2_t ofi_neon_min_f64(float64x2_t s, float64x2_t d)
+{
+	return vbslq_f64(vcltq_f64(s, d), s, d);
+}
+
+static inline float64x2_t ofi_neon_max_f64(float64x2_t s, float64x2_t d)
+{
+	return vbslq_f64(vcgtq_f64(s, d), s, d);
+}
+
+#define OFI_DEF_REDUCE_NEON_FP(type, sfx)				\
+	OFI_DEF_REDUCE_VEC(neon, MIN, type, vld1q_## sfx, vst1q_## sfx,	\
+			   ofi_neon_min_## sfx)				\
+	OFI_DEF_REDUCE_VEC(neon, MAX, type, vld1q_## sfx, vst1q_## sfx,	\
+			   ofi_neon_max_## sfx)				\
+	OFI_DEF_REDUCE_VEC(neon, SUM, type, vld1q_## sfx, vst1q_## sfx,	\
+			   vaddq_## sfx)				\
+	OFI_DEF_REDUCE_VEC(neon, PROD, type, vld1q_## sfx, vst1q_## sfx, \
+			   vmulq_## sfx)
+
+#define OFI_DEF_REDUCE_NEON_BIT(type, sfx)				\
+	OFI_DEF_REDUCE_VEC(neon, SUM, type, vld1q_## sfx, vst1q_## sfx,	\
+			   vaddq_## sfx)				\
+	OFI_DEF_REDUCE_VEC(neon, BOR, type, vld1q_## sfx, vst1q_## sfx,	\
+			   vorrq_## sfx)				\
+	OFI_DEF_REDUCE_VEC(neon, BAND, type, vld1q_## sfx, vst1q_## sfx, \
+			   vandq_## sfx)				\
+	OFI_DEF_REDUCE_VEC(neon, BXOR, type, vld1q_## sfx, vst1q_## sfx, \
+			   veorq_## sfx)
+
+#define OFI_DEF_REDUCE_NEON_I32(type, sfx)				\
+	OFI_DEF_REDUCE_VEC(neon, MIN, type, vld1q_## sfx, vst1q_## sfx,	\
+			   vminq_## sfx)				\
+	OFI_DEF_REDUCE_VEC(neon, MAX, type, vld1q_## sfx, vst1q_## sfx,	\
+			   vmaxq_## sfx)				\
+	OFI_DEF_REDUCE_VEC(neon, PROD, type, vld1q_## sfx, vst1q_## sfx, \
+			   vmulq_## sfx)				\
+	OFI_DEF_REDUCE_NEON_BIT(type, sfx)
+
+OFI_DEF_REDUCE_NEON_FP(float, f32)
+OFI_DEF_REDUCE_NEON_FP(double, f64)
+OFI_DEF_REDUCE_NEON_I32(int32_t, s32)
+OFI_DEF_REDUCE_NEON_I32(uint32_t, u32)
+OFI_DEF_REDUCE_NEON_BIT(int64_t, s64)
+OFI_DEF_REDUCE_NEON_BIT(uint64_t, u64)
+
+/* Advanced SIMD is mandatory on aarch64. */
+static bool ofi_reduce_has_neon(void)
+{
+	return true;
+}
+
+static void ofi_reduce_set_neon(void)
+{
+	OFI_SET_REDUCE_VEC(neon, MIN, FI_FLOAT, float);
+	OFI_SET_REDUCE_VEC(neon, MAX, FI_FLOAT, float);
+	OFI_SET_REDUCE_VEC(neon, SUM, FI_FLOAT, float);
+	OFI_SET_REDUCE_VEC(neon, PROD, FI_FLOAT, float);
+	OFI_SET_REDUCE_VEC(neon, MIN, FI_DOUBLE, double);
+	OFI_SET_REDUCE_VEC(neon, MAX, FI_DOUBLE, double);
+	OFI_SET_REDUCE_VEC(neon, SUM, FI_DOUBLE, double);
+	OFI_SET_REDUCE_VEC(neon, PROD, FI_DOUBLE, double);
+	OFI_SET_REDUCE_VEC(neon, MIN, FI_INT32, int32_t);
+	OFI_SET_REDUCE_VEC(neon, MAX, FI_INT32, int32_t);
+	OFI_SET_REDUCE_VEC(neon, SUM, FI_INT32, int32_t);
+	OFI_SET_REDUCE_VEC(neon, PROD, FI_INT32, int32_t);
+	OFI_SET_REDUCE_VEC(neon, BOR, FI_INT32, int32_t);
+	OFI_SET_REDUCE_VEC(neon, BAND, FI_INT32, int32_t);
+	OFI_SET_REDUCE_VEC(neon, BXOR, FI_INT32, int32_t);
+	OFI_SET_REDUCE_VEC(neon, MIN, FI_UINT32, uint32_t);
+	OFI_SET_REDUCE_VEC(neon, MAX, FI_UINT32, uint32_t);
+	OFI_SET_REDUCE_VEC(neon, SUM, FI_UINT32, uint32_t);
+	OFI_SET_REDUCE_VEC(neon, PROD, FI_UINT32, uint32_t);
+	OFI_SET_REDUCE_VEC(neon, BOR, FI_UINT32, uint32_t);
+	OFI_SET_REDUCE_VEC(neon, BAND, FI_UINT32, uint32_t);
+	OFI_SET_REDUCE_VEC(neon, BXOR, FI_UINT32, uint32_t);
+	OFI_SET_REDUCE_VEC(neon, SUM, FI_INT64, int64_t);
+	OFI_SET_REDUCE_VEC(neon, BOR, FI_INT64, int64_t);
+	OFI_SET_REDUCE_VEC(neon, BAND, FI_INT64, int64_t);
+	OFI_SET_REDUCE_VEC(neon, BXOR, FI_INT64, int64_t);
+	OFI_SET_REDUCE_VEC(neon, SUM, FI_UINT64, uint64_t);
+	OFI_SET_REDUCE_VEC(neon, BOR, FI_UINT64, uint64_t);
+	OFI_SET_REDUCE_VEC(neon, BAND, FI_UINT64, uint64_t);
+	OFI_SET_REDUCE_VEC(neon, BXOR, FI_UINT64, uint64_t);
+}
+
+#endif
+
+/* Instruction sets in increasing order, each one a superset of the last */
+static const struct {
+	const char *name;
+	bool (*supported)(void);
+	void (*set)(void);
+} ofi_reduce_isas[] = {
+	{ "scalar", NULL, ofi_reduce_set_scalar },
+#if OFI_REDUCE_X86
+	{ "sse4.1", ofi_reduce_has_sse41, ofi_reduce_set_sse41 },
+	{ "avx2", ofi_reduce_has_avx2, ofi_reduce_set_avx2 },
+	{ "avx512f", ofi_reduce_has_avx512f, ofi_reduce_set_avx512f },
+#elif OFI_REDUCE_NEON
+	{ "neon", ofi_reduce_has_neon, ofi_reduce_set_neon },
+#endif
+};
+
+int ofi_atomic_reduce_init(const char *isa)
+{
+	size_t i;
+
+#if OFI_REDUCE_X86
+	__builtin_cpu_init();
+#endif
+	memcpy(ofi_atomic_reduce_handlers, ofi_atomic_write_handlers,
+	       sizeof(ofi_atomic_reduce_handlers));
+
+	for (i = 0; i < ARRAY_SIZE(ofi_reduce_isas); i++) {
+		if (ofi_reduce_isas[i].supported &&
+		    !ofi_reduce_isas[i].supported())
+			break;
+
+		ofi_reduce_isas[i].set();
+		ofi_reduce_isa = ofi_reduce_isas[i].name;
+		if (isa && !strcasecmp(isa, ofi_reduce_isa))
+			return FI_SUCCESS;
+	}
+
+	return isa ? -FI_ENOSYS : FI_SUCCESS;
+}
+
+const char *ofi_atomic_reduce_isa(void)
+{
+	return ofi_reduce_isa;
+}
+
+void ofi_atomic_init(void)
+{
+	char *isa = NULL;
+
+	fi_param_define(NULL, "reduce_isa", FI_PARAM_STRING,
+			"Highest instruction set used by the local reduction "
+			"kernels of collective operations: scalar, sse4.1, "
+			"avx2, avx512f or neon (default: best supported by "
+			"the CPU)");
+	fi_param_get_str(NULL, "reduce_isa", &isa);
+
+	if (ofi_atomic_reduce_init(isa))
+		FI_WARN(&core_prov, FI_LOG_CORE,
+			"reduce_isa %s not supported, using %s\n", isa,
+			ofi_reduce_isa);
+	else
+		FI_INFO(&core_prov, FI_LOG_CORE,
+			"using %s reduction kernels\n", ofi_reduce_isa);
+}
@@ -49,6 +49,7 @@
 #endif
 
 #include <ofi_util.h>
+#include <fasthash.h>
 
 
 enum {
@@ -279,13 +280,165 @@ int ofi_verify_av_insert(struct util_av *av, uint64_t flags, void *context)
 	return 0;
 }
 
+/*
+ * Open addressing reverse index.
+ *
+ * Collisions are resolved by linear probing, and removals shift the
+ * following slots back instead of leaving tombstones.  The table is kept
+ * at most half full.  The address of an AV entry is only compared when
+ * the hash stored in the slot matches.
+ */
+static inline uint32_t util_av_hash(struct util_av *av, const void *addr)
+{
+	return fasthash32(addr, av->addrlen, 0);
+}
+
+static struct util_av_slot *
+util_av_slot_find(struct util_av *av, const void *addr, uint32_t hash)
+{
+	struct util_av_entry *entry;
+	size_t mask = av->slot_cnt - 1;
+	size_t i;
+
+	for (i = hash & mask; av->slots[i].index; i = (i + 1) & mask) {
+		if (av->slots[i].hash != hash)
+			continue;
+
+		entry = ofi_bufpool_get_ibuf(av->av_entry_pool,
+					     av->slots[i].index - 1);
+		if (!memcmp(entry->data, addr, av->addrlen))
+			return &av->slots[i];
+	}
+	return NULL;
+}
+
+static void util_av_slot_set(struct util_av_slot *slots, size_t slot_cnt,
+			     uint32_t hash, size_t index)
+{
+	size_t i;
+
+	assert(index < UINT32_MAX);
+	for (i = hash & (slot_cnt - 1); slots[i].index;
+	     i = (i + 1) & (slot_cnt - 1))
+		;
+
+	slots[i].hash = hash;
+	slots[i].index = (uint32_t) index + 1;
+}
+
+static int util_av_slots_resize(struct util_av *av, size_t slot_cnt)
+{
+	struct util_av_slot *slots;
+	size_t i;
+
+	slots = calloc(slot_cnt, sizeof(*slots));
+	if (!slots)
+		return -FI_ENOMEM;
+
+	for (i = 0; i < av->slot_cnt; i++) {
+		if (av->slots[i].index)
+			util_av_slot_set(slots, slot_cnt, av->slots[i].hash,
+					 av->slots[i].index - 1);
+	}
+
+	free(av->slots);
+	av->slots = slots;
+	av->slot_cnt = slot_cnt;
+	return 0;
+}
+
+/* Make room in the reverse index for count more addresses. */
+static int util_av_reserve(struct util_av *av, size_t count)
+{
+	size_t need;
+
+	if (!av->slots)
+		return 0;
+
+	need = (av->addr_cnt + count) * 2;
+	if (need <= av->slot_cnt)
+		return 0;
+
+	return util_av_slots_resize(av, roundup_power_of_two(need));
+}
+
+static struct util_av_entry *
+util_av_find_entry(struct util_av *av, const void *addr)
+{
+	struct util_av_entry *entry = NULL;
+	struct util_av_slot *slot;
+
+	if (!av->slots) {
+		HASH_FIND(hh, av->hash, addr, av->addrlen, entry);
+		return entry;
+	}
+
+	slot = util_av_slot_find(av, addr, util_av_hash(av, addr));
+	return slot ? ofi_bufpool_get_ibuf(av->av_entry_pool, slot->index - 1) :
+		      NULL;
+}
+
+static int util_av_add_entry(struct util_av *av, struct util_av_entry *entry)
+{
+	int ret;
+
+	if (!av->slots) {
+		HASH_ADD(hh, av->hash, data, av->addrlen, entry);
+		return 0;
+	}
+
+	ret = util_av_reserve(av, 1);
+	if (ret)
+		return ret;
+
+	util_av_slot_set(av->slots, av->slot_cnt,
+			 util_av_hash(av, entry->data), ofi_buf_index(entry));
+	av->addr_cnt++;
+	return 0;
+}
+
+/* Removes an entry from the reverse index.  The caller frees the entry. */
+void ofi_av_del_entry(struct util_av *av, struct util_av_entry *entry)
+{
+	size_t mask = av->slot_cnt - 1;
+	size_t i, j, home;
+
+	assert(ofi_genlock_held(&av->lock));
+	if (!av->slots) {
+		HASH_DELETE(hh, av->hash, entry);
+		return;
+	}
+
+	for (i = util_av_hash(av, entry->data) & mask;
+	     av->slots[i].index != ofi_buf_index(entry) + 1;
+	     i = (i + 1) & mask)
+		assert(av->slots[i].index);
+
+	/* Move back any following slot whose probe sequence crosses i. */
+	for (j = (i + 1) & mask; av->slots[j].index; j = (j + 1) & mask) {
+		home = av->slots[j].hash & mask;
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			av->slots[i] = av->slots[j];
+			i = j;
+		}
+	}
+	av->slots[i].index = 0;
+	av->addr_cnt--;
+}
+
+size_t ofi_av_addr_cnt(struct util_av *av)
+{
+	return av->slots ? av->addr_cnt : HASH_CNT(hh, av->hash);
+}
+
 int ofi_av_insert_addr_at(struct util_av *av, const void *addr, fi_addr_t fi_addr)
 {
 	struct util_av_entry *entry = NULL;
+	int ret;
 
 	assert(ofi_genlock_held(&av->lock));
 	ofi_av_straddr_log(av, FI_LOG_INFO, "inserting addr", addr);
-	HASH_FIND(hh, av->hash, addr, av->addrlen, entry);
+	entry = util_av_find_entry(av, addr);
 	if (entry) {
 		if (fi_addr == ofi_buf_index(entry))
 			return FI_SUCCESS;
@@ -300,7 +453,11 @@ int ofi_av_insert_addr_at(struct util_av *av, const void *addr, fi_addr_t fi_add
 
 	memcpy(entry->data, addr, av->addrlen);
 	ofi_atomic_initialize32(&entry->use_cnt, 1);
-	HASH_ADD(hh, av->hash, data, av->addrlen, entry);
+	ret = util_av_add_entry(av, entry);
+	if (ret) {
+		ofi_ibuf_free(entry);
+		return ret;
+	}
 	FI_INFO(av->prov, FI_LOG_AV, "fi_addr: %zu\n",
 		ofi_buf_index(entry));
 	return 0;
@@ -309,10 +466,11 @@ int ofi_av_insert_addr_at(struct util_av *av, const void *addr, fi_addr_t fi_add
 int ofi_av_insert_addr(struct util_av *av, const void *addr, fi_addr_t *fi_addr)
 {
 	struct util_av_entry *entry = NULL;
+	int ret;
 
 	assert(ofi_genlock_held(&av->lock));
 	ofi_av_straddr_log(av, FI_LOG_INFO, "inserting addr", addr);
-	HASH_FIND(hh, av->hash, addr, av->addrlen, entry);
+	entry = util_av_find_entry(av, addr);
 	if (entry) {
 		if (fi_addr)
 			*fi_addr = ofi_buf_index(entry);
@@ -327,17 +485,44 @@ int ofi_av_insert_addr(struct util_av *av, const void *addr, fi_addr_t *fi_addr)
 			return -FI_ENOMEM;
 		}
 
-		if (fi_addr)
-			*fi_addr = ofi_buf_index(entry);
 		memcpy(entry->data, addr, av->addrlen);
 		ofi_atomic_initialize32(&entry->use_cnt, 1);
-		HASH_ADD(hh, av->hash, data, av->addrlen, entry);
+		ret = util_av_add_entry(av, entry);
+		if (ret) {
+			ofi_ibuf_free(entry);
+			if (fi_addr)
+				*fi_addr = FI_ADDR_NOTAVAIL;
+			return ret;
+		}
+		if (fi_addr)
+			*fi_addr = ofi_buf_index(entry);
 		FI_INFO(av->prov, FI_LOG_AV, "fi_addr: %zu\n",
 			ofi_buf_index(entry));
 	}
 	return 0;
 }
 
+/* Inserts count addresses of addrlen bytes each, stored back to back.  The
+ * reverse index is grown once for the whole block.  If fi_addr is given,
+ * it receives FI_ADDR_NOTAVAIL for addresses which could not be inserted.
+ * Returns the number of addresses inserted.
+ */
+size_t ofi_av_insert_addrs(struct util_av *av, const void *addr, size_t count,
+			   fi_addr_t *fi_addr)
+{
+	size_t i, success_cnt = 0;
+
+	assert(ofi_genlock_held(&av->lock));
+	(void) util_av_reserve(av, count);
+	for (i = 0; i < count; i++) {
+		if (!ofi_av_insert_addr(av, (const char *) addr +
+					i * av->addrlen,
+					fi_addr ? &fi_addr[i] : NULL))
+			success_cnt++;
+	}
+	return success_cnt;
+}
+
 int ofi_av_remove_addr(struct util_av *av, fi_addr_t fi_addr)
 {
 	struct util_av_entry *av_entry;
@@ -350,7 +535,7 @@ int ofi_av_remove_addr(struct util_av *av, fi_addr_t fi_addr)
 	if (ofi_atomic_dec32(&av_entry->use_cnt))
 		return FI_SUCCESS;
 
-	HASH_DELETE(hh, av->hash, av_entry);
+	ofi_av_del_entry(av, av_entry);
 	FI_DBG(av->prov, FI_LOG_AV, "av_remove fi_addr: %" PRIu64 "\n", fi_addr);
 	ofi_ibuf_free(av_entry);
 	return 0;
@@ -358,9 +543,9 @@ int ofi_av_remove_addr(struct util_av *av, fi_addr_t fi_addr)
 
 fi_addr_t ofi_av_lookup_fi_addr_unsafe(struct util_av *av, const void *addr)
 {
-	struct util_av_entry *entry = NULL;
+	struct util_av_entry *entry;
 
-	HASH_FIND(hh, av->hash, addr, av->addrlen, entry);
+	entry = util_av_find_entry(av, addr);
 	return entry ? ofi_buf_index(entry) : FI_ADDR_NOTAVAIL;
 }
 
@@ -383,6 +568,8 @@ ofi_av_lookup_addr(struct util_av *av, fi_addr_t fi_addr, size_t *addrlen)
 static void util_av_close(struct util_av *av)
 {
 	HASH_CLEAR(hh, av->hash);
+	free(av->slots);
+	av->slots = NULL;
 	ofi_bufpool_destroy(av->av_entry_pool);
 }
 
@@ -479,9 +666,23 @@ static int util_av_init(struct util_av *av, const struct fi_av_attr *attr,
 	av->context_offset = offset + av->addrlen;
 	av->flags = util_attr->flags | attr->flags;
 	av->hash = NULL;
+	av->slots = NULL;
+	av->slot_cnt = 0;
+	av->addr_cnt = 0;
+
+	if (ofi_av_flat_index) {
+		ret = util_av_slots_resize(av, orig_size * 2);
+		if (ret)
+			return ret;
+	}
 
 	pool_attr.chunk_cnt = orig_size;
-	return ofi_bufpool_create_attr(&pool_attr, &av->av_entry_pool);
+	ret = ofi_bufpool_create_attr(&pool_attr, &av->av_entry_pool);
+	if (ret) {
+		free(av->slots);
+		av->slots = NULL;
+	}
+	return ret;
 }
 
 static int util_verify_av_attr(struct util_domain *domain,
@@ -644,6 +845,10 @@ int ofi_ip_av_insertv(struct util_av *av, const void *addr, size_t addrlen,
 		memset(sync_err, 0, sizeof(*sync_err) * count);
 	}
 
+	ofi_genlock_lock(&av->lock);
+	(void) util_av_reserve(av, count);
+	ofi_genlock_unlock(&av->lock);
+
 	for (i = 0; i < count; i++) {
 		ret = ip_av_insert_addr(av, (const char *) addr + i * addrlen,
 					fi_addr ? &fi_addr[i] : NULL, context);
@@ -56,9 +56,55 @@ ofi_bufpool_track_mem(size_t size)
 #endif
 
 enum {
-	OFI_BUFPOOL_REGION_CHUNK_CNT = 16
+	OFI_BUFPOOL_REGION_CHUNK_CNT = 16,
+	OFI_BUFPOOL_CACHE_SLOTS = 64,
+	OFI_BUFPOOL_MAG_SIZE = 32,
+	OFI_BUFPOOL_DEPOT_CHUNK_CNT = 16,
 };
 
+#ifndef OFI_CACHE_LINE_SIZE
+#define OFI_CACHE_LINE_SIZE 64
+#endif
+
+/*
+ * Per-thread caching follows the magazine design of the Solaris slab
+ * allocator.  A magazine is a list of up to OFI_BUFPOOL_MAG_SIZE free
+ * buffers.  Every slot owns a loaded and a previous magazine; allocations
+ * pop from the loaded magazine and frees push onto it.  When the loaded
+ * magazine runs empty or full it is swapped with the previous one, and
+ * only if that does not help is a full magazine exchanged with the depot.
+ * Each exchange moves a whole magazine by relinking its list head, so
+ * the depot lock is taken at most once every OFI_BUFPOOL_MAG_SIZE
+ * operations.  Threads are spread round robin across the slots, and a
+ * slot lock is only contended when more threads than slots use the pool.
+ */
+struct ofi_bufpool_mag {
+	struct slist			list;
+	size_t				cnt;
+};
+
+struct ofi_bufpool_slot {
+	ofi_spin_t			lock;
+	struct ofi_bufpool_mag		loaded;
+	struct ofi_bufpool_mag		prev;
+} __attribute__((aligned(OFI_CACHE_LINE_SIZE)));
+
+struct ofi_bufpool_cache {
+	ofi_spin_t			lock;
+	pthread_mutex_t			grow_lock;
+	struct ofi_bufpool_mag		*full;
+	size_t				full_cnt;
+	size_t				full_size;
+	struct ofi_bufpool_slot		slot[OFI_BUFPOOL_CACHE_SLOTS];
+};
+
+/* A thread's slot id indexes the slot[] array of every cached pool, so
+ * it is assigned from a process wide count rather than per pool.
+ */
+static OFI_THREAD_LOCAL int ofi_bufpool_slot_id = -1;
+static pthread_mutex_t ofi_bufpool_slot_lock = PTHREAD_MUTEX_INITIALIZER;
+static int ofi_bufpool_slot_cnt;
+
 
 static int ofi_bufpool_region_alloc(struct ofi_bufpool_region *buf_region)
 {
@@ -132,24 +178,12 @@ static void ofi_bufpool_region_free(struct ofi_bufpool_region *buf_region)
 	}
 }
 
-int ofi_bufpool_grow(struct ofi_bufpool *pool)
+/* Allocate a region and run alloc_fn on it, without touching pool lists */
+static int ofi_bufpool_region_create(struct ofi_bufpool *pool,
+				     struct ofi_bufpool_region **region)
 {
 	struct ofi_bufpool_region *buf_region;
-	struct ofi_bufpool_hdr *buf_hdr;
-	void *buf;
 	int ret;
-	size_t i;
-
-	size_t mem_allocated = 0;
-
-	FI_DBG(&core_prov, FI_LOG_CORE, "%s pool %p  size %zu region_size %zu "
-	       "entry_cnt %d chunk_cnt %d\n",
-		__func__, pool, pool->alloc_size, pool->region_size,
-		(int)(pool->entry_cnt+pool->attr.chunk_cnt),
-		(int)pool->attr.chunk_cnt);
-
-	if (pool->attr.max_cnt && pool->entry_cnt >= pool->attr.max_cnt)
-		return -FI_ENOMEM;
 
 	buf_region = calloc(1, sizeof(*buf_region));
 	if (!buf_region)
@@ -166,8 +200,6 @@ int ofi_bufpool_grow(struct ofi_bufpool *pool)
 		goto err1;
 	}
 
-	mem_allocated += buf_region->pool->alloc_size;
-
 	if (!(pool->attr.flags & OFI_BUFPOOL_NO_ZERO))
 		memset(buf_region->alloc_region, 0, pool->alloc_size);
 	buf_region->mem_region = buf_region->alloc_region + pool->entry_size;
@@ -177,16 +209,42 @@ int ofi_bufpool_grow(struct ofi_bufpool *pool)
 			goto err2;
 	}
 
+	*region = buf_region;
+	return 0;
+
+err2:
+	ofi_bufpool_region_free(buf_region);
+err1:
+	free(buf_region);
+	return ret;
+}
+
+static void ofi_bufpool_region_destroy(struct ofi_bufpool_region *buf_region)
+{
+	if (buf_region->pool->attr.free_fn)
+		buf_region->pool->attr.free_fn(buf_region);
+	ofi_bufpool_region_free(buf_region);
+	free(buf_region);
+}
+
+/* Add a created region to the region table and its buffers to the pool */
+static int ofi_bufpool_region_insert(struct ofi_bufpool *pool,
+				     struct ofi_bufpool_region *buf_region)
+{
+	struct ofi_bufpool_hdr *buf_hdr;
+	void *buf;
+	size_t i;
+
+	size_t mem_allocated = pool->alloc_size;
+
 	if (!(pool->region_cnt % OFI_BUFPOOL_REGION_CHUNK_CNT)) {
 		struct ofi_bufpool_region **new_table;
 
 		new_table = realloc(pool->region_table,
 				(pool->region_cnt + OFI_BUFPOOL_REGION_CHUNK_CNT) *
 				sizeof(*pool->region_table));
-		if (!new_table) {
-			ret = -FI_ENOMEM;
-			goto err3;
-		}
+		if (!new_table)
+			return -FI_ENOMEM;
 		pool->region_table = new_table;
 		mem_allocated += OFI_BUFPOOL_REGION_CHUNK_CNT *
 				 sizeof(*pool->region_table);
@@ -228,22 +286,273 @@ int ofi_bufpool_grow(struct ofi_bufpool *pool)
 
 	ofi_bufpool_track_mem(mem_allocated);
 	return 0;
+}
 
-err3:
-	if (pool->attr.free_fn)
-	    pool->attr.free_fn(buf_region);
-err2:
-	ofi_bufpool_region_free(buf_region);
-err1:
-	free(buf_region);
+int ofi_bufpool_grow(struct ofi_bufpool *pool)
+{
+	struct ofi_bufpool_region *buf_region;
+	int ret;
+
+	FI_DBG(&core_prov, FI_LOG_CORE, "%s pool %p  size %zu region_size %zu "
+	       "entry_cnt %d chunk_cnt %d\n",
+		__func__, pool, pool->alloc_size, pool->region_size,
+		(int)(pool->entry_cnt+pool->attr.chunk_cnt),
+		(int)pool->attr.chunk_cnt);
+
+	if (pool->attr.max_cnt && pool->entry_cnt >= pool->attr.max_cnt)
+		return -FI_ENOMEM;
+
+	ret = ofi_bufpool_region_create(pool, &buf_region);
+	if (ret)
+		return ret;
+
+	ret = ofi_bufpool_region_insert(pool, buf_region);
+	if (ret)
+		ofi_bufpool_region_destroy(buf_region);
+	return ret;
+}
+
+static void ofi_bufpool_mag_swap(struct ofi_bufpool_slot *slot)
+{
+	struct ofi_bufpool_mag tmp;
+
+	tmp = slot->loaded;
+	slot->loaded = slot->prev;
+	slot->prev = tmp;
+}
+
+/* Caller holds the depot lock */
+static void ofi_bufpool_depot_put(struct ofi_bufpool *pool,
+				  struct ofi_bufpool_mag *mag)
+{
+	struct ofi_bufpool_cache *cache = pool->cache;
+	struct ofi_bufpool_mag *new_full;
+
+	if (cache->full_cnt == cache->full_size) {
+		new_full = realloc(cache->full, (cache->full_size +
+				   OFI_BUFPOOL_DEPOT_CHUNK_CNT) *
+				   sizeof(*cache->full));
+		if (!new_full) {
+			/* Hand the buffers back to the pool free list */
+			if (!slist_empty(&pool->free_list.entries)) {
+				mag->list.tail->next =
+					pool->free_list.entries.head;
+				mag->list.tail = pool->free_list.entries.tail;
+			}
+			pool->free_list.entries = mag->list;
+			goto out;
+		}
+		cache->full = new_full;
+		cache->full_size += OFI_BUFPOOL_DEPOT_CHUNK_CNT;
+	}
+
+	cache->full[cache->full_cnt++] = *mag;
+out:
+	slist_init(&mag->list);
+	mag->cnt = 0;
+}
+
+/*
+ * Return the magazines of all other slots to the depot.  Used before
+ * failing an allocation from a pool limited by max_cnt, so that buffers
+ * parked in the caches of idle threads remain usable.  Slot locks are
+ * normally taken before the depot lock, so only try them here.
+ */
+static void ofi_bufpool_depot_reclaim(struct ofi_bufpool *pool,
+				      struct ofi_bufpool_slot *self)
+{
+	struct ofi_bufpool_cache *cache = pool->cache;
+	struct ofi_bufpool_slot *slot;
+	int i;
+
+	for (i = 0; i < OFI_BUFPOOL_CACHE_SLOTS; i++) {
+		slot = &cache->slot[i];
+		if (slot == self || ofi_spin_trylock(&slot->lock))
+			continue;
+
+		if (slot->loaded.cnt)
+			ofi_bufpool_depot_put(pool, &slot->loaded);
+		if (slot->prev.cnt)
+			ofi_bufpool_depot_put(pool, &slot->prev);
+		ofi_spin_unlock(&slot->lock);
+	}
+}
+
+/*
+ * Allocating a region, and registering it through alloc_fn, can take a
+ * while, so it is done without the depot lock.  grow_lock serializes
+ * threads that find the depot empty at the same time, so that a burst
+ * of misses adds one region instead of one per thread.  Only linking the
+ * new buffers into the pool happens under the depot lock.
+ */
+static int ofi_bufpool_cache_grow(struct ofi_bufpool *pool)
+{
+	struct ofi_bufpool_cache *cache = pool->cache;
+	struct ofi_bufpool_region *buf_region = NULL;
+	int ret = 0;
+
+	pthread_mutex_lock(&cache->grow_lock);
+	ofi_spin_lock(&cache->lock);
+	if (cache->full_cnt || !ofi_bufpool_empty(pool))
+		goto unlock;
+
+	if (pool->attr.max_cnt && pool->entry_cnt >= pool->attr.max_cnt) {
+		ret = -FI_ENOMEM;
+		goto unlock;
+	}
+	ofi_spin_unlock(&cache->lock);
+
+	ret = ofi_bufpool_region_create(pool, &buf_region);
+	if (ret)
+		goto out;
+
+	ofi_spin_lock(&cache->lock);
+	ret = ofi_bufpool_region_insert(pool, buf_region);
+unlock:
+	ofi_spin_unlock(&cache->lock);
+	if (ret && buf_region)
+		ofi_bufpool_region_destroy(buf_region);
+out:
+	pthread_mutex_unlock(&cache->grow_lock);
 	return ret;
 }
 
+static int ofi_bufpool_depot_get(struct ofi_bufpool *pool,
+				 struct ofi_bufpool_slot *slot)
+{
+	struct ofi_bufpool_cache *cache = pool->cache;
+	struct ofi_bufpool_mag *mag = &slot->loaded;
+	struct slist_entry *entry;
+	int ret = 0;
+
+	assert(!mag->cnt);
+	ofi_spin_lock(&cache->lock);
+	while (!cache->full_cnt && ofi_bufpool_empty(pool)) {
+		ofi_spin_unlock(&cache->lock);
+		ret = ofi_bufpool_cache_grow(pool);
+		ofi_spin_lock(&cache->lock);
+		if (ret) {
+			ofi_bufpool_depot_reclaim(pool, slot);
+			if (!cache->full_cnt && ofi_bufpool_empty(pool))
+				goto unlock;
+			ret = 0;
+		}
+	}
+
+	if (cache->full_cnt) {
+		*mag = cache->full[--cache->full_cnt];
+		goto unlock;
+	}
+
+	while (mag->cnt < OFI_BUFPOOL_MAG_SIZE && !ofi_bufpool_empty(pool)) {
+		entry = slist_remove_head(&pool->free_list.entries);
+		slist_insert_tail(entry, &mag->list);
+		mag->cnt++;
+	}
+unlock:
+	ofi_spin_unlock(&cache->lock);
+	return ret;
+}
+
+static struct ofi_bufpool_slot *ofi_bufpool_get_slot(struct ofi_bufpool *pool)
+{
+	if (OFI_UNLIKELY(ofi_bufpool_slot_id < 0)) {
+		pthread_mutex_lock(&ofi_bufpool_slot_lock);
+		ofi_bufpool_slot_id = ofi_bufpool_slot_cnt++ %
+				      OFI_BUFPOOL_CACHE_SLOTS;
+		pthread_mutex_unlock(&ofi_bufpool_slot_lock);
+	}
+	return &pool->cache->slot[ofi_bufpool_slot_id];
+}
+
+void *ofi_bufpool_cache_alloc(struct ofi_bufpool *pool)
+{
+	struct ofi_bufpool_slot *slot = ofi_bufpool_get_slot(pool);
+	struct ofi_bufpool_hdr *buf_hdr;
+
+	ofi_spin_lock(&slot->lock);
+	if (!slot->loaded.cnt) {
+		if (slot->prev.cnt) {
+			ofi_bufpool_mag_swap(slot);
+		} else if (ofi_bufpool_depot_get(pool, slot)) {
+			ofi_spin_unlock(&slot->lock);
+			return NULL;
+		}
+	}
+
+	slist_remove_head_container(&slot->loaded.list,
+				struct ofi_bufpool_hdr, buf_hdr, entry.slist);
+	slot->loaded.cnt--;
+	ofi_spin_unlock(&slot->lock);
+
+	assert(ofi_atomic_inc32(&buf_hdr->region->use_cnt));
+	assert(!ofi_buf_is_valid(ofi_buf_data(buf_hdr)));
+
+	buf_hdr->entry.slist.next = &buf_hdr->entry.slist;
+
+	return ofi_buf_data(buf_hdr);
+}
+
+void ofi_bufpool_cache_free(struct ofi_bufpool *pool, void *buf)
+{
+	struct ofi_bufpool_slot *slot = ofi_bufpool_get_slot(pool);
+
+	ofi_spin_lock(&slot->lock);
+	if (slot->loaded.cnt == OFI_BUFPOOL_MAG_SIZE) {
+		if (slot->prev.cnt) {
+			ofi_spin_lock(&pool->cache->lock);
+			ofi_bufpool_depot_put(pool, &slot->prev);
+			ofi_spin_unlock(&pool->cache->lock);
+		}
+		ofi_bufpool_mag_swap(slot);
+	}
+
+	slist_insert_head(&ofi_buf_hdr(buf)->entry.slist, &slot->loaded.list);
+	slot->loaded.cnt++;
+	ofi_spin_unlock(&slot->lock);
+}
+
+static int ofi_bufpool_cache_init(struct ofi_bufpool *pool)
+{
+	struct ofi_bufpool_cache *cache;
+	int i;
+
+	if (ofi_memalign((void **) &cache, OFI_CACHE_LINE_SIZE,
+			 sizeof(*cache)))
+		return -FI_ENOMEM;
+
+	memset(cache, 0, sizeof(*cache));
+	ofi_spin_init(&cache->lock);
+	pthread_mutex_init(&cache->grow_lock, NULL);
+	for (i = 0; i < OFI_BUFPOOL_CACHE_SLOTS; i++) {
+		ofi_spin_init(&cache->slot[i].lock);
+		slist_init(&cache->slot[i].loaded.list);
+		slist_init(&cache->slot[i].prev.list);
+	}
+
+	pool->cache = cache;
+	return 0;
+}
+
+static void ofi_bufpool_cache_cleanup(struct ofi_bufpool *pool)
+{
+	struct ofi_bufpool_cache *cache = pool->cache;
+	int i;
+
+	for (i = 0; i < OFI_BUFPOOL_CACHE_SLOTS; i++)
+		ofi_spin_destroy(&cache->slot[i].lock);
+	ofi_spin_destroy(&cache->lock);
+	pthread_mutex_destroy(&cache->grow_lock);
+	free(cache->full);
+	ofi_freealign(cache);
+}
+
 int ofi_bufpool_create_attr(struct ofi_bufpool_attr *attr,
 			      struct ofi_bufpool **buf_pool)
 {
 	struct ofi_bufpool *pool;
 	size_t entry_sz;
+	int ret;
 
 	pool = calloc(1, sizeof(**buf_pool));
 	if (!pool)
@@ -267,6 +576,15 @@ int ofi_bufpool_create_attr(struct ofi_bufpool_attr *attr,
 	else
 		slist_init(&pool->free_list.entries);
 
+	if (pool->attr.flags & OFI_BUFPOOL_THREAD_CACHE) {
+		ret = (pool->attr.flags & OFI_BUFPOOL_INDEXED) ? -FI_EINVAL :
+		      ofi_bufpool_cache_init(pool);
+		if (ret) {
+			free(pool);
+			return ret;
+		}
+	}
+
 	pool->alloc_size = (pool->attr.chunk_cnt + 1) * pool->entry_size;
 	pool->region_size = pool->alloc_size - pool->entry_size;
 
@@ -297,6 +615,8 @@ void ofi_bufpool_destroy(struct ofi_bufpool *pool)
 		free(buf_region);
 	}
 	free(pool->region_table);
+	if (pool->cache)
+		ofi_bufpool_cache_cleanup(pool);
 	free(pool);
 }
 
@@ -39,6 +39,13 @@
 #define UTIL_DEF_CQ_SIZE (1024)
 
 
+static void util_cq_free_aux(struct util_cq_aux_entry *entry)
+{
+	if (entry->comp.err_data_size)
+		free(entry->comp.err_data);
+	free(entry);
+}
+
 /* While the CQ is full, we continue to add new entries to the auxiliary
  * queue.
  */
@@ -46,6 +53,12 @@ static void util_cq_insert_aux(struct util_cq *cq,
 			      struct util_cq_aux_entry *entry)
 {
 	assert(ofi_genlock_held(&cq->cq_lock));
+	if (cq->aq) {
+		slist_insert_tail(&entry->list_entry, &cq->aux_queue);
+		ofi_atomic_inc32(&cq->aux_cnt);
+		return;
+	}
+
 	if (!ofi_cirque_isfull(cq->cirq))
 		ofi_cirque_commit(cq->cirq);
 
@@ -62,7 +75,7 @@ int ofi_cq_write_overflow(struct util_cq *cq, void *context, uint64_t flags,
 
 	assert(ofi_genlock_held(&cq->cq_lock));
 	FI_DBG(cq->domain->prov, FI_LOG_CQ, "writing to CQ overflow list\n");
-	assert(ofi_cirque_freecnt(cq->cirq) <= 1);
+	assert(cq->aq || ofi_cirque_freecnt(cq->cirq) <= 1);
 
 	entry = calloc(1, sizeof(*entry));
 	if (!entry)
@@ -85,7 +98,9 @@ static int util_cq_insert_error(struct util_cq *cq,
 				const struct fi_cq_err_entry *err_entry)
 {
 	struct util_cq_aux_entry *entry;
+	struct util_comp_entry *comp;
 	void *err_data;
+	int64_t pos;
 
 	assert(ofi_genlock_held(&cq->cq_lock));
 	assert(err_entry->err);
@@ -106,10 +121,149 @@ static int util_cq_insert_error(struct util_cq *cq,
 		entry->comp.err_data = err_data;
 	}
 
+	if (cq->aq && !ofi_atomic_get32(&cq->aux_cnt) &&
+	    !util_comp_aq_next(cq->aq, &comp, &pos)) {
+		comp->aux = entry;
+		util_comp_aq_commit(comp, pos);
+		return 0;
+	}
+
 	util_cq_insert_aux(cq, entry);
 	return 0;
 }
 
+/*
+ * Writers only fall back to the overflow list if the ring is full, or if
+ * older entries are still queued there.  This keeps the completions of a
+ * single thread in order.
+ */
+int ofi_cq_write_mpsc(struct util_cq *cq, void *context, uint64_t flags,
+		      size_t len, void *buf, uint64_t data, uint64_t tag,
+		      fi_addr_t src)
+{
+	struct util_comp_entry *comp;
+	int64_t pos;
+	int ret;
+
+	if (!ofi_atomic_get32(&cq->aux_cnt) &&
+	    !util_comp_aq_next(cq->aq, &comp, &pos)) {
+		comp->comp.op_context = context;
+		comp->comp.flags = flags;
+		comp->comp.len = len;
+		comp->comp.buf = buf;
+		comp->comp.data = data;
+		comp->comp.tag = tag;
+		comp->src = src;
+		comp->aux = NULL;
+		util_comp_aq_commit(comp, pos);
+		return 0;
+	}
+
+	ofi_genlock_lock(&cq->cq_lock);
+	ret = ofi_cq_write_overflow(cq, context, flags, len, buf, data, tag,
+				    src);
+	ofi_genlock_unlock(&cq->cq_lock);
+	return ret;
+}
+
+static struct util_comp_entry *util_cq_aq_peek(struct util_comp_aq *aq)
+{
+	struct util_comp_aq_entry *ce;
+
+	ce = &aq->entry[aq->read_pos & aq->size_mask];
+	if (ofi_atomic_load_explicit64(&ce->seq, memory_order_acquire) !=
+	    aq->read_pos + 1)
+		return NULL;
+	return &ce->buf;
+}
+
+/* Move the next entry to err_entry if it reports an error */
+static struct util_cq_aux_entry *util_cq_mpsc_err(struct util_cq *cq)
+{
+	struct util_cq_aux_entry *aux_entry;
+	struct util_comp_entry *comp;
+	int64_t pos;
+
+	assert(ofi_genlock_held(&cq->cq_lock));
+	if (cq->err_entry)
+		return cq->err_entry;
+
+	comp = util_cq_aq_peek(cq->aq);
+	if (comp) {
+		if (!comp->aux)
+			return NULL;
+		if (util_comp_aq_head(cq->aq, &comp, &pos))
+			return NULL;
+		cq->err_entry = comp->aux;
+		util_comp_aq_release(cq->aq, comp, pos);
+		return cq->err_entry;
+	}
+
+	if (slist_empty(&cq->aux_queue))
+		return NULL;
+
+	aux_entry = container_of(cq->aux_queue.head, struct util_cq_aux_entry,
+				 list_entry);
+	if (!aux_entry->comp.err)
+		return NULL;
+
+	slist_remove_head(&cq->aux_queue);
+	ofi_atomic_dec32(&cq->aux_cnt);
+	cq->err_entry = aux_entry;
+	return aux_entry;
+}
+
+ssize_t ofi_cq_read_entries_mpsc(struct util_cq *cq, void *buf, size_t count,
+				 fi_addr_t *src_addr)
+{
+	struct util_cq_aux_entry *aux_entry;
+	struct util_comp_entry *comp;
+	int64_t pos;
+	ssize_t i = 0;
+
+	ofi_genlock_lock(&cq->cq_lock);
+	if (cq->err_data) {
+		free(cq->err_data);
+		cq->err_data = NULL;
+	}
+
+	while (i < (ssize_t) count) {
+		if (util_cq_mpsc_err(cq)) {
+			if (!i)
+				i = -FI_EAVAIL;
+			goto out;
+		}
+
+		if (!util_comp_aq_head(cq->aq, &comp, &pos)) {
+			if (src_addr)
+				src_addr[i] = comp->src;
+			buf = ofi_cq_copy_entries(cq, buf, &comp->comp, 1);
+			util_comp_aq_release(cq->aq, comp, pos);
+			i++;
+			continue;
+		}
+
+		if (slist_empty(&cq->aux_queue))
+			break;
+
+		aux_entry = container_of(slist_remove_head(&cq->aux_queue),
+					 struct util_cq_aux_entry, list_entry);
+		ofi_atomic_dec32(&cq->aux_cnt);
+		if (src_addr)
+			src_addr[i] = aux_entry->src;
+		buf = ofi_cq_copy_entries(cq, buf, (struct fi_cq_tagged_entry *)
+					  &aux_entry->comp, 1);
+		free(aux_entry);
+		i++;
+	}
+
+	if (!i)
+		i = -FI_EAGAIN;
+out:
+	ofi_genlock_unlock(&cq->cq_lock);
+	return i;
+}
+
 int ofi_cq_write_error(struct util_cq *cq,
 		       const struct fi_cq_err_entry *err_entry)
 {
@@ -236,30 +390,6 @@ int ofi_check_cq_attr(const struct fi_provider *prov,
 	return 0;
 }
 
-static void util_cq_read_ctx(void **dst, void *src)
-{
-	*(struct fi_cq_entry *) *dst = *(struct fi_cq_entry *) src;
-	*(char**)dst += sizeof(struct fi_cq_entry);
-}
-
-static void util_cq_read_msg(void **dst, void *src)
-{
-	*(struct fi_cq_msg_entry *) *dst = *(struct fi_cq_msg_entry *) src;
-	*(char**)dst += sizeof(struct fi_cq_msg_entry);
-}
-
-static void util_cq_read_data(void **dst, void *src)
-{
-	*(struct fi_cq_data_entry *) *dst = *(struct fi_cq_data_entry *) src;
-	*(char**)dst += sizeof(struct fi_cq_data_entry);
-}
-
-static void util_cq_read_tagged(void **dst, void *src)
-{
-	*(struct fi_cq_tagged_entry *) *dst = *(struct fi_cq_tagged_entry *) src;
-	*(char **)dst += sizeof(struct fi_cq_tagged_entry);
-}
-
 ssize_t ofi_cq_readfrom(struct fid_cq *cq_fid, void *buf, size_t count,
 			fi_addr_t *src_addr)
 {
@@ -296,20 +426,28 @@ ssize_t ofi_cq_readerr(struct fid_cq *cq_fid, struct fi_cq_err_entry *buf,
 		cq->err_data = NULL;
 	}
 
-	if (ofi_cirque_isempty(cq->cirq) ||
-	    !(ofi_cirque_head(cq->cirq)->flags & UTIL_FLAG_AUX)) {
-		ret = -FI_EAGAIN;
-		goto unlock;
-	}
+	if (cq->aq) {
+		aux_entry = util_cq_mpsc_err(cq);
+		if (!aux_entry) {
+			ret = -FI_EAGAIN;
+			goto unlock;
+		}
+	} else {
+		if (ofi_cirque_isempty(cq->cirq) ||
+		    !(ofi_cirque_head(cq->cirq)->flags & UTIL_FLAG_AUX)) {
+			ret = -FI_EAGAIN;
+			goto unlock;
+		}
 
-	assert(!slist_empty(&cq->aux_queue));
-	aux_entry = container_of(cq->aux_queue.head,
-				 struct util_cq_aux_entry, list_entry);
-	assert(aux_entry->cq_slot == ofi_cirque_head(cq->cirq));
+		assert(!slist_empty(&cq->aux_queue));
+		aux_entry = container_of(cq->aux_queue.head,
+					 struct util_cq_aux_entry, list_entry);
+		assert(aux_entry->cq_slot == ofi_cirque_head(cq->cirq));
 
-	if (!aux_entry->comp.err) {
-		ret = -FI_EAGAIN;
-		goto unlock;
+		if (!aux_entry->comp.err) {
+			ret = -FI_EAGAIN;
+			goto unlock;
+		}
 	}
 
 	ofi_cq_err_memcpy(api_version, buf, &aux_entry->comp);
@@ -330,10 +468,15 @@ ssize_t ofi_cq_readerr(struct fid_cq *cq_fid, struct fi_cq_err_entry *buf,
 		buf->err_data_size = aux_entry->comp.err_data_size;
 	}
 
+	if (cq->aq) {
+		cq->err_entry = NULL;
+		util_cq_free_aux(aux_entry);
+		ret = 1;
+		goto unlock;
+	}
+
 	slist_remove_head(&cq->aux_queue);
-	if (aux_entry->comp.err_data_size)
-		free(aux_entry->comp.err_data);
-	free(aux_entry);
+	util_cq_free_aux(aux_entry);
 	if (slist_empty(&cq->aux_queue)) {
 		ofi_cirque_discard(cq->cirq);
 	} else {
@@ -414,15 +557,25 @@ static struct fi_ops_cq util_cq_ops = {
 
 static void util_peer_cq_cleanup(struct util_cq *cq)
 {
-	struct util_cq_aux_entry *err;
+	struct util_comp_entry *comp;
 	struct slist_entry *entry;
+	int64_t pos;
 
 	while (!slist_empty(&cq->aux_queue)) {
 		entry = slist_remove_head(&cq->aux_queue);
-		err = container_of(entry, struct util_cq_aux_entry, list_entry);
-		if (err->comp.err_data_size)
-			free(err->comp.err_data);
-		free(err);
+		util_cq_free_aux(container_of(entry, struct util_cq_aux_entry,
+					      list_entry));
+	}
+
+	if (cq->aq) {
+		if (cq->err_entry)
+			util_cq_free_aux(cq->err_entry);
+		while (!util_comp_aq_head(cq->aq, &comp, &pos)) {
+			if (comp->aux)
+				util_cq_free_aux(comp->aux);
+			util_comp_aq_release(cq->aq, comp, pos);
+		}
+		util_comp_aq_free(cq->aq);
 	}
 
 	util_comp_cirq_free(cq->cirq);
@@ -538,18 +691,7 @@ static ssize_t util_peer_cq_write(struct fid_peer_cq *cq, void *context,
 	struct util_cq *util_cq = cq->fid.context;
 	int ret;
 
-	util_cq = cq->fid.context;
-
-	ofi_genlock_lock(&util_cq->cq_lock);
-	if (ofi_cirque_freecnt(util_cq->cirq) > 1) {
-		ofi_cq_write_entry(util_cq, context, flags, len, buf, data,
-				     tag);
-		ret = 0;
-	} else {
-		ret = ofi_cq_write_overflow(util_cq, context, flags, len, buf,
-					      data, tag, FI_ADDR_NOTAVAIL);
-	}
-	ofi_genlock_unlock(&util_cq->cq_lock);
+	ret = ofi_cq_write(util_cq, context, flags, len, buf, data, tag);
 
 	if (util_cq->wait)
 		util_cq->wait->signal(util_cq->wait);
@@ -564,16 +706,8 @@ static ssize_t util_peer_cq_write_src(struct fid_peer_cq *cq, void *context,
 	struct util_cq *util_cq = cq->fid.context;
 	int ret;
 
-	ofi_genlock_lock(&util_cq->cq_lock);
-	if (ofi_cirque_freecnt(util_cq->cirq) > 1) {
-		ofi_cq_write_src_entry(util_cq, context, flags, len, buf, data,
-				       tag, src);
-		ret = 0;
-	} else {
-		ret = ofi_cq_write_overflow(util_cq, context, flags, len, buf,
-					      data, tag, src);
-	}
-	ofi_genlock_unlock(&util_cq->cq_lock);
+	ret = ofi_cq_write_src(util_cq, context, flags, len, buf, data, tag,
+			       src);
 
 	if (util_cq->wait)
 		util_cq->wait->signal(util_cq->wait);
@@ -646,8 +780,10 @@ static struct fi_ops util_peer_cq_fi_ops = {
 	.ops_open = fi_no_ops_open,
 };
 
-static int util_init_peer_cq(struct util_cq *cq, struct fi_cq_attr *attr)
+static int util_init_peer_cq(struct util_cq *cq, struct fi_cq_attr *attr,
+			     bool mpsc)
 {
+	size_t size;
 	int ret;
 
 	cq->peer_cq = calloc(1, sizeof(*cq->peer_cq));
@@ -655,20 +791,16 @@ static int util_init_peer_cq(struct util_cq *cq, struct fi_cq_attr *attr)
 		return -FI_ENOMEM;
 
 	slist_init(&cq->aux_queue);
+	ofi_atomic_initialize32(&cq->aux_cnt, 0);
+	cq->err_entry = NULL;
 
 	switch (attr->format) {
 	case FI_CQ_FORMAT_UNSPEC:
 	case FI_CQ_FORMAT_CONTEXT:
-		cq->read_entry = util_cq_read_ctx;
-		break;
 	case FI_CQ_FORMAT_MSG:
-		cq->read_entry = util_cq_read_msg;
-		break;
 	case FI_CQ_FORMAT_DATA:
-		cq->read_entry = util_cq_read_data;
-		break;
 	case FI_CQ_FORMAT_TAGGED:
-		cq->read_entry = util_cq_read_tagged;
+		cq->format = attr->format;
 		break;
 	default:
 		assert(0);
@@ -676,18 +808,30 @@ static int util_init_peer_cq(struct util_cq *cq, struct fi_cq_attr *attr)
 		goto free;
 	}
 
-	cq->cirq = util_comp_cirq_create(attr->size == 0 ? UTIL_DEF_CQ_SIZE : attr->size);
-	if (!cq->cirq) {
-		ret = -FI_ENOMEM;
-		goto free;
+	size = attr->size == 0 ? UTIL_DEF_CQ_SIZE : attr->size;
+	if (mpsc && cq->domain->threading == FI_THREAD_SAFE) {
+		/* Source addresses are kept in the ring slots */
+		cq->aq = util_comp_aq_create(size);
+		if (!cq->aq) {
+			ret = -FI_ENOMEM;
+			goto free;
+		}
+	} else {
+		cq->cirq = util_comp_cirq_create(size);
+		if (!cq->cirq) {
+			ret = -FI_ENOMEM;
+			goto free;
+		}
 	}
 
 	if (cq->domain->info_domain_caps & FI_SOURCE) {
-		cq->src = calloc(cq->cirq->size, sizeof(*cq->src));
-		if (!cq->src) {
-			util_comp_cirq_free(cq->cirq);
-			ret = -FI_ENOMEM;
-			goto free;
+		if (cq->cirq) {
+			cq->src = calloc(cq->cirq->size, sizeof(*cq->src));
+			if (!cq->src) {
+				util_comp_cirq_free(cq->cirq);
+				ret = -FI_ENOMEM;
+				goto free;
+			}
 		}
 		cq->peer_cq->owner_ops = &util_peer_cq_src_owner_ops;
 	} else {
@@ -704,9 +848,10 @@ free:
 	return ret;
 }
 
-int ofi_cq_init(const struct fi_provider *prov, struct fid_domain *domain,
-		 struct fi_cq_attr *attr, struct util_cq *cq,
-		 ofi_cq_progress_func progress, void *context)
+static int util_cq_init(const struct fi_provider *prov,
+			struct fid_domain *domain, struct fi_cq_attr *attr,
+			struct util_cq *cq, ofi_cq_progress_func progress,
+			void *context, bool mpsc)
 {
 	struct fi_wait_attr wait_attr;
 	struct fid_wait *wait;
@@ -753,7 +898,7 @@ int ofi_cq_init(const struct fi_provider *prov, struct fid_domain *domain,
 		cq->peer_cq = ((struct fi_peer_cq_context *) context)->cq;
 		cq->cq_fid.ops = &util_peer_cq_ops;
 	} else {
-		ret = util_init_peer_cq(cq, attr);
+		ret = util_init_peer_cq(cq, attr, mpsc);
 		if (ret)
 			goto destroy2;
 	}
@@ -808,6 +953,20 @@ destroy1:
 	return ret;
 }
 
+int ofi_cq_init(const struct fi_provider *prov, struct fid_domain *domain,
+		 struct fi_cq_attr *attr, struct util_cq *cq,
+		 ofi_cq_progress_func progress, void *context)
+{
+	return util_cq_init(prov, domain, attr, cq, progress, context, false);
+}
+
+int ofi_cq_init_mpsc(const struct fi_provider *prov, struct fid_domain *domain,
+		     struct fi_cq_attr *attr, struct util_cq *cq,
+		     ofi_cq_progress_func progress, void *context)
+{
+	return util_cq_init(prov, domain, attr, cq, progress, context, true);
+}
+
 uint64_t ofi_rx_flags[] = {
 	[ofi_op_msg] = FI_MSG | FI_RECV,
 	[ofi_op_tagged] = FI_RECV | FI_TAGGED,
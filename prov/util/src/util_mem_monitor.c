@@ -277,6 +277,11 @@ void ofi_monitors_init(void)
 	fi_param_define(NULL, "mr_ze_cache_monitor_enabled", FI_PARAM_BOOL,
 			"Enable or disable the oneAPI Level Zero cache memory "
 			"monitor.  Enabled by default.");
+	fi_param_define(NULL, "mr_cache_async_dereg", FI_PARAM_BOOL,
+			"Deregister regions invalidated by the memory monitor"
+			" from a background thread, instead of on the next"
+			" cache lookup.  Only use with providers whose"
+			" deregistration is thread safe.  (default: false)");
 
 	fi_param_get_size_t(NULL, "mr_cache_max_size", &cache_params.max_size);
 	fi_param_get_size_t(NULL, "mr_cache_max_count", &cache_params.max_cnt);
@@ -287,6 +292,8 @@ void ofi_monitors_init(void)
 			  &cache_params.rocr_monitor_enabled);
 	fi_param_get_bool(NULL, "mr_ze_cache_monitor_enabled",
 			  &cache_params.ze_monitor_enabled);
+	fi_param_get_bool(NULL, "mr_cache_async_dereg",
+			  &cache_params.async_dereg);
 
 	if (!cache_params.max_size)
 		cache_params.max_size = ofi_default_cache_size();
@@ -485,6 +492,87 @@ void ofi_monitor_notify(struct ofi_mem_monitor *monitor,
 	}
 }
 
+/* Ranges are usually released in address order, so try the last range
+ * first.  Chains of ranges which only touch through a later addition are
+ * merged when the batch is notified.
+ */
+void ofi_monitor_batch_add(struct ofi_monitor_batch *batch,
+			   const void *addr, size_t len)
+{
+	uintptr_t start = (uintptr_t) addr, end = start + len;
+	uintptr_t cur_start, cur_end;
+	size_t i;
+
+	batch->event_cnt++;
+	for (i = batch->cnt; i > 0; i--) {
+		cur_start = (uintptr_t) batch->range[i - 1].iov_base;
+		cur_end = cur_start + batch->range[i - 1].iov_len;
+		if (start > cur_end || end < cur_start)
+			continue;
+
+		start = MIN(start, cur_start);
+		end = MAX(end, cur_end);
+		batch->range[i - 1].iov_base = (void *) start;
+		batch->range[i - 1].iov_len = end - start;
+		return;
+	}
+
+	assert(!ofi_monitor_batch_full(batch));
+	batch->range[batch->cnt].iov_base = (void *) addr;
+	batch->range[batch->cnt++].iov_len = len;
+}
+
+static int ofi_monitor_range_cmp(const void *a, const void *b)
+{
+	uintptr_t a_start = (uintptr_t) ((const struct iovec *) a)->iov_base;
+	uintptr_t b_start = (uintptr_t) ((const struct iovec *) b)->iov_base;
+
+	return (a_start > b_start) - (a_start < b_start);
+}
+
+static void ofi_monitor_batch_merge(struct ofi_monitor_batch *batch)
+{
+	uintptr_t start, end;
+	size_t i, j;
+
+	qsort(batch->range, batch->cnt, sizeof(*batch->range),
+	      ofi_monitor_range_cmp);
+
+	for (i = 0, j = 1; j < batch->cnt; j++) {
+		start = (uintptr_t) batch->range[i].iov_base;
+		end = start + batch->range[i].iov_len;
+		if ((uintptr_t) batch->range[j].iov_base > end) {
+			batch->range[++i] = batch->range[j];
+			continue;
+		}
+
+		end = MAX(end, (uintptr_t) batch->range[j].iov_base +
+			       batch->range[j].iov_len);
+		batch->range[i].iov_len = end - start;
+	}
+	batch->cnt = i + 1;
+}
+
+/* Must be called with the same locks in place as ofi_monitor_notify().
+ * The batch is empty on return.
+ */
+void ofi_monitor_notify_batch(struct ofi_mem_monitor *monitor,
+			      struct ofi_monitor_batch *batch)
+{
+	struct ofi_mr_cache *cache;
+
+	if (!batch->cnt)
+		return;
+
+	ofi_monitor_batch_merge(batch);
+	dlist_foreach_container(&monitor->list, struct ofi_mr_cache,
+				cache, notify_entries[monitor->iface]) {
+		ofi_mr_cache_notify_batch(cache, batch->range, batch->cnt,
+					  batch->event_cnt);
+	}
+	ofi_monitor_batch_init(batch);
+}
+
 /* Must be called with locks in place like following
  *	pthread_rwlock_rdlock(&mm_list_rwlock);
  *	pthread_mutex_lock(&mm_lock);
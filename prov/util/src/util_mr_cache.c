@@ -185,32 +185,389 @@ static struct ofi_mr_entry *ofi_mr_rbt_overlap(struct ofi_rbmap *tree,
 	return node->data;
 }
 
+#define UTIL_MR_SHARD_TOTAL	(OFI_MR_CACHE_SHARD_CNT + 1)
+
+/* Unlocked tree walks may race with a rebalance.  Give up on walks that
+ * go deeper than any red-black tree which fits in memory could be.
+ */
+#define UTIL_MR_MAX_DEPTH	128
+
+static struct ofi_mr_cache_shard *
+util_mr_shard(struct ofi_mr_cache *cache, const struct iovec *iov)
+{
+	uintptr_t start, end;
+
+	start = (uintptr_t) iov->iov_base >> OFI_MR_CACHE_SHARD_SHIFT;
+	end = (uintptr_t) ofi_iov_end(iov) >> OFI_MR_CACHE_SHARD_SHIFT;
+	if (start != end)
+		return &cache->shards[OFI_MR_CACHE_SHARD_CNT];
+
+	return &cache->shards[start & (OFI_MR_CACHE_SHARD_CNT - 1)];
+}
+
+static inline void util_mr_stat_add(size_t *stat, size_t val)
+{
+	__atomic_fetch_add(stat, val, __ATOMIC_RELAXED);
+}
+
+static inline void util_mr_stat_sub(size_t *stat, size_t val)
+{
+	__atomic_fetch_sub(stat, val, __ATOMIC_RELAXED);
+}
+
+/* Caller must hold the shard lock.  The fence orders the update of seq
+ * against the use count changes which follow in uncache paths, so that an
+ * unlocked reader which won a reference either sees the new seq or
+ * prevents the entry from being declared dead.
+ */
+static inline void util_mr_shard_write_begin(struct ofi_mr_cache_shard *shard)
+{
+	__atomic_store_n(&shard->seq, shard->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void util_mr_shard_write_end(struct ofi_mr_cache_shard *shard)
+{
+	__atomic_store_n(&shard->seq, shard->seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Reference counting for sharded caches.
+ *
+ * A use count of -1 marks a dead entry: one on a dead list, being freed,
+ * or back in the entry pool.  References to any other entry can be taken
+ * without a lock.  Whoever finds an entry through a possibly stale view of
+ * the cache must check afterwards that the view still holds, and drop the
+ * reference if it does not.  Only the thread that moves the count from 0
+ * to -1 may free the entry.
+ *
+ * Cached entries stay on their shard's LRU list while in use.  Eviction
+ * skips entries that are in use and gives a second chance to entries that
+ * were used since it last passed over them.
+ */
+static bool util_mr_entry_get(struct ofi_mr_entry *entry)
+{
+	int cnt;
+
+	cnt = __atomic_load_n(&entry->use_cnt, __ATOMIC_RELAXED);
+	do {
+		if (cnt < 0)
+			return false;
+	} while (!__atomic_compare_exchange_n(&entry->use_cnt, &cnt, cnt + 1,
+					      true, __ATOMIC_SEQ_CST,
+					      __ATOMIC_RELAXED));
+
+	if (!__atomic_load_n(&entry->accessed, __ATOMIC_RELAXED))
+		__atomic_store_n(&entry->accessed, true, __ATOMIC_RELAXED);
+	return true;
+}
+
+/* An entry that is no longer cached is freed by whoever drops its last
+ * reference.  Either this thread sees the node cleared by the uncache path,
+ * or the uncache path sees the use count at 0 and declares the entry dead
+ * itself.
+ */
+static void util_mr_entry_put(struct ofi_mr_cache *cache,
+			      struct ofi_mr_entry *entry)
+{
+	int cnt = 0;
+
+	if (__atomic_sub_fetch(&entry->use_cnt, 1, __ATOMIC_SEQ_CST) > 0 ||
+	    __atomic_load_n(&entry->node, __ATOMIC_SEQ_CST) ||
+	    !__atomic_compare_exchange_n(&entry->use_cnt, &cnt, -1, false,
+					 __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+		return;
+
+	util_mr_stat_sub(&cache->uncached_cnt, 1);
+	util_mr_stat_sub(&cache->uncached_size, entry->info.iov.iov_len);
+	util_mr_free_entry(cache, entry);
+}
+
+/* Look up a cached region containing info without taking the shard lock.
+ * The reference taken on the entry found is only kept if no writer touched
+ * the shard during the walk.  Otherwise the caller falls back to the locked
+ * lookup.
+ */
+static struct ofi_mr_entry *
+util_mr_shard_find_unlocked(struct ofi_mr_cache *cache,
+			    struct ofi_mr_cache_shard *shard,
+			    const struct ofi_mr_info *info)
+{
+	struct ofi_mr_entry *entry = NULL;
+	struct ofi_rbnode *node;
+	uint32_t seq;
+	int depth, ret;
+
+	seq = __atomic_load_n(&shard->seq, __ATOMIC_ACQUIRE);
+	if (seq & 1)
+		return NULL;
+
+	node = __atomic_load_n(&shard->tree.root, __ATOMIC_RELAXED);
+	for (depth = 0; depth < UTIL_MR_MAX_DEPTH; depth++) {
+		if (!node || node == &shard->tree.sentinel)
+			return NULL;
+
+		entry = __atomic_load_n(&node->data, __ATOMIC_RELAXED);
+		if (!entry)
+			return NULL;
+
+		ret = util_mr_find_within(&shard->tree, (void *) info, entry);
+		if (!ret)
+			break;
+
+		node = (ret < 0) ?
+		       __atomic_load_n(&node->left, __ATOMIC_RELAXED) :
+		       __atomic_load_n(&node->right, __ATOMIC_RELAXED);
+	}
+
+	if (depth == UTIL_MR_MAX_DEPTH ||
+	    !ofi_iov_within(&info->iov, &entry->info.iov) ||
+	    !util_mr_entry_get(entry))
+		return NULL;
+
+	if (__atomic_load_n(&shard->seq, __ATOMIC_SEQ_CST) != seq) {
+		util_mr_entry_put(cache, entry);
+		return NULL;
+	}
+
+	return entry;
+}
+
+/* Caller must hold the shard lock. */
+static struct ofi_mr_entry *
+util_mr_shard_find(struct ofi_mr_cache_shard *shard,
+		   struct ofi_mem_monitor *monitor,
+		   const struct ofi_mr_info *info)
+{
+	struct ofi_mr_entry *entry;
+	bool ret;
+
+	entry = ofi_mr_rbt_find(&shard->tree, info);
+	if (!entry || !ofi_iov_within(&info->iov, &entry->info.iov) ||
+	    !monitor->valid(monitor, info, entry))
+		return NULL;
+
+	/* Cached entries are only declared dead under the shard lock. */
+	ret = util_mr_entry_get(entry);
+	assert(ret);
+	(void) ret;
+	return entry;
+}
+
+/* Caller must hold mm_lock and the shard lock. */
+static void util_mr_shard_uncache_entry_storage(struct ofi_mr_cache *cache,
+						struct ofi_mr_cache_shard *shard,
+						struct ofi_mr_entry *entry)
+{
+	struct ofi_mem_monitor *monitor = cache->monitors[entry->info.iface];
+
+	__atomic_store_n(&shard->gen, shard->gen + 1, __ATOMIC_SEQ_CST);
+	util_mr_shard_write_begin(shard);
+	ofi_rbmap_delete(&shard->tree, entry->node);
+	util_mr_shard_write_end(shard);
+	__atomic_store_n(&entry->node, NULL, __ATOMIC_SEQ_CST);
+
+	dlist_remove_init(&entry->list_entry);
+	shard->lru_cnt--;
+
+	ofi_monitor_unsubscribe(monitor, entry->info.iov.iov_base,
+				entry->info.iov.iov_len, &entry->hmem_info);
+
+	util_mr_stat_sub(&cache->cached_cnt, 1);
+	util_mr_stat_sub(&cache->cached_size, entry->info.iov.iov_len);
+}
+
+static void util_mr_shard_uncache_entry(struct ofi_mr_cache *cache,
+					struct ofi_mr_cache_shard *shard,
+					struct ofi_mr_entry *entry)
+{
+	int cnt = 0;
+
+	util_mr_shard_uncache_entry_storage(cache, shard, entry);
+
+	if (__atomic_compare_exchange_n(&entry->use_cnt, &cnt, -1, false,
+					__ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+		dlist_insert_tail(&entry->list_entry,
+				  &shard->dead_region_list);
+		util_mr_stat_add(&cache->dead_cnt, 1);
+	} else {
+		util_mr_stat_add(&cache->uncached_cnt, 1);
+		util_mr_stat_add(&cache->uncached_size,
+				 entry->info.iov.iov_len);
+	}
+}
+
+/* Only the shards of the granules covered by a range, plus the spanning
+ * shard, can hold regions overlapping it.
+ */
+static bool util_mr_shard_covers(size_t idx, const struct iovec *iov)
+{
+	uintptr_t start, end;
+
+	if (idx == OFI_MR_CACHE_SHARD_CNT)
+		return true;
+
+	start = (uintptr_t) iov->iov_base >> OFI_MR_CACHE_SHARD_SHIFT;
+	end = (uintptr_t) ofi_iov_end(iov) >> OFI_MR_CACHE_SHARD_SHIFT;
+	return end - start >= OFI_MR_CACHE_SHARD_CNT - 1 ||
+	       ((idx - start) & (OFI_MR_CACHE_SHARD_CNT - 1)) <= end - start;
+}
+
+/* Each shard lock is taken at most once for the whole batch. */
+static void util_mr_cache_notify_shards(struct ofi_mr_cache *cache,
+					const struct iovec *range, size_t cnt)
+{
+	struct ofi_mr_cache_shard *shard;
+	struct ofi_mr_entry *entry;
+	size_t i, j;
+	bool locked;
+
+	for (i = 0; i < UTIL_MR_SHARD_TOTAL; i++) {
+		shard = &cache->shards[i];
+		locked = false;
+		for (j = 0; j < cnt; j++) {
+			if (!util_mr_shard_covers(i, &range[j]))
+				continue;
+
+			if (!locked) {
+				pthread_mutex_lock(&shard->lock);
+				locked = true;
+			}
+			for (entry = ofi_mr_rbt_overlap(&shard->tree, &range[j]);
+			     entry;
+			     entry = ofi_mr_rbt_overlap(&shard->tree, &range[j]))
+				util_mr_shard_uncache_entry(cache, shard, entry);
+		}
+		if (locked)
+			pthread_mutex_unlock(&shard->lock);
+	}
+}
+
+static void util_mr_cache_dereg_signal(struct ofi_mr_cache *cache)
+{
+	if (!cache->dereg_active ||
+	    !__atomic_load_n(&cache->dead_cnt, __ATOMIC_RELAXED))
+		return;
+
+	pthread_mutex_lock(&cache->dereg_lock);
+	pthread_cond_signal(&cache->dereg_cond);
+	pthread_mutex_unlock(&cache->dereg_lock);
+}
+
+/* Caller must hold ofi_mem_monitor lock as well as unsubscribe from the
+ * ranges.  event_cnt is the number of monitor events merged into them.
+ */
+void ofi_mr_cache_notify_batch(struct ofi_mr_cache *cache,
+			       const struct iovec *range, size_t cnt,
+			       size_t event_cnt)
+{
+	struct ofi_mr_entry *entry;
+	size_t i;
+
+	util_mr_stat_add(&cache->notify_cnt, cnt);
+	util_mr_stat_add(&cache->notify_batch_cnt, 1);
+	util_mr_stat_add(&cache->notify_event_cnt, event_cnt);
+	if (event_cnt > cache->notify_batch_max)
+		cache->notify_batch_max = event_cnt;
+
+	if (cache->shards) {
+		util_mr_cache_notify_shards(cache, range, cnt);
+		util_mr_cache_dereg_signal(cache);
+		return;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		for (entry = ofi_mr_rbt_overlap(&cache->tree, &range[i]); entry;
+		     entry = ofi_mr_rbt_overlap(&cache->tree, &range[i]))
+			util_mr_uncache_entry(cache, entry);
+	}
+}
+
 /* Caller must hold ofi_mem_monitor lock as well as unsubscribe from the region */
 void ofi_mr_cache_notify(struct ofi_mr_cache *cache, const void *addr, size_t len)
 {
-	struct ofi_mr_entry *entry;
 	struct iovec iov;
 
-	cache->notify_cnt++;
 	iov.iov_base = (void *) addr;
 	iov.iov_len = len;
-
-	for (entry = ofi_mr_rbt_overlap(&cache->tree, &iov); entry;
-	     entry = ofi_mr_rbt_overlap(&cache->tree, &iov))
-		util_mr_uncache_entry(cache, entry);
+	ofi_mr_cache_notify_batch(cache, &iov, 1, 1);
 }
 
-/* Function to remove dead regions and prune MR cache size.
- * Returns true if any entries were flushed from the cache.
+/* Eviction walks the shards round robin, starting after the shard that
+ * was last evicted from.  mm_lock is only needed for unsubscribing evicted
+ * regions; dead regions have already been unsubscribed.
  */
-bool ofi_mr_cache_flush(struct ofi_mr_cache *cache, bool flush_lru)
+static void util_mr_cache_flush_shards(struct ofi_mr_cache *cache,
+				       bool flush_lru,
+				       struct dlist_entry *free_list)
+{
+	struct ofi_mr_cache_shard *shard;
+	struct ofi_mr_entry *entry;
+	bool evict = flush_lru;
+	size_t i, idx, scan;
+	int cnt;
+
+	if (flush_lru)
+		pthread_mutex_lock(&mm_lock);
+
+	idx = __atomic_load_n(&cache->evict_shard, __ATOMIC_RELAXED);
+	for (i = 0; i < UTIL_MR_SHARD_TOTAL; i++) {
+		shard = &cache->shards[(idx + i) % UTIL_MR_SHARD_TOTAL];
+		pthread_mutex_lock(&shard->lock);
+		while (!dlist_empty(&shard->dead_region_list)) {
+			dlist_pop_front(&shard->dead_region_list,
+					struct ofi_mr_entry, entry, list_entry);
+			dlist_insert_tail(&entry->list_entry, free_list);
+			util_mr_stat_sub(&cache->dead_cnt, 1);
+		}
+
+		for (scan = 2 * shard->lru_cnt;
+		     evict && scan && !dlist_empty(&shard->lru_list); scan--) {
+			entry = container_of(shard->lru_list.next,
+					     struct ofi_mr_entry, list_entry);
+			cnt = 0;
+			if (__atomic_exchange_n(&entry->accessed, false,
+						__ATOMIC_RELAXED) ||
+			    !__atomic_compare_exchange_n(&entry->use_cnt, &cnt,
+							 -1, false,
+							 __ATOMIC_SEQ_CST,
+							 __ATOMIC_RELAXED)) {
+				dlist_remove(&entry->list_entry);
+				dlist_insert_tail(&entry->list_entry,
+						  &shard->lru_list);
+				continue;
+			}
+
+			util_mr_shard_uncache_entry_storage(cache, shard,
+							    entry);
+			dlist_insert_tail(&entry->list_entry, free_list);
+
+			evict = ofi_mr_cache_full(cache);
+			__atomic_store_n(&cache->evict_shard,
+					 (idx + i + 1) % UTIL_MR_SHARD_TOTAL,
+					 __ATOMIC_RELAXED);
+		}
+		pthread_mutex_unlock(&shard->lock);
+	}
+
+	if (flush_lru)
+		pthread_mutex_unlock(&mm_lock);
+}
+
+/* Returns the number of entries flushed from the cache. */
+static size_t util_mr_cache_flush(struct ofi_mr_cache *cache, bool flush_lru)
 {
 	struct dlist_entry free_list;
 	struct ofi_mr_entry *entry;
-	bool entries_freed;
+	size_t entries_freed = 0;
 
 	dlist_init(&free_list);
 
+	if (cache->shards) {
+		util_mr_cache_flush_shards(cache, flush_lru, &free_list);
+		goto free;
+	}
+
 	pthread_mutex_lock(&mm_lock);
 
 	dlist_splice_tail(&free_list, &cache->dead_region_list);
@@ -227,24 +584,104 @@ bool ofi_mr_cache_flush(struct ofi_mr_cache *cache, bool flush_lru)
 
 	pthread_mutex_unlock(&mm_lock);
 
-	entries_freed = !dlist_empty(&free_list);
-
+free:
 	while(!dlist_empty(&free_list)) {
 		dlist_pop_front(&free_list, struct ofi_mr_entry,
 				entry, list_entry);
 		FI_DBG(cache->prov, FI_LOG_MR, "flush %p (len: %zu)\n",
 			entry->info.iov.iov_base, entry->info.iov.iov_len);
 		util_mr_free_entry(cache, entry);
+		entries_freed++;
 	}
 
 	return entries_freed;
 }
 
+/* Function to remove dead regions and prune MR cache size.
+ * Returns true if any entries were flushed from the cache.
+ */
+bool ofi_mr_cache_flush(struct ofi_mr_cache *cache, bool flush_lru)
+{
+	return util_mr_cache_flush(cache, flush_lru) != 0;
+}
+
+/* Frees the regions killed by monitor notifications outside of mm_lock
+ * and of the notifying thread, so that a burst of invalidations does not
+ * stall the monitor or leave deregistration to the next cache lookup.
+ */
+static void *util_mr_cache_dereg_handler(void *arg)
+{
+	struct ofi_mr_cache *cache = arg;
+	size_t cnt;
+
+	pthread_mutex_lock(&cache->dereg_lock);
+	while (!cache->dereg_stop) {
+		if (!__atomic_load_n(&cache->dead_cnt, __ATOMIC_RELAXED)) {
+			pthread_cond_wait(&cache->dereg_cond,
+					  &cache->dereg_lock);
+			continue;
+		}
+
+		pthread_mutex_unlock(&cache->dereg_lock);
+		cnt = util_mr_cache_flush(cache, false);
+		util_mr_stat_add(&cache->dereg_async_cnt, cnt);
+		pthread_mutex_lock(&cache->dereg_lock);
+	}
+	pthread_mutex_unlock(&cache->dereg_lock);
+	return NULL;
+}
+
+static int util_mr_cache_start_dereg(struct ofi_mr_cache *cache)
+{
+	int ret;
+
+	cache->dereg_active = false;
+	cache->dereg_stop = false;
+	cache->dereg_async_cnt = 0;
+	pthread_mutex_init(&cache->dereg_lock, NULL);
+	pthread_cond_init(&cache->dereg_cond, NULL);
+	if (!cache_params.async_dereg || !cache->shards)
+		return 0;
+
+	ret = pthread_create(&cache->dereg_thread, NULL,
+			     util_mr_cache_dereg_handler, cache);
+	if (ret) {
+		FI_WARN(cache->prov, FI_LOG_MR,
+			"failed to start deregistration thread: %s\n",
+			strerror(ret));
+		pthread_cond_destroy(&cache->dereg_cond);
+		pthread_mutex_destroy(&cache->dereg_lock);
+		return -ret;
+	}
+
+	cache->dereg_active = true;
+	return 0;
+}
+
+static void util_mr_cache_stop_dereg(struct ofi_mr_cache *cache)
+{
+	if (!cache->dereg_active)
+		return;
+
+	pthread_mutex_lock(&cache->dereg_lock);
+	cache->dereg_stop = true;
+	pthread_cond_signal(&cache->dereg_cond);
+	pthread_mutex_unlock(&cache->dereg_lock);
+	pthread_join(cache->dereg_thread, NULL);
+}
+
 void ofi_mr_cache_delete(struct ofi_mr_cache *cache, struct ofi_mr_entry *entry)
 {
 	FI_DBG(cache->prov, FI_LOG_MR, "delete %p (len: %zu)\n",
 	       entry->info.iov.iov_base, entry->info.iov.iov_len);
 
+	if (cache->shards) {
+		util_mr_stat_add(&util_mr_shard(cache,
+				 &entry->info.iov)->delete_cnt, 1);
+		util_mr_entry_put(cache, entry);
+		return;
+	}
+
 	pthread_mutex_lock(&mm_lock);
 	cache->delete_cnt++;
 
@@ -362,6 +799,292 @@ free:
 	return ret;
 }
 
+static struct ofi_rbnode *
+util_mr_shard_node_alloc(struct ofi_mr_cache_shard *shard)
+{
+	struct ofi_rbnode *node = NULL;
+
+	pthread_mutex_lock(&shard->lock);
+	if (shard->tree.free_list)
+		node = ofi_rbnode_alloc(&shard->tree);
+	pthread_mutex_unlock(&shard->lock);
+
+	return node ? node : malloc(sizeof(*node));
+}
+
+/* Same as util_mr_cache_create(), but the region is inserted into the shard
+ * it maps to once the provider has had a chance to expand it.  The node is
+ * set up before it becomes reachable, so that unlocked readers never follow
+ * uninitialized links.  The entry stays dead until it is published, as an
+ * unlocked reader may still hold a stale pointer to its previous use.
+ */
+static int
+util_mr_shard_create(struct ofi_mr_cache *cache, struct ofi_mr_info *info,
+		     struct ofi_mr_entry **entry)
+{
+	struct ofi_mem_monitor *monitor = cache->monitors[info->iface];
+	struct ofi_mr_cache_shard *shard;
+	struct ofi_rbnode *rbnode;
+	struct ofi_mr_entry *cur;
+	int ret;
+
+	assert(monitor);
+
+	FI_DBG(cache->prov, FI_LOG_MR, "create %p (len: %zu)\n",
+	       info->iov.iov_base, info->iov.iov_len);
+
+	*entry = util_mr_entry_alloc(cache);
+	if (!*entry)
+		return -FI_ENOMEM;
+
+	__atomic_store_n(&(*entry)->use_cnt, -1, __ATOMIC_RELAXED);
+	(*entry)->node = NULL;
+	(*entry)->info = *info;
+	(*entry)->accessed = false;
+	dlist_init(&(*entry)->list_entry);
+
+	ret = cache->add_region(cache, *entry);
+	if (ret)
+		goto free;
+
+	assert(ofi_iov_within(&(*info).iov, &(*entry)->info.iov));
+	*info = (*entry)->info;
+
+	shard = util_mr_shard(cache, &info->iov);
+	rbnode = util_mr_shard_node_alloc(shard);
+	if (OFI_UNLIKELY(!rbnode)) {
+		ret = -FI_ENOMEM;
+		goto free;
+	}
+	rbnode->left = &shard->tree.sentinel;
+	rbnode->right = &shard->tree.sentinel;
+	rbnode->parent = NULL;
+	rbnode->data = *entry;
+
+	pthread_mutex_lock(&mm_lock);
+	pthread_mutex_lock(&shard->lock);
+	cur = ofi_mr_rbt_find(&shard->tree, info);
+	if (cur) {
+		ret = -FI_EAGAIN;
+		goto unlock;
+	}
+
+	if (ofi_mr_cache_full(cache)) {
+		util_mr_stat_add(&cache->uncached_cnt, 1);
+		util_mr_stat_add(&cache->uncached_size, info->iov.iov_len);
+		__atomic_store_n(&(*entry)->use_cnt, 1, __ATOMIC_RELAXED);
+	} else {
+		util_mr_shard_write_begin(shard);
+		ret = ofi_rbmap_insert_at(&shard->tree,
+					  (void *) &(*entry)->info,
+					  (void *) *entry, &(*entry)->node,
+					  rbnode);
+		util_mr_shard_write_end(shard);
+		if (ret)
+			goto unlock;
+		rbnode = NULL;
+		__atomic_store_n(&(*entry)->use_cnt, 1, __ATOMIC_RELAXED);
+		dlist_insert_tail(&(*entry)->list_entry, &shard->lru_list);
+		shard->lru_cnt++;
+
+		util_mr_stat_add(&cache->cached_cnt, 1);
+		util_mr_stat_add(&cache->cached_size, info->iov.iov_len);
+
+		ret = ofi_monitor_subscribe(monitor, info->iov.iov_base,
+					    info->iov.iov_len,
+					    &(*entry)->hmem_info);
+		if (ret) {
+			util_mr_shard_uncache_entry_storage(cache, shard,
+							    *entry);
+			util_mr_stat_add(&cache->uncached_cnt, 1);
+			util_mr_stat_add(&cache->uncached_size,
+					 (*entry)->info.iov.iov_len);
+		}
+	}
+	if (rbnode)
+		ofi_rbnode_free(&shard->tree, rbnode);
+	pthread_mutex_unlock(&shard->lock);
+	pthread_mutex_unlock(&mm_lock);
+	return 0;
+
+unlock:
+	if (rbnode)
+		ofi_rbnode_free(&shard->tree, rbnode);
+	pthread_mutex_unlock(&shard->lock);
+	pthread_mutex_unlock(&mm_lock);
+free:
+	util_mr_free_entry(cache, *entry);
+	return ret;
+}
+
+/*
+ * Per-thread front end to the shards: a small direct-mapped table of the
+ * regions last found by each thread, keyed by the exact range and peer that
+ * was looked up.  A slot is only trusted while the shard which holds its
+ * entry has not dropped any region since the slot was filled.
+ */
+#define UTIL_MR_FRONT_SIZE	64
+
+struct util_mr_front_slot {
+	uint64_t			cache_id;
+	const void			*addr;
+	size_t				len;
+	uint64_t			peer_id;
+	struct ofi_mr_cache_shard	*shard;
+	struct ofi_mr_entry		*entry;
+	uint32_t			gen;
+};
+
+static OFI_THREAD_LOCAL struct util_mr_front_slot
+	util_mr_front[UTIL_MR_FRONT_SIZE];
+static uint64_t util_mr_cache_id;
+
+static inline struct util_mr_front_slot *
+util_mr_front_slot(const struct ofi_mr_info *info)
+{
+	uintptr_t addr = (uintptr_t) info->iov.iov_base;
+
+	return &util_mr_front[((addr >> 6) ^ (addr >> 18) ^
+			       info->iov.iov_len) & (UTIL_MR_FRONT_SIZE - 1)];
+}
+
+static struct ofi_mr_entry *
+util_mr_front_find(struct ofi_mr_cache *cache, const struct ofi_mr_info *info)
+{
+	struct util_mr_front_slot *slot = util_mr_front_slot(info);
+
+	if (slot->cache_id != cache->id ||
+	    slot->addr != info->iov.iov_base ||
+	    slot->len != info->iov.iov_len ||
+	    slot->peer_id != info->peer_id ||
+	    __atomic_load_n(&slot->shard->gen, __ATOMIC_RELAXED) != slot->gen ||
+	    !util_mr_entry_get(slot->entry))
+		return NULL;
+
+	/* The entry may have been dropped and reused since the first check. */
+	if (__atomic_load_n(&slot->shard->gen, __ATOMIC_SEQ_CST) != slot->gen) {
+		util_mr_entry_put(cache, slot->entry);
+		return NULL;
+	}
+
+	return slot->entry;
+}
+
+static void util_mr_front_fill(struct ofi_mr_cache *cache,
+			       const struct ofi_mr_info *info,
+			       struct ofi_mr_cache_shard *shard,
+			       struct ofi_mr_entry *entry, uint32_t gen)
+{
+	struct util_mr_front_slot *slot = util_mr_front_slot(info);
+
+	slot->cache_id = cache->id;
+	slot->addr = info->iov.iov_base;
+	slot->len = info->iov.iov_len;
+	slot->peer_id = info->peer_id;
+	slot->shard = shard;
+	slot->entry = entry;
+	slot->gen = gen;
+}
+
+/* A region can be found in the shard of its granule or in the spanning
+ * shard.  Hits on system memory do not take mm_lock: the per-thread front
+ * table is checked first, then the shards are searched without any lock,
+ * then under the shard lock.  Other monitors may
+ * rely on mm_lock in their valid() callback, so it is held throughout.
+ * Misses purge overlapping regions and insert the new one under mm_lock
+ * for monitor (un)subscription, as before.
+ */
+static int util_mr_cache_search_shards(struct ofi_mr_cache *cache,
+				       struct ofi_mem_monitor *monitor,
+				       struct ofi_mr_info *info,
+				       struct ofi_mr_entry **entry)
+{
+	struct ofi_mr_cache_shard *shard[2];
+	bool mm_locked, flush_lru;
+	uint32_t gen;
+	int i, cnt, ret;
+
+	shard[0] = util_mr_shard(cache, &info->iov);
+	shard[1] = &cache->shards[OFI_MR_CACHE_SHARD_CNT];
+	cnt = (shard[0] == shard[1]) ? 1 : 2;
+
+	do {
+		flush_lru = ofi_mr_cache_full(cache);
+		if (flush_lru ||
+		    __atomic_load_n(&cache->dead_cnt, __ATOMIC_RELAXED))
+			ofi_mr_cache_flush(cache, flush_lru);
+
+		util_mr_stat_add(&shard[0]->search_cnt, 1);
+		mm_locked = info->iface != FI_HMEM_SYSTEM ||
+			    monitor == import_monitor;
+		if (mm_locked) {
+			pthread_mutex_lock(&mm_lock);
+		} else {
+			*entry = util_mr_front_find(cache, info);
+			if (*entry) {
+				if (monitor->valid(monitor, info, *entry))
+					goto hit;
+				util_mr_entry_put(cache, *entry);
+			}
+
+			for (i = 0; i < cnt; i++) {
+				gen = __atomic_load_n(&shard[i]->gen,
+						      __ATOMIC_ACQUIRE);
+				*entry = util_mr_shard_find_unlocked(cache,
+							shard[i], info);
+				if (!*entry)
+					continue;
+				if (monitor->valid(monitor, info, *entry)) {
+					util_mr_front_fill(cache, info,
+							   shard[i], *entry,
+							   gen);
+					goto hit;
+				}
+				util_mr_entry_put(cache, *entry);
+			}
+		}
+
+		for (i = 0; i < cnt; i++) {
+			pthread_mutex_lock(&shard[i]->lock);
+			*entry = util_mr_shard_find(shard[i], monitor, info);
+			if (*entry && !mm_locked)
+				util_mr_front_fill(cache, info, shard[i],
+						   *entry, shard[i]->gen);
+			pthread_mutex_unlock(&shard[i]->lock);
+			if (*entry) {
+				if (mm_locked)
+					pthread_mutex_unlock(&mm_lock);
+				goto hit;
+			}
+		}
+
+		/* Purge regions that overlap with new region */
+		if (!mm_locked)
+			pthread_mutex_lock(&mm_lock);
+		for (i = 0; i < cnt; i++) {
+			pthread_mutex_lock(&shard[i]->lock);
+			while ((*entry = ofi_mr_rbt_find(&shard[i]->tree,
+							 info)))
+				util_mr_shard_uncache_entry(cache, shard[i],
+							    *entry);
+			pthread_mutex_unlock(&shard[i]->lock);
+		}
+		pthread_mutex_unlock(&mm_lock);
+
+		ret = util_mr_shard_create(cache, info, entry);
+		if (ret && ret != -FI_EAGAIN) {
+			if (ofi_mr_cache_flush(cache, true))
+				ret = -FI_EAGAIN;
+		}
+	} while (ret == -FI_EAGAIN);
+
+	return ret;
+
+hit:
+	util_mr_stat_add(&shard[0]->hit_cnt, 1);
+	return 0;
+}
+
 int ofi_mr_cache_search(struct ofi_mr_cache *cache, struct ofi_mr_info *info,
 			struct ofi_mr_entry **entry)
 {
@@ -380,6 +1103,9 @@ int ofi_mr_cache_search(struct ofi_mr_cache *cache, struct ofi_mr_info *info,
 	FI_DBG(cache->prov, FI_LOG_MR, "search %p (len: %zu)\n",
 	       info->iov.iov_base, info->iov.iov_len);
 
+	if (cache->shards)
+		return util_mr_cache_search_shards(cache, monitor, info, entry);
+
 	do {
 		pthread_mutex_lock(&mm_lock);
 		flush_lru = ofi_mr_cache_full(cache);
@@ -421,6 +1147,52 @@ hit:
 	return 0;
 }
 
+static struct ofi_mr_entry *
+util_mr_cache_find_shards(struct ofi_mr_cache *cache, struct ofi_mr_info *info)
+{
+	struct ofi_mr_cache_shard *shard[2];
+	struct ofi_mem_monitor *monitor;
+	struct ofi_mr_entry *entry = NULL;
+	int i, cnt;
+	bool ret;
+
+	if (__atomic_load_n(&cache->dead_cnt, __ATOMIC_RELAXED))
+		ofi_mr_cache_flush(cache, false);
+
+	shard[0] = util_mr_shard(cache, &info->iov);
+	shard[1] = &cache->shards[OFI_MR_CACHE_SHARD_CNT];
+	cnt = (shard[0] == shard[1]) ? 1 : 2;
+	util_mr_stat_add(&shard[0]->search_cnt, 1);
+
+	pthread_mutex_lock(&mm_lock);
+	for (i = 0; i < cnt && !entry; i++) {
+		pthread_mutex_lock(&shard[i]->lock);
+		entry = ofi_mr_rbt_find(&shard[i]->tree, info);
+		if (!entry)
+			goto next;
+
+		monitor = cache->monitors[entry->info.iface];
+		if (ofi_iov_within(&info->iov, &entry->info.iov) &&
+		    monitor->valid(monitor, info, entry)) {
+			util_mr_stat_add(&shard[0]->hit_cnt, 1);
+			ret = util_mr_entry_get(entry);
+			assert(ret);
+			(void) ret;
+		} else {
+			while (entry) {
+				util_mr_shard_uncache_entry(cache, shard[i],
+							    entry);
+				entry = ofi_mr_rbt_find(&shard[i]->tree, info);
+			}
+		}
+next:
+		pthread_mutex_unlock(&shard[i]->lock);
+	}
+	pthread_mutex_unlock(&mm_lock);
+
+	return entry;
+}
+
 struct ofi_mr_entry *ofi_mr_cache_find(struct ofi_mr_cache *cache,
 				       const struct fi_mr_attr *attr,
 				       uint64_t flags)
@@ -433,6 +1205,11 @@ struct ofi_mr_entry *ofi_mr_cache_find(struct ofi_mr_cache *cache,
 	FI_DBG(cache->prov, FI_LOG_MR, "find %p (len: %zu)\n",
 	       attr->mr_iov->iov_base, attr->mr_iov->iov_len);
 
+	info.peer_id = 0;
+	ofi_mr_info_get_iov_from_mr_attr(&info, attr, flags);
+	if (cache->shards)
+		return util_mr_cache_find_shards(cache, &info);
+
 	pthread_mutex_lock(&mm_lock);
 
 	if (!dlist_empty(&cache->dead_region_list)) {
@@ -443,8 +1220,6 @@ struct ofi_mr_entry *ofi_mr_cache_find(struct ofi_mr_cache *cache,
 
 	cache->search_cnt++;
 
-	info.peer_id = 0;
-	ofi_mr_info_get_iov_from_mr_attr(&info, attr, flags);
 	entry = ofi_mr_rbt_find(&cache->tree, &info);
 	if (!entry) {
 		goto unlock;
@@ -482,46 +1257,129 @@ int ofi_mr_cache_reg(struct ofi_mr_cache *cache, const struct fi_mr_attr *attr,
 	if (!*entry)
 		return -FI_ENOMEM;
 
-	pthread_mutex_lock(&mm_lock);
-	cache->uncached_cnt++;
-	cache->uncached_size += attr->mr_iov->iov_len;
-	pthread_mutex_unlock(&mm_lock);
+	if (!cache->shards)
+		pthread_mutex_lock(&mm_lock);
+	util_mr_stat_add(&cache->uncached_cnt, 1);
+	util_mr_stat_add(&cache->uncached_size, attr->mr_iov->iov_len);
+	if (!cache->shards)
+		pthread_mutex_unlock(&mm_lock);
 
 	ofi_mr_info_get_iov_from_mr_attr(&(*entry)->info, attr, flags);
-	(*entry)->use_cnt = 1;
+	__atomic_store_n(&(*entry)->use_cnt, -1, __ATOMIC_RELAXED);
 	(*entry)->node = NULL;
 
 	ret = cache->add_region(cache, *entry);
 	if (ret)
 		goto buf_free;
 
+	__atomic_store_n(&(*entry)->use_cnt, 1, __ATOMIC_RELAXED);
 	return 0;
 
 buf_free:
 	util_mr_entry_free(cache, *entry);
-	pthread_mutex_lock(&mm_lock);
-	cache->uncached_cnt--;
-	cache->uncached_size -= attr->mr_iov->iov_len;
-	pthread_mutex_unlock(&mm_lock);
+	if (!cache->shards)
+		pthread_mutex_lock(&mm_lock);
+	util_mr_stat_sub(&cache->uncached_cnt, 1);
+	util_mr_stat_sub(&cache->uncached_size, attr->mr_iov->iov_len);
+	if (!cache->shards)
+		pthread_mutex_unlock(&mm_lock);
 	return ret;
 }
 
+/* Regions in use stay on the LRU lists of sharded caches, so only count
+ * the ones that could be evicted.
+ */
+bool ofi_mr_cache_lru_empty(struct ofi_mr_cache *cache)
+{
+	struct ofi_mr_entry *entry;
+	bool empty = true;
+	int i;
+
+	if (!cache->shards)
+		return dlist_empty(&cache->lru_list);
+
+	for (i = 0; i < UTIL_MR_SHARD_TOTAL && empty; i++) {
+		pthread_mutex_lock(&cache->shards[i].lock);
+		dlist_foreach_container(&cache->shards[i].lru_list,
+					struct ofi_mr_entry, entry,
+					list_entry) {
+			if (!__atomic_load_n(&entry->use_cnt,
+					     __ATOMIC_RELAXED)) {
+				empty = false;
+				break;
+			}
+		}
+		pthread_mutex_unlock(&cache->shards[i].lock);
+	}
+	return empty;
+}
+
+static int util_mr_cache_init_shards(struct ofi_mr_cache *cache)
+{
+	struct ofi_mr_cache_shard *shard;
+	int i, ret;
+
+	ret = ofi_memalign((void **) &cache->shards, 64,
+			   sizeof(*cache->shards) * UTIL_MR_SHARD_TOTAL);
+	if (ret)
+		return -FI_ENOMEM;
+
+	memset(cache->shards, 0, sizeof(*cache->shards) * UTIL_MR_SHARD_TOTAL);
+	for (i = 0; i < UTIL_MR_SHARD_TOTAL; i++) {
+		shard = &cache->shards[i];
+		pthread_mutex_init(&shard->lock, NULL);
+		ofi_rbmap_init(&shard->tree, util_mr_find_within);
+		dlist_init(&shard->lru_list);
+		dlist_init(&shard->dead_region_list);
+	}
+	cache->dead_cnt = 0;
+	cache->evict_shard = 0;
+	return 0;
+}
+
+static void util_mr_cache_cleanup_shards(struct ofi_mr_cache *cache)
+{
+	struct ofi_mr_cache_shard *shard;
+	int i;
+
+	for (i = 0; i < UTIL_MR_SHARD_TOTAL; i++) {
+		shard = &cache->shards[i];
+		cache->search_cnt += shard->search_cnt;
+		cache->delete_cnt += shard->delete_cnt;
+		cache->hit_cnt += shard->hit_cnt;
+		ofi_rbmap_cleanup(&shard->tree);
+		pthread_mutex_destroy(&shard->lock);
+	}
+	ofi_freealign(cache->shards);
+	cache->shards = NULL;
+}
+
 void ofi_mr_cache_cleanup(struct ofi_mr_cache *cache)
 {
 	/* If we don't have a prov, initialization failed */
 	if (!cache->prov)
 		return;
 
-	FI_INFO(cache->prov, FI_LOG_MR, "MR cache stats: "
-		"searches %zu, deletes %zu, hits %zu notify %zu\n",
-		cache->search_cnt, cache->delete_cnt, cache->hit_cnt,
-		cache->notify_cnt);
-
+	util_mr_cache_stop_dereg(cache);
 	while (ofi_mr_cache_flush(cache, true))
 		;
 
 	pthread_mutex_destroy(&cache->lock);
 	ofi_monitors_del_cache(cache);
+	pthread_cond_destroy(&cache->dereg_cond);
+	pthread_mutex_destroy(&cache->dereg_lock);
+	if (cache->shards)
+		util_mr_cache_cleanup_shards(cache);
+
+	FI_INFO(cache->prov, FI_LOG_MR, "MR cache stats: "
+		"searches %zu, deletes %zu, hits %zu notify %zu\n",
+		cache->search_cnt, cache->delete_cnt, cache->hit_cnt,
+		cache->notify_cnt);
+	FI_INFO(cache->prov, FI_LOG_MR, "MR cache notify batches: "
+		"batches %zu, events %zu, max batch %zu, async deregs %zu\n",
+		cache->notify_batch_cnt, cache->notify_event_cnt,
+		cache->notify_batch_max, cache->dereg_async_cnt);
+
 	ofi_rbmap_cleanup(&cache->tree);
 	if (cache->domain)
 		ofi_atomic_dec32(&cache->domain->ref);
@@ -556,6 +1414,10 @@ int ofi_mr_cache_init(struct util_domain *domain,
 	cache->delete_cnt = 0;
 	cache->hit_cnt = 0;
 	cache->notify_cnt = 0;
+	cache->notify_batch_cnt = 0;
+	cache->notify_event_cnt = 0;
+	cache->notify_batch_max = 0;
+	cache->dereg_active = false;
 	cache->domain = domain;
 	if (domain) {
 		cache->prov = domain->prov;
@@ -565,10 +1427,15 @@ int ofi_mr_cache_init(struct util_domain *domain,
 	}
 
 	ofi_rbmap_init(&cache->tree, util_mr_find_within);
-	ret = ofi_monitors_add_cache(monitors, cache);
+	cache->id = __atomic_add_fetch(&util_mr_cache_id, 1, __ATOMIC_RELAXED);
+	ret = util_mr_cache_init_shards(cache);
 	if (ret)
 		goto destroy;
 
+	ret = ofi_monitors_add_cache(monitors, cache);
+	if (ret)
+		goto shards;
+
 	ret = ofi_bufpool_create(&cache->entry_pool,
 				 sizeof(struct ofi_mr_entry) +
 				 cache->entry_data_size,
@@ -576,9 +1443,17 @@ int ofi_mr_cache_init(struct util_domain *domain,
 	if (ret)
 		goto del;
 
+	ret = util_mr_cache_start_dereg(cache);
+	if (ret)
+		goto pool;
+
 	return 0;
+pool:
+	ofi_bufpool_destroy(cache->entry_pool);
 del:
 	ofi_monitors_del_cache(cache);
+shards:
+	util_mr_cache_cleanup_shards(cache);
 destroy:
 	ofi_rbmap_cleanup(&cache->tree);
 	if (domain) {
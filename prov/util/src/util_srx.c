@@ -249,90 +249,34 @@ static int util_get_msg(struct fid_peer_srx *srx,
 	return FI_SUCCESS;
 }
 
-static int util_match_tag(struct fid_peer_srx *srx,
-			  struct fi_peer_match_attr *attr,
-			  struct fi_peer_rx_entry **rx_entry)
-{
-	struct util_srx_ctx *srx_ctx;
-	struct util_rx_entry *util_entry;
-	struct slist_entry *item, *prev;
-	int ret = FI_SUCCESS;
-
-	srx_ctx = srx->ep_fid.fid.context;
-	slist_foreach(&srx_ctx->tag_queue, item, prev) {
-		util_entry = container_of(item, struct util_rx_entry, s_entry);
-		assert(util_entry->status == RX_ENTRY_POSTED);
-		if (ofi_match_tag(util_entry->peer_entry.tag,
-				  util_entry->ignore, attr->tag)) {
-			util_entry->status = RX_ENTRY_MATCHED;
-			util_entry->peer_entry.srx = srx;
-			srx_ctx->update_func(srx_ctx, util_entry);
-			slist_remove(&srx_ctx->tag_queue, item, prev);
-			goto out;
-		}
-	}
-
-	util_entry = util_init_unexp(srx_ctx, attr, FI_TAGGED | FI_RECV);
-	if (!util_entry)
-		return -FI_ENOMEM;
-	ret = -FI_ENOENT;
-	util_entry->peer_entry.srx = srx;
-out:
-	util_entry->peer_entry.msg_size = MIN(util_entry->peer_entry.msg_size,
-					      attr->msg_size);
-	*rx_entry = &util_entry->peer_entry;
-	return ret;
-}
-
 static int util_get_tag(struct fid_peer_srx *srx,
 			struct fi_peer_match_attr *attr,
 			struct fi_peer_rx_entry **rx_entry)
 {
 	struct util_srx_ctx *srx_ctx;
-	struct slist *queue;
-	struct slist_entry *any_item, *any_prev;
-	struct slist_entry *item, *prev;
-	struct util_rx_entry *util_entry, *any_entry;
+	struct util_rx_entry *util_entry;
 	int ret = FI_SUCCESS;
 
 	srx_ctx = srx->ep_fid.fid.context;
 	assert(ofi_genlock_held(srx_ctx->lock));
 
-	queue = attr->addr == FI_ADDR_UNSPEC ? NULL:
-		ofi_array_at(&srx_ctx->src_trecv_queues, attr->addr);
-
-	if (!queue || slist_empty(queue))
-		return util_match_tag(srx, attr, rx_entry);
-
-	slist_foreach(queue, item, prev) {
-		util_entry = container_of(item, struct util_rx_entry, s_entry);
-		if (ofi_match_tag(util_entry->peer_entry.tag,
-				  util_entry->ignore, attr->tag))
-			goto check_any;
-	}
-	return util_match_tag(srx, attr, rx_entry);
-
-check_any:
-	slist_foreach(&srx_ctx->tag_queue, any_item, any_prev) {
-		any_entry = container_of(any_item, struct util_rx_entry,
-					 peer_entry);
-		if (any_entry->seq_no > util_entry->seq_no)
-			break;
-
-		if (ofi_match_tag(any_entry->peer_entry.tag, any_entry->ignore,
-				  attr->tag)) {
-			queue = &srx_ctx->tag_queue;
-			util_entry = any_entry;
-			item = any_item;
-			prev = any_prev;
-			break;
-		}
+	util_entry = srx_ctx->match_ops->match_posted(srx_ctx, attr->addr,
+						      attr->tag);
+	if (util_entry) {
+		assert(util_entry->status == RX_ENTRY_POSTED);
+		util_entry->status = RX_ENTRY_MATCHED;
+		util_entry->peer_entry.srx = srx;
+		srx_ctx->update_func(srx_ctx, util_entry);
+	} else {
+		util_entry = util_init_unexp(srx_ctx, attr, FI_TAGGED | FI_RECV);
+		if (!util_entry)
+			return -FI_ENOMEM;
+		ret = -FI_ENOENT;
+		util_entry->peer_entry.srx = srx;
 	}
-	util_entry->status = RX_ENTRY_MATCHED;
-	util_entry->peer_entry.srx = srx;
-	srx_ctx->update_func(srx_ctx, util_entry);
+	util_entry->peer_entry.msg_size = MIN(util_entry->peer_entry.msg_size,
+					      attr->msg_size);
 	*rx_entry = &util_entry->peer_entry;
-	slist_remove(queue, item, prev);
 	return ret;
 }
 
@@ -365,34 +309,39 @@ static int util_queue_tag(struct fi_peer_rx_entry *rx_entry)
 {
 	struct util_srx_ctx *srx_ctx = rx_entry->srx->ep_fid.fid.context;
 	struct util_rx_entry *util_entry;
-	struct util_unexp_peer *unexp_peer;
 
 	assert(ofi_genlock_held(srx_ctx->lock));
 
 	util_entry = container_of(rx_entry, struct util_rx_entry, peer_entry);
 	assert(util_entry->status == RX_ENTRY_UNEXP);
-	if (!srx_ctx->dir_recv || rx_entry->addr == FI_ADDR_UNSPEC) {
-		dlist_insert_tail(&util_entry->d_entry,
-				  &srx_ctx->unspec_unexp_tag_queue);
-	} else {
-		unexp_peer = ofi_array_at(&srx_ctx->src_unexp_peers,
-					  rx_entry->addr);
-		assert(unexp_peer);
-		slist_insert_tail(&util_entry->s_entry, &unexp_peer->tag_queue);
-		if (!unexp_peer->cnt++)
-			dlist_insert_tail(&unexp_peer->entry,
-					  &srx_ctx->unexp_peers);
+	srx_ctx->match_ops->insert_unexp(srx_ctx, util_entry);
+	return FI_SUCCESS;
+}
+
+static void util_remove_peer_entry(struct util_unexp_peer *unexp_peer,
+				   struct slist *queue,
+				   struct util_rx_entry *util_entry)
+{
+	struct slist_entry *item, *prev;
 
+	slist_foreach(queue, item, prev) {
+		if (item == &util_entry->s_entry) {
+			slist_remove(queue, item, prev);
+			break;
+		}
+	}
+
+	if (!--unexp_peer->cnt) {
+		assert(slist_empty(&unexp_peer->msg_queue) &&
+		       slist_empty(&unexp_peer->tag_queue));
+		dlist_remove(&unexp_peer->entry);
 	}
-	return FI_SUCCESS;
 }
 
 static void util_free_entry(struct fi_peer_rx_entry *entry)
 {
 	struct util_srx_ctx *srx;
 	struct util_unexp_peer *unexp_peer;
-	struct slist *queue;
-	struct slist_entry *item, *prev;
 	struct util_rx_entry *util_entry, *owner_entry;
 
 	srx = (struct util_srx_ctx *) entry->srx->ep_fid.fid.context;
@@ -415,25 +364,17 @@ static void util_free_entry(struct fi_peer_rx_entry *entry)
 	}
 
 	if (util_entry->status == RX_ENTRY_UNEXP) {
-		if (util_entry->peer_entry.addr == FI_ADDR_UNSPEC) {
+		if (util_entry->peer_entry.flags & FI_TAGGED) {
+			srx->match_ops->remove_unexp(srx, util_entry);
+		} else if (!srx->dir_recv ||
+			   util_entry->peer_entry.addr == FI_ADDR_UNSPEC) {
 			dlist_remove(&util_entry->d_entry);
 		} else {
 			unexp_peer = ofi_array_at(&srx->src_unexp_peers,
 						  util_entry->peer_entry.addr);
-			queue = util_entry->peer_entry.flags & FI_TAGGED ?
-					&unexp_peer->tag_queue :
-					&unexp_peer->msg_queue;
-
-			slist_foreach(queue, item, prev) {
-				if ((struct util_rx_entry *) item == util_entry)
-					slist_remove(queue, item, prev);
-			}
-
-			if (!--unexp_peer->cnt) {
-				assert(slist_empty(&unexp_peer->msg_queue) &&
-				       slist_empty(&unexp_peer->tag_queue));
-				dlist_remove(&unexp_peer->entry);
-			}
+			util_remove_peer_entry(unexp_peer,
+					       &unexp_peer->msg_queue,
+					       util_entry);
 		}
 	}
 
@@ -471,25 +412,7 @@ static void util_foreach_unspec(struct fid_peer_srx *srx,
 					  &srx_ctx->unexp_peers);
 	}
 
-	dlist_foreach_container_safe(&srx_ctx->unspec_unexp_tag_queue,
-				     struct util_rx_entry, rx_entry, d_entry,
-				     tmp) {
-		if (rx_entry->peer_entry.srx != srx)
-			continue;
-		rx_entry->peer_entry.addr = get_addr(&rx_entry->peer_entry);
-		if (rx_entry->peer_entry.addr == FI_ADDR_UNSPEC ||
-		    !srx_ctx->dir_recv)
-			continue;
-
-		dlist_remove(&rx_entry->d_entry);
-		unexp_peer = ofi_array_at(&srx_ctx->src_unexp_peers,
-					  rx_entry->peer_entry.addr);
-		assert(unexp_peer);
-		slist_insert_tail(&rx_entry->s_entry, &unexp_peer->tag_queue);
-		if (!unexp_peer->cnt++)
-			dlist_insert_tail(&unexp_peer->entry,
-					  &srx_ctx->unexp_peers);
-	}
+	srx_ctx->match_ops->foreach_unspec(srx_ctx, srx, get_addr);
 }
 
 static struct fi_ops_srx_owner util_srx_owner_ops = {
@@ -618,67 +541,6 @@ out:
 	return ret;
 }
 
-static struct util_rx_entry *util_search_peer_tag(struct util_unexp_peer *peer,
-				uint64_t tag, uint64_t ignore, bool remove)
-{
-	struct util_rx_entry *rx_entry;
-	struct slist_entry *item, *prev;
-
-	assert(peer);
-	if (slist_empty(&peer->tag_queue))
-		return NULL;
-
-	slist_foreach(&peer->tag_queue, item, prev) {
-		rx_entry = (struct util_rx_entry *) item;
-		if (!ofi_match_tag(tag, ignore, rx_entry->peer_entry.tag))
-			continue;
-
-		if (remove) {
-			slist_remove(&peer->tag_queue, item, prev);
-			if (!--peer->cnt) {
-				assert(slist_empty(&peer->tag_queue));
-				dlist_remove(&peer->entry);
-			}
-		}
-		return rx_entry;
-	}
-	return NULL;
-}
-
-static struct util_rx_entry *util_search_unexp_tag(struct util_srx_ctx *srx,
-		fi_addr_t addr, uint64_t tag, uint64_t ignore, bool remove)
-{
-	struct util_rx_entry *rx_entry;
-	struct util_unexp_peer *unexp_peer;
-
-	if (addr == FI_ADDR_UNSPEC) {
-		dlist_foreach_container(&srx->unspec_unexp_tag_queue,
-					struct util_rx_entry, rx_entry,
-					d_entry) {
-			if (!ofi_match_tag(tag, ignore,
-			    rx_entry->peer_entry.tag))
-				continue;
-
-			if (remove)
-				dlist_remove(&rx_entry->d_entry);
-
-			return rx_entry;
-		}
-
-		dlist_foreach_container(&srx->unexp_peers,
-				struct util_unexp_peer, unexp_peer, entry) {
-			rx_entry = util_search_peer_tag(unexp_peer, tag,
-							ignore, remove);
-			if (rx_entry)
-				return rx_entry;
-		}
-		return NULL;
-	}
-
-	return util_search_peer_tag(ofi_array_at(&srx->src_unexp_peers, addr),
-				    tag, ignore, remove);
-}
-
 static ssize_t util_srx_peek(struct util_srx_ctx *srx, const struct iovec *iov,
 			     void **desc, size_t iov_count, fi_addr_t addr,
 			     void *context, uint64_t tag, uint64_t ignore,
@@ -687,8 +549,8 @@ static ssize_t util_srx_peek(struct util_srx_ctx *srx, const struct iovec *iov,
 	struct util_rx_entry *rx_entry;
 	int ret = FI_SUCCESS;
 
-	rx_entry = util_search_unexp_tag(srx, addr, tag, ignore,
-					 flags & (FI_CLAIM | FI_DISCARD));
+	rx_entry = srx->match_ops->search_unexp(srx, addr, tag, ignore,
+					flags & (FI_CLAIM | FI_DISCARD));
 	if (!rx_entry) {
 		FI_DBG(&core_prov, FI_LOG_EP_CTRL, "Message not found\n");
 		return ofi_cq_write_error_peek(srx->cq, tag, context);
@@ -721,7 +583,6 @@ ssize_t util_srx_generic_trecv(struct fid_ep *ep_fid, const struct iovec *iov,
 {
 	struct util_srx_ctx *srx;
 	struct util_rx_entry *rx_entry;
-	struct slist *queue;
 	ssize_t ret = FI_SUCCESS;
 
 	srx = container_of(ep_fid, struct util_srx_ctx, peer_srx.ep_fid);
@@ -756,11 +617,9 @@ ssize_t util_srx_generic_trecv(struct fid_ep *ep_fid, const struct iovec *iov,
 		rx_entry = (struct util_rx_entry *)
 				(((struct fi_context *) context)->internal[0]);
 	} else {
-		rx_entry = util_search_unexp_tag(srx, addr, tag, ignore, true);
+		rx_entry = srx->match_ops->search_unexp(srx, addr, tag, ignore,
+							true);
 		if (!rx_entry) {
-			queue = addr == FI_ADDR_UNSPEC ? &srx->tag_queue:
-				ofi_array_at(&srx->src_trecv_queues, addr);
-			assert(queue);
 			rx_entry = util_get_recv_entry(srx, iov, desc,
 						iov_count, addr, context, tag,
 						ignore,
@@ -768,7 +627,7 @@ ssize_t util_srx_generic_trecv(struct fid_ep *ep_fid, const struct iovec *iov,
 			if (!rx_entry)
 				ret = -FI_ENOMEM;
 			else
-				slist_insert_tail(&rx_entry->s_entry, queue);
+				srx->match_ops->insert_posted(srx, rx_entry);
 			goto out;
 		}
 	}
@@ -995,6 +854,9 @@ int util_srx_close(struct fid *fid)
 		return -FI_EINVAL;
 
 	ofi_genlock_lock(srx->lock);
+	if (srx->match_ops->close)
+		srx->match_ops->close(srx);
+
 	(void)ofi_array_iter(&srx->src_recv_queues, srx, util_cleanup_queues);
 	(void)ofi_array_iter(&srx->src_trecv_queues, srx, util_cleanup_queues);
 	ofi_array_destroy(&srx->src_recv_queues);
@@ -1100,14 +962,21 @@ static int util_cancel_src(struct ofi_dyn_arr *arr, void *list, void *context)
 {
 	struct util_srx_ctx *srx;
 	struct slist *queue = list;
-	uint64_t flags;
 
-	srx = container_of(arr, struct util_srx_ctx, src_trecv_queues);
+	srx = container_of(arr, struct util_srx_ctx, src_recv_queues);
+	return (int) (util_cancel_recv(srx, queue, FI_MSG | FI_RECV,
+				       context) == FI_SUCCESS);
+}
 
-	flags = arr == &srx->src_trecv_queues ?
-		FI_TAGGED | FI_RECV : FI_MSG | FI_RECV;
+static int util_cancel_src_tag(struct ofi_dyn_arr *arr, void *list,
+			       void *context)
+{
+	struct util_srx_ctx *srx;
+	struct slist *queue = list;
 
-	return (int) (util_cancel_recv(srx, queue, flags, context) == FI_SUCCESS);
+	srx = container_of(arr, struct util_srx_ctx, src_trecv_queues);
+	return (int) (util_cancel_recv(srx, queue, FI_TAGGED | FI_RECV,
+				       context) == FI_SUCCESS);
 }
 
 static ssize_t util_srx_cancel(fid_t ep_fid, void *context)
@@ -1118,8 +987,7 @@ static ssize_t util_srx_cancel(fid_t ep_fid, void *context)
 	srx = container_of(ep_fid, struct util_srx_ctx, peer_srx.ep_fid);
 
 	ofi_genlock_lock(srx->lock);
-	ret = util_cancel_recv(srx, &srx->tag_queue, FI_TAGGED | FI_RECV,
-			       context);
+	ret = srx->match_ops->cancel_posted(srx, context);
 	if (ret != -FI_ENOENT)
 		goto out;
 
@@ -1127,8 +995,7 @@ static ssize_t util_srx_cancel(fid_t ep_fid, void *context)
 	if (ret != -FI_ENOENT)
 		goto out;
 
-	if (ofi_array_iter(&srx->src_trecv_queues, context, util_cancel_src) ||
-	    ofi_array_iter(&srx->src_recv_queues, context, util_cancel_src)) {
+	if (ofi_array_iter(&srx->src_recv_queues, context, util_cancel_src)) {
 		/* nothing to do, always return success */
 	}
 
@@ -1139,6 +1006,510 @@ out:
 	return ret;
 }
 
+/*
+ * List match engine: posted receives are kept in per-source and wildcard
+ * source lists and unexpected messages in per-peer lists, all searched
+ * linearly.
+ */
+static void util_list_insert_posted(struct util_srx_ctx *srx,
+				    struct util_rx_entry *rx_entry)
+{
+	struct slist *queue;
+
+	queue = rx_entry->peer_entry.addr == FI_ADDR_UNSPEC ? &srx->tag_queue :
+		ofi_array_at(&srx->src_trecv_queues, rx_entry->peer_entry.addr);
+	assert(queue);
+	slist_insert_tail(&rx_entry->s_entry, queue);
+}
+
+static struct util_rx_entry *util_list_match_any(struct util_srx_ctx *srx,
+						 uint64_t tag)
+{
+	struct util_rx_entry *rx_entry;
+	struct slist_entry *item, *prev;
+
+	slist_foreach(&srx->tag_queue, item, prev) {
+		rx_entry = container_of(item, struct util_rx_entry, s_entry);
+		if (ofi_match_tag(rx_entry->peer_entry.tag, rx_entry->ignore,
+				  tag)) {
+			slist_remove(&srx->tag_queue, item, prev);
+			return rx_entry;
+		}
+	}
+	return NULL;
+}
+
+static struct util_rx_entry *util_list_match_posted(struct util_srx_ctx *srx,
+						    fi_addr_t addr,
+						    uint64_t tag)
+{
+	struct slist *queue;
+	struct slist_entry *any_item, *any_prev;
+	struct slist_entry *item, *prev;
+	struct util_rx_entry *rx_entry, *any_entry;
+
+	queue = addr == FI_ADDR_UNSPEC ? NULL :
+		ofi_array_at(&srx->src_trecv_queues, addr);
+
+	if (!queue || slist_empty(queue))
+		return util_list_match_any(srx, tag);
+
+	slist_foreach(queue, item, prev) {
+		rx_entry = container_of(item, struct util_rx_entry, s_entry);
+		if (ofi_match_tag(rx_entry->peer_entry.tag, rx_entry->ignore,
+				  tag))
+			goto check_any;
+	}
+	return util_list_match_any(srx, tag);
+
+check_any:
+	slist_foreach(&srx->tag_queue, any_item, any_prev) {
+		any_entry = container_of(any_item, struct util_rx_entry,
+					 s_entry);
+		if (any_entry->seq_no > rx_entry->seq_no)
+			break;
+
+		if (ofi_match_tag(any_entry->peer_entry.tag, any_entry->ignore,
+				  tag)) {
+			queue = &srx->tag_queue;
+			rx_entry = any_entry;
+			item = any_item;
+			prev = any_prev;
+			break;
+		}
+	}
+	slist_remove(queue, item, prev);
+	return rx_entry;
+}
+
+static int util_list_cancel_posted(struct util_srx_ctx *srx, void *context)
+{
+	int ret;
+
+	ret = util_cancel_recv(srx, &srx->tag_queue, FI_TAGGED | FI_RECV,
+			       context);
+	if (ret != -FI_ENOENT)
+		return ret;
+
+	return ofi_array_iter(&srx->src_trecv_queues, context,
+			      util_cancel_src_tag) ? FI_SUCCESS : -FI_ENOENT;
+}
+
+static void util_list_insert_unexp(struct util_srx_ctx *srx,
+				   struct util_rx_entry *rx_entry)
+{
+	struct util_unexp_peer *unexp_peer;
+
+	if (!srx->dir_recv || rx_entry->peer_entry.addr == FI_ADDR_UNSPEC) {
+		dlist_insert_tail(&rx_entry->d_entry,
+				  &srx->unspec_unexp_tag_queue);
+		return;
+	}
+
+	unexp_peer = ofi_array_at(&srx->src_unexp_peers,
+				  rx_entry->peer_entry.addr);
+	assert(unexp_peer);
+	slist_insert_tail(&rx_entry->s_entry, &unexp_peer->tag_queue);
+	if (!unexp_peer->cnt++)
+		dlist_insert_tail(&unexp_peer->entry, &srx->unexp_peers);
+}
+
+static struct util_rx_entry *util_search_peer_tag(struct util_unexp_peer *peer,
+				uint64_t tag, uint64_t ignore, bool remove)
+{
+	struct util_rx_entry *rx_entry;
+	struct slist_entry *item, *prev;
+
+	assert(peer);
+	if (slist_empty(&peer->tag_queue))
+		return NULL;
+
+	slist_foreach(&peer->tag_queue, item, prev) {
+		rx_entry = (struct util_rx_entry *) item;
+		if (!ofi_match_tag(tag, ignore, rx_entry->peer_entry.tag))
+			continue;
+
+		if (remove) {
+			slist_remove(&peer->tag_queue, item, prev);
+			if (!--peer->cnt) {
+				assert(slist_empty(&peer->tag_queue));
+				dlist_remove(&peer->entry);
+			}
+		}
+		return rx_entry;
+	}
+	return NULL;
+}
+
+static struct util_rx_entry *util_list_search_unexp(struct util_srx_ctx *srx,
+		fi_addr_t addr, uint64_t tag, uint64_t ignore, bool remove)
+{
+	struct util_rx_entry *rx_entry;
+	struct util_unexp_peer *unexp_peer;
+
+	if (addr == FI_ADDR_UNSPEC) {
+		dlist_foreach_container(&srx->unspec_unexp_tag_queue,
+					struct util_rx_entry, rx_entry,
+					d_entry) {
+			if (!ofi_match_tag(tag, ignore,
+			    rx_entry->peer_entry.tag))
+				continue;
+
+			if (remove)
+				dlist_remove(&rx_entry->d_entry);
+
+			return rx_entry;
+		}
+
+		dlist_foreach_container(&srx->unexp_peers,
+				struct util_unexp_peer, unexp_peer, entry) {
+			rx_entry = util_search_peer_tag(unexp_peer, tag,
+							ignore, remove);
+			if (rx_entry)
+				return rx_entry;
+		}
+		return NULL;
+	}
+
+	return util_search_peer_tag(ofi_array_at(&srx->src_unexp_peers, addr),
+				    tag, ignore, remove);
+}
+
+static void util_list_remove_unexp(struct util_srx_ctx *srx,
+				   struct util_rx_entry *rx_entry)
+{
+	struct util_unexp_peer *unexp_peer;
+
+	if (!srx->dir_recv || rx_entry->peer_entry.addr == FI_ADDR_UNSPEC) {
+		dlist_remove(&rx_entry->d_entry);
+		return;
+	}
+
+	unexp_peer = ofi_array_at(&srx->src_unexp_peers,
+				  rx_entry->peer_entry.addr);
+	util_remove_peer_entry(unexp_peer, &unexp_peer->tag_queue, rx_entry);
+}
+
+static void util_list_foreach_unspec(struct util_srx_ctx *srx,
+		struct fid_peer_srx *peer_srx,
+		fi_addr_t (*get_addr)(struct fi_peer_rx_entry *))
+{
+	struct util_rx_entry *rx_entry;
+	struct dlist_entry *tmp;
+
+	dlist_foreach_container_safe(&srx->unspec_unexp_tag_queue,
+				     struct util_rx_entry, rx_entry, d_entry,
+				     tmp) {
+		if (rx_entry->peer_entry.srx != peer_srx)
+			continue;
+		rx_entry->peer_entry.addr = get_addr(&rx_entry->peer_entry);
+		if (rx_entry->peer_entry.addr == FI_ADDR_UNSPEC ||
+		    !srx->dir_recv)
+			continue;
+
+		dlist_remove(&rx_entry->d_entry);
+		util_list_insert_unexp(srx, rx_entry);
+	}
+}
+
+static const struct util_srx_match_ops util_srx_list_match_ops = {
+	.name = "list",
+	.insert_posted = util_list_insert_posted,
+	.match_posted = util_list_match_posted,
+	.cancel_posted = util_list_cancel_posted,
+	.insert_unexp = util_list_insert_unexp,
+	.search_unexp = util_list_search_unexp,
+	.remove_unexp = util_list_remove_unexp,
+	.foreach_unspec = util_list_foreach_unspec,
+};
+
+/*
+ * Hash match engine.  Posted receives with an exact tag are hashed by tag
+ * and source, or by tag alone when posted for any source.  Receives that
+ * ignore tag bits, like MPI_ANY_TAG, go to a separate wildcard list.  An
+ * incoming message checks the head of its two buckets and the wildcard
+ * list, and takes the candidate posted first, going by the sequence number
+ * stamped at post time.  Unexpected messages are hashed by tag and also
+ * kept in one arrival ordered list for wildcard receives.
+ *
+ * Every entry is linked in arrival order through d_entry (posted or
+ * unexpected list) and in its bucket or wildcard list through hash_entry.
+ */
+#define UTIL_SRX_HASH_BITS	10
+#define UTIL_SRX_HASH_SIZE	(1 << UTIL_SRX_HASH_BITS)
+
+struct util_srx_hash {
+	struct dlist_entry	posted;
+	struct dlist_entry	posted_wild;
+	struct dlist_entry	posted_src[UTIL_SRX_HASH_SIZE];
+	struct dlist_entry	posted_any[UTIL_SRX_HASH_SIZE];
+	struct dlist_entry	unexp;
+	struct dlist_entry	unexp_tag[UTIL_SRX_HASH_SIZE];
+};
+
+static inline size_t util_srx_hash_key(uint64_t tag, fi_addr_t addr)
+{
+	uint64_t key = tag ^ (addr * 0xff51afd7ed558ccdULL);
+
+	return (size_t) ((key * 0x9e3779b97f4a7c15ULL) >>
+			 (64 - UTIL_SRX_HASH_BITS));
+}
+
+static int util_hash_init(struct util_srx_ctx *srx)
+{
+	struct util_srx_hash *hash;
+	int i;
+
+	hash = malloc(sizeof(*hash));
+	if (!hash)
+		return -FI_ENOMEM;
+
+	dlist_init(&hash->posted);
+	dlist_init(&hash->posted_wild);
+	dlist_init(&hash->unexp);
+	for (i = 0; i < UTIL_SRX_HASH_SIZE; i++) {
+		dlist_init(&hash->posted_src[i]);
+		dlist_init(&hash->posted_any[i]);
+		dlist_init(&hash->unexp_tag[i]);
+	}
+	srx->match_ctx = hash;
+	return FI_SUCCESS;
+}
+
+static void util_hash_close(struct util_srx_ctx *srx)
+{
+	struct util_srx_hash *hash = srx->match_ctx;
+	struct util_rx_entry *rx_entry;
+
+	while (!dlist_empty(&hash->posted)) {
+		dlist_pop_front(&hash->posted, struct util_rx_entry, rx_entry,
+				d_entry);
+		ofi_buf_free(rx_entry);
+	}
+
+	while (!dlist_empty(&hash->unexp)) {
+		dlist_pop_front(&hash->unexp, struct util_rx_entry, rx_entry,
+				d_entry);
+		rx_entry->peer_entry.srx->peer_ops->discard_tag(
+							&rx_entry->peer_entry);
+		ofi_buf_free(rx_entry);
+	}
+
+	free(hash);
+	srx->match_ctx = NULL;
+}
+
+static void util_hash_insert_posted(struct util_srx_ctx *srx,
+				    struct util_rx_entry *rx_entry)
+{
+	struct util_srx_hash *hash = srx->match_ctx;
+	struct dlist_entry *list;
+	uint64_t tag = rx_entry->peer_entry.tag;
+	fi_addr_t addr = rx_entry->peer_entry.addr;
+
+	if (rx_entry->ignore)
+		list = &hash->posted_wild;
+	else if (addr == FI_ADDR_UNSPEC)
+		list = &hash->posted_any[util_srx_hash_key(tag, 0)];
+	else
+		list = &hash->posted_src[util_srx_hash_key(tag, addr)];
+
+	dlist_insert_tail(&rx_entry->d_entry, &hash->posted);
+	dlist_insert_tail(&rx_entry->hash_entry, list);
+}
+
+static struct util_rx_entry *util_hash_match_posted(struct util_srx_ctx *srx,
+						    fi_addr_t addr,
+						    uint64_t tag)
+{
+	struct util_srx_hash *hash = srx->match_ctx;
+	struct util_rx_entry *rx_entry, *match = NULL;
+	struct dlist_entry *list;
+
+	if (addr != FI_ADDR_UNSPEC) {
+		list = &hash->posted_src[util_srx_hash_key(tag, addr)];
+		dlist_foreach_container(list, struct util_rx_entry, rx_entry,
+					hash_entry) {
+			if (rx_entry->peer_entry.tag == tag &&
+			    rx_entry->peer_entry.addr == addr) {
+				match = rx_entry;
+				break;
+			}
+		}
+	}
+
+	list = &hash->posted_any[util_srx_hash_key(tag, 0)];
+	dlist_foreach_container(list, struct util_rx_entry, rx_entry,
+				hash_entry) {
+		if (match && rx_entry->seq_no > match->seq_no)
+			break;
+		if (rx_entry->peer_entry.tag == tag) {
+			match = rx_entry;
+			break;
+		}
+	}
+
+	dlist_foreach_container(&hash->posted_wild, struct util_rx_entry,
+				rx_entry, hash_entry) {
+		if (match && rx_entry->seq_no > match->seq_no)
+			break;
+		if ((rx_entry->peer_entry.addr == FI_ADDR_UNSPEC ||
+		     rx_entry->peer_entry.addr == addr) &&
+		    ofi_match_tag(rx_entry->peer_entry.tag, rx_entry->ignore,
+				  tag)) {
+			match = rx_entry;
+			break;
+		}
+	}
+
+	if (match) {
+		dlist_remove(&match->d_entry);
+		dlist_remove(&match->hash_entry);
+	}
+	return match;
+}
+
+static int util_hash_cancel_posted(struct util_srx_ctx *srx, void *context)
+{
+	struct util_srx_hash *hash = srx->match_ctx;
+	struct util_rx_entry *rx_entry;
+
+	dlist_foreach_container(&hash->posted, struct util_rx_entry, rx_entry,
+				d_entry) {
+		if (rx_entry->peer_entry.context != context)
+			continue;
+
+		dlist_remove(&rx_entry->d_entry);
+		dlist_remove(&rx_entry->hash_entry);
+		util_cancel_entry(srx, FI_TAGGED | FI_RECV, rx_entry);
+		return FI_SUCCESS;
+	}
+	return -FI_ENOENT;
+}
+
+static void util_hash_insert_unexp(struct util_srx_ctx *srx,
+				   struct util_rx_entry *rx_entry)
+{
+	struct util_srx_hash *hash = srx->match_ctx;
+
+	dlist_insert_tail(&rx_entry->d_entry, &hash->unexp);
+	dlist_insert_tail(&rx_entry->hash_entry,
+		&hash->unexp_tag[util_srx_hash_key(rx_entry->peer_entry.tag, 0)]);
+}
+
+static struct util_rx_entry *util_hash_search_unexp(struct util_srx_ctx *srx,
+		fi_addr_t addr, uint64_t tag, uint64_t ignore, bool remove)
+{
+	struct util_srx_hash *hash = srx->match_ctx;
+	struct util_rx_entry *rx_entry;
+
+	if (ignore) {
+		dlist_foreach_container(&hash->unexp, struct util_rx_entry,
+					rx_entry, d_entry) {
+			if ((addr == FI_ADDR_UNSPEC ||
+			     rx_entry->peer_entry.addr == addr) &&
+			    ofi_match_tag(tag, ignore, rx_entry->peer_entry.tag))
+				goto found;
+		}
+		return NULL;
+	}
+
+	dlist_foreach_container(&hash->unexp_tag[util_srx_hash_key(tag, 0)],
+				struct util_rx_entry, rx_entry, hash_entry) {
+		if ((addr == FI_ADDR_UNSPEC ||
+		     rx_entry->peer_entry.addr == addr) &&
+		    rx_entry->peer_entry.tag == tag)
+			goto found;
+	}
+	return NULL;
+
+found:
+	if (remove) {
+		dlist_remove(&rx_entry->d_entry);
+		dlist_remove(&rx_entry->hash_entry);
+	}
+	return rx_entry;
+}
+
+static void util_hash_remove_unexp(struct util_srx_ctx *srx,
+				   struct util_rx_entry *rx_entry)
+{
+	dlist_remove(&rx_entry->d_entry);
+	dlist_remove(&rx_entry->hash_entry);
+}
+
+/* Buckets are keyed by tag only, so resolved entries stay in place. */
+static void util_hash_foreach_unspec(struct util_srx_ctx *srx,
+		struct fid_peer_srx *peer_srx,
+		fi_addr_t (*get_addr)(struct fi_peer_rx_entry *))
+{
+	struct util_srx_hash *hash = srx->match_ctx;
+	struct util_rx_entry *rx_entry;
+
+	dlist_foreach_container(&hash->unexp, struct util_rx_entry, rx_entry,
+				d_entry) {
+		if (rx_entry->peer_entry.srx != peer_srx ||
+		    rx_entry->peer_entry.addr != FI_ADDR_UNSPEC)
+			continue;
+		rx_entry->peer_entry.addr = get_addr(&rx_entry->peer_entry);
+	}
+}
+
+static const struct util_srx_match_ops util_srx_hash_match_ops = {
+	.name = "hash",
+	.init = util_hash_init,
+	.close = util_hash_close,
+	.insert_posted = util_hash_insert_posted,
+	.match_posted = util_hash_match_posted,
+	.cancel_posted = util_hash_cancel_posted,
+	.insert_unexp = util_hash_insert_unexp,
+	.search_unexp = util_hash_search_unexp,
+	.remove_unexp = util_hash_remove_unexp,
+	.foreach_unspec = util_hash_foreach_unspec,
+};
+
+static const struct util_srx_match_ops *util_srx_match_engines[] = {
+	&util_srx_list_match_ops,
+	&util_srx_hash_match_ops,
+};
+
+static const struct util_srx_match_ops *util_srx_match =
+	&util_srx_list_match_ops;
+
+int util_srx_match_init(const char *engine)
+{
+	size_t i;
+
+	if (!engine) {
+		util_srx_match = &util_srx_list_match_ops;
+		return FI_SUCCESS;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(util_srx_match_engines); i++) {
+		if (!strcasecmp(engine, util_srx_match_engines[i]->name)) {
+			util_srx_match = util_srx_match_engines[i];
+			return FI_SUCCESS;
+		}
+	}
+	return -FI_EINVAL;
+}
+
+void ofi_srx_init(void)
+{
+	char *engine = NULL;
+
+	fi_param_define(NULL, "srx_match", FI_PARAM_STRING,
+			"Tag matching engine of the shared receive context "
+			"used by shm and the providers sharing its SRX: list "
+			"or hash (default: list)");
+	fi_param_get_str(NULL, "srx_match", &engine);
+
+	if (util_srx_match_init(engine))
+		FI_WARN(&core_prov, FI_LOG_CORE,
+			"srx_match %s not supported, using %s\n", engine,
+			util_srx_match->name);
+}
+
 static int util_srx_getopt(fid_t fid, int level, int optname,
 		           void *optval, size_t *optlen)
 {
@@ -1246,6 +1617,16 @@ int util_ep_srx_context(struct util_domain *domain, size_t rx_size,
 		return ret;
 	}
 
+	srx->match_ops = util_srx_match;
+	if (srx->match_ops->init) {
+		ret = srx->match_ops->init(srx);
+		if (ret) {
+			ofi_bufpool_destroy(srx->rx_pool);
+			free(srx);
+			return ret;
+		}
+	}
+
 	srx->min_multi_recv_size = default_min_multi_recv;
 	srx->iov_limit = iov_limit;
 	srx->dir_recv = domain->info_domain_caps & FI_DIRECTED_RECV;
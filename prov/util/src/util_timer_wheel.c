@@ -0,0 +1,241 @@
+/*
+ * Copyright (c) 2024 Hewlett Packard Enterprise Development LP. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "config.h"
+
+#include <assert.h>
+#include <limits.h>
+
+#include "ofi.h"
+#include "ofi_timer.h"
+
+#define OFI_TIMER_WHEEL_SPAN	(1ULL << (OFI_TIMER_WHEEL_LEVELS * \
+					  OFI_TIMER_WHEEL_BITS))
+
+static inline unsigned int ofi_timer_ffs(uint64_t val)
+{
+#ifdef __GNUC__
+	return __builtin_ffsll(val);
+#else
+	return ofi_lsb(val);
+#endif
+}
+
+void ofi_timer_wheel_init(struct ofi_timer_wheel *wheel, uint64_t tick_ns,
+			  uint64_t now_ns)
+{
+	int level, slot;
+
+	assert(tick_ns);
+	wheel->tick_ns = tick_ns;
+	wheel->now = now_ns / tick_ns;
+	wheel->cnt = 0;
+	for (level = 0; level < OFI_TIMER_WHEEL_LEVELS; level++) {
+		wheel->occupied[level] = 0;
+		for (slot = 0; slot < OFI_TIMER_WHEEL_SLOTS; slot++)
+			dlist_init(&wheel->slots[level][slot]);
+	}
+}
+
+/*
+ * Place the timer in the lowest level whose rotation, counted from the tick
+ * after now, reaches the expiration.  A level 0 slot serves the tick 64
+ * ticks out once the current one is done, and the same holds one level up
+ * for the slot being cascaded.
+ */
+static void ofi_timer_insert(struct ofi_timer_wheel *wheel,
+			     struct ofi_timer *timer)
+{
+	uint64_t expires, delta;
+	int level;
+
+	expires = MAX(timer->expires, wheel->now + 1);
+	delta = expires - wheel->now;
+	if (delta > OFI_TIMER_WHEEL_SPAN)
+		expires = wheel->now + OFI_TIMER_WHEEL_SPAN;
+
+	for (level = 0; level < OFI_TIMER_WHEEL_LEVELS - 1; level++) {
+		if (delta <= 1ULL << ((level + 1) * OFI_TIMER_WHEEL_BITS))
+			break;
+	}
+
+	timer->level = (uint8_t) level;
+	timer->slot = (uint8_t) ((expires >> (level * OFI_TIMER_WHEEL_BITS)) &
+				 OFI_TIMER_WHEEL_MASK);
+	dlist_insert_tail(&timer->entry, &wheel->slots[level][timer->slot]);
+	wheel->occupied[level] |= 1ULL << timer->slot;
+}
+
+void ofi_timer_arm(struct ofi_timer_wheel *wheel, struct ofi_timer *timer,
+		   uint64_t expires_ns)
+{
+	if (ofi_timer_armed(timer))
+		ofi_timer_cancel(wheel, timer);
+
+	timer->expires = (expires_ns + wheel->tick_ns - 1) / wheel->tick_ns;
+	ofi_timer_insert(wheel, timer);
+	wheel->cnt++;
+}
+
+void ofi_timer_cancel(struct ofi_timer_wheel *wheel, struct ofi_timer *timer)
+{
+	if (!ofi_timer_armed(timer))
+		return;
+
+	dlist_remove_init(&timer->entry);
+	if (dlist_empty(&wheel->slots[timer->level][timer->slot]))
+		wheel->occupied[timer->level] &= ~(1ULL << timer->slot);
+	wheel->cnt--;
+}
+
+/*
+ * First tick after now at which an occupied slot is expired (level 0) or
+ * cascaded (higher levels).  The slot holding the current digit of a level
+ * is only reached after a full rotation of that level.
+ */
+static uint64_t ofi_timer_wheel_next_tick(struct ofi_timer_wheel *wheel)
+{
+	uint64_t occ, cur, tick, next = UINT64_MAX;
+	unsigned int shift, digit;
+	int level;
+
+	for (level = 0; level < OFI_TIMER_WHEEL_LEVELS; level++) {
+		occ = wheel->occupied[level];
+		if (!occ)
+			continue;
+
+		shift = level * OFI_TIMER_WHEEL_BITS;
+		cur = wheel->now >> shift;
+		digit = (unsigned int) (cur & OFI_TIMER_WHEEL_MASK) + 1;
+		if (digit < OFI_TIMER_WHEEL_SLOTS)
+			occ = (occ >> digit) |
+			      (occ << (OFI_TIMER_WHEEL_SLOTS - digit));
+
+		tick = (cur + ofi_timer_ffs(occ)) << shift;
+		next = MIN(next, tick);
+	}
+	return next;
+}
+
+static void ofi_timer_cascade(struct ofi_timer_wheel *wheel, int level,
+			      int slot)
+{
+	struct dlist_entry list;
+	struct ofi_timer *timer;
+
+	dlist_init(&list);
+	dlist_splice_tail(&list, &wheel->slots[level][slot]);
+	wheel->occupied[level] &= ~(1ULL << slot);
+
+	while (!dlist_empty(&list)) {
+		dlist_pop_front(&list, struct ofi_timer, timer, entry);
+		ofi_timer_insert(wheel, timer);
+	}
+}
+
+size_t ofi_timer_wheel_expire(struct ofi_timer_wheel *wheel, uint64_t now_ns)
+{
+	struct dlist_entry list;
+	struct ofi_timer *timer;
+	uint64_t target, tick;
+	size_t fired = 0;
+	int level, slot;
+
+	target = now_ns / wheel->tick_ns;
+	dlist_init(&list);
+	while (wheel->now < target) {
+		tick = wheel->cnt ? ofi_timer_wheel_next_tick(wheel) :
+			UINT64_MAX;
+		if (tick > target) {
+			wheel->now = target;
+			break;
+		}
+
+		/* Cascade from the top, so timers can drop more than one
+		 * level.  Timers due at this tick land in its level 0 slot.
+		 */
+		wheel->now = tick - 1;
+		for (level = OFI_TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+			if (tick & ((1ULL << (level * OFI_TIMER_WHEEL_BITS)) - 1))
+				continue;
+			slot = (tick >> (level * OFI_TIMER_WHEEL_BITS)) &
+			       OFI_TIMER_WHEEL_MASK;
+			ofi_timer_cascade(wheel, level, slot);
+		}
+
+		/* Timers armed by the callbacks belong to later ticks. */
+		wheel->now = tick;
+		slot = tick & OFI_TIMER_WHEEL_MASK;
+		dlist_splice_tail(&list, &wheel->slots[0][slot]);
+		wheel->occupied[0] &= ~(1ULL << slot);
+
+		while (!dlist_empty(&list)) {
+			dlist_pop_front(&list, struct ofi_timer, timer, entry);
+			if (timer->expires > tick) {
+				ofi_timer_insert(wheel, timer);
+				continue;
+			}
+			dlist_init(&timer->entry);
+			wheel->cnt--;
+			fired++;
+			timer->callback(timer);
+		}
+	}
+	return fired;
+}
+
+uint64_t ofi_timer_wheel_next(struct ofi_timer_wheel *wheel)
+{
+	uint64_t tick;
+
+	if (!wheel->cnt)
+		return UINT64_MAX;
+
+	tick = ofi_timer_wheel_next_tick(wheel);
+	return tick * wheel->tick_ns;
+}
+
+/* Bound a poll timeout in milliseconds by the next expiration. */
+int ofi_timer_wheel_timeout(struct ofi_timer_wheel *wheel, uint64_t now_ns,
+			    int timeout)
+{
+	uint64_t next, ms;
+
+	next = ofi_timer_wheel_next(wheel);
+	if (next == UINT64_MAX)
+		return timeout;
+
+	ms = next > now_ns ? (next - now_ns + 999999) / 1000000 : 0;
+	if (timeout >= 0 && (uint64_t) timeout <= ms)
+		return timeout;
+	return (int) MIN(ms, (uint64_t) INT_MAX);
+}
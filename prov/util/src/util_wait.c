@@ -174,25 +174,15 @@ static int ofi_wait_match_fd(struct dlist_entry *item, const void *arg)
 int ofi_wait_fdset_del(struct util_wait_fd *wait_fd, int fd)
 {
 	wait_fd->change_index++;
-
-	return (wait_fd->util_wait.wait_obj == FI_WAIT_FD) ?
-		ofi_epoll_del(wait_fd->epoll_fd, fd) :
-		ofi_pollfds_del(wait_fd->pollfds, fd);
+	return ofi_dynpoll_del(&wait_fd->dynpoll, fd);
 }
 
-static int ofi_wait_fdset_add(struct util_wait_fd *wait_fd, int fd,
-			      uint32_t events, void *context)
+int ofi_wait_fdset_add(struct util_wait_fd *wait_fd, int fd,
+		       uint32_t events, void *context)
 {
-	int ret;
-
 	wait_fd->change_index++;
-	if (wait_fd->util_wait.wait_obj == FI_WAIT_FD) {
-		ret = ofi_epoll_add(wait_fd->epoll_fd, fd,
-				    ofi_poll_to_epoll(events), context);
-	} else {
-		ret = ofi_pollfds_add(wait_fd->pollfds, fd, events, context);
-	}
-	return ret;
+	return ofi_dynpoll_add(&wait_fd->dynpoll, fd,
+			       ofi_poll_to_epoll(events), context);
 }
 
 int ofi_wait_del_fd(struct util_wait *wait, int fd)
@@ -332,6 +322,22 @@ static int util_wait_update_pollfd(struct util_wait_fd *wait_fd,
 	return -FI_EAGAIN;
 }
 
+/* Completed polls keep the ring fd readable.  Reap and rearm the ones
+ * already queued before the application blocks on it; the state checked
+ * by the caller is what decides whether anything is ready.  A rearmed fd
+ * that is still ready completes again at once, so this must not loop
+ * until the ring is empty.
+ */
+void ofi_wait_fd_reset(struct util_wait_fd *wait_fd)
+{
+	struct ofi_epollfds_event events[8];
+
+	fd_signal_reset(&wait_fd->signal);
+	if (wait_fd->dynpoll.type == OFI_DYNPOLL_URING)
+		(void) ofi_dynpoll_wait(&wait_fd->dynpoll, events,
+					ARRAY_SIZE(events), 0);
+}
+
 static int util_wait_fd_try(struct util_wait *wait)
 {
 	struct ofi_wait_fid_entry *fid_entry;
@@ -341,7 +347,8 @@ static int util_wait_fd_try(struct util_wait *wait)
 	int ret;
 
 	wait_fd = container_of(wait, struct util_wait_fd, util_wait);
-	fd_signal_reset(&wait_fd->signal);
+	ofi_wait_fd_reset(wait_fd);
+
 	ofi_mutex_lock(&wait->lock);
 	dlist_foreach_container(&wait_fd->fd_list, struct ofi_wait_fd_entry,
 				fd_entry, entry) {
@@ -390,9 +397,7 @@ static int util_wait_fd_run(struct fid_wait *wait_fid, int timeout)
 		if (ofi_adjust_timeout(endtime, &timeout))
 			return -FI_ETIMEDOUT;
 
-		ret = (wait->util_wait.wait_obj == FI_WAIT_FD) ?
-		      ofi_epoll_wait(wait->epoll_fd, &event, 1, timeout) :
-		      ofi_pollfds_wait(wait->pollfds, &event, 1, timeout);
+		ret = ofi_dynpoll_wait(&wait->dynpoll, &event, 1, timeout);
 		if (ret > 0)
 			return FI_SUCCESS;
 
@@ -413,6 +418,7 @@ static int util_wait_fd_control(struct fid *fid, int command, void *arg)
 {
 	struct util_wait_fd *wait;
 	struct fi_wait_pollfd *pollfd;
+	struct ofi_pollfds *pfds;
 	int ret;
 
 	wait = container_of(fid, struct util_wait_fd, util_wait.wait_fid.fid);
@@ -420,7 +426,7 @@ static int util_wait_fd_control(struct fid *fid, int command, void *arg)
 	case FI_GETWAIT:
 		if (wait->util_wait.wait_obj == FI_WAIT_FD) {
 #if defined (HAVE_EPOLL) || defined(HAVE_KQUEUE)
-			*(int *) arg = wait->epoll_fd;
+			*(int *) arg = ofi_dynpoll_get_fd(&wait->dynpoll);
 			return 0;
 #else
 			return -FI_ENODATA;
@@ -429,15 +435,16 @@ static int util_wait_fd_control(struct fid *fid, int command, void *arg)
 
 		pollfd = arg;
 		ofi_mutex_lock(&wait->util_wait.lock);
-		if (pollfd->nfds >= wait->pollfds->nfds) {
-			memcpy(pollfd->fd, &wait->pollfds->fds[0],
-			       wait->pollfds->nfds * sizeof(*wait->pollfds->fds));
+		pfds = wait->dynpoll.pfds;
+		if (pollfd->nfds >= pfds->nfds) {
+			memcpy(pollfd->fd, &pfds->fds[0],
+			       pfds->nfds * sizeof(*pfds->fds));
 			ret = 0;
 		} else {
 			ret = -FI_ETOOSMALL;
 		}
 		pollfd->change_index = wait->change_index;
-		pollfd->nfds = wait->pollfds->nfds;
+		pollfd->nfds = pfds->nfds;
 		ofi_mutex_unlock(&wait->util_wait.lock);
 		break;
 	case FI_GETWAITOBJ:
@@ -476,11 +483,7 @@ static int util_wait_fd_close(struct fid *fid)
 
 	ofi_wait_fdset_del(wait, wait->signal.fd[FI_READ_FD]);
 	fd_signal_free(&wait->signal);
-
-	if (wait->util_wait.wait_obj == FI_WAIT_FD)
-		ofi_epoll_close(wait->epoll_fd);
-	else
-		ofi_pollfds_close(wait->pollfds);
+	ofi_dynpoll_close(&wait->dynpoll);
 	free(wait);
 	return 0;
 }
@@ -520,6 +523,32 @@ static int util_verify_wait_fd_attr(const struct fi_provider *prov,
 	return 0;
 }
 
+/* Fd based wait sets use the io_uring poll ring when requested and
+ * available, falling back to epoll otherwise.  Pollfd wait sets expose
+ * their fd array to the application and always use poll.
+ */
+static int util_wait_fd_dynpoll_create(struct util_wait_fd *wait)
+{
+	int ret;
+
+	if (wait->util_wait.wait_obj == FI_WAIT_POLLFD)
+		return ofi_dynpoll_create(&wait->dynpoll, OFI_DYNPOLL_POLL,
+					  OFI_LOCK_MUTEX);
+
+	if (ofi_wait_uring) {
+		ret = ofi_dynpoll_create(&wait->dynpoll, OFI_DYNPOLL_URING,
+					 OFI_LOCK_MUTEX);
+		if (!ret)
+			return 0;
+
+		FI_INFO(wait->util_wait.prov, FI_LOG_FABRIC,
+			"io_uring wait unavailable, using epoll: %s\n",
+			fi_strerror(-ret));
+	}
+	return ofi_dynpoll_create(&wait->dynpoll, OFI_DYNPOLL_EPOLL,
+				  OFI_LOCK_MUTEX);
+}
+
 int ofi_wait_fd_open(struct fid_fabric *fabric_fid, struct fi_wait_attr *attr,
 		    struct fid_wait **waitset)
 {
@@ -546,9 +575,7 @@ int ofi_wait_fd_open(struct fid_fabric *fabric_fid, struct fi_wait_attr *attr,
 	if (ret)
 		goto err2;
 
-	ret = (wait->util_wait.wait_obj == FI_WAIT_FD) ?
-	      ofi_epoll_create(&wait->epoll_fd) :
-	      ofi_pollfds_create(&wait->pollfds);
+	ret = util_wait_fd_dynpoll_create(wait);
 	if (ret)
 		goto err3;
 
@@ -566,10 +593,7 @@ int ofi_wait_fd_open(struct fid_fabric *fabric_fid, struct fi_wait_attr *attr,
 	return 0;
 
 err4:
-	if (wait->util_wait.wait_obj == FI_WAIT_FD)
-		ofi_epoll_close(wait->epoll_fd);
-	else
-		ofi_pollfds_close(wait->pollfds);
+	ofi_dynpoll_close(&wait->dynpoll);
 err3:
 	fd_signal_free(&wait->signal);
 err2:
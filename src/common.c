@@ -88,6 +88,8 @@ struct ofi_common_locks common_locks = {
 int ofi_fork_unsafe;
 size_t ofi_universe_size = 1024;
 int ofi_av_remove_cleanup;
+int ofi_av_flat_index;
+int ofi_wait_uring;
 char *ofi_offload_coll_prov_name = NULL;
 
 
@@ -96,6 +98,8 @@ void ofi_params_init(void)
 	fi_param_get_bool(NULL, "fork_unsafe", &ofi_fork_unsafe);
 	fi_param_get_size_t(NULL, "universe_size", &ofi_universe_size);
 	fi_param_get_bool(NULL, "av_remove_cleanup", &ofi_av_remove_cleanup);
+	fi_param_get_bool(NULL, "av_flat_index", &ofi_av_flat_index);
+	fi_param_get_bool(NULL, "wait_uring", &ofi_wait_uring);
 	fi_param_get_str(NULL, "offload_coll_provider",
 			 &ofi_offload_coll_prov_name);
 }
@@ -1967,6 +1971,44 @@ ofi_dynpoll_get_fd_poll(struct ofi_dynpoll *dynpoll)
 	return INVALID_SOCKET;  /* Unsupported */
 }
 
+static int
+ofi_dynpoll_add_uring(struct ofi_dynpoll *dynpoll, int fd,
+		      uint32_t events, void *context)
+{
+	assert(dynpoll->type == OFI_DYNPOLL_URING);
+	return ofi_pollring_add(dynpoll->ring, fd, events, context);
+}
+
+static int
+ofi_dynpoll_mod_uring(struct ofi_dynpoll *dynpoll, int fd,
+		      uint32_t events, void *context)
+{
+	assert(dynpoll->type == OFI_DYNPOLL_URING);
+	return ofi_pollring_mod(dynpoll->ring, fd, events, context);
+}
+
+static int ofi_dynpoll_del_uring(struct ofi_dynpoll *dynpoll, int fd)
+{
+	assert(dynpoll->type == OFI_DYNPOLL_URING);
+	return ofi_pollring_del(dynpoll->ring, fd);
+}
+
+static int
+ofi_dynpoll_wait_uring(struct ofi_dynpoll *dynpoll,
+		       struct ofi_epollfds_event *events,
+		       int maxevents, int timeout)
+{
+	assert(dynpoll->type == OFI_DYNPOLL_URING);
+	return ofi_pollring_wait(dynpoll->ring, events, maxevents, timeout);
+}
+
+static int
+ofi_dynpoll_get_fd_uring(struct ofi_dynpoll *dynpoll)
+{
+	assert(dynpoll->type == OFI_DYNPOLL_URING);
+	return ofi_pollring_fd(dynpoll->ring);
+}
+
 void ofi_dynpoll_close(struct ofi_dynpoll *dynpoll)
 {
 	switch (dynpoll->type) {
@@ -1976,6 +2018,9 @@ void ofi_dynpoll_close(struct ofi_dynpoll *dynpoll)
 	case OFI_DYNPOLL_POLL:
 		ofi_pollfds_close(dynpoll->pfds);
 		break;
+	case OFI_DYNPOLL_URING:
+		ofi_pollring_close(dynpoll->ring);
+		break;
 	default:
 		assert(0);
 		break;
@@ -2005,6 +2050,14 @@ int ofi_dynpoll_create(struct ofi_dynpoll *dynpoll, enum ofi_dynpoll_type type,
 		dynpoll->wait = ofi_dynpoll_wait_poll;
 		dynpoll->get_fd = ofi_dynpoll_get_fd_poll;
 		break;
+	case OFI_DYNPOLL_URING:
+		ret = ofi_pollring_create(&dynpoll->ring, lock_type);
+		dynpoll->add = ofi_dynpoll_add_uring;
+		dynpoll->mod = ofi_dynpoll_mod_uring;
+		dynpoll->del = ofi_dynpoll_del_uring;
+		dynpoll->wait = ofi_dynpoll_wait_uring;
+		dynpoll->get_fd = ofi_dynpoll_get_fd_uring;
+		break;
 	default:
 		assert(0);
 		ret = -FI_EINVAL;
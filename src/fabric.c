@@ -51,6 +51,7 @@
 #include "ofi_perf.h"
 #include "ofi_hmem.h"
 #include "ofi_mr.h"
+#include "ofi_atomic.h"
 #include <ofi_shm_p2p.h>
 #include <rdma/fi_ext.h>
 
@@ -480,7 +481,7 @@ static void ofi_ordered_provs_init(void)
 		 * doesn't matter
 		 */
 		"ofi_hook_perf", "ofi_hook_trace", "ofi_hook_profile",
-		"ofi_hook_monitor", "ofi_hook_debug",
+		"ofi_hook_monitor", "ofi_hook_record", "ofi_hook_debug",
 		"ofi_hook_noop", "ofi_hook_hmem", "ofi_hook_dmabuf_peer_mem",
 
 		/* So do the offload providers. */
@@ -920,6 +921,307 @@ static void ofi_hook_fini(void)
 		ofi_free_string_array(hooks);
 }
 
+/*
+ * fi_getinfo result cache.  Results are kept for the lifetime of the
+ * process, keyed by the arguments of the call.  When a cache path is
+ * set, the names of the providers that returned data for a key are also
+ * appended to a node-local file, one "<hash> <time> <providers>" line
+ * per call.  Other processes making the same call within the ttl only
+ * query those providers, skipping ones that found no devices or
+ * interfaces.  The providers that are queried still build their own
+ * state, so nothing but provider names is shared between processes.
+ */
+#define OFI_GETINFO_KEY_LEN	16384
+#define OFI_GETINFO_LINE_LEN	1024
+
+struct ofi_getinfo_entry {
+	struct dlist_entry	entry;
+	char			*key;
+	struct fi_info		*info;
+	int			ret;
+};
+
+static DEFINE_LIST(getinfo_cache);
+static pthread_mutex_t getinfo_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static int getinfo_cache_enabled;
+static char *getinfo_cache_path;
+static int getinfo_cache_ttl = 60;
+
+static void ofi_getinfo_cache_init(void)
+{
+	fi_param_get_bool(NULL, "getinfo_cache", &getinfo_cache_enabled);
+	fi_param_get_str(NULL, "getinfo_cache_path", &getinfo_cache_path);
+	fi_param_get_int(NULL, "getinfo_cache_ttl", &getinfo_cache_ttl);
+	if (getinfo_cache_path && !*getinfo_cache_path)
+		getinfo_cache_path = NULL;
+}
+
+static void ofi_getinfo_cache_cleanup(void)
+{
+	struct ofi_getinfo_entry *entry;
+
+	while (!dlist_empty(&getinfo_cache)) {
+		dlist_pop_front(&getinfo_cache, struct ofi_getinfo_entry,
+				entry, entry);
+		fi_freeinfo(entry->info);
+		free(entry->key);
+		free(entry);
+	}
+}
+
+static struct fi_info *ofi_dupinfo_list(const struct fi_info *info)
+{
+	struct fi_info *head = NULL, *tail = NULL, *cur;
+
+	for (; info; info = info->next) {
+		cur = fi_dupinfo(info);
+		if (!cur) {
+			fi_freeinfo(head);
+			return NULL;
+		}
+
+		if (tail)
+			tail->next = cur;
+		else
+			head = cur;
+		tail = cur;
+	}
+	return head;
+}
+
+static char *ofi_getinfo_key(uint32_t version, const char *node,
+			     const char *service, uint64_t flags,
+			     const struct fi_info *hints)
+{
+	char *str, *key;
+
+	if (hints && (hints->handle ||
+	    (hints->fabric_attr && hints->fabric_attr->fabric) ||
+	    (hints->domain_attr && (hints->domain_attr->domain ||
+				    hints->domain_attr->auth_key)) ||
+	    (hints->ep_attr && hints->ep_attr->auth_key)))
+		return NULL;
+
+	str = calloc(1, OFI_GETINFO_KEY_LEN);
+	if (!str)
+		return NULL;
+
+	if (hints)
+		fi_tostr_r(str, OFI_GETINFO_KEY_LEN, hints, FI_TYPE_INFO);
+
+	if (asprintf(&key, "%x %" PRIx64 " %s %s\n%s", version, flags,
+		     node ? node : "-", service ? service : "-", str) < 0)
+		key = NULL;
+
+	free(str);
+	return key;
+}
+
+static bool ofi_getinfo_cache_get(const char *key, struct fi_info **info,
+				  int *ret)
+{
+	struct ofi_getinfo_entry *entry;
+	bool found = false;
+
+	pthread_mutex_lock(&getinfo_cache_lock);
+	dlist_foreach_container(&getinfo_cache, struct ofi_getinfo_entry,
+				entry, entry) {
+		if (strcmp(entry->key, key))
+			continue;
+
+		found = true;
+		*ret = entry->ret;
+		*info = NULL;
+		if (!*ret) {
+			*info = ofi_dupinfo_list(entry->info);
+			if (!*info)
+				*ret = -FI_ENOMEM;
+		}
+		break;
+	}
+	pthread_mutex_unlock(&getinfo_cache_lock);
+	return found;
+}
+
+/* Takes ownership of key */
+static void ofi_getinfo_cache_add(char *key, const struct fi_info *info,
+				  int ret)
+{
+	struct ofi_getinfo_entry *entry;
+
+	entry = calloc(1, sizeof(*entry));
+	if (!entry)
+		goto err;
+
+	entry->ret = ret;
+	if (info) {
+		entry->info = ofi_dupinfo_list(info);
+		if (!entry->info)
+			goto err;
+	}
+	entry->key = key;
+
+	pthread_mutex_lock(&getinfo_cache_lock);
+	dlist_insert_head(&entry->entry, &getinfo_cache);
+	pthread_mutex_unlock(&getinfo_cache_lock);
+	return;
+err:
+	free(entry);
+	free(key);
+}
+
+static uint64_t ofi_fnv1a(uint64_t hash, const char *str)
+{
+	for (; *str; str++) {
+		hash ^= (uint8_t) *str;
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+extern char **environ;
+
+/* Variables outside of the FI_ namespace that change which devices
+ * providers discover.
+ */
+static const char *const ofi_getinfo_env[] = {
+	"CUDA_VISIBLE_DEVICES", "ROCR_VISIBLE_DEVICES", "HIP_VISIBLE_DEVICES",
+	"ZE_AFFINITY_MASK", "NEURON_RT_VISIBLE_CORES",
+};
+
+static bool ofi_getinfo_env_match(const char *var)
+{
+	size_t i, len;
+
+	/* Logging and the cache settings do not affect discovery */
+	if (!strncmp(var, "FI_", 3))
+		return strncmp(var, "FI_LOG_", 7) &&
+		       strncmp(var, "FI_GETINFO_CACHE", 16);
+
+	for (i = 0; i < ARRAY_SIZE(ofi_getinfo_env); i++) {
+		len = strlen(ofi_getinfo_env[i]);
+		if (!strncmp(var, ofi_getinfo_env[i], len) && var[len] == '=')
+			return true;
+	}
+	return false;
+}
+
+/* Processes with a different set of visible providers, for example due
+ * to FI_PROVIDER, or whose environment changes what the providers
+ * discover, such as FI_TCP_IFACE or CUDA_VISIBLE_DEVICES, must not
+ * share entries.  Environment variables are summed so that their order
+ * does not matter.
+ */
+static uint64_t ofi_getinfo_hash(const char *key)
+{
+	struct ofi_prov *prov;
+	uint64_t hash, env = 0;
+	char **var;
+
+	hash = ofi_fnv1a(0xcbf29ce484222325ULL, key);
+	for (prov = prov_head; prov; prov = prov->next) {
+		if (prov->provider && !prov->hidden)
+			hash = ofi_fnv1a(hash, prov->provider->name);
+	}
+
+	for (var = environ; var && *var; var++) {
+		if (ofi_getinfo_env_match(*var))
+			env += ofi_fnv1a(0xcbf29ce484222325ULL, *var);
+	}
+	return hash ^ env;
+}
+
+static bool ofi_getinfo_file_parse(const char *line, time_t now,
+				   uint64_t *hash, long *stamp, char *provs)
+{
+	return sscanf(line, "%" SCNx64 " %ld %1023s", hash, stamp,
+		      provs) == 3 &&
+	       *stamp <= now && now - *stamp <= getinfo_cache_ttl;
+}
+
+/* Returns the providers recorded for hash in the shared file, or NULL */
+static char **ofi_getinfo_file_get(uint64_t hash)
+{
+	char line[OFI_GETINFO_LINE_LEN], provs[OFI_GETINFO_LINE_LEN];
+	char match[OFI_GETINFO_LINE_LEN] = "";
+	uint64_t line_hash;
+	time_t now;
+	long stamp;
+	size_t count;
+	FILE *fp;
+
+	fp = fopen(getinfo_cache_path, "r");
+	if (!fp)
+		return NULL;
+
+	now = time(NULL);
+	while (fgets(line, sizeof(line), fp)) {
+		if (ofi_getinfo_file_parse(line, now, &line_hash, &stamp,
+					   provs) && line_hash == hash)
+			strcpy(match, provs);
+	}
+	fclose(fp);
+
+	if (!*match)
+		return NULL;
+
+	FI_INFO(&core_prov, FI_LOG_CORE,
+		"fi_getinfo: using providers %s from %s\n", match,
+		getinfo_cache_path);
+	return ofi_split_and_alloc(match, ",", &count);
+}
+
+/* Rewrites the file with the entries that are still valid plus the new
+ * one, so that it does not grow without bound.  The new contents are
+ * renamed into place, so readers never see a partial file.  Entries
+ * added concurrently by another process may be lost, which only costs
+ * that process a full query next time.
+ */
+static void ofi_getinfo_file_put(uint64_t hash, const char *provs)
+{
+	char line[OFI_GETINFO_LINE_LEN], old[OFI_GETINFO_LINE_LEN];
+	uint64_t line_hash;
+	char *tmp_path;
+	FILE *fp, *tmp;
+	time_t now;
+	long stamp;
+
+	if (asprintf(&tmp_path, "%s.%d", getinfo_cache_path,
+		     (int) getpid()) < 0)
+		return;
+
+	tmp = fopen(tmp_path, "w");
+	if (!tmp) {
+		FI_WARN(&core_prov, FI_LOG_CORE,
+			"unable to open %s: %s\n", tmp_path,
+			strerror(errno));
+		free(tmp_path);
+		return;
+	}
+
+	now = time(NULL);
+	fp = fopen(getinfo_cache_path, "r");
+	if (fp) {
+		while (fgets(line, sizeof(line), fp)) {
+			if (ofi_getinfo_file_parse(line, now, &line_hash,
+						   &stamp, old) &&
+			    line_hash != hash)
+				fputs(line, tmp);
+		}
+		fclose(fp);
+	}
+
+	fprintf(tmp, "%016" PRIx64 " %ld %s\n", hash, (long) now,
+		*provs ? provs : "-");
+	if (fclose(tmp) || rename(tmp_path, getinfo_cache_path)) {
+		FI_WARN(&core_prov, FI_LOG_CORE,
+			"unable to update %s: %s\n", getinfo_cache_path,
+			strerror(errno));
+		unlink(tmp_path);
+	}
+	free(tmp_path);
+}
+
 void fi_ini(void)
 {
 	char *param_val = NULL;
@@ -935,11 +1237,13 @@ void fi_ini(void)
 	ofi_dump_sysconfig();
 	ofi_osd_init();
 	ofi_mem_init();
+	ofi_atomic_init();
 	ofi_pmem_init();
 	ofi_perf_init();
 	ofi_hook_init();
 	ofi_hmem_init();
 	ofi_monitors_init();
+	ofi_srx_init();
 	ofi_shm_p2p_init();
 
 	fi_param_define(NULL, "provider", FI_PARAM_STRING,
@@ -969,11 +1273,45 @@ void fi_ini(void)
 			"address is removed from the local AV.  "
 			"(default: false)");
 
+	fi_param_define(NULL, "av_flat_index", FI_PARAM_BOOL,
+			"When true, AVs built on the common AV code map "
+			"addresses back to fi_addr_t values through an open "
+			"addressing table instead of a chained hash.  This "
+			"uses less memory and fewer cache misses with large "
+			"numbers of peers.  (default: false)");
+
+	fi_param_define(NULL, "wait_uring", FI_PARAM_BOOL,
+			"When true, fd based wait sets built on the common "
+			"wait code poll their fds through io_uring, if "
+			"libfabric was built with liburing.  Rearming fds and "
+			"blocking are then submitted to the kernel together.  "
+			"FI_GETWAIT returns the io_uring fd.  (default: false)");
+
 	fi_param_define(NULL, "offload_coll_provider", FI_PARAM_STRING,
 			"The name of a colective offload provider (default: \
 			empty - no provider)");
 
+	fi_param_define(NULL, "getinfo_cache", FI_PARAM_BOOL,
+			"When true, results of fi_getinfo are cached for the "
+			"lifetime of the process, keyed by the version, "
+			"node, service, flags and hints of the call.  Calls "
+			"with hints that reference an open fabric, domain or "
+			"an authorization key are never cached.  "
+			"(default: false)");
+
+	fi_param_define(NULL, "getinfo_cache_path", FI_PARAM_STRING,
+			"Path of a node-local file shared by processes that "
+			"records which providers returned data for a given "
+			"fi_getinfo call.  Later calls with the same "
+			"arguments only query those providers.  Used with "
+			"FI_GETINFO_CACHE.  (default: none)");
+
+	fi_param_define(NULL, "getinfo_cache_ttl", FI_PARAM_INT,
+			"Seconds that entries in FI_GETINFO_CACHE_PATH stay "
+			"valid.  (default: 60)");
+
 	ofi_params_init();
+	ofi_getinfo_cache_init();
 
 	ofi_load_dl_prov();
 
@@ -1000,6 +1338,7 @@ void fi_ini(void)
 	ofi_register_provider(HOOK_TRACE_INIT, NULL);
 	ofi_register_provider(HOOK_PROFILE_INIT, NULL);
 	ofi_register_provider(HOOK_MONITOR_INIT, NULL);
+	ofi_register_provider(HOOK_RECORD_INIT, NULL);
 	ofi_register_provider(HOOK_DEBUG_INIT, NULL);
 	ofi_register_provider(HOOK_HMEM_INIT, NULL);
 	ofi_register_provider(HOOK_DMABUF_PEER_MEM_INIT, NULL);
@@ -1033,6 +1372,7 @@ FI_DESTRUCTOR(fi_fini(void))
 
 	ofi_free_prov_recursive(prov_head);
 	ofi_free_filter(&prov_filter);
+	ofi_getinfo_cache_cleanup();
 	ofi_shm_p2p_cleanup();
 	ofi_monitors_cleanup();
 	ofi_hmem_cleanup();
@@ -1316,10 +1656,14 @@ static int ofi_layering_ok(const struct fi_provider *provider,
 	return !strcasecmp(provider->name, prov_name);
 }
 
-__attribute__((visibility ("default"),EXTERNALLY_VISIBLE))
-int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
-		const char *service, uint64_t flags,
-		const struct fi_info *hints, struct fi_info **info)
+/*
+ * If provs is set, only the providers it names are queried.  The names of
+ * the providers that returned data are appended to found, if set.
+ */
+static int ofi_getinfo(uint32_t version, const char *node,
+		       const char *service, uint64_t flags,
+		       const struct fi_info *hints, struct fi_info **info,
+		       char **provs, char *found, size_t found_len)
 {
 	struct ofi_prov *prov;
 	struct fi_info *tail, *cur;
@@ -1328,18 +1672,6 @@ int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
 	enum fi_log_level level;
 	int ret;
 
-	fi_ini();
-
-	if (FI_VERSION_LT(fi_version(), version)) {
-		FI_WARN(&core_prov, FI_LOG_CORE,
-			"Requested version is newer than library\n");
-		return -FI_ENOSYS;
-	}
-
-	if (flags == FI_PROV_ATTR_ONLY) {
-		return ofi_getprovinfo(info);
-	}
-
 	if (hints && hints->fabric_attr && hints->fabric_attr->prov_name) {
 		prov_vec = ofi_split_and_alloc(hints->fabric_attr->prov_name,
 					       ";", &count);
@@ -1364,6 +1696,9 @@ int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
 		if (!ofi_layering_ok(prov->provider, prov_vec, count, flags))
 			continue;
 
+		if (provs && ofi_find_name(provs, prov->provider->name) < 0)
+			continue;
+
 		if (FI_VERSION_LT(prov->provider->fi_version, version)) {
 			FI_WARN(&core_prov, FI_LOG_CORE,
 				"Provider %s fi_version %d.%d < requested %d.%d\n",
@@ -1399,6 +1734,10 @@ int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
 		FI_DBG(&core_prov, FI_LOG_CORE, "fi_getinfo: provider %s "
 		       "returned success\n", prov->provider->name);
 
+		if (found)
+			ofi_strncatf(found, found_len, "%s%s", *found ? "," : "",
+				     prov->provider->name);
+
 		if (!*info)
 			*info = cur;
 		else
@@ -1421,6 +1760,67 @@ int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
 
 	return *info ? 0 : -FI_ENODATA;
 }
+
+__attribute__((visibility ("default"),EXTERNALLY_VISIBLE))
+int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
+		const char *service, uint64_t flags,
+		const struct fi_info *hints, struct fi_info **info)
+{
+	char found[OFI_GETINFO_LINE_LEN] = "";
+	char **provs = NULL;
+	uint64_t hash = 0;
+	char *key = NULL;
+	int ret;
+
+	fi_ini();
+
+	if (FI_VERSION_LT(fi_version(), version)) {
+		FI_WARN(&core_prov, FI_LOG_CORE,
+			"Requested version is newer than library\n");
+		return -FI_ENOSYS;
+	}
+
+	if (flags == FI_PROV_ATTR_ONLY) {
+		return ofi_getprovinfo(info);
+	}
+
+	if (!getinfo_cache_enabled)
+		return ofi_getinfo(version, node, service, flags, hints, info,
+				   NULL, NULL, 0);
+
+	key = ofi_getinfo_key(version, node, service, flags, hints);
+	if (!key)
+		return ofi_getinfo(version, node, service, flags, hints, info,
+				   NULL, NULL, 0);
+
+	if (ofi_getinfo_cache_get(key, info, &ret)) {
+		free(key);
+		return ret;
+	}
+
+	if (getinfo_cache_path) {
+		hash = ofi_getinfo_hash(key);
+		provs = ofi_getinfo_file_get(hash);
+	}
+
+	ret = ofi_getinfo(version, node, service, flags, hints, info, provs,
+			  getinfo_cache_path && !provs ? found : NULL,
+			  sizeof(found));
+
+	/* Other errors may be transient and are not cached */
+	if (ret && ret != -FI_ENODATA) {
+		ofi_free_string_array(provs);
+		free(key);
+		return ret;
+	}
+
+	if (getinfo_cache_path && !provs)
+		ofi_getinfo_file_put(hash, found);
+	ofi_free_string_array(provs);
+
+	ofi_getinfo_cache_add(key, ret ? NULL : *info, ret);
+	return ret;
+}
 DEFAULT_SYMVER(fi_getinfo_, fi_getinfo, FABRIC_1.9);
 
 struct fi_info *ofi_allocinfo_internal(void)
@@ -36,6 +36,7 @@
 #include <liburing.h>
 
 #include <ofi_net.h>
+#include <ofi_epoll.h>
 
 int ofi_sockapi_connect_uring(struct ofi_sockapi *sockapi, SOCKET sock,
 			      const struct sockaddr *addr, socklen_t addrlen,
@@ -252,3 +253,465 @@ int ofi_uring_destroy(ofi_io_uring_t *io_uring)
 	return 0;
 }
 
+
+
+#define OFI_POLLRING_ENTRIES	256
+#define OFI_POLLRING_IGNORE	UINT64_MAX
+
+struct ofi_pollring_ctx {
+	void		*context;
+	uint32_t	events;
+	uint32_t	gen;
+	bool		active;
+	bool		armed;
+	bool		pending;
+};
+
+struct ofi_pollring_remove {
+	uint64_t	key;
+	struct slist_entry entry;
+};
+
+/* The submission queue belongs to the thread blocked in the ring while
+ * waiting is set.  Changes made in the meantime only update the fd
+ * contexts, record the polls to rearm or remove, and signal the waiter
+ * to pick them up on its next submission.
+ */
+struct ofi_pollring {
+	struct io_uring	ring;
+	struct ofi_pollring_ctx *ctx;
+	int		size;
+	int		rearm;
+	bool		waiting;
+	struct fd_signal signal;
+	struct slist	remove_list;
+	struct ofi_genlock lock;
+};
+
+static inline uint64_t ofi_pollring_key(int fd, struct ofi_pollring_ctx *ctx)
+{
+	return ((uint64_t) ctx->gen << 32) | (uint32_t) fd;
+}
+
+static struct ofi_pollring_ctx *
+ofi_pollring_get_ctx(struct ofi_pollring *ring, int fd)
+{
+	return (fd >= 0 && fd < ring->size) ? &ring->ctx[fd] : NULL;
+}
+
+static struct ofi_pollring_ctx *
+ofi_pollring_alloc_ctx(struct ofi_pollring *ring, int fd)
+{
+	struct ofi_pollring_ctx *ctx;
+	int size;
+
+	if (fd < ring->size)
+		return &ring->ctx[fd];
+
+	size = MAX(fd + 1, ring->size * 2);
+	ctx = realloc(ring->ctx, size * sizeof(*ctx));
+	if (!ctx)
+		return NULL;
+
+	memset(&ctx[ring->size], 0, (size - ring->size) * sizeof(*ctx));
+	ring->ctx = ctx;
+	ring->size = size;
+	return &ring->ctx[fd];
+}
+
+static struct io_uring_sqe *ofi_pollring_get_sqe(struct ofi_pollring *ring)
+{
+	struct io_uring_sqe *sqe;
+
+	assert(!ring->waiting);
+	sqe = io_uring_get_sqe(&ring->ring);
+	if (!sqe) {
+		io_uring_submit(&ring->ring);
+		sqe = io_uring_get_sqe(&ring->ring);
+	}
+	return sqe;
+}
+
+static int ofi_pollring_arm(struct ofi_pollring *ring, int fd,
+			    struct ofi_pollring_ctx *ctx)
+{
+	struct io_uring_sqe *sqe;
+
+	assert(ofi_genlock_held(&ring->lock));
+	assert(ctx->active && !ctx->armed);
+	if (ring->waiting) {
+		if (!ctx->pending) {
+			ctx->pending = true;
+			ring->rearm++;
+			fd_signal_set(&ring->signal);
+		}
+		return 0;
+	}
+
+	sqe = ofi_pollring_get_sqe(ring);
+	if (!sqe)
+		return -FI_EOVERFLOW;
+
+	io_uring_prep_poll_add(sqe, fd, (unsigned) ctx->events);
+	io_uring_sqe_set_data(sqe, (void *) (uintptr_t)
+			      ofi_pollring_key(fd, ctx));
+	ctx->armed = true;
+	return 0;
+}
+
+/* io_uring_prep_poll_remove() changed its argument type across liburing
+ * releases, so the removal is built directly.
+ */
+static int ofi_pollring_prep_remove(struct ofi_pollring *ring, uint64_t key)
+{
+	struct io_uring_sqe *sqe;
+
+	sqe = ofi_pollring_get_sqe(ring);
+	if (!sqe)
+		return -FI_EOVERFLOW;
+
+	io_uring_prep_rw(IORING_OP_POLL_REMOVE, sqe, -1,
+			 (void *) (uintptr_t) key, 0, 0);
+	io_uring_sqe_set_data(sqe, (void *) (uintptr_t) OFI_POLLRING_IGNORE);
+	return 0;
+}
+
+/* Any completion of the old poll carries the previous generation and is
+ * dropped when reaped.
+ */
+static int ofi_pollring_disarm(struct ofi_pollring *ring, int fd,
+			       struct ofi_pollring_ctx *ctx)
+{
+	struct ofi_pollring_remove *item;
+	uint64_t key;
+
+	assert(ofi_genlock_held(&ring->lock));
+	key = ofi_pollring_key(fd, ctx);
+	ctx->gen++;
+	if (ctx->pending) {
+		ctx->pending = false;
+		ring->rearm--;
+	}
+	if (!ctx->armed)
+		return 0;
+
+	ctx->armed = false;
+	if (!ring->waiting)
+		return ofi_pollring_prep_remove(ring, key);
+
+	item = malloc(sizeof(*item));
+	if (!item)
+		return -FI_ENOMEM;
+
+	item->key = key;
+	slist_insert_tail(&item->entry, &ring->remove_list);
+	fd_signal_set(&ring->signal);
+	return 0;
+}
+
+static void ofi_pollring_process_work(struct ofi_pollring *ring)
+{
+	struct ofi_pollring_remove *item;
+	struct slist_entry *entry;
+	int fd;
+
+	assert(ofi_genlock_held(&ring->lock) && !ring->waiting);
+	while (!slist_empty(&ring->remove_list)) {
+		entry = slist_remove_head(&ring->remove_list);
+		item = container_of(entry, struct ofi_pollring_remove, entry);
+		(void) ofi_pollring_prep_remove(ring, item->key);
+		free(item);
+	}
+
+	for (fd = 0; ring->rearm && fd < ring->size; fd++) {
+		if (!ring->ctx[fd].pending)
+			continue;
+		ring->ctx[fd].pending = false;
+		ring->rearm--;
+		(void) ofi_pollring_arm(ring, fd, &ring->ctx[fd]);
+	}
+}
+
+int ofi_pollring_add(struct ofi_pollring *ring, int fd, uint32_t events,
+		     void *context)
+{
+	struct ofi_pollring_ctx *ctx;
+	int ret = 0;
+
+	ofi_genlock_lock(&ring->lock);
+	ctx = ofi_pollring_alloc_ctx(ring, fd);
+	if (!ctx) {
+		ret = -FI_ENOMEM;
+		goto out;
+	}
+
+	/* Adding an fd twice is not an error, as with ofi_epoll_add() */
+	if (ctx->active)
+		goto out;
+
+	ctx->context = context;
+	ctx->events = events;
+	ctx->active = true;
+	ret = ofi_pollring_arm(ring, fd, ctx);
+	if (ret)
+		ctx->active = false;
+out:
+	ofi_genlock_unlock(&ring->lock);
+	return ret;
+}
+
+int ofi_pollring_mod(struct ofi_pollring *ring, int fd, uint32_t events,
+		     void *context)
+{
+	struct ofi_pollring_ctx *ctx;
+	int ret;
+
+	ofi_genlock_lock(&ring->lock);
+	ctx = ofi_pollring_get_ctx(ring, fd);
+	if (!ctx || !ctx->active) {
+		ret = -FI_ENOENT;
+		goto out;
+	}
+
+	ctx->context = context;
+	if (ctx->events == events && (ctx->armed || ctx->pending)) {
+		ret = 0;
+		goto out;
+	}
+
+	ret = ofi_pollring_disarm(ring, fd, ctx);
+	if (ret)
+		goto out;
+
+	ctx->events = events;
+	ret = ofi_pollring_arm(ring, fd, ctx);
+out:
+	ofi_genlock_unlock(&ring->lock);
+	return ret;
+}
+
+int ofi_pollring_del(struct ofi_pollring *ring, int fd)
+{
+	struct ofi_pollring_ctx *ctx;
+	int ret;
+
+	ofi_genlock_lock(&ring->lock);
+	ctx = ofi_pollring_get_ctx(ring, fd);
+	if (!ctx || !ctx->active) {
+		ret = -FI_ENOENT;
+	} else {
+		ret = ofi_pollring_disarm(ring, fd, ctx);
+		ctx->active = false;
+	}
+	ofi_genlock_unlock(&ring->lock);
+	return ret;
+}
+
+/* Completed polls are one-shot.  Each reported fd is rearmed, so a fd
+ * that stays ready is reported again on the next wait, the same as with
+ * level-triggered epoll.
+ */
+static int ofi_pollring_reap(struct ofi_pollring *ring,
+			     struct ofi_epollfds_event *events, int maxevents)
+{
+	struct ofi_pollring_ctx *ctx;
+	struct io_uring_cqe *cqe;
+	uint64_t key;
+	int fd, res, cnt = 0;
+
+	assert(ofi_genlock_held(&ring->lock));
+	while (cnt < maxevents && !io_uring_peek_cqe(&ring->ring, &cqe)) {
+		key = (uint64_t) (uintptr_t) io_uring_cqe_get_data(cqe);
+		res = cqe->res;
+		io_uring_cqe_seen(&ring->ring, cqe);
+		if (key == OFI_POLLRING_IGNORE)
+			continue;
+
+		fd = (int) (uint32_t) key;
+		ctx = ofi_pollring_get_ctx(ring, fd);
+		if (!ctx || !ctx->active || ofi_pollring_key(fd, ctx) != key)
+			continue;
+
+		ctx->armed = false;
+		if (fd == ring->signal.fd[FI_READ_FD]) {
+			fd_signal_reset(&ring->signal);
+			(void) ofi_pollring_arm(ring, fd, ctx);
+			continue;
+		}
+
+		/* Errors such as a closed fd are reported once, the fd is
+		 * not polled again until it is modified or removed.
+		 */
+		if (res < 0) {
+			OFI_EPOLL_EVT_EVENTS(events[cnt]) = POLLERR;
+		} else {
+			OFI_EPOLL_EVT_EVENTS(events[cnt]) = (uint32_t) res;
+			(void) ofi_pollring_arm(ring, fd, ctx);
+		}
+		OFI_EPOLL_EVT_DATA(events[cnt++]) = ctx->context;
+	}
+	return cnt;
+}
+
+static int ofi_pollring_submit_wait(struct ofi_pollring *ring, int timeout)
+{
+	struct __kernel_timespec ts;
+	struct io_uring_cqe *cqe;
+	int ret;
+
+	if (timeout < 0) {
+		ret = io_uring_submit_and_wait(&ring->ring, 1);
+	} else {
+		ts.tv_sec = timeout / 1000;
+		ts.tv_nsec = (timeout % 1000) * 1000000;
+#if HAVE_DECL_IO_URING_SUBMIT_AND_WAIT_TIMEOUT
+		ret = io_uring_submit_and_wait_timeout(&ring->ring, &cqe, 1,
+						       &ts, NULL);
+#else
+		ret = io_uring_submit(&ring->ring);
+		if (ret >= 0)
+			ret = io_uring_wait_cqe_timeout(&ring->ring, &cqe, &ts);
+#endif
+	}
+
+	return (ret >= 0 || ret == -ETIME || ret == -EINTR) ? 0 : ret;
+}
+
+int ofi_pollring_wait(struct ofi_pollring *ring,
+		      struct ofi_epollfds_event *events,
+		      int maxevents, int timeout)
+{
+	struct pollfd fds;
+	uint64_t endtime;
+	int ret;
+
+	ofi_genlock_lock(&ring->lock);
+	if (ring->waiting) {
+		/* Another thread is blocked in the ring, so only wait for
+		 * completions and reap them.
+		 */
+		ofi_genlock_unlock(&ring->lock);
+		fds.fd = ring->ring.ring_fd;
+		fds.events = POLLIN;
+		ret = poll(&fds, 1, timeout);
+		if (ret <= 0)
+			return ret ? -ofi_syserr() : 0;
+
+		ofi_genlock_lock(&ring->lock);
+		ret = ofi_pollring_reap(ring, events, maxevents);
+		ofi_genlock_unlock(&ring->lock);
+		return ret;
+	}
+
+	endtime = ofi_timeout_time(timeout);
+	do {
+		ofi_pollring_process_work(ring);
+		ret = ofi_pollring_reap(ring, events, maxevents);
+		if (ret || !timeout) {
+			/* Rearmed polls ride along with the next wait, unless
+			 * the caller is only probing the ring.
+			 */
+			if (!timeout)
+				io_uring_submit(&ring->ring);
+			break;
+		}
+
+		ring->waiting = true;
+		ofi_genlock_unlock(&ring->lock);
+		ret = ofi_pollring_submit_wait(ring, timeout);
+		ofi_genlock_lock(&ring->lock);
+		ring->waiting = false;
+		if (ret)
+			break;
+
+		ofi_pollring_process_work(ring);
+		ret = ofi_pollring_reap(ring, events, maxevents);
+	} while (!ret && !ofi_adjust_timeout(endtime, &timeout));
+
+	ofi_genlock_unlock(&ring->lock);
+	return ret;
+}
+
+/* Callers that poll the ring fd themselves need all fd set changes and
+ * rearmed polls submitted first.
+ */
+int ofi_pollring_fd(struct ofi_pollring *ring)
+{
+	ofi_genlock_lock(&ring->lock);
+	if (!ring->waiting) {
+		ofi_pollring_process_work(ring);
+		io_uring_submit(&ring->ring);
+	}
+	ofi_genlock_unlock(&ring->lock);
+	return ring->ring.ring_fd;
+}
+
+void ofi_pollring_close(struct ofi_pollring *ring)
+{
+	struct ofi_pollring_remove *item;
+	struct slist_entry *entry;
+
+	if (!ring)
+		return;
+
+	while (!slist_empty(&ring->remove_list)) {
+		entry = slist_remove_head(&ring->remove_list);
+		item = container_of(entry, struct ofi_pollring_remove, entry);
+		free(item);
+	}
+	io_uring_queue_exit(&ring->ring);
+	ofi_genlock_destroy(&ring->lock);
+	fd_signal_free(&ring->signal);
+	free(ring->ctx);
+	free(ring);
+}
+
+int ofi_pollring_create(struct ofi_pollring **ring,
+			enum ofi_lock_type lock_type)
+{
+	struct ofi_pollring_ctx *ctx;
+	int ret;
+
+	*ring = calloc(1, sizeof(**ring));
+	if (!*ring)
+		return -FI_ENOMEM;
+
+	ret = ofi_uring_init(&(*ring)->ring, OFI_POLLRING_ENTRIES);
+	if (ret)
+		goto err0;
+
+	ret = ofi_genlock_init(&(*ring)->lock, lock_type);
+	if (ret)
+		goto err1;
+
+	ret = fd_signal_init(&(*ring)->signal);
+	if (ret)
+		goto err2;
+
+	slist_init(&(*ring)->remove_list);
+	ofi_genlock_lock(&(*ring)->lock);
+	ctx = ofi_pollring_alloc_ctx(*ring, (*ring)->signal.fd[FI_READ_FD]);
+	if (ctx) {
+		ctx->events = POLLIN;
+		ctx->active = true;
+		ret = ofi_pollring_arm(*ring, (*ring)->signal.fd[FI_READ_FD],
+				       ctx);
+	} else {
+		ret = -FI_ENOMEM;
+	}
+	ofi_genlock_unlock(&(*ring)->lock);
+	if (ret)
+		goto err3;
+
+	return FI_SUCCESS;
+err3:
+	free((*ring)->ctx);
+	fd_signal_free(&(*ring)->signal);
+err2:
+	ofi_genlock_destroy(&(*ring)->lock);
+err1:
+	io_uring_queue_exit(&(*ring)->ring);
+err0:
+	free(*ring);
+	return ret;
+}
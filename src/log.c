@@ -48,6 +48,7 @@
 #include "ofi_str.h"
 #include "ofi_enosys.h"
 #include "ofi_util.h"
+#include "ofi_atomic_queue.h"
 
 
 enum {
@@ -98,6 +99,58 @@ extern struct ofi_common_locks common_locks;
 
 static pid_t pid;
 
+/*
+ * Asynchronous logging.  The calling thread formats the message straight
+ * into a slot of a lock-free multi-producer ring and returns.  A writer
+ * thread composes the full lines and writes them in batches.  Messages
+ * are dropped, and counted, when the ring is full.  Names are copied
+ * into the record because DL providers may be unloaded before the ring
+ * is drained.
+ */
+#define OFI_LOG_MSG_SIZE	1024
+#define OFI_LOG_NAME_SIZE	32
+#define OFI_LOG_FUNC_SIZE	64
+#define OFI_LOG_BATCH_SIZE	(64 * 1024)
+#define OFI_LOG_POLL_US		1000
+#define OFI_LOG_SITES		256
+#define OFI_LOG_CLOSING		(1 << 30)
+
+struct ofi_log_record {
+	char			prefix[OFI_LOG_NAME_SIZE];
+	char			prov[OFI_LOG_NAME_SIZE];
+	char			func[OFI_LOG_FUNC_SIZE];
+	int			line;
+	enum fi_log_level	level;
+	enum fi_log_subsys	subsys;
+	time_t			time;
+	char			msg[OFI_LOG_MSG_SIZE];
+};
+
+OFI_DECLARE_ATOMIC_Q(struct ofi_log_record, ofi_log_queue);
+
+/* Rate limit state.  Call sites that hash to the same slot share a
+ * budget.
+ */
+struct ofi_log_site {
+	uint64_t		window;
+	ofi_atomic32_t		count;
+};
+
+static size_t log_async;
+static int log_rate;
+static struct ofi_log_queue *log_queue;
+/* Number of callers using log_queue, plus OFI_LOG_CLOSING once it is
+ * being freed.
+ */
+static ofi_atomic32_t log_queue_refs;
+static bool log_atfork_set;
+static struct ofi_log_site log_sites[OFI_LOG_SITES];
+static ofi_atomic64_t log_dropped;
+static uint64_t log_dropped_reported;
+static pthread_t log_writer;
+static volatile int log_writer_stop;
+static char log_batch[OFI_LOG_BATCH_SIZE];
+
 static int fi_convert_log_str(const char *value)
 {
 	int i;
@@ -163,10 +216,218 @@ error_log_location:
 		locationstr, strerror(errno));
 }
 
+static void ofi_log_copy(char *dst, const char *src, size_t size)
+{
+	size_t len = strnlen(src, size - 1);
+
+	memcpy(dst, src, len);
+	dst[len] = '\0';
+}
+
+static bool ofi_log_site_allow(const char *func, int line)
+{
+	struct ofi_log_site *site;
+	uint64_t now;
+
+	site = &log_sites[(((uintptr_t) func >> 4) ^ line) % OFI_LOG_SITES];
+	now = ofi_gettime_ms() / 1000;
+	if (site->window != now) {
+		site->window = now;
+		ofi_atomic_set32(&site->count, 0);
+	}
+
+	if (ofi_atomic_inc32(&site->count) <= log_rate)
+		return true;
+
+	ofi_atomic_inc64(&log_dropped);
+	return false;
+}
+
+static void ofi_log_async(const struct fi_provider *prov,
+			  enum fi_log_level level, enum fi_log_subsys subsys,
+			  const char *func, int line, const char *fmt,
+			  va_list vargs)
+{
+	struct ofi_log_record *rec;
+	int64_t pos;
+
+	if (ofi_log_queue_next(log_queue, &rec, &pos)) {
+		ofi_atomic_inc64(&log_dropped);
+		return;
+	}
+
+	ofi_log_copy(rec->prefix, log_prefix, sizeof(rec->prefix));
+	ofi_log_copy(rec->prov, prov->name, sizeof(rec->prov));
+	ofi_log_copy(rec->func, func, sizeof(rec->func));
+	rec->line = line;
+	rec->level = level;
+	rec->subsys = subsys;
+	rec->time = time(NULL);
+	vsnprintf(rec->msg, sizeof(rec->msg), fmt, vargs);
+	ofi_log_queue_commit(rec, pos);
+}
+
+/* Formats a warning with the number of messages dropped since the last
+ * one, if any.  Returns the length of the warning, or 0.
+ */
+static int ofi_log_dropped(char *buf, size_t size)
+{
+	uint64_t dropped;
+	int ret;
+
+	dropped = ofi_atomic_get64(&log_dropped);
+	if (dropped == log_dropped_reported)
+		return 0;
+
+	ret = snprintf(buf, size, "%s:%d:%ld::core:core:%s():%d<warn> "
+		       "%" PRIu64 " log messages dropped\n",
+		       PACKAGE, pid, (unsigned long) time(NULL), __func__,
+		       __LINE__, dropped - log_dropped_reported);
+	if (ret <= 0 || ret >= size)
+		return 0;
+
+	log_dropped_reported = dropped;
+	return ret;
+}
+
+static void ofi_log_write_batch(size_t *len)
+{
+	if (*len) {
+		fwrite(log_batch, 1, *len, log_location);
+		fflush(log_location);
+		*len = 0;
+	}
+}
+
+/* Returns the number of records written */
+static int ofi_log_drain(void)
+{
+	struct ofi_log_record *rec;
+	size_t len = 0;
+	int64_t pos;
+	int ret, cnt = 0;
+
+	while (!ofi_log_queue_head(log_queue, &rec, &pos)) {
+		for (;;) {
+			ret = snprintf(log_batch + len, sizeof(log_batch) - len,
+				       "%s:%d:%ld:%s:%s:%s:%s():%d<%s> %s",
+				       PACKAGE, pid, (unsigned long) rec->time,
+				       rec->prefix, rec->prov,
+				       log_subsys[rec->subsys], rec->func,
+				       rec->line, log_levels[rec->level],
+				       rec->msg);
+			if (ret >= 0 && len + ret < sizeof(log_batch))
+				break;
+
+			/* a record never fills an empty batch */
+			assert(len);
+			ofi_log_write_batch(&len);
+		}
+		len += ret;
+		ofi_log_queue_release(log_queue, rec, pos);
+		cnt++;
+	}
+
+	ret = ofi_log_dropped(log_batch + len, sizeof(log_batch) - len);
+	if (ret > 0)
+		len += ret;
+
+	ofi_log_write_batch(&len);
+	return cnt;
+}
+
+static void *ofi_log_writer_thread(void *arg)
+{
+	while (!log_writer_stop) {
+		if (!ofi_log_drain())
+			usleep(OFI_LOG_POLL_US);
+	}
+	ofi_log_drain();
+	return NULL;
+}
+
+/* The writer thread does not survive fork.  The child logs synchronously
+ * and drops whatever the parent left in the ring.
+ */
+static void ofi_log_atfork_child(void)
+{
+	log_queue = NULL;
+}
+
+static bool ofi_log_queue_get(void)
+{
+	if (ofi_atomic_inc32(&log_queue_refs) & OFI_LOG_CLOSING) {
+		ofi_atomic_dec32(&log_queue_refs);
+		return false;
+	}
+	return true;
+}
+
+static void ofi_log_queue_put(void)
+{
+	ofi_atomic_dec32(&log_queue_refs);
+}
+
+/* Called with the ini lock held */
+static void ofi_log_async_init(void)
+{
+	int i;
+
+	for (i = 0; i < OFI_LOG_SITES; i++)
+		ofi_atomic_initialize32(&log_sites[i].count, 0);
+	ofi_atomic_initialize64(&log_dropped, 0);
+	ofi_atomic_initialize32(&log_queue_refs, 0);
+	log_dropped_reported = 0;
+
+	if (!log_async || !log_location)
+		return;
+
+	log_queue = ofi_log_queue_create(log_async);
+	if (!log_queue)
+		return;
+
+	log_writer_stop = 0;
+	if (pthread_create(&log_writer, NULL, ofi_log_writer_thread, NULL)) {
+		ofi_log_queue_free(log_queue);
+		log_queue = NULL;
+		return;
+	}
+
+	/* fi_log_init runs again after each fi_fini */
+	if (!log_atfork_set) {
+		pthread_atfork(NULL, NULL, ofi_log_atfork_child);
+		log_atfork_set = true;
+	}
+}
+
+static void ofi_log_async_fini(void)
+{
+	struct ofi_log_queue *queue = log_queue;
+	size_t len;
+
+	if (queue) {
+		/* Wait for callers still writing into the ring */
+		ofi_atomic_add32(&log_queue_refs, OFI_LOG_CLOSING);
+		while (ofi_atomic_get32(&log_queue_refs) != OFI_LOG_CLOSING)
+			sched_yield();
+
+		log_writer_stop = 1;
+		pthread_join(log_writer, NULL);
+		log_queue = NULL;
+		ofi_log_queue_free(queue);
+	}
+
+	/* Report messages dropped by rate limiting in synchronous mode */
+	if (log_location) {
+		len = ofi_log_dropped(log_batch, sizeof(log_batch));
+		ofi_log_write_batch(&len);
+	}
+}
+
 void fi_log_init(void)
 {
 	struct ofi_filter subsys_filter;
-	int level, i;
+	int level, i, rate = 0;
 	char *levelstr = NULL, *provstr = NULL, *subsysstr = NULL,
 		*locationstr = NULL;
 	int location_mode = 0600;
@@ -211,6 +472,25 @@ void fi_log_init(void)
 		fi_log_location_init(locationstr, location_mode);
 	else
 		log_location = stderr;
+
+	fi_param_define(NULL, "log_async", FI_PARAM_SIZE_T,
+			"Number of entries in a ring used to log "
+			"asynchronously.  When set, messages are formatted "
+			"into the ring by the calling thread and written in "
+			"batches by a background thread.  Messages are "
+			"dropped when the ring is full.  (default: 0, log "
+			"synchronously)");
+	fi_param_get_size_t(NULL, "log_async", &log_async);
+
+	fi_param_define(NULL, "log_rate", FI_PARAM_INT,
+			"Maximum number of messages per second logged from "
+			"a single call site.  Further messages are dropped "
+			"and counted.  (default: 0, unlimited)");
+	fi_param_get_int(NULL, "log_rate", &rate);
+
+	/* Reading the variables logs, so enable rate limiting last */
+	ofi_log_async_init();
+	log_rate = rate;
 }
 
 static int ofi_log_enabled(const struct fi_provider *prov,
@@ -388,6 +668,7 @@ void ofi_tostr_log_subsys(char *buf, size_t len, enum fi_log_subsys subsys)
 
 void fi_log_fini(void)
 {
+	ofi_log_async_fini();
 	ofi_free_filter(&prov_log_filter);
 	if (log_location != NULL && log_location != stderr
 		&& log_location != stdout) {
@@ -439,10 +720,21 @@ void DEFAULT_SYMVER_PRE(fi_log)(const struct fi_provider *prov, enum fi_log_leve
 		enum fi_log_subsys subsys, const char *func, int line,
 		const char *fmt, ...)
 {
-	char msg[1024];
+	char msg[OFI_LOG_MSG_SIZE];
 	int size = 0;
 	va_list vargs;
 
+	if (log_rate > 0 && !ofi_log_site_allow(func, line))
+		return;
+
+	if (log_queue && log_fid.ops->log == ofi_log && ofi_log_queue_get()) {
+		va_start(vargs, fmt);
+		ofi_log_async(prov, level, subsys, func, line, fmt, vargs);
+		va_end(vargs);
+		ofi_log_queue_put();
+		return;
+	}
+
 	va_start(vargs, fmt);
 	vsnprintf(msg + size, sizeof(msg) - size, fmt, vargs);
 	va_end(vargs);
@@ -41,6 +41,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 
 #include <ofi_mem.h>
@@ -64,11 +67,14 @@ static void signal_handler(int signal) {
 
 enum ms_formats {
 	MS_CSV=0,
+	MS_PROM,
+	MS_JSON,
 };
 
 struct ms_opts {
 	char *target_path;
 	char *output;
+	char *socket_path;
 	unsigned long watch_usec;
 	enum ms_formats format;
 };
@@ -82,6 +88,16 @@ struct file_entry {
 	bool is_mapped;
 	bool finalize;
 	bool header_written;
+
+	// exporter state: totals since the sampler started, last delta
+	unsigned int pid;
+	unsigned long job_id;
+	char prov[64];
+	struct monitor_data total[mon_api_size];
+	struct monitor_data delta[mon_api_size];
+	uint64_t flush_ns;
+	double interval;
+	bool fresh;
 };
 
 struct ct_mon_sampler {
@@ -89,6 +105,12 @@ struct ct_mon_sampler {
 	struct monitor_data data[mon_api_size];
 	mode_t target_mode;
 	struct file_entry *files;
+
+	// totals of processes that have finished, kept in node totals
+	struct monitor_data retired[mon_api_size];
+	int listen_fd;
+	char *snapshot;
+	size_t snapshot_len;
 };
 
 // Note: keep in-sync with prov/hook/monitor/include/hook_monitor.h
@@ -107,6 +129,7 @@ static const char *mon_functions[] = {
 	"mon_cq_sread",     "mon_cq_sreadfrom", "mon_cq_ctx",
 	"mon_cq_msg_tx",    "mon_cq_msg_rx",    "mon_cq_data_tx",
 	"mon_cq_data_rx",   "mon_cq_tagged_tx", "mon_cq_tagged_rx",
+	"mon_xfer_tx",      "mon_xfer_rx",
 };
 
 static const char* mon_buckets[] = {
@@ -165,10 +188,358 @@ static void ms_output_data(struct ct_mon_sampler *ct,
 		ms_write_csv(ct->data, file);
 		break;
 	default:
+		// exporter formats are written once per round, see ms_export
 		break;
 	}
 }
 
+/*******************************************************************************
+ *                         Exporter Functions
+ ******************************************************************************/
+
+struct ms_rate {
+	double count[MON_SIZE_MAX];
+	double sum[MON_SIZE_MAX];
+};
+
+enum ms_metric {
+	MS_CALLS,
+	MS_BYTES,
+	MS_CALL_RATE,
+	MS_BYTE_RATE,
+	MS_METRIC_MAX
+};
+
+static const struct {
+	const char *name;
+	const char *type;
+	const char *help;
+} ms_metrics[] = {
+	{ "calls_total", "counter", "API calls by size class" },
+	{ "bytes_total", "counter", "Bytes handled by size class" },
+	{ "calls_per_second", "gauge",
+	  "API calls per second between the last two samples" },
+	{ "bytes_per_second", "gauge",
+	  "Bytes per second between the last two samples" },
+};
+
+static const char *ms_api_name(int api) {
+	return mon_functions[api] + strlen("mon_");
+}
+
+static void ms_file_rate(struct file_entry *file,
+			 struct ms_rate rate[mon_api_size]) {
+	memset(rate, 0, sizeof(*rate) * mon_api_size);
+	if (file->interval <= 0)
+		return;
+
+	for (int i = 0; i < mon_api_size; i++) {
+		for (int j = 0; j < MON_SIZE_MAX; j++) {
+			rate[i].count[j] = file->delta[i].count[j] / file->interval;
+			rate[i].sum[j] = file->delta[i].sum[j] / file->interval;
+		}
+	}
+}
+
+// node totals include processes that have finished, rates only live ones
+static int ms_node_data(struct ct_mon_sampler *ct,
+			struct monitor_data total[mon_api_size],
+			struct monitor_data delta[mon_api_size],
+			struct ms_rate rate[mon_api_size]) {
+	struct ms_rate file_rate[mon_api_size];
+	int procs = 0;
+
+	memcpy(total, ct->retired, sizeof(ct->retired));
+	memset(delta, 0, sizeof(*delta) * mon_api_size);
+	memset(rate, 0, sizeof(*rate) * mon_api_size);
+
+	for (struct file_entry *f = ct->files; f != NULL; f = f->next) {
+		if (!f->is_mapped)
+			continue;
+		procs++;
+		ms_file_rate(f, file_rate);
+		for (int i = 0; i < mon_api_size; i++) {
+			for (int j = 0; j < MON_SIZE_MAX; j++) {
+				total[i].count[j] += f->total[i].count[j];
+				total[i].sum[j] += f->total[i].sum[j];
+				rate[i].count[j] += file_rate[i].count[j];
+				rate[i].sum[j] += file_rate[i].sum[j];
+				if (!f->fresh)
+					continue;
+				delta[i].count[j] += f->delta[i].count[j];
+				delta[i].sum[j] += f->delta[i].sum[j];
+			}
+		}
+	}
+	return procs;
+}
+
+// series are only exported once the API has been called in a size class
+static bool ms_prom_value(enum ms_metric metric, struct monitor_data *total,
+			  struct ms_rate *rate, int bucket, char *buf,
+			  size_t len) {
+	switch (metric) {
+	case MS_CALLS:
+		snprintf(buf, len, "%" PRIu64, total->count[bucket]);
+		return total->count[bucket] != 0;
+	case MS_BYTES:
+		snprintf(buf, len, "%" PRIu64, total->sum[bucket]);
+		return total->sum[bucket] != 0;
+	case MS_CALL_RATE:
+		snprintf(buf, len, "%.3f", rate->count[bucket]);
+		return total->count[bucket] != 0;
+	case MS_BYTE_RATE:
+		snprintf(buf, len, "%.3f", rate->sum[bucket]);
+		return total->sum[bucket] != 0;
+	default:
+		return false;
+	}
+}
+
+static void ms_write_prom(struct ct_mon_sampler *ct, FILE *out) {
+	struct monitor_data total[mon_api_size], delta[mon_api_size];
+	struct ms_rate rate[mon_api_size];
+	char value[32];
+
+	for (int m = 0; m < MS_METRIC_MAX; m++) {
+		fprintf(out, "# HELP ofi_mon_%s %s\n# TYPE ofi_mon_%s %s\n",
+			ms_metrics[m].name, ms_metrics[m].help,
+			ms_metrics[m].name, ms_metrics[m].type);
+		for (struct file_entry *f = ct->files; f != NULL; f = f->next) {
+			if (!f->is_mapped)
+				continue;
+			ms_file_rate(f, rate);
+			for (int i = 0; i < mon_api_size; i++) {
+				for (int j = 0; j < MON_SIZE_MAX; j++) {
+					if (!ms_prom_value(m, &f->total[i], &rate[i],
+							   j, value, sizeof(value)))
+						continue;
+					fprintf(out, "ofi_mon_%s{pid=\"%u\",job=\"%lu\","
+						"prov=\"%s\",api=\"%s\",size=\"%s\"} %s\n",
+						ms_metrics[m].name, f->pid, f->job_id,
+						f->prov, ms_api_name(i), mon_buckets[j],
+						value);
+				}
+			}
+		}
+	}
+
+	ms_node_data(ct, total, delta, rate);
+	for (int m = 0; m < MS_METRIC_MAX; m++) {
+		fprintf(out, "# HELP ofi_mon_node_%s %s, all processes\n"
+			"# TYPE ofi_mon_node_%s %s\n",
+			ms_metrics[m].name, ms_metrics[m].help,
+			ms_metrics[m].name, ms_metrics[m].type);
+		for (int i = 0; i < mon_api_size; i++) {
+			for (int j = 0; j < MON_SIZE_MAX; j++) {
+				if (!ms_prom_value(m, &total[i], &rate[i], j,
+						   value, sizeof(value)))
+					continue;
+				fprintf(out, "ofi_mon_node_%s{api=\"%s\",size=\"%s\"} %s\n",
+					ms_metrics[m].name, ms_api_name(i),
+					mon_buckets[j], value);
+			}
+		}
+	}
+}
+
+static void ms_write_json_data(FILE *out, struct monitor_data total[mon_api_size],
+			       struct monitor_data delta[mon_api_size],
+			       struct ms_rate rate[mon_api_size]) {
+	bool first = true;
+
+	fprintf(out, "\"data\":[");
+	for (int i = 0; i < mon_api_size; i++) {
+		for (int j = 0; j < MON_SIZE_MAX; j++) {
+			if (!total[i].count[j])
+				continue;
+			fprintf(out, "%s{\"api\":\"%s\",\"size\":\"%s\","
+				"\"calls\":%" PRIu64 ",\"bytes\":%" PRIu64 ","
+				"\"calls_total\":%" PRIu64 ",\"bytes_total\":%" PRIu64 ","
+				"\"calls_per_s\":%.3f,\"bytes_per_s\":%.3f}",
+				first ? "" : ",", ms_api_name(i), mon_buckets[j],
+				delta[i].count[j], delta[i].sum[j],
+				total[i].count[j], total[i].sum[j],
+				rate[i].count[j], rate[i].sum[j]);
+			first = false;
+		}
+	}
+	fprintf(out, "]}\n");
+}
+
+// one line per process with new data, then one line for the node
+static void ms_write_json(struct ct_mon_sampler *ct, FILE *out) {
+	struct monitor_data total[mon_api_size], delta[mon_api_size];
+	struct ms_rate rate[mon_api_size];
+	struct timespec ts;
+	uint64_t now;
+	int procs;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	now = (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+
+	for (struct file_entry *f = ct->files; f != NULL; f = f->next) {
+		if (!f->is_mapped || !f->fresh)
+			continue;
+		ms_file_rate(f, rate);
+		fprintf(out, "{\"time_ms\":%" PRIu64 ",\"pid\":%u,\"job\":%lu,"
+			"\"prov\":\"%s\",\"interval_s\":%.3f,",
+			now, f->pid, f->job_id, f->prov, f->interval);
+		ms_write_json_data(out, f->total, f->delta, rate);
+	}
+
+	procs = ms_node_data(ct, total, delta, rate);
+	fprintf(out, "{\"time_ms\":%" PRIu64 ",\"node\":true,\"procs\":%d,",
+		now, procs);
+	ms_write_json_data(out, total, delta, rate);
+}
+
+/*
+ * Prometheus output files are replaced atomically, so the textfile
+ * collector of node_exporter never reads a partial sample.  JSON lines
+ * are appended.
+ */
+static int ms_export(struct ct_mon_sampler *ct) {
+	char tmp_path[PATH_MAX];
+	char *buf = NULL;
+	size_t len = 0;
+	FILE *out;
+
+	out = open_memstream(&buf, &len);
+	if (out == NULL)
+		return -ENOMEM;
+	if (ct->opts.format == MS_PROM)
+		ms_write_prom(ct, out);
+	else
+		ms_write_json(ct, out);
+	fclose(out);
+
+	free(ct->snapshot);
+	ct->snapshot = buf;
+	ct->snapshot_len = len;
+
+	if (ct->opts.output == NULL) {
+		if (ct->opts.socket_path == NULL) {
+			fwrite(buf, 1, len, stdout);
+			fflush(stdout);
+		}
+		return 0;
+	}
+
+	if (ct->opts.format == MS_JSON) {
+		out = fopen(ct->opts.output, "a");
+		if (out == NULL) {
+			fprintf(stderr, "Could not open %s: %s\n",
+				ct->opts.output, strerror(errno));
+			return -errno;
+		}
+		fwrite(buf, 1, len, out);
+		fclose(out);
+		return 0;
+	}
+
+	if (snprintf(tmp_path, PATH_MAX, "%s.tmp", ct->opts.output) >= PATH_MAX)
+		return -ENAMETOOLONG;
+	out = fopen(tmp_path, "w");
+	if (out == NULL) {
+		fprintf(stderr, "Could not open %s: %s\n", tmp_path,
+			strerror(errno));
+		return -errno;
+	}
+	fwrite(buf, 1, len, out);
+	if (fclose(out) != 0 || rename(tmp_path, ct->opts.output) != 0) {
+		fprintf(stderr, "Could not write %s: %s\n", ct->opts.output,
+			strerror(errno));
+		unlink(tmp_path);
+		return -errno;
+	}
+	return 0;
+}
+
+/*******************************************************************************
+ *                         Socket Functions
+ ******************************************************************************/
+
+static int ms_listen(struct ct_mon_sampler *ct) {
+	struct sockaddr_un addr = { .sun_family = AF_UNIX };
+
+	if (strlen(ct->opts.socket_path) >= sizeof(addr.sun_path)) {
+		fprintf(stderr, "Socket path too long: %s\n",
+			ct->opts.socket_path);
+		return -ENAMETOOLONG;
+	}
+	strcpy(addr.sun_path, ct->opts.socket_path);
+
+	ct->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (ct->listen_fd < 0)
+		return -errno;
+
+	unlink(ct->opts.socket_path);
+	if (bind(ct->listen_fd, (struct sockaddr *) &addr, sizeof(addr)) ||
+	    listen(ct->listen_fd, 16)) {
+		fprintf(stderr, "Could not listen on %s: %s\n",
+			ct->opts.socket_path, strerror(errno));
+		close(ct->listen_fd);
+		ct->listen_fd = -1;
+		return -errno;
+	}
+	return 0;
+}
+
+/*
+ * Every connection gets the latest sample and is closed.  Clients that
+ * send an HTTP GET request, like curl --unix-socket or a Prometheus
+ * scraper behind a proxy, get an HTTP response.
+ */
+static void ms_reply(struct ct_mon_sampler *ct, int fd) {
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+	char req[1024], hdr[256];
+	ssize_t len = 0;
+	int hdr_len;
+
+	if (poll(&pfd, 1, 100) > 0)
+		len = recv(fd, req, sizeof(req), MSG_DONTWAIT);
+
+	if (len >= 4 && !strncmp(req, "GET ", 4)) {
+		hdr_len = snprintf(hdr, sizeof(hdr),
+				   "HTTP/1.0 200 OK\r\nContent-Type: %s\r\n"
+				   "Content-Length: %zu\r\n\r\n",
+				   ct->opts.format == MS_PROM ?
+				   "text/plain; version=0.0.4" :
+				   "application/x-ndjson",
+				   ct->snapshot_len);
+		if (send(fd, hdr, hdr_len, MSG_NOSIGNAL) != hdr_len)
+			return;
+	}
+	if (ct->snapshot_len)
+		send(fd, ct->snapshot, ct->snapshot_len, MSG_NOSIGNAL);
+}
+
+static uint64_t ms_now_us(void) {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// serve clients until the next sample is due
+static void ms_serve(struct ct_mon_sampler *ct, unsigned long usec) {
+	struct pollfd pfd = { .fd = ct->listen_fd, .events = POLLIN };
+	uint64_t end = ms_now_us() + usec;
+	uint64_t now;
+	int fd;
+
+	while (running && (now = ms_now_us()) < end) {
+		if (poll(&pfd, 1, (int) ((end - now + 999) / 1000)) <= 0)
+			continue;
+		fd = accept(ct->listen_fd, NULL, NULL);
+		if (fd < 0)
+			continue;
+		ms_reply(ct, fd);
+		close(fd);
+	}
+}
+
 /*******************************************************************************
  *                         Resource Management Functions
  ******************************************************************************/
@@ -200,6 +571,13 @@ void ms_add_file_entry(struct ct_mon_sampler *ct, struct file_entry *entry) {
 
 struct file_entry* ms_remove_file_entry(struct ct_mon_sampler *ct,
 					struct file_entry *entry) {
+	for (int i = 0; i < mon_api_size; i++) {
+		for (int j = 0; j < MON_SIZE_MAX; j++) {
+			ct->retired[i].count[j] += entry->total[i].count[j];
+			ct->retired[i].sum[j] += entry->total[i].sum[j];
+		}
+	}
+
 	if (ct->files == entry) {
 		ct->files = ct->files->next;
 		ms_free_file_entry(entry);
@@ -239,6 +617,18 @@ int ms_create_file_entry(struct ct_mon_sampler *ct, struct file_entry *file) {
 	}
 	file->is_mapped = true;
 
+	// <ppid>_<pid>_<sequential id>_<job id>_<provider name>
+	char name[PATH_MAX];
+	unsigned int ppid;
+	strncpy(name, file->in_path, PATH_MAX - 1);
+	name[PATH_MAX - 1] = '\0';
+	if (sscanf(basename(name), "%u_%u_%*u_%lu_%63s", &ppid, &file->pid,
+		   &file->job_id, file->prov) != 4)
+		snprintf(file->prov, sizeof(file->prov), "unknown");
+
+	if (ct->opts.format != MS_CSV)
+		return 0;
+
 	char format[16] = "";
 	switch (ct->opts.format) {
 	case MS_CSV:
@@ -360,6 +750,12 @@ static void ms_cleanup(struct ct_mon_sampler *ct) {
 		free(del_ptr);
 	}
 	ct->files = NULL;
+
+	if (ct->listen_fd >= 0) {
+		close(ct->listen_fd);
+		unlink(ct->opts.socket_path);
+	}
+	free(ct->snapshot);
 }
 
 /*******************************************************************************
@@ -372,6 +768,20 @@ static int ms_extract_data(struct ct_mon_sampler *ct, struct file_entry *entry)
 		return -1;
 
 	memcpy(ct->data, entry->share, sizeof (ct->data));
+	uint64_t flush_ns = entry->share->flush_ns;
+
+	// each sample holds the delta since the previous flush of the hook
+	memcpy(entry->delta, ct->data, sizeof (entry->delta));
+	for (int i = 0; i < mon_api_size; i++) {
+		for (int j = 0; j < MON_SIZE_MAX; j++) {
+			entry->total[i].count[j] += ct->data[i].count[j];
+			entry->total[i].sum[j] += ct->data[i].sum[j];
+		}
+	}
+	entry->interval = entry->flush_ns && flush_ns > entry->flush_ns ?
+			  (flush_ns - entry->flush_ns) / 1e9 : 0;
+	entry->flush_ns = flush_ns;
+	entry->fresh = true;
 
 	// set request bit again
 	entry->share->flags |= 0b1;
@@ -395,6 +805,7 @@ int ms_run(struct ct_mon_sampler *ct) {
 
 	struct file_entry *file_ptr = ct->files;
 	while (file_ptr != NULL) {
+		file_ptr->fresh = false;
 		ret = ms_extract_data(ct, file_ptr);
 
 		switch (ret) {
@@ -408,6 +819,8 @@ int ms_run(struct ct_mon_sampler *ct) {
 		file_ptr = file_ptr->next;
 	}
 
+	if (ct->opts.format != MS_CSV)
+		return ms_export(ct);
 	return 0;
 }
 
@@ -427,9 +840,11 @@ static void ms_usage(char *name) {
 	fprintf(stderr, " %-20s %s\n", "-w <msec>",
 		"watch file for changes, wait <msec> milliseconds between checks");
 	fprintf(stderr, " %-20s %s\n", "-f <format>",
-		"output format (CSV)");
+		"output format (csv, prom, json)");
 	fprintf(stderr, " %-20s %s\n", "-o <outpath>",
 		"output file (stdout if unset)");
+	fprintf(stderr, " %-20s %s\n", "-s <socket>",
+		"serve the latest prom or json sample on a unix socket");
 }
 
 static int ms_parse_opts(struct ct_mon_sampler *ct, int op, char *current_optarg) {
@@ -446,9 +861,12 @@ static int ms_parse_opts(struct ct_mon_sampler *ct, int op, char *current_optarg
 		ct->opts.watch_usec = out * 1000;
 		break;
 	case 'f':
-		if ((strlen(current_optarg) == 3) &&
-		    strncasecmp("csv", current_optarg, 3) == 0) {
+		if (strcasecmp("csv", current_optarg) == 0) {
 			ct->opts.format = MS_CSV;
+		} else if (strcasecmp("prom", current_optarg) == 0) {
+			ct->opts.format = MS_PROM;
+		} else if (strcasecmp("json", current_optarg) == 0) {
+			ct->opts.format = MS_JSON;
 		} else {
 			fprintf(stderr, "Invalid format '%s'\n",
 				current_optarg);
@@ -458,6 +876,9 @@ static int ms_parse_opts(struct ct_mon_sampler *ct, int op, char *current_optarg
 	case 'o':
 		ct->opts.output = current_optarg;
 		break;
+	case 's':
+		ct->opts.socket_path = current_optarg;
+		break;
 	default:
 		break;
 	}
@@ -466,9 +887,9 @@ static int ms_parse_opts(struct ct_mon_sampler *ct, int op, char *current_optarg
 
 int main(int argc, char **argv) {
 	int op, ret = EXIT_SUCCESS;
-	struct ct_mon_sampler ct = {};
+	struct ct_mon_sampler ct = { .listen_fd = -1 };
 
-	while ((op = getopt(argc, argv, "hw:f:o:")) != -1) {
+	while ((op = getopt(argc, argv, "hw:f:o:s:")) != -1) {
 		switch (op) {
 		default:
 			ret = ms_parse_opts(&ct, op, optarg);
@@ -496,10 +917,20 @@ int main(int argc, char **argv) {
 	}
 	ct.opts.target_path = argv[optind];
 	ct.target_mode = st.st_mode;
-	if (S_ISDIR(ct.target_mode) && ct.opts.output == NULL) {
+	if (S_ISDIR(ct.target_mode) && ct.opts.output == NULL &&
+	    ct.opts.format == MS_CSV) {
 		fprintf(stderr, "Target is a directory, cannot use stdout as output!\n");
 		return -ENOENT;
 	}
+	if (ct.opts.socket_path != NULL) {
+		if (ct.opts.format == MS_CSV || ct.opts.watch_usec == 0) {
+			fprintf(stderr, "-s requires -w and the prom or json format\n");
+			return -EINVAL;
+		}
+		ret = ms_listen(&ct);
+		if (ret != 0)
+			return ret;
+	}
 
 
 	signal(SIGINT, signal_handler);
@@ -507,7 +938,10 @@ int main(int argc, char **argv) {
 
 	do {
 		ret = ms_run(&ct);
-		usleep(ct.opts.watch_usec);
+		if (ct.listen_fd >= 0)
+			ms_serve(&ct, ct.opts.watch_usec);
+		else
+			usleep(ct.opts.watch_usec);
 	} while (running);
 
 	if (ret != 0)
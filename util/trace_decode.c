@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2024 Hewlett Packard Enterprise Development LP. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ * Decoder for the binary trace files written by ofi_hook_trace.
+ *
+ * The records of every ring are merged by timestamp and written as text,
+ * as a JSON array, or in the Chrome trace-event format, which can be
+ * loaded into chrome://tracing or Perfetto.  Files may be decoded while
+ * the traced process is still running; records overwritten during the
+ * read show up as out of place.
+ */
+
+#include <config.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <prov/hook/trace/include/hook_trace.h>
+
+enum decode_format {
+	DECODE_TEXT,
+	DECODE_JSON,
+	DECODE_CHROME,
+};
+
+struct decode_record {
+	struct trace_record rec;
+	uint64_t tid;
+};
+
+static const char *trace_op_str[] = {
+	TRACE_OPS(OFI_STR)
+};
+
+static const char *decode_op_name(uint16_t op)
+{
+	if (op >= trace_op_max)
+		return "unknown";
+	return trace_op_str[op] + strlen("trace_op_");
+}
+
+static bool decode_op_is_cq(uint16_t op)
+{
+	return op >= trace_op_cq_read && op < trace_op_max;
+}
+
+static int decode_cmp(const void *a, const void *b)
+{
+	const struct decode_record *ra = a, *rb = b;
+
+	if (ra->rec.ts != rb->rec.ts)
+		return ra->rec.ts < rb->rec.ts ? -1 : 1;
+	return ra->tid < rb->tid ? -1 : ra->tid > rb->tid;
+}
+
+static int decode_check(struct trace_file_hdr *hdr, size_t size,
+			const char *path)
+{
+	if (size < sizeof(*hdr) || hdr->magic != TRACE_MAGIC) {
+		fprintf(stderr, "%s is not a trace file\n", path);
+		return -FI_EINVAL;
+	}
+	if (hdr->version != TRACE_VERSION ||
+	    hdr->record_size != sizeof(struct trace_record)) {
+		fprintf(stderr, "%s: unsupported trace version %u, record "
+			"size %u\n", path, hdr->version, hdr->record_size);
+		return -FI_EINVAL;
+	}
+	if (!hdr->ring_size || size < trace_file_bytes(hdr)) {
+		fprintf(stderr, "%s is truncated\n", path);
+		return -FI_EINVAL;
+	}
+	return 0;
+}
+
+static struct decode_record *decode_collect(struct trace_file_hdr *hdr,
+					    size_t *cnt)
+{
+	struct decode_record *recs;
+	struct trace_ring_hdr *ring;
+	struct trace_record *ring_recs;
+	uint64_t head, pos;
+	uint32_t i, rings;
+	size_t n = 0;
+
+	rings = MIN(atomic_load(&hdr->rings_used), hdr->ring_cnt);
+	recs = calloc((size_t) rings * hdr->ring_size + 1, sizeof(*recs));
+	if (!recs)
+		return NULL;
+
+	for (i = 0; i < rings; i++) {
+		ring = trace_ring(hdr, i);
+		ring_recs = trace_ring_records(ring);
+		head = atomic_load_explicit(&ring->head, memory_order_acquire);
+		pos = head > hdr->ring_size ? head - hdr->ring_size : 0;
+		for (; pos < head; pos++) {
+			recs[n].rec = ring_recs[pos % hdr->ring_size];
+			recs[n].tid = ring->tid;
+			n++;
+		}
+	}
+
+	qsort(recs, n, sizeof(*recs), decode_cmp);
+	*cnt = n;
+	return recs;
+}
+
+static void decode_text(FILE *out, struct trace_file_hdr *hdr,
+			struct decode_record *recs, size_t cnt)
+{
+	struct trace_record *rec;
+	size_t i;
+
+	fprintf(out, "# pid %u, %u rings of %u records, %" PRIu64
+		" calls dropped\n", hdr->pid,
+		MIN(atomic_load(&hdr->rings_used), hdr->ring_cnt),
+		hdr->ring_size, atomic_load(&hdr->dropped));
+	fprintf(out, "# %14s %8s %-16s %-18s %-18s %10s %-18s %-18s %5s\n",
+		"time_us", "tid", "op", "fid", "context", "len",
+		"addr/flags", "tag/data", "ret");
+	for (i = 0; i < cnt; i++) {
+		rec = &recs[i].rec;
+		fprintf(out, "%16.3f %8" PRIu64 " %-16s 0x%016" PRIx64
+			" 0x%016" PRIx64 " %10" PRIu64 " 0x%016" PRIx64
+			" 0x%016" PRIx64 " %5d %uns\n",
+			(double) (rec->ts - hdr->start_ns) / 1000,
+			recs[i].tid, decode_op_name(rec->op), rec->fid,
+			rec->context, rec->len, rec->addr, rec->tag,
+			rec->ret, rec->dur);
+	}
+}
+
+static void decode_args(FILE *out, struct trace_record *rec)
+{
+	fprintf(out, "\"fid\":\"0x%" PRIx64 "\",\"context\":\"0x%" PRIx64
+		"\",\"len\":%" PRIu64 ",\"%s\":\"0x%" PRIx64
+		"\",\"%s\":\"0x%" PRIx64 "\",\"ret\":%d",
+		rec->fid, rec->context, rec->len,
+		decode_op_is_cq(rec->op) ? "flags" : "addr", rec->addr,
+		decode_op_is_cq(rec->op) ? "data" : "tag", rec->tag,
+		rec->ret);
+}
+
+static void decode_json(FILE *out, struct trace_file_hdr *hdr,
+			struct decode_record *recs, size_t cnt)
+{
+	size_t i;
+
+	fprintf(out, "{\"pid\":%u,\"start_wall_ns\":%" PRIu64
+		",\"dropped\":%" PRIu64 ",\"records\":[", hdr->pid,
+		hdr->start_wall_ns, atomic_load(&hdr->dropped));
+	for (i = 0; i < cnt; i++) {
+		fprintf(out, "%s\n{\"ts_ns\":%" PRIu64 ",\"dur_ns\":%u,"
+			"\"tid\":%" PRIu64 ",\"op\":\"%s\",", i ? "," : "",
+			recs[i].rec.ts - hdr->start_ns, recs[i].rec.dur,
+			recs[i].tid, decode_op_name(recs[i].rec.op));
+		decode_args(out, &recs[i].rec);
+		fprintf(out, "}");
+	}
+	fprintf(out, "\n]}\n");
+}
+
+static void decode_chrome(FILE *out, struct trace_file_hdr *hdr,
+			  struct decode_record *recs, size_t cnt)
+{
+	size_t i;
+
+	fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	for (i = 0; i < cnt; i++) {
+		fprintf(out, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+			"\"ts\":%.3f,\"dur\":%.3f,\"pid\":%u,\"tid\":%" PRIu64
+			",\"args\":{", i ? "," : "",
+			decode_op_name(recs[i].rec.op),
+			decode_op_is_cq(recs[i].rec.op) ? "cq" : "ep",
+			(double) (recs[i].rec.ts - hdr->start_ns) / 1000,
+			(double) recs[i].rec.dur / 1000, hdr->pid,
+			recs[i].tid);
+		decode_args(out, &recs[i].rec);
+		fprintf(out, "}}");
+	}
+	fprintf(out, "\n]}\n");
+}
+
+static void usage(char *name)
+{
+	printf("usage: %s [-f text|json|chrome] [-o output] trace_file\n", name);
+	printf("\t-f output format (default text)\n");
+	printf("\t-o write to output instead of stdout\n");
+}
+
+int main(int argc, char **argv)
+{
+	enum decode_format format = DECODE_TEXT;
+	struct trace_file_hdr *hdr = MAP_FAILED;
+	struct decode_record *recs = NULL;
+	char *out_path = NULL;
+	FILE *out = stdout;
+	struct stat st;
+	size_t cnt;
+	int op, fd, ret = 0;
+
+	while ((op = getopt(argc, argv, "f:o:h")) != -1) {
+		switch (op) {
+		case 'f':
+			if (!strcasecmp(optarg, "text")) {
+				format = DECODE_TEXT;
+			} else if (!strcasecmp(optarg, "json")) {
+				format = DECODE_JSON;
+			} else if (!strcasecmp(optarg, "chrome")) {
+				format = DECODE_CHROME;
+			} else {
+				usage(argv[0]);
+				return EXIT_FAILURE;
+			}
+			break;
+		case 'o':
+			out_path = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return op == 'h' ? 0 : EXIT_FAILURE;
+		}
+	}
+
+	if (optind != argc - 1) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	fd = open(argv[optind], O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "Could not open %s: %s\n", argv[optind],
+			strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	if (fstat(fd, &st)) {
+		fprintf(stderr, "Could not stat %s: %s\n", argv[optind],
+			strerror(errno));
+		ret = -FI_EIO;
+		goto out;
+	}
+
+	hdr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED) {
+		fprintf(stderr, "Could not mmap %s: %s\n", argv[optind],
+			strerror(errno));
+		ret = -FI_EIO;
+		goto out;
+	}
+
+	ret = decode_check(hdr, st.st_size, argv[optind]);
+	if (ret)
+		goto out;
+
+	recs = decode_collect(hdr, &cnt);
+	if (!recs) {
+		fprintf(stderr, "out of memory\n");
+		ret = -FI_ENOMEM;
+		goto out;
+	}
+
+	if (out_path) {
+		out = fopen(out_path, "w");
+		if (!out) {
+			fprintf(stderr, "Could not open %s: %s\n", out_path,
+				strerror(errno));
+			ret = -FI_EIO;
+			goto out;
+		}
+	}
+
+	switch (format) {
+	case DECODE_TEXT:
+		decode_text(out, hdr, recs, cnt);
+		break;
+	case DECODE_JSON:
+		decode_json(out, hdr, recs, cnt);
+		break;
+	case DECODE_CHROME:
+		decode_chrome(out, hdr, recs, cnt);
+		break;
+	}
+
+	if (out != stdout && fclose(out)) {
+		fprintf(stderr, "Could not write %s: %s\n", out_path,
+			strerror(errno));
+		ret = -FI_EIO;
+	}
+out:
+	free(recs);
+	if (hdr != MAP_FAILED)
+		munmap(hdr, st.st_size);
+	close(fd);
+	return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+}